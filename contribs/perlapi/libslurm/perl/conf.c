@@ -44,6 +44,7 @@ slurm_ctl_conf_to_hv(slurm_ctl_conf_t *conf, HV *hv)
 	if(conf->cluster_name)
 		STORE_FIELD(hv, conf, cluster_name, charp);
 	STORE_FIELD(hv, conf, complete_wait, uint16_t);
+	STORE_FIELD(hv, conf, conn_cache_size, uint16_t);
 	
 	if(conf->control_addr)
 		STORE_FIELD(hv, conf, control_addr, charp);
@@ -266,6 +267,7 @@ hv_to_slurm_ctl_conf(HV *hv, slurm_ctl_conf_t *conf)
 	FETCH_FIELD(hv, conf, checkpoint_type, charp, FALSE);
 	FETCH_FIELD(hv, conf, cluster_name, charp, FALSE);
 	FETCH_FIELD(hv, conf, complete_wait, uint16_t, TRUE);
+	FETCH_FIELD(hv, conf, conn_cache_size, uint16_t, FALSE);
 
 	FETCH_FIELD(hv, conf, control_addr, charp, FALSE);
 	FETCH_FIELD(hv, conf, control_machine, charp, FALSE);
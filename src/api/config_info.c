@@ -246,6 +246,13 @@ extern void *slurm_ctl_conf_2_key_pairs (slurm_ctl_conf_t* slurm_ctl_conf_ptr)
 	key_pair->value = xstrdup(tmp_str);
 	list_append(ret_list, key_pair);
 
+	snprintf(tmp_str, sizeof(tmp_str), "%u",
+		 slurm_ctl_conf_ptr->conn_cache_size);
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ConnCacheSize");
+	key_pair->value = xstrdup(tmp_str);
+	list_append(ret_list, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("ControlAddr");
 	key_pair->value = xstrdup(slurm_ctl_conf_ptr->control_addr);
@@ -1251,6 +1258,19 @@ void slurm_print_slurmd_status (FILE* out,
 		slurmd_status_ptr->slurmd_logfile);
 	fprintf(out, "Version                  = %s\n",
 		slurmd_status_ptr->version);
+	if (slurmd_status_ptr->rpc_stats) {
+		char *line, *save_ptr = NULL;
+		char *stats = xstrdup(slurmd_status_ptr->rpc_stats);
+		char *title = "RPC lanes                =";
+
+		line = strtok_r(stats, "\n", &save_ptr);
+		while (line) {
+			fprintf(out, "%s %s\n", title, line);
+			title = "                          ";
+			line = strtok_r(NULL, "\n", &save_ptr);
+		}
+		xfree(stats);
+	}
 	return;
 }
 
@@ -863,6 +863,119 @@ slurm_load_jobs (time_t update_time, job_info_msg_t **resp,
 	return SLURM_PROTOCOL_SUCCESS ;
 }
 
+static int _cmp_job_id(const void *x, const void *y)
+{
+	uint32_t job_id_x = *(uint32_t *) x;
+	uint32_t job_id_y = *(uint32_t *) y;
+
+	if (job_id_x < job_id_y)
+		return -1;
+	if (job_id_x > job_id_y)
+		return 1;
+	return 0;
+}
+
+/* Merge an incremental job information response with the previous response,
+ * moving unchanged job records out of old_job_ptr */
+static job_info_msg_t *_merge_job_info(job_info_msg_t *old_job_ptr,
+				       job_info_delta_msg_t *delta_ptr)
+{
+	job_info_msg_t *new_job_ptr = delta_ptr->job_info;
+	job_info_t *job_array;
+	uint32_t *job_ids, job_id_cnt, i, j;
+
+	/* Sorted IDs of changed and removed jobs */
+	job_id_cnt = new_job_ptr->record_count + delta_ptr->removed_cnt;
+	job_ids = xmalloc(sizeof(uint32_t) * (job_id_cnt + 1));
+	for (i = 0; i < new_job_ptr->record_count; i++)
+		job_ids[i] = new_job_ptr->job_array[i].job_id;
+	for (j = 0; j < delta_ptr->removed_cnt; j++)
+		job_ids[i++] = delta_ptr->removed_ids[j];
+	qsort(job_ids, job_id_cnt, sizeof(uint32_t), _cmp_job_id);
+
+	job_array = xmalloc(sizeof(job_info_t) *
+			    (new_job_ptr->record_count +
+			     old_job_ptr->record_count + 1));
+	memcpy(job_array, new_job_ptr->job_array,
+	       sizeof(job_info_t) * new_job_ptr->record_count);
+	j = new_job_ptr->record_count;
+	for (i = 0; i < old_job_ptr->record_count; i++) {
+		if (bsearch(&old_job_ptr->job_array[i].job_id, job_ids,
+			    job_id_cnt, sizeof(uint32_t), _cmp_job_id))
+			continue;
+		memcpy(&job_array[j++], &old_job_ptr->job_array[i],
+		       sizeof(job_info_t));
+		memset(&old_job_ptr->job_array[i], 0, sizeof(job_info_t));
+	}
+	xfree(job_ids);
+
+	xfree(new_job_ptr->job_array);
+	new_job_ptr->job_array = job_array;
+	new_job_ptr->record_count = j;
+	delta_ptr->job_info = NULL;
+	return new_job_ptr;
+}
+
+/*
+ * slurm_load_jobs_delta - issue RPC to get slurm job information changed
+ *	since a previous response and merge it with that response
+ * IN old_job_info_ptr - job information from a previous slurm_load_jobs()
+ *	or slurm_load_jobs_delta() call, or NULL to load all job information
+ * IN job_info_msg_pptr - place to store a job configuration pointer
+ * IN show_flags - job filtering options, as used for old_job_info_ptr
+ * RET 0 or -1 on error
+ * NOTE: Unchanged job records are moved from old_job_info_ptr, which must
+ *	still be freed (and no longer used) if the call succeeds
+ * NOTE: free the response using slurm_free_job_info_msg
+ */
+extern int
+slurm_load_jobs_delta (job_info_msg_t *old_job_ptr, job_info_msg_t **resp,
+		       uint16_t show_flags)
+{
+	int rc;
+	slurm_msg_t resp_msg;
+	slurm_msg_t req_msg;
+	job_info_request_msg_t req;
+	job_info_delta_msg_t *delta_ptr;
+
+	if (old_job_ptr == NULL)
+		return slurm_load_jobs((time_t) NULL, resp, show_flags);
+
+	slurm_msg_t_init(&req_msg);
+	slurm_msg_t_init(&resp_msg);
+
+	req.last_update  = old_job_ptr->last_update;
+	req.show_flags = show_flags;
+	req_msg.msg_type = REQUEST_JOB_INFO_DELTA;
+	req_msg.data     = &req;
+
+	if (slurm_send_recv_controller_msg(&req_msg, &resp_msg) < 0)
+		return SLURM_ERROR;
+
+	switch (resp_msg.msg_type) {
+	case RESPONSE_JOB_INFO_DELTA:
+		delta_ptr = (job_info_delta_msg_t *) resp_msg.data;
+		if (delta_ptr->full) {
+			*resp = delta_ptr->job_info;
+			delta_ptr->job_info = NULL;
+		} else
+			*resp = _merge_job_info(old_job_ptr, delta_ptr);
+		slurm_free_job_info_delta_msg(delta_ptr);
+		break;
+	case RESPONSE_SLURM_RC:
+		rc = ((return_code_msg_t *) resp_msg.data)->return_code;
+		slurm_free_return_code_msg(resp_msg.data);
+		if (rc)
+			slurm_seterrno_ret(rc);
+		break;
+	default:
+		slurm_seterrno_ret(SLURM_UNEXPECTED_MSG_ERROR);
+		break;
+	}
+
+	return SLURM_PROTOCOL_SUCCESS ;
+}
+
 /*
  * slurm_load_job - issue RPC to get job information for one job ID
  * IN job_info_msg_pptr - place to store a job configuration pointer
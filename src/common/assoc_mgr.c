@@ -36,9 +36,15 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE	/* pthread_rwlockattr_setkind_np() */
+#endif
+
 #include "assoc_mgr.h"
 
+#include <sys/time.h>
 #include <sys/types.h>
+#include <ctype.h>
 #include <pwd.h>
 #include <fcntl.h>
 
@@ -59,7 +65,6 @@ List assoc_mgr_wckey_list = NULL;
 
 static char *assoc_mgr_cluster_name = NULL;
 static int setup_children = 0;
-static assoc_mgr_lock_flags_t assoc_mgr_locks;
 
 void (*remove_assoc_notify) (slurmdb_association_rec_t *rec) = NULL;
 void (*remove_qos_notify) (slurmdb_qos_rec_t *rec) = NULL;
@@ -67,8 +72,39 @@ void (*update_assoc_notify) (slurmdb_association_rec_t *rec) = NULL;
 void (*update_qos_notify) (slurmdb_qos_rec_t *rec) = NULL;
 void (*update_resvs) () = NULL;
 
-static pthread_mutex_t locks_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t locks_cond = PTHREAD_COND_INITIALIZER;
+/* One reader-writer lock per assoc_mgr_lock_datatype_t, set up once by
+ * _init_locks() to prefer writers so a waiting update is not starved by
+ * a steady stream of readers */
+static pthread_rwlock_t assoc_mgr_locks[ASSOC_MGR_ENTITY_COUNT];
+static pthread_once_t assoc_mgr_locks_once = PTHREAD_ONCE_INIT;
+
+/* Lock statistics indexed by [datatype][0=read, 1=write], updated with
+ * atomic operations so the uncontended path takes no other lock */
+typedef struct {
+	uint32_t cnt;		/* acquisitions */
+	uint32_t wait_cnt;	/* acquisitions which had to block */
+	uint64_t wait_usec;	/* total time blocked */
+	uint64_t wait_max_usec;	/* longest time blocked */
+} assoc_lock_stats_t;
+
+static assoc_lock_stats_t assoc_mgr_lock_stats[ASSOC_MGR_ENTITY_COUNT][2];
+
+/* Hash indexes of assoc_mgr_association_list, by id and by (uid, acct,
+ * partition), protected by the ASSOC lock. assoc_index holds the
+ * associations in list order, the hash tables the first entry of each
+ * bucket (-1 if empty). assoc_index_size is 0 while there is no index. */
+typedef struct {
+	slurmdb_association_rec_t *assoc;
+	int next_id;
+	int next_key;
+} assoc_index_t;
+
+static assoc_index_t *assoc_index = NULL;
+static int *assoc_id_hash = NULL;
+static int *assoc_key_hash = NULL;
+static uint32_t assoc_index_size = 0;
+
+static void _rebuild_assoc_index(void);
 
 /* you should check for assoc == NULL before this function */
 static void _normalize_assoc_shares(slurmdb_association_rec_t *assoc)
@@ -177,6 +213,7 @@ static int _change_user_name(slurmdb_user_rec_t *user)
 			}
 		}
 		list_iterator_destroy(itr);
+		_rebuild_assoc_index();
 	}
 
 	if (assoc_mgr_wckey_list) {
@@ -481,6 +518,215 @@ static void _set_qos_norm_priority(slurmdb_qos_rec_t *qos)
 		(double)qos->priority / (double)g_qos_max_priority;
 }
 
+/* Hash a (uid, acct, partition) key, names are case insensitive */
+static uint32_t _assoc_key_hash(uint32_t uid, char *acct, char *partition)
+{
+	uint32_t hash = uid;
+
+	if (acct) {
+		for ( ; *acct; acct++)
+			hash = (hash * 31) + tolower((int)*acct);
+	}
+	hash = (hash * 31) + '/';
+	if (partition) {
+		for ( ; *partition; partition++)
+			hash = (hash * 31) + tolower((int)*partition);
+	}
+	return hash & (assoc_index_size - 1);
+}
+
+/* locks should be put in place before calling this function ASSOC_WRITE
+ * Rebuild the id and key indexes of assoc_mgr_association_list. Entries
+ * are chained in list order, so a lookup returns the same association as
+ * a walk of the list. */
+static void _rebuild_assoc_index(void)
+{
+	slurmdb_association_rec_t *assoc = NULL;
+	ListIterator itr = NULL;
+	uint32_t hash, size = 1;
+	int cnt = 0, i;
+
+	xfree(assoc_index);
+	xfree(assoc_id_hash);
+	xfree(assoc_key_hash);
+	assoc_index_size = 0;
+
+	if (!assoc_mgr_association_list
+	    || !(cnt = list_count(assoc_mgr_association_list)))
+		return;
+
+	assoc_index = xmalloc(sizeof(assoc_index_t) * cnt);
+	cnt = 0;
+	itr = list_iterator_create(assoc_mgr_association_list);
+	while ((assoc = list_next(itr))) {
+		/* An association without an account matches any account
+		 * so it can't be hashed, just walk the list. */
+		if (!assoc->acct) {
+			debug("association %u has no account, "
+			      "not indexing associations", assoc->id);
+			list_iterator_destroy(itr);
+			xfree(assoc_index);
+			return;
+		}
+		assoc_index[cnt++].assoc = assoc;
+	}
+	list_iterator_destroy(itr);
+
+	while (size < (cnt * 2))
+		size <<= 1;
+	assoc_index_size = size;
+	assoc_id_hash  = xmalloc(sizeof(int) * size);
+	assoc_key_hash = xmalloc(sizeof(int) * size);
+	for (i = 0; i < size; i++)
+		assoc_id_hash[i] = assoc_key_hash[i] = -1;
+
+	for (i = cnt - 1; i >= 0; i--) {
+		assoc = assoc_index[i].assoc;
+		hash = assoc->id & (size - 1);
+		assoc_index[i].next_id = assoc_id_hash[hash];
+		assoc_id_hash[hash] = i;
+
+		hash = _assoc_key_hash(assoc->uid, assoc->acct,
+				       assoc->partition);
+		assoc_index[i].next_key = assoc_key_hash[hash];
+		assoc_key_hash[hash] = i;
+	}
+}
+
+/* locks should be put in place before calling this function ASSOC_READ */
+static slurmdb_association_rec_t *_find_assoc_id(uint32_t id)
+{
+	slurmdb_association_rec_t *assoc = NULL;
+	ListIterator itr = NULL;
+	int i;
+
+	if (assoc_index_size) {
+		for (i = assoc_id_hash[id & (assoc_index_size - 1)]; i >= 0;
+		     i = assoc_index[i].next_id) {
+			if (assoc_index[i].assoc->id == id)
+				return assoc_index[i].assoc;
+		}
+		return NULL;
+	}
+
+	if (!assoc_mgr_association_list)
+		return NULL;
+	itr = list_iterator_create(assoc_mgr_association_list);
+	while ((assoc = list_next(itr))) {
+		if (assoc->id == id)
+			break;
+	}
+	list_iterator_destroy(itr);
+
+	return assoc;
+}
+
+/* locks should be put in place before calling this function ASSOC_READ
+ * Return the first (or last) indexed association of assoc's uid, acct
+ * and cluster with the given partition (NULL for none). */
+static slurmdb_association_rec_t *_find_assoc_key(
+	slurmdb_association_rec_t *assoc, char *partition, bool last)
+{
+	slurmdb_association_rec_t *found_assoc = NULL, *ret_assoc = NULL;
+	int i;
+
+	for (i = assoc_key_hash[_assoc_key_hash(assoc->uid, assoc->acct,
+						partition)];
+	     i >= 0; i = assoc_index[i].next_key) {
+		found_assoc = assoc_index[i].assoc;
+		if ((assoc->uid != found_assoc->uid)
+		    || strcasecmp(assoc->acct, found_assoc->acct))
+			continue;
+		/* only check for on the slurmdbd */
+		if (!assoc_mgr_cluster_name && found_assoc->cluster
+		    && strcasecmp(assoc->cluster, found_assoc->cluster))
+			continue;
+		if (partition) {
+			if (!found_assoc->partition
+			    || strcasecmp(partition, found_assoc->partition))
+				continue;
+		} else if (found_assoc->partition)
+			continue;
+
+		ret_assoc = found_assoc;
+		if (!last)
+			break;
+	}
+
+	return ret_assoc;
+}
+
+/* locks should be put in place before calling this function ASSOC_READ
+ * Find the association assoc refers to, either by id or by user, account,
+ * cluster and partition (falling back to the association with no
+ * partition). */
+static slurmdb_association_rec_t *_find_assoc_rec(
+	slurmdb_association_rec_t *assoc)
+{
+	slurmdb_association_rec_t *found_assoc = NULL, *ret_assoc = NULL;
+	ListIterator itr = NULL;
+
+	if (assoc->id)
+		return _find_assoc_id(assoc->id);
+
+	if (assoc_index_size) {
+		if (assoc->partition
+		    && (ret_assoc = _find_assoc_key(assoc, assoc->partition,
+						    false)))
+			return ret_assoc;
+		/* With a partition given the last association without
+		 * one is used, like the walk below does. */
+		return _find_assoc_key(assoc, NULL, (assoc->partition != NULL));
+	}
+
+	itr = list_iterator_create(assoc_mgr_association_list);
+	while ((found_assoc = list_next(itr))) {
+		if (assoc->uid == NO_VAL && found_assoc->uid != NO_VAL) {
+			debug3("we are looking for a nonuser association");
+			continue;
+		} else if (assoc->uid != found_assoc->uid) {
+			debug4("not the right user %u != %u",
+			       assoc->uid, found_assoc->uid);
+			continue;
+		}
+
+		if (found_assoc->acct
+		    && strcasecmp(assoc->acct, found_assoc->acct)) {
+			debug4("not the right account %s != %s",
+			       assoc->acct, found_assoc->acct);
+			continue;
+		}
+
+		/* only check for on the slurmdbd */
+		if (!assoc_mgr_cluster_name && found_assoc->cluster
+		    && strcasecmp(assoc->cluster, found_assoc->cluster)) {
+			debug4("not the right cluster");
+			continue;
+		}
+
+		if (assoc->partition) {
+			if (!found_assoc->partition) {
+				ret_assoc = found_assoc;
+				debug3("found association for no partition");
+				continue;
+			} else if (strcasecmp(assoc->partition,
+					      found_assoc->partition)) {
+				debug4("not the right partition");
+				continue;
+			}
+		} else if (found_assoc->partition) {
+			debug4("partition specific association "
+			       "looking for one without.");
+			continue;
+		}
+		ret_assoc = found_assoc;
+		break;
+	}
+	list_iterator_destroy(itr);
+
+	return ret_assoc;
+}
+
 /* transfer slurmdb assoc list to be assoc_mgr assoc list */
 static int _post_association_list(List assoc_list)
 {
@@ -531,6 +777,8 @@ static int _post_association_list(List assoc_list)
 	list_iterator_destroy(itr);
 
 	slurmdb_sort_hierarchical_assoc_list(assoc_list);
+	if (assoc_list == assoc_mgr_association_list)
+		_rebuild_assoc_index();
 
 	//END_TIMER2("load_associations");
 	return SLURM_SUCCESS;
@@ -659,6 +907,7 @@ static int _get_assoc_mgr_association_list(void *db_conn, int enforce)
 		   isn't anything there */
 		assoc_mgr_association_list =
 			list_create(slurmdb_destroy_association_rec);
+		_rebuild_assoc_index();
 		assoc_mgr_unlock(&locks);
 		if (enforce & ACCOUNTING_ENFORCE_ASSOCS) {
 			error("_get_assoc_mgr_association_list: "
@@ -797,7 +1046,6 @@ static int _refresh_assoc_mgr_association_list(void *db_conn, int enforce)
 	List current_assocs = NULL;
 	uid_t uid = getuid();
 	ListIterator curr_itr = NULL;
-	ListIterator assoc_mgr_itr = NULL;
 	slurmdb_association_rec_t *curr_assoc = NULL, *assoc = NULL;
 	assoc_mgr_lock_t locks = { WRITE_LOCK, NO_LOCK,
 				   READ_LOCK, NO_LOCK, NO_LOCK };
@@ -842,17 +1090,13 @@ static int _refresh_assoc_mgr_association_list(void *db_conn, int enforce)
 	}
 
 	curr_itr = list_iterator_create(current_assocs);
-	assoc_mgr_itr = list_iterator_create(assoc_mgr_association_list);
 
 	/* add used limits We only look for the user associations to
 	 * do the parents since a parent may have moved */
 	while ((curr_assoc = list_next(curr_itr))) {
 		if (!curr_assoc->user)
 			continue;
-		while ((assoc = list_next(assoc_mgr_itr))) {
-			if (assoc->id == curr_assoc->id)
-				break;
-		}
+		assoc = _find_assoc_id(curr_assoc->id);
 
 		while (assoc) {
 			_addto_used_info(assoc, curr_assoc);
@@ -860,11 +1104,9 @@ static int _refresh_assoc_mgr_association_list(void *db_conn, int enforce)
 			   different than the one we are updating from */
 			assoc = assoc->usage->parent_assoc_ptr;
 		}
-		list_iterator_reset(assoc_mgr_itr);
 	}
 
 	list_iterator_destroy(curr_itr);
-	list_iterator_destroy(assoc_mgr_itr);
 
 	assoc_mgr_unlock(&locks);
 
@@ -984,68 +1226,106 @@ static int _refresh_assoc_wckey_list(void *db_conn, int enforce)
 	return SLURM_SUCCESS;
 }
 
+static void _init_locks(void)
+{
+	pthread_rwlockattr_t attr;
+	int i;
+
+	pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+	pthread_rwlockattr_setkind_np(
+		&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+	for (i = 0; i < ASSOC_MGR_ENTITY_COUNT; i++) {
+		if (pthread_rwlock_init(&assoc_mgr_locks[i], &attr))
+			fatal("pthread_rwlock_init: %m");
+	}
+	pthread_rwlockattr_destroy(&attr);
+}
+
+/* Record an acquisition of the given lock, blocked for wait_usec if
+ * contended is set */
+static void _lock_stats_add(assoc_mgr_lock_datatype_t datatype, int mode,
+			    bool contended, uint64_t wait_usec)
+{
+	assoc_lock_stats_t *stats = &assoc_mgr_lock_stats[datatype][mode];
+	uint64_t max_usec;
+
+	__sync_fetch_and_add(&stats->cnt, 1);
+	if (!contended)
+		return;
+
+	__sync_fetch_and_add(&stats->wait_cnt, 1);
+	__sync_fetch_and_add(&stats->wait_usec, wait_usec);
+	max_usec = stats->wait_max_usec;
+	while ((wait_usec > max_usec) &&
+	       !__sync_bool_compare_and_swap(&stats->wait_max_usec,
+					     max_usec, wait_usec))
+		max_usec = stats->wait_max_usec;
+}
+
+static uint64_t _wait_usec(struct timeval *start)
+{
+	struct timeval now;
+	int64_t usec;
+
+	gettimeofday(&now, NULL);
+	usec = (int64_t)(now.tv_sec - start->tv_sec) * 1000000 +
+		(now.tv_usec - start->tv_usec);
+
+	return (usec > 0) ? usec : 0;
+}
+
 /* _wr_rdlock - Issue a read lock on the specified data type */
-static void _wr_rdlock(lock_datatype_t datatype)
-{
-	//info("going to read lock on %d", datatype);
-	slurm_mutex_lock(&locks_mutex);
-	//info("read lock on %d", datatype);
-	while (1) {
-		if ((assoc_mgr_locks.entity[write_wait_lock(datatype)] ==
-		     0)
-		    && (assoc_mgr_locks.entity[write_lock(datatype)] ==
-			0)) {
-			assoc_mgr_locks.entity[read_lock(datatype)]++;
-			break;
-		} else {	/* wait for state change and retry */
-			pthread_cond_wait(&locks_cond, &locks_mutex);
-		}
+static void _wr_rdlock(assoc_mgr_lock_datatype_t datatype)
+{
+	struct timeval start;
+	int err;
+
+	if (!pthread_rwlock_tryrdlock(&assoc_mgr_locks[datatype])) {
+		_lock_stats_add(datatype, 0, false, 0);
+		return;
 	}
-	slurm_mutex_unlock(&locks_mutex);
+
+	gettimeofday(&start, NULL);
+	if ((err = pthread_rwlock_rdlock(&assoc_mgr_locks[datatype]))) {
+		errno = err;
+		fatal("%s: pthread_rwlock_rdlock(%d): %m",
+		      __func__, datatype);
+	}
+	_lock_stats_add(datatype, 0, true, _wait_usec(&start));
 }
 
 /* _wr_rdunlock - Issue a read unlock on the specified data type */
-static void _wr_rdunlock(lock_datatype_t datatype)
+static void _wr_rdunlock(assoc_mgr_lock_datatype_t datatype)
 {
-	//info("going to read unlock on %d", datatype);
-	slurm_mutex_lock(&locks_mutex);
-	//info("read unlock on %d", datatype);
-	assoc_mgr_locks.entity[read_lock(datatype)]--;
-	pthread_cond_broadcast(&locks_cond);
-	slurm_mutex_unlock(&locks_mutex);
+	pthread_rwlock_unlock(&assoc_mgr_locks[datatype]);
 }
 
 /* _wr_wrlock - Issue a write lock on the specified data type */
-static void _wr_wrlock(lock_datatype_t datatype)
-{
-	//info("going to write lock on %d", datatype);
-	slurm_mutex_lock(&locks_mutex);
-	assoc_mgr_locks.entity[write_wait_lock(datatype)]++;
-
-	//info("write lock on %d", datatype);
-	while (1) {
-		if ((assoc_mgr_locks.entity[read_lock(datatype)] == 0) &&
-		    (assoc_mgr_locks.entity[write_lock(datatype)] == 0)) {
-			assoc_mgr_locks.entity[write_lock(datatype)]++;
-			assoc_mgr_locks.
-				entity[write_wait_lock(datatype)]--;
-			break;
-		} else {	/* wait for state change and retry */
-			pthread_cond_wait(&locks_cond, &locks_mutex);
-		}
+static void _wr_wrlock(assoc_mgr_lock_datatype_t datatype)
+{
+	struct timeval start;
+	int err;
+
+	if (!pthread_rwlock_trywrlock(&assoc_mgr_locks[datatype])) {
+		_lock_stats_add(datatype, 1, false, 0);
+		return;
 	}
-	slurm_mutex_unlock(&locks_mutex);
+
+	gettimeofday(&start, NULL);
+	if ((err = pthread_rwlock_wrlock(&assoc_mgr_locks[datatype]))) {
+		errno = err;
+		fatal("%s: pthread_rwlock_wrlock(%d): %m",
+		      __func__, datatype);
+	}
+	_lock_stats_add(datatype, 1, true, _wait_usec(&start));
 }
 
 /* _wr_wrunlock - Issue a write unlock on the specified data type */
-static void _wr_wrunlock(lock_datatype_t datatype)
+static void _wr_wrunlock(assoc_mgr_lock_datatype_t datatype)
 {
-	//info("going to write unlock on %d", datatype);
-	slurm_mutex_lock(&locks_mutex);
-	//info("write unlock on %d", datatype);
-	assoc_mgr_locks.entity[write_lock(datatype)]--;
-	pthread_cond_broadcast(&locks_cond);
-	slurm_mutex_unlock(&locks_mutex);
+	pthread_rwlock_unlock(&assoc_mgr_locks[datatype]);
 }
 
 extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args)
@@ -1061,7 +1341,6 @@ extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args)
 
 		xfree(prio);
 		checked_prio = 1;
-		memset(&assoc_mgr_locks, 0, sizeof(assoc_mgr_locks));
 	}
 
 	if (args) {
@@ -1136,6 +1415,10 @@ extern int assoc_mgr_fini(char *state_save_location)
 
 	if (assoc_mgr_association_list)
 		list_destroy(assoc_mgr_association_list);
+	xfree(assoc_index);
+	xfree(assoc_id_hash);
+	xfree(assoc_key_hash);
+	assoc_index_size = 0;
 	if (assoc_mgr_qos_list)
 		list_destroy(assoc_mgr_qos_list);
 	if (assoc_mgr_user_list)
@@ -1153,11 +1436,18 @@ extern int assoc_mgr_fini(char *state_save_location)
 
 extern void assoc_mgr_lock(assoc_mgr_lock_t *locks)
 {
+	pthread_once(&assoc_mgr_locks_once, _init_locks);
+
 	if (locks->assoc == READ_LOCK)
 		_wr_rdlock(ASSOC_LOCK);
 	else if (locks->assoc == WRITE_LOCK)
 		_wr_wrlock(ASSOC_LOCK);
 
+	if (locks->file == READ_LOCK)
+		_wr_rdlock(FILE_LOCK);
+	else if (locks->file == WRITE_LOCK)
+		_wr_wrlock(FILE_LOCK);
+
 	if (locks->qos == READ_LOCK)
 		_wr_rdlock(QOS_LOCK);
 	else if (locks->qos == WRITE_LOCK)
@@ -1191,12 +1481,45 @@ extern void assoc_mgr_unlock(assoc_mgr_lock_t *locks)
 	else if (locks->qos == WRITE_LOCK)
 		_wr_wrunlock(QOS_LOCK);
 
+	if (locks->file == READ_LOCK)
+		_wr_rdunlock(FILE_LOCK);
+	else if (locks->file == WRITE_LOCK)
+		_wr_wrunlock(FILE_LOCK);
+
 	if (locks->assoc == READ_LOCK)
 		_wr_rdunlock(ASSOC_LOCK);
 	else if (locks->assoc == WRITE_LOCK)
 		_wr_wrunlock(ASSOC_LOCK);
 }
 
+extern void assoc_mgr_lock_stats_report(void)
+{
+	static char *lock_names[ASSOC_MGR_ENTITY_COUNT] = {
+		"assoc", "file", "qos", "user", "wckey" };
+	static char *mode_names[2] = { "read", "write" };
+	assoc_lock_stats_t *stats;
+	uint32_t cnt, wait_cnt;
+	uint64_t wait_usec, wait_max_usec;
+	int i, j;
+
+	for (i = 0; i < ASSOC_MGR_ENTITY_COUNT; i++) {
+		for (j = 0; j < 2; j++) {
+			stats = &assoc_mgr_lock_stats[i][j];
+			cnt = __sync_fetch_and_and(&stats->cnt, 0);
+			wait_cnt = __sync_fetch_and_and(&stats->wait_cnt, 0);
+			wait_usec = __sync_fetch_and_and(&stats->wait_usec, 0);
+			wait_max_usec = __sync_fetch_and_and(
+				&stats->wait_max_usec, 0);
+			if (!cnt)
+				continue;
+			debug("Assoc lock stats: %s %s cnt=%u waited=%u "
+			      "wait_avg=%"PRIu64" wait_max=%"PRIu64,
+			      lock_names[i], mode_names[j], cnt, wait_cnt,
+			      wait_usec / MAX(wait_cnt, 1), wait_max_usec);
+		}
+	}
+}
+
 extern assoc_mgr_association_usage_t *create_assoc_mgr_association_usage()
 {
 	assoc_mgr_association_usage_t *usage =
@@ -1243,10 +1566,82 @@ extern void destroy_assoc_mgr_qos_usage(void *object)
 			list_destroy(usage->job_list);
 		if (usage->user_limit_list)
 			list_destroy(usage->user_limit_list);
+		xfree(usage->user_limit_hash);
 		xfree(usage);
 	}
 }
 
+/* Records are only added to user_limit_list by assoc_mgr_get_used_limits()
+ * and never removed, so the hash uses open addressing. */
+static void _add_used_limits_hash(assoc_mgr_qos_usage_t *usage,
+				  slurmdb_used_limits_t *used_limits)
+{
+	uint32_t inx, mask = usage->user_limit_hash_size - 1;
+
+	for (inx = used_limits->uid & mask; usage->user_limit_hash[inx];
+	     inx = (inx + 1) & mask)
+		;
+	usage->user_limit_hash[inx] = used_limits;
+}
+
+/* Resize the hash to keep it at most half full and rehash the list */
+static void _rebuild_used_limits_hash(assoc_mgr_qos_usage_t *usage)
+{
+	slurmdb_used_limits_t *used_limits = NULL;
+	ListIterator itr = NULL;
+	uint32_t size = 64;
+
+	while (size < (list_count(usage->user_limit_list) * 2))
+		size <<= 1;
+	xfree(usage->user_limit_hash);
+	usage->user_limit_hash = xmalloc(sizeof(slurmdb_used_limits_t *)
+					 * size);
+	usage->user_limit_hash_size = size;
+
+	itr = list_iterator_create(usage->user_limit_list);
+	while ((used_limits = list_next(itr)))
+		_add_used_limits_hash(usage, used_limits);
+	list_iterator_destroy(itr);
+}
+
+extern slurmdb_used_limits_t *assoc_mgr_get_used_limits(
+	assoc_mgr_qos_usage_t *usage, uint32_t uid, bool add)
+{
+	slurmdb_used_limits_t *used_limits = NULL;
+	uint32_t inx, mask;
+
+	if (!usage)
+		return NULL;
+
+	if (usage->user_limit_hash_size) {
+		mask = usage->user_limit_hash_size - 1;
+		for (inx = uid & mask; (used_limits =
+					usage->user_limit_hash[inx]);
+		     inx = (inx + 1) & mask) {
+			if (used_limits->uid == uid)
+				return used_limits;
+		}
+	}
+
+	if (!add)
+		return NULL;
+
+	if (!usage->user_limit_list)
+		usage->user_limit_list =
+			list_create(slurmdb_destroy_used_limits);
+	used_limits = xmalloc(sizeof(slurmdb_used_limits_t));
+	used_limits->uid = uid;
+	list_append(usage->user_limit_list, used_limits);
+
+	if ((list_count(usage->user_limit_list) * 2) >
+	    usage->user_limit_hash_size)
+		_rebuild_used_limits_hash(usage);
+	else
+		_add_used_limits_hash(usage, used_limits);
+
+	return used_limits;
+}
+
 
 extern int assoc_mgr_get_user_assocs(void *db_conn,
 				     slurmdb_association_rec_t *assoc,
@@ -1302,8 +1697,6 @@ extern int assoc_mgr_fill_in_assoc(void *db_conn,
 				   int enforce,
 				   slurmdb_association_rec_t **assoc_pptr)
 {
-	ListIterator itr = NULL;
-	slurmdb_association_rec_t * found_assoc = NULL;
 	slurmdb_association_rec_t * ret_assoc = NULL;
 	assoc_mgr_lock_t locks = { READ_LOCK, NO_LOCK,
 				   NO_LOCK, NO_LOCK, NO_LOCK };
@@ -1373,62 +1766,7 @@ extern int assoc_mgr_fill_in_assoc(void *db_conn,
 /* 	     assoc->user, assoc->uid, assoc->acct, */
 /* 	     assoc->cluster, assoc->partition); */
 	assoc_mgr_lock(&locks);
-	itr = list_iterator_create(assoc_mgr_association_list);
-	while ((found_assoc = list_next(itr))) {
-		if (assoc->id) {
-			if (assoc->id == found_assoc->id) {
-				ret_assoc = found_assoc;
-				break;
-			}
-			continue;
-		} else {
-			if (assoc->uid == NO_VAL
-			    && found_assoc->uid != NO_VAL) {
-				debug3("we are looking for a "
-				       "nonuser association");
-				continue;
-			} else if (assoc->uid != found_assoc->uid) {
-				debug4("not the right user %u != %u",
-				       assoc->uid, found_assoc->uid);
-				continue;
-			}
-
-			if (found_assoc->acct
-			    && strcasecmp(assoc->acct, found_assoc->acct)) {
-				debug4("not the right account %s != %s",
-				       assoc->acct, found_assoc->acct);
-				continue;
-			}
-
-			/* only check for on the slurmdbd */
-			if (!assoc_mgr_cluster_name && found_assoc->cluster
-			    && strcasecmp(assoc->cluster,
-					  found_assoc->cluster)) {
-				debug4("not the right cluster");
-				continue;
-			}
-
-			if (assoc->partition) {
-				if (!found_assoc->partition) {
-					ret_assoc = found_assoc;
-					debug3("found association "
-					       "for no partition");
-					continue;
-				} else if (strcasecmp(assoc->partition,
-						      found_assoc->partition)) {
-					debug4("not the right partition");
-					continue;
-				}
-			} else if (found_assoc->partition) {
-				debug4("partition specific association "
-				       "looking for one without.");
-				continue;
-			}
-		}
-		ret_assoc = found_assoc;
-		break;
-	}
-	list_iterator_destroy(itr);
+	ret_assoc = _find_assoc_rec(assoc);
 
 	if (!ret_assoc) {
 		assoc_mgr_unlock(&locks);
@@ -2167,6 +2505,7 @@ extern int assoc_mgr_update_assocs(slurmdb_update_object_t *update)
 	int parents_changed = 0;
 	int run_update_resvs = 0;
 	int resort = 0;
+	int removed = 0;
 	List remove_list = NULL;
 	List update_list = NULL;
 	assoc_mgr_lock_t locks = { WRITE_LOCK, NO_LOCK,
@@ -2422,6 +2761,7 @@ extern int assoc_mgr_update_assocs(slurmdb_update_object_t *update)
 
 			run_update_resvs = 1; /* needed for updating
 						 reservations */
+			removed = 1;
 
 			if (setup_children)
 				parents_changed = 1; /* set since we need to
@@ -2535,6 +2875,9 @@ extern int assoc_mgr_update_assocs(slurmdb_update_object_t *update)
 		slurmdb_sort_hierarchical_assoc_list(
 			assoc_mgr_association_list);
 
+	if (parents_changed || resort || removed)
+		_rebuild_assoc_index();
+
 	list_iterator_destroy(itr);
 	assoc_mgr_unlock(&locks);
 
@@ -3097,7 +3440,6 @@ extern int assoc_mgr_validate_assoc_id(void *db_conn,
 				       uint32_t assoc_id,
 				       int enforce)
 {
-	ListIterator itr = NULL;
 	slurmdb_association_rec_t * found_assoc = NULL;
 	assoc_mgr_lock_t locks = { READ_LOCK, NO_LOCK,
 				   NO_LOCK, NO_LOCK, NO_LOCK };
@@ -3113,12 +3455,7 @@ extern int assoc_mgr_validate_assoc_id(void *db_conn,
 		return SLURM_SUCCESS;
 
 	assoc_mgr_lock(&locks);
-	itr = list_iterator_create(assoc_mgr_association_list);
-	while ((found_assoc = list_next(itr))) {
-		if (assoc_id == found_assoc->id)
-			break;
-	}
-	list_iterator_destroy(itr);
+	found_assoc = _find_assoc_id(assoc_id);
 	assoc_mgr_unlock(&locks);
 
 	if (found_assoc || !(enforce & ACCOUNTING_ENFORCE_ASSOCS))
@@ -3469,7 +3806,6 @@ extern int load_assoc_usage(char *state_save_location)
 	char *data = NULL, *state_file;
 	Buf buffer;
 	time_t buf_time;
-	ListIterator itr = NULL;
 	assoc_mgr_lock_t locks = { WRITE_LOCK, READ_LOCK,
 				   NO_LOCK, NO_LOCK, NO_LOCK };
 
@@ -3525,7 +3861,6 @@ extern int load_assoc_usage(char *state_save_location)
 
 	safe_unpack_time(&buf_time, buffer);
 
-	itr = list_iterator_create(assoc_mgr_association_list);
 	while (remaining_buf(buffer) > 0) {
 		uint32_t assoc_id = 0;
 		uint32_t grp_used_wall = 0;
@@ -3535,9 +3870,7 @@ extern int load_assoc_usage(char *state_save_location)
 		safe_unpack32(&assoc_id, buffer);
 		safe_unpack64(&usage_raw, buffer);
 		safe_unpack32(&grp_used_wall, buffer);
-		while ((assoc = list_next(itr)))
-			if (assoc->id == assoc_id)
-				break;
+		assoc = _find_assoc_id(assoc_id);
 
 		/* We want to do this all the way up to and including
 		   root.  This way we can keep track of how much usage
@@ -3550,9 +3883,7 @@ extern int load_assoc_usage(char *state_save_location)
 
 			assoc = assoc->usage->parent_assoc_ptr;
 		}
-		list_iterator_reset(itr);
 	}
-	list_iterator_destroy(itr);
 	assoc_mgr_unlock(&locks);
 
 	free_buf(buffer);
@@ -3561,8 +3892,6 @@ extern int load_assoc_usage(char *state_save_location)
 unpack_error:
 	if (buffer)
 		free_buf(buffer);
-	if (itr)
-		list_iterator_destroy(itr);
 	assoc_mgr_unlock(&locks);
 	return SLURM_ERROR;
 }
@@ -3882,6 +4211,7 @@ extern int assoc_mgr_set_missing_uids()
 			}
 		}
 		list_iterator_destroy(itr);
+		_rebuild_assoc_index();
 	}
 
 	if (assoc_mgr_wckey_list) {
@@ -67,12 +67,8 @@ typedef struct {
 	lock_level_t wckey;
 } assoc_mgr_lock_t;
 
-/* Interval lock structure
- * we actually use three semaphores for each data type, see macros below
- *	(assoc_mgr_lock_datatype_t * 3 + 0) = read_lock
- *	(assoc_mgr_lock_datatype_t * 3 + 1) = write_lock
- *	(assoc_mgr_lock_datatype_t * 3 + 2) = write_wait_lock
- */
+/* Each data type is protected by its own reader-writer lock, taken in
+ * the order below by assoc_mgr_lock() */
 typedef enum {
 	ASSOC_LOCK,
 	FILE_LOCK,
@@ -82,10 +78,6 @@ typedef enum {
 	ASSOC_MGR_ENTITY_COUNT
 } assoc_mgr_lock_datatype_t;
 
-typedef struct {
-	int entity[ASSOC_MGR_ENTITY_COUNT * 3];
-} assoc_mgr_lock_flags_t;
-
 typedef struct {
  	uint16_t cache_level;
 	uint16_t enforce;
@@ -149,6 +141,10 @@ struct assoc_mgr_qos_usage {
 	long double usage_raw;	/* measure of resource usage (DON'T PACK) */
 
 	List user_limit_list; /* slurmdb_used_limits_t's (DON'T PACK) */
+	slurmdb_used_limits_t **user_limit_hash; /* user_limit_list
+						  * hashed by uid
+						  * (DON'T PACK) */
+	uint32_t user_limit_hash_size; /* (DON'T PACK) */
 };
 
 
@@ -168,11 +164,28 @@ extern int assoc_mgr_fini(char *state_save_location);
 extern void assoc_mgr_lock(assoc_mgr_lock_t *locks);
 extern void assoc_mgr_unlock(assoc_mgr_lock_t *locks);
 
+/* assoc_mgr_lock_stats_report - Log the number of lock acquisitions, how
+ *	many of them had to wait and the wait times (in microseconds)
+ *	accumulated since the last report, then clear them */
+extern void assoc_mgr_lock_stats_report(void);
+
 extern assoc_mgr_association_usage_t *create_assoc_mgr_association_usage();
 extern void destroy_assoc_mgr_association_usage(void *object);
 extern assoc_mgr_qos_usage_t *create_assoc_mgr_qos_usage();
 extern void destroy_assoc_mgr_qos_usage(void *object);
 
+/*
+ * get the usage of a user in a qos
+ * IN:  usage - usage of the qos
+ * IN:  uid - user to look for
+ * IN:  add - if set, create a record for the user if there isn't one
+ * RET: the slurmdb_used_limits_t of uid in usage->user_limit_list,
+ *      NULL if there is none (and add is not set). DO NOT FREE.
+ * NOTE: QOS read lock should be in place, write lock if add is set.
+ */
+extern slurmdb_used_limits_t *assoc_mgr_get_used_limits(
+	assoc_mgr_qos_usage_t *usage, uint32_t uid, bool add);
+
 /*
  * get info from the storage
  * IN:  assoc - slurmdb_association_rec_t with at least cluster and
@@ -50,6 +50,378 @@
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
+/*
+ * Whole words are examined with the compiler's population count and
+ * count leading/trailing zero builtins when available. On x86_64 the
+ * bulk operations also have AVX2 and hardware POPCNT versions, selected
+ * at run time based upon the processor's capabilities. The plain C
+ * versions remain in use everywhere else.
+ */
+#if defined(__GNUC__) && \
+    ((__GNUC__ > 3) || ((__GNUC__ == 3) && (__GNUC_MINOR__ >= 4)))
+#  define HAVE_BITSTR_BUILTINS 1
+#endif
+
+#if defined(HAVE_BITSTR_BUILTINS) && defined(__x86_64__) && \
+    !defined(__clang__) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#  define HAVE_BITSTR_X86_DISPATCH 1
+#  include <immintrin.h>
+#endif
+
+#ifdef USE_64BIT_BITSTR
+typedef uint64_t bitstr_uword_t;
+#else
+typedef uint32_t bitstr_uword_t;
+#endif
+
+/* all bits of a word set */
+#define BITSTR_ALL_SET		((bitstr_t) ~((bitstr_uword_t) 0))
+
+/* words of data (excluding overhead) in bitstring name */
+#define _bitstr_data_words(name) \
+	(_bitstr_words(_bitstr_bits(name)) - BITSTR_OVERHEAD)
+
+/* bit offset of the first bit of data word inx (zero origin) */
+#define _bitstr_word_bit(inx)	((bitoff_t) (inx) << BITSTR_SHIFT)
+
+/*
+ * mask of the valid bits in the last data word of a bitstring of nbits
+ * bits, bits beyond the end of the bitstring may be left set by bit_not()
+ */
+#ifdef SLURM_BIGENDIAN
+#define _bit_tail_mask(nbits) (((nbits) & BITSTR_MAXPOS) ? \
+	(bitstr_t) ~(~((bitstr_uword_t) 0) >> ((nbits) & BITSTR_MAXPOS)) : \
+	BITSTR_ALL_SET)
+#else
+#define _bit_tail_mask(nbits) (((nbits) & BITSTR_MAXPOS) ? \
+	(bitstr_t) (((bitstr_uword_t) 1 << ((nbits) & BITSTR_MAXPOS)) - 1) : \
+	BITSTR_ALL_SET)
+#endif
+
+#if !defined(USE_64BIT_BITSTR)
+/*
+ * Returns the hamming weight (i.e. the number of bits set) in a word.
+ * NOTE: This routine borrowed from Linux 2.4.9 <linux/bitops.h>.
+ */
+static inline uint32_t
+hweight(uint32_t w)
+{
+#ifdef HAVE_BITSTR_BUILTINS
+	return __builtin_popcount(w);
+#else
+	uint32_t res;
+
+	res = (w   & 0x55555555) + ((w >> 1)    & 0x55555555);
+	res = (res & 0x33333333) + ((res >> 2)  & 0x33333333);
+	res = (res & 0x0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F);
+	res = (res & 0x00FF00FF) + ((res >> 8)  & 0x00FF00FF);
+	res = (res & 0x0000FFFF) + ((res >> 16) & 0x0000FFFF);
+
+	return res;
+#endif
+}
+#else
+/*
+ * A 64 bit version crafted from 32-bit one borrowed above.
+ */
+static inline uint64_t
+hweight(uint64_t w)
+{
+#ifdef HAVE_BITSTR_BUILTINS
+	return __builtin_popcountll(w);
+#else
+	uint64_t res;
+
+	res = (w   & 0x5555555555555555) + ((w >> 1)    & 0x5555555555555555);
+	res = (res & 0x3333333333333333) + ((res >> 2)  & 0x3333333333333333);
+	res = (res & 0x0F0F0F0F0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F0F0F0F0F);
+	res = (res & 0x00FF00FF00FF00FF) + ((res >> 8)  & 0x00FF00FF00FF00FF);
+	res = (res & 0x0000FFFF0000FFFF) + ((res >> 16) & 0x0000FFFF0000FFFF);
+	res = (res & 0x00000000FFFFFFFF) + ((res >> 32) & 0x00000000FFFFFFFF);
+
+	return res;
+#endif
+}
+#endif /* !USE_64BIT_BITSTR */
+
+/* Number of trailing (low order) zero bits in a non-zero word */
+static inline int
+_word_ctz(bitstr_uword_t w)
+{
+#if defined(HAVE_BITSTR_BUILTINS) && defined(USE_64BIT_BITSTR)
+	return __builtin_ctzll(w);
+#elif defined(HAVE_BITSTR_BUILTINS)
+	return __builtin_ctz(w);
+#else
+	int n = 0;
+
+	while ((w & 1) == 0) {
+		w >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Number of leading (high order) zero bits in a non-zero word */
+static inline int
+_word_clz(bitstr_uword_t w)
+{
+#if defined(HAVE_BITSTR_BUILTINS) && defined(USE_64BIT_BITSTR)
+	return __builtin_clzll(w);
+#elif defined(HAVE_BITSTR_BUILTINS)
+	return __builtin_clz(w);
+#else
+	int n = 0;
+
+	while ((w & ((bitstr_uword_t) 1 << BITSTR_MAXPOS)) == 0) {
+		w <<= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Position within its word of the first bit set in a non-zero word */
+static inline int
+_word_ffs(bitstr_t w)
+{
+#ifdef SLURM_BIGENDIAN
+	return _word_clz((bitstr_uword_t) w);
+#else
+	return _word_ctz((bitstr_uword_t) w);
+#endif
+}
+
+/* Position within its word of the last bit set in a non-zero word */
+static inline int
+_word_fls(bitstr_t w)
+{
+#ifdef SLURM_BIGENDIAN
+	return BITSTR_MAXPOS - _word_ctz((bitstr_uword_t) w);
+#else
+	return BITSTR_MAXPOS - _word_clz((bitstr_uword_t) w);
+#endif
+}
+
+/*
+ * Word kernels for the bulk operations. Each operates upon the n data
+ * words of its arguments. Generic versions are written so the compiler
+ * may vectorize them with the baseline instruction set (e.g. SSE2).
+ */
+static void _and_words(bitstr_t *d, const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i;
+
+	for (i = 0; i < n; i++)
+		d[i] &= s[i];
+}
+
+static void _and_not_words(bitstr_t *d, const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i;
+
+	for (i = 0; i < n; i++)
+		d[i] &= ~s[i];
+}
+
+static void _or_words(bitstr_t *d, const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i;
+
+	for (i = 0; i < n; i++)
+		d[i] |= s[i];
+}
+
+static void _not_words(bitstr_t *d, bitoff_t n)
+{
+	bitoff_t i;
+
+	for (i = 0; i < n; i++)
+		d[i] = ~d[i];
+}
+
+/* Returns 1 if any bit is set in both s1 and s2 */
+static int _and_any_words(const bitstr_t *s1, const bitstr_t *s2, bitoff_t n)
+{
+	bitoff_t i;
+
+	for (i = 0; i < n; i++) {
+		if (s1[i] & s2[i])
+			return 1;
+	}
+	return 0;
+}
+
+static int _count_words(const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i;
+	int count = 0;
+
+	for (i = 0; i < n; i++)
+		count += hweight((bitstr_uword_t) s[i]);
+	return count;
+}
+
+static int _and_count_words(const bitstr_t *s1, const bitstr_t *s2,
+			    bitoff_t n)
+{
+	bitoff_t i;
+	int count = 0;
+
+	for (i = 0; i < n; i++)
+		count += hweight((bitstr_uword_t) (s1[i] & s2[i]));
+	return count;
+}
+
+#ifdef HAVE_BITSTR_X86_DISPATCH
+/* Bytes handled per AVX2 operation and minimum words worth dispatching */
+#define AVX2_BYTES		32
+#define AVX2_WORDS		(AVX2_BYTES / sizeof(bitstr_t))
+#define AVX2_MIN_WORDS		(AVX2_WORDS * 2)
+
+#define BITSTR_CPU_POPCNT	0x0001
+#define BITSTR_CPU_AVX2		0x0002
+
+static int bitstr_cpu_flags = -1;
+
+/* Return the BITSTR_CPU_* capabilities of this processor. Concurrent first
+ * calls all store the same value, so no lock is needed. */
+static inline int _cpu_flags(void)
+{
+	int flags;
+
+	if (bitstr_cpu_flags != -1)
+		return bitstr_cpu_flags;
+
+	__builtin_cpu_init();
+	flags = 0;
+	if (__builtin_cpu_supports("popcnt"))
+		flags |= BITSTR_CPU_POPCNT;
+	if (__builtin_cpu_supports("avx2"))
+		flags |= BITSTR_CPU_AVX2;
+	bitstr_cpu_flags = flags;
+	return flags;
+}
+
+#define _use_avx2(n) \
+	(((n) >= AVX2_MIN_WORDS) && (_cpu_flags() & BITSTR_CPU_AVX2))
+#define _use_popcnt() \
+	(_cpu_flags() & BITSTR_CPU_POPCNT)
+
+__attribute__((target("avx2")))
+static void _and_words_avx2(bitstr_t *d, const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i;
+	__m256i v1, v2;
+
+	for (i = 0; i + AVX2_WORDS <= n; i += AVX2_WORDS) {
+		v1 = _mm256_loadu_si256((const __m256i *) (d + i));
+		v2 = _mm256_loadu_si256((const __m256i *) (s + i));
+		_mm256_storeu_si256((__m256i *) (d + i),
+				    _mm256_and_si256(v1, v2));
+	}
+	_and_words(d + i, s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void _and_not_words_avx2(bitstr_t *d, const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i;
+	__m256i v1, v2;
+
+	for (i = 0; i + AVX2_WORDS <= n; i += AVX2_WORDS) {
+		v1 = _mm256_loadu_si256((const __m256i *) (d + i));
+		v2 = _mm256_loadu_si256((const __m256i *) (s + i));
+		/* _mm256_andnot_si256() complements its first argument */
+		_mm256_storeu_si256((__m256i *) (d + i),
+				    _mm256_andnot_si256(v2, v1));
+	}
+	_and_not_words(d + i, s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void _or_words_avx2(bitstr_t *d, const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i;
+	__m256i v1, v2;
+
+	for (i = 0; i + AVX2_WORDS <= n; i += AVX2_WORDS) {
+		v1 = _mm256_loadu_si256((const __m256i *) (d + i));
+		v2 = _mm256_loadu_si256((const __m256i *) (s + i));
+		_mm256_storeu_si256((__m256i *) (d + i),
+				    _mm256_or_si256(v1, v2));
+	}
+	_or_words(d + i, s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void _not_words_avx2(bitstr_t *d, bitoff_t n)
+{
+	bitoff_t i;
+	__m256i v1, ones = _mm256_set1_epi32(-1);
+
+	for (i = 0; i + AVX2_WORDS <= n; i += AVX2_WORDS) {
+		v1 = _mm256_loadu_si256((const __m256i *) (d + i));
+		_mm256_storeu_si256((__m256i *) (d + i),
+				    _mm256_xor_si256(v1, ones));
+	}
+	_not_words(d + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int _and_any_words_avx2(const bitstr_t *s1, const bitstr_t *s2,
+			       bitoff_t n)
+{
+	bitoff_t i;
+	__m256i v1, v2;
+
+	for (i = 0; i + AVX2_WORDS <= n; i += AVX2_WORDS) {
+		v1 = _mm256_loadu_si256((const __m256i *) (s1 + i));
+		v2 = _mm256_loadu_si256((const __m256i *) (s2 + i));
+		if (!_mm256_testz_si256(v1, v2))
+			return 1;
+	}
+	return _and_any_words(s1 + i, s2 + i, n - i);
+}
+
+/* The POPCNT versions count 64 bits at a time */
+__attribute__((target("popcnt")))
+static int _count_words_popcnt(const bitstr_t *s, bitoff_t n)
+{
+	bitoff_t i, n64 = n * sizeof(bitstr_t) / sizeof(uint64_t);
+	uint64_t w;
+	int count = 0;
+
+	for (i = 0; i < n64; i++) {
+		memcpy(&w, (const uint64_t *) s + i, sizeof(w));
+		count += __builtin_popcountll(w);
+	}
+	for (i = n64 * sizeof(uint64_t) / sizeof(bitstr_t); i < n; i++)
+		count += __builtin_popcountll((bitstr_uword_t) s[i]);
+	return count;
+}
+
+__attribute__((target("popcnt")))
+static int _and_count_words_popcnt(const bitstr_t *s1, const bitstr_t *s2,
+				   bitoff_t n)
+{
+	bitoff_t i, n64 = n * sizeof(bitstr_t) / sizeof(uint64_t);
+	uint64_t w1, w2;
+	int count = 0;
+
+	for (i = 0; i < n64; i++) {
+		memcpy(&w1, (const uint64_t *) s1 + i, sizeof(w1));
+		memcpy(&w2, (const uint64_t *) s2 + i, sizeof(w2));
+		count += __builtin_popcountll(w1 & w2);
+	}
+	for (i = n64 * sizeof(uint64_t) / sizeof(bitstr_t); i < n; i++)
+		count += __builtin_popcountll((bitstr_uword_t) (s1[i] & s2[i]));
+	return count;
+}
+#endif	/* HAVE_BITSTR_X86_DISPATCH */
+
 /*
  * Define slurm-specific aliases for use by plugins, see slurm_xlator.h
  * for details.
@@ -62,10 +434,12 @@ strong_alias(bit_nclear,	slurm_bit_nclear);
 strong_alias(bit_nset,		slurm_bit_nset);
 strong_alias(bit_ffc,		slurm_bit_ffc);
 strong_alias(bit_ffs,		slurm_bit_ffs);
+strong_alias(bit_ffs_and_not,	slurm_bit_ffs_and_not);
 strong_alias(bit_free,		slurm_bit_free);
 strong_alias(bit_realloc,	slurm_bit_realloc);
 strong_alias(bit_size,		slurm_bit_size);
 strong_alias(bit_and,		slurm_bit_and);
+strong_alias(bit_and_not,	slurm_bit_and_not);
 strong_alias(bit_not,		slurm_bit_not);
 strong_alias(bit_or,		slurm_bit_or);
 strong_alias(bit_set_count,	slurm_bit_set_count);
@@ -85,6 +459,7 @@ strong_alias(bit_fls,		slurm_bit_fls);
 strong_alias(bit_fill_gaps,	slurm_bit_fill_gaps);
 strong_alias(bit_super_set,	slurm_bit_super_set);
 strong_alias(bit_overlap,	slurm_bit_overlap);
+strong_alias(bit_overlap_any,	slurm_bit_overlap_any);
 strong_alias(bit_equal,		slurm_bit_equal);
 strong_alias(bit_copy,		slurm_bit_copy);
 strong_alias(bit_pick_cnt,	slurm_bit_pick_cnt);
@@ -257,25 +632,21 @@ bit_nclear(bitstr_t *b, bitoff_t start, bitoff_t stop)
 bitoff_t
 bit_ffc(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
+	bitoff_t word, nwords, value = -1;
 
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int word = _bit_word(bit);
+	nwords = _bitstr_data_words(b);
+	for (word = 0; word < nwords; word++) {
+		bitstr_t w = b[word + BITSTR_OVERHEAD];
 
-		if (b[word] == BITSTR_MAXPOS) {
-			bit += sizeof(bitstr_t)*8;
+		if (w == BITSTR_ALL_SET)
 			continue;
-		}
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (!bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
+		value = _bitstr_word_bit(word) + _word_ffs(~w);
+		break;
 	}
+	if (value >= _bitstr_bits(b))	/* clear bit beyond the end */
+		value = -1;
 	return value;
 }
 
@@ -396,25 +767,51 @@ bit_nffs(bitstr_t *b, int n)
 bitoff_t
 bit_ffs(bitstr_t *b)
 {
-	bitoff_t bit = 0, value = -1;
+	bitoff_t word, nwords, value = -1;
 
 	_assert_bitstr_valid(b);
 
-	while (bit < _bitstr_bits(b) && value == -1) {
-		int word = _bit_word(bit);
+	nwords = _bitstr_data_words(b);
+	for (word = 0; word < nwords; word++) {
+		bitstr_t w = b[word + BITSTR_OVERHEAD];
 
-		if (b[word] == 0) {
-			bit += sizeof(bitstr_t)*8;
+		if (w == 0)
 			continue;
-		}
-		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
-			if (bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit++;
-		}
+		value = _bitstr_word_bit(word) + _word_ffs(w);
+		break;
 	}
+	if (value >= _bitstr_bits(b))	/* set bit beyond the end */
+		value = -1;
+	return value;
+}
+
+/*
+ * Find first bit set in b1 which is clear in b2 (i.e. bit_ffs(b1 & ~b2))
+ *   b1 (IN)		bitstring to search
+ *   b2 (IN)		bitstring of bits to skip
+ *   RETURN 		resulting bit position (-1 if none found)
+ */
+bitoff_t
+bit_ffs_and_not(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t word, nwords, value = -1;
+
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	nwords = _bitstr_data_words(b1);
+	for (word = 0; word < nwords; word++) {
+		bitstr_t w = b1[word + BITSTR_OVERHEAD] &
+			     ~b2[word + BITSTR_OVERHEAD];
+
+		if (w == 0)
+			continue;
+		value = _bitstr_word_bit(word) + _word_ffs(w);
+		break;
+	}
+	if (value >= _bitstr_bits(b1))	/* set bit beyond the end */
+		value = -1;
 	return value;
 }
 
@@ -426,39 +823,22 @@ bit_ffs(bitstr_t *b)
 bitoff_t
 bit_fls(bitstr_t *b)
 {
-	bitoff_t bit, value = -1;
-	int word;
+	bitoff_t word;
+	bitstr_t w;
 
 	_assert_bitstr_valid(b);
 
 	if (_bitstr_bits(b) == 0)	/* empty bitstring */
 		return -1;
 
-	bit = _bitstr_bits(b) - 1;	/* zero origin */
-
-	while (bit >= 0 && 		/* test partitial words */
-		(_bit_word(bit) == _bit_word(bit + 1))) {
-		if (bit_test(b, bit)) {
-			value = bit;
-			break;
-		}
-		bit--;
-	}
-	while (bit >= 0 && value == -1) {	/* test whole words */
-		word = _bit_word(bit);
-		if (b[word] == 0) {
-			bit -= sizeof(bitstr_t) * 8;
-			continue;
-		}
-		while (bit >= 0) {
-			if (bit_test(b, bit)) {
-				value = bit;
-				break;
-			}
-			bit--;
-		}
+	word = _bitstr_data_words(b) - 1;
+	w = b[word + BITSTR_OVERHEAD] & _bit_tail_mask(_bitstr_bits(b));
+	while (w == 0) {
+		if (--word < 0)
+			return -1;
+		w = b[word + BITSTR_OVERHEAD];
 	}
-	return value;
+	return _bitstr_word_bit(word) + _word_fls(w);
 }
 
 /*
@@ -486,17 +866,22 @@ bit_fill_gaps(bitstr_t *b) {
  */
 int
 bit_super_set(bitstr_t *b1, bitstr_t *b2)  {
-	bitoff_t bit;
+	bitoff_t word, last;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
-		if (b1[_bit_word(bit)] != (b1[_bit_word(bit)] &
-		                           b2[_bit_word(bit)]))
+	if (_bitstr_bits(b1) == 0)
+		return 1;
+
+	last = _bitstr_data_words(b1) - 1 + BITSTR_OVERHEAD;
+	for (word = BITSTR_OVERHEAD; word < last; word++) {
+		if (b1[word] & ~b2[word])
 			return 0;
 	}
+	if (b1[last] & ~b2[last] & _bit_tail_mask(_bitstr_bits(b1)))
+		return 0;
 
 	return 1;
 }
@@ -507,18 +892,23 @@ bit_super_set(bitstr_t *b1, bitstr_t *b2)  {
 extern int
 bit_equal(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	bitoff_t word, last;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 
 	if (_bitstr_bits(b1) != _bitstr_bits(b2))
 		return 0;
+	if (_bitstr_bits(b1) == 0)
+		return 1;
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
-		if (b1[_bit_word(bit)] != b2[_bit_word(bit)])
+	last = _bitstr_data_words(b1) - 1 + BITSTR_OVERHEAD;
+	for (word = BITSTR_OVERHEAD; word < last; word++) {
+		if (b1[word] != b2[word])
 			return 0;
 	}
+	if ((b1[last] ^ b2[last]) & _bit_tail_mask(_bitstr_bits(b1)))
+		return 0;
 
 	return 1;
 }
@@ -532,14 +922,45 @@ bit_equal(bitstr_t *b1, bitstr_t *b2)
  */
 void
 bit_and(bitstr_t *b1, bitstr_t *b2) {
-	bitoff_t bit;
+	bitoff_t nwords;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] &= b2[_bit_word(bit)];
+	nwords = _bitstr_data_words(b1);
+#ifdef HAVE_BITSTR_X86_DISPATCH
+	if (_use_avx2(nwords)) {
+		_and_words_avx2(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD,
+				nwords);
+		return;
+	}
+#endif
+	_and_words(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD, nwords);
+}
+
+/*
+ * b1 &= ~b2		clear in b1 all bits which are set in b2
+ *   b1 (IN/OUT)	first string
+ *   b2 (IN)		second bitstring
+ */
+void
+bit_and_not(bitstr_t *b1, bitstr_t *b2) {
+	bitoff_t nwords;
+
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	nwords = _bitstr_data_words(b1);
+#ifdef HAVE_BITSTR_X86_DISPATCH
+	if (_use_avx2(nwords)) {
+		_and_not_words_avx2(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD,
+				    nwords);
+		return;
+	}
+#endif
+	_and_not_words(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD, nwords);
 }
 
 /*
@@ -548,12 +969,18 @@ bit_and(bitstr_t *b1, bitstr_t *b2) {
  */
 void
 bit_not(bitstr_t *b) {
-	bitoff_t bit;
+	bitoff_t nwords;
 
 	_assert_bitstr_valid(b);
 
-	for (bit = 0; bit < _bitstr_bits(b); bit += sizeof(bitstr_t)*8)
-		b[_bit_word(bit)] = ~b[_bit_word(bit)];
+	nwords = _bitstr_data_words(b);
+#ifdef HAVE_BITSTR_X86_DISPATCH
+	if (_use_avx2(nwords)) {
+		_not_words_avx2(b + BITSTR_OVERHEAD, nwords);
+		return;
+	}
+#endif
+	_not_words(b + BITSTR_OVERHEAD, nwords);
 }
 
 /*
@@ -563,14 +990,21 @@ bit_not(bitstr_t *b) {
  */
 void
 bit_or(bitstr_t *b1, bitstr_t *b2) {
-	bitoff_t bit;
+	bitoff_t nwords;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] |= b2[_bit_word(bit)];
+	nwords = _bitstr_data_words(b1);
+#ifdef HAVE_BITSTR_X86_DISPATCH
+	if (_use_avx2(nwords)) {
+		_or_words_avx2(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD,
+			       nwords);
+		return;
+	}
+#endif
+	_or_words(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD, nwords);
 }
 
 
@@ -609,43 +1043,6 @@ bit_copybits(bitstr_t *dest, bitstr_t *src)
 	memcpy(&dest[BITSTR_OVERHEAD], &src[BITSTR_OVERHEAD], len);
 }
 
-#if !defined(USE_64BIT_BITSTR)
-/*
- * Returns the hamming weight (i.e. the number of bits set) in a word.
- * NOTE: This routine borrowed from Linux 2.4.9 <linux/bitops.h>.
- */
-static uint32_t
-hweight(uint32_t w)
-{
-	uint32_t res;
-
-	res = (w   & 0x55555555) + ((w >> 1)    & 0x55555555);
-	res = (res & 0x33333333) + ((res >> 2)  & 0x33333333);
-	res = (res & 0x0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F);
-	res = (res & 0x00FF00FF) + ((res >> 8)  & 0x00FF00FF);
-	res = (res & 0x0000FFFF) + ((res >> 16) & 0x0000FFFF);
-
-	return res;
-}
-#else
-/*
- * A 64 bit version crafted from 32-bit one borrowed above.
- */
-static uint64_t
-hweight(uint64_t w)
-{
-	uint64_t res;
-
-	res = (w   & 0x5555555555555555) + ((w >> 1)    & 0x5555555555555555);
-	res = (res & 0x3333333333333333) + ((res >> 2)  & 0x3333333333333333);
-	res = (res & 0x0F0F0F0F0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F0F0F0F0F);
-	res = (res & 0x00FF00FF00FF00FF) + ((res >> 8)  & 0x00FF00FF00FF00FF);
-	res = (res & 0x0000FFFF0000FFFF) + ((res >> 16) & 0x0000FFFF0000FFFF);
-	res = (res & 0x00000000FFFFFFFF) + ((res >> 32) & 0x00000000FFFFFFFF);
-
-	return res;
-}
-#endif /* !USE_64BIT_BITSTR */
 
 /*
  * Count the number of bits set in bitstring.
@@ -655,22 +1052,23 @@ hweight(uint64_t w)
 int
 bit_set_count(bitstr_t *b)
 {
-	int count = 0;
-	bitoff_t bit, bit_cnt;
-	int word_size = sizeof(bitstr_t) * 8;
+	int count;
+	bitoff_t last;
 
 	_assert_bitstr_valid(b);
 
-	bit_cnt = _bitstr_bits(b);
-	for (bit = 0; bit < bit_cnt; bit += word_size) {
-		if ((bit + word_size - 1) >= bit_cnt)
-			break;
-		count += hweight(b[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b, bit))
-			count++;
-	}
+	if (_bitstr_bits(b) == 0)
+		return 0;
+
+	last = _bitstr_data_words(b) - 1;
+#ifdef HAVE_BITSTR_X86_DISPATCH
+	if (_use_popcnt())
+		count = _count_words_popcnt(b + BITSTR_OVERHEAD, last);
+	else
+#endif
+	count = _count_words(b + BITSTR_OVERHEAD, last);
+	count += hweight((bitstr_uword_t) (b[last + BITSTR_OVERHEAD] &
+					   _bit_tail_mask(_bitstr_bits(b))));
 
 	return count;
 }
@@ -681,28 +1079,66 @@ bit_set_count(bitstr_t *b)
 extern int
 bit_overlap(bitstr_t *b1, bitstr_t *b2)
 {
-	int count = 0;
-	bitoff_t bit, bit_cnt;
-	int word_size = sizeof(bitstr_t) * 8;
+	int count;
+	bitoff_t last;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	bit_cnt = _bitstr_bits(b1);
-	for (bit = 0; bit < bit_cnt; bit += word_size) {
-		if ((bit + word_size - 1) >= bit_cnt)
-			break;
-		count += hweight(b1[_bit_word(bit)] & b2[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
-		if (bit_test(b1, bit) && bit_test(b2, bit))
-			count++;
-	}
+	if (_bitstr_bits(b1) == 0)
+		return 0;
+
+	last = _bitstr_data_words(b1) - 1;
+#ifdef HAVE_BITSTR_X86_DISPATCH
+	if (_use_popcnt())
+		count = _and_count_words_popcnt(b1 + BITSTR_OVERHEAD,
+						b2 + BITSTR_OVERHEAD, last);
+	else
+#endif
+	count = _and_count_words(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD,
+				 last);
+	count += hweight((bitstr_uword_t) (b1[last + BITSTR_OVERHEAD] &
+					   b2[last + BITSTR_OVERHEAD] &
+					   _bit_tail_mask(_bitstr_bits(b1))));
 
 	return count;
 }
 
+/*
+ * return 1 if any bit set in b1 is also set in b2, 0 if no overlap.
+ * Faster than bit_overlap() when the number of common bits is not needed.
+ */
+extern int
+bit_overlap_any(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t last;
+	int any;
+
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	assert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	if (_bitstr_bits(b1) == 0)
+		return 0;
+
+	last = _bitstr_data_words(b1) - 1;
+#ifdef HAVE_BITSTR_X86_DISPATCH
+	if (_use_avx2(last))
+		any = _and_any_words_avx2(b1 + BITSTR_OVERHEAD,
+					  b2 + BITSTR_OVERHEAD, last);
+	else
+#endif
+	any = _and_any_words(b1 + BITSTR_OVERHEAD, b2 + BITSTR_OVERHEAD, last);
+	if (any)
+		return 1;
+	if (b1[last + BITSTR_OVERHEAD] & b2[last + BITSTR_OVERHEAD] &
+	    _bit_tail_mask(_bitstr_bits(b1)))
+		return 1;
+
+	return 0;
+}
+
 /*
  * Count the number of bits clear in bitstring.
  *   b (IN)		bitstring to check
@@ -0,0 +1,248 @@
+/*****************************************************************************\
+ *  conn_cache.c - cache of idle connections to slurmd daemons for reuse
+ *	by later RPCs
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/poll.h>
+#include <time.h>
+
+#include "src/common/conn_cache.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+
+typedef struct conn_cache_ent {
+	slurm_addr_t addr;
+	slurm_fd_t fd;
+	time_t idle_start;
+	struct conn_cache_ent *next;
+} conn_cache_ent_t;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static conn_cache_ent_t **cache_hash = NULL;
+static uint32_t cache_hash_size = 0;	/* power of two */
+static uint16_t cache_max = 0;
+static uint32_t cache_cnt = 0;
+static time_t   last_purge = 0;
+
+/* Statistics since the last report */
+static uint32_t stat_gets = 0, stat_reused = 0, stat_stale = 0;
+static uint32_t stat_cached = 0, stat_full = 0, stat_idle = 0;
+
+static void _close_conn(slurm_fd_t fd)
+{
+	int retry = 0;
+
+	while ((slurm_shutdown_msg_conn(fd) < 0) && (errno == EINTR)) {
+		if (retry++ > 10)
+			break;
+	}
+}
+
+static uint32_t _hash_addr(slurm_addr_t *addr)
+{
+	uint32_t hash = addr->sin_addr.s_addr ^ (addr->sin_port << 16);
+
+	return (hash * 2654435761U) & (cache_hash_size - 1);
+}
+
+static bool _same_addr(slurm_addr_t *addr1, slurm_addr_t *addr2)
+{
+	return ((addr1->sin_addr.s_addr == addr2->sin_addr.s_addr) &&
+		(addr1->sin_port == addr2->sin_port));
+}
+
+/* Return true if a connection is still open and has no unexpected data,
+ * i.e. the slurmd has not closed its end */
+static bool _conn_idle(slurm_fd_t fd)
+{
+	struct pollfd ufds;
+
+	ufds.fd = fd;
+	ufds.events = POLLIN;
+	ufds.revents = 0;
+	if (poll(&ufds, 1, 0) != 0)
+		return false;
+	return true;
+}
+
+/* Close cached connections which have been idle too long, or all cached
+ * connections if purge_all is set. Call with cache_lock held. */
+static void _purge_conns(time_t now, bool purge_all)
+{
+	conn_cache_ent_t *ent, **ent_pp;
+	uint32_t i;
+
+	last_purge = now;
+	for (i = 0; i < cache_hash_size; i++) {
+		ent_pp = &cache_hash[i];
+		while ((ent = *ent_pp)) {
+			if (!purge_all &&
+			    (difftime(now, ent->idle_start) <
+			     CONN_CACHE_IDLE_TIME)) {
+				ent_pp = &ent->next;
+				continue;
+			}
+			*ent_pp = ent->next;
+			_close_conn(ent->fd);
+			xfree(ent);
+			cache_cnt--;
+			if (!purge_all)
+				stat_idle++;
+		}
+	}
+}
+
+extern void conn_cache_init(uint16_t max_conns)
+{
+	slurm_mutex_lock(&cache_lock);
+	if (max_conns != cache_max) {
+		_purge_conns(time(NULL), true);
+		xfree(cache_hash);
+		cache_hash_size = 0;
+		cache_max = max_conns;
+		if (cache_max) {
+			cache_hash_size = 64;
+			while (cache_hash_size < cache_max)
+				cache_hash_size *= 2;
+			cache_hash = xmalloc(sizeof(conn_cache_ent_t *) *
+					     cache_hash_size);
+			verbose("Caching up to %u idle connections to slurmd",
+				cache_max);
+		}
+	}
+	slurm_mutex_unlock(&cache_lock);
+}
+
+extern bool conn_cache_enabled(void)
+{
+	return (cache_max != 0);
+}
+
+extern slurm_fd_t conn_cache_get(slurm_addr_t *addr)
+{
+	conn_cache_ent_t *ent, **ent_pp;
+	slurm_fd_t fd = -1;
+	time_t now;
+
+	slurm_mutex_lock(&cache_lock);
+	if (cache_max == 0) {
+		slurm_mutex_unlock(&cache_lock);
+		return fd;
+	}
+
+	now = time(NULL);
+	if (difftime(now, last_purge) >= (CONN_CACHE_IDLE_TIME / 2))
+		_purge_conns(now, false);
+
+	stat_gets++;
+	ent_pp = &cache_hash[_hash_addr(addr)];
+	while ((ent = *ent_pp)) {
+		if (!_same_addr(&ent->addr, addr)) {
+			ent_pp = &ent->next;
+			continue;
+		}
+		*ent_pp = ent->next;
+		cache_cnt--;
+		if (_conn_idle(ent->fd)) {
+			fd = ent->fd;
+			xfree(ent);
+			stat_reused++;
+			break;
+		}
+		_close_conn(ent->fd);
+		xfree(ent);
+		stat_stale++;
+	}
+	slurm_mutex_unlock(&cache_lock);
+
+	return fd;
+}
+
+extern void conn_cache_put(slurm_addr_t *addr, slurm_fd_t fd)
+{
+	conn_cache_ent_t *ent;
+	uint32_t inx;
+
+	slurm_mutex_lock(&cache_lock);
+	if (cache_cnt >= cache_max) {
+		if (cache_max)
+			stat_full++;
+		slurm_mutex_unlock(&cache_lock);
+		_close_conn(fd);
+		return;
+	}
+
+	ent = xmalloc(sizeof(conn_cache_ent_t));
+	memcpy(&ent->addr, addr, sizeof(slurm_addr_t));
+	ent->fd = fd;
+	ent->idle_start = time(NULL);
+	inx = _hash_addr(addr);
+	ent->next = cache_hash[inx];
+	cache_hash[inx] = ent;
+	cache_cnt++;
+	stat_cached++;
+	slurm_mutex_unlock(&cache_lock);
+}
+
+extern void conn_cache_stats_report(void)
+{
+	slurm_mutex_lock(&cache_lock);
+	if (stat_gets || stat_cached) {
+		debug("Connection cache stats: requests=%u reused=%u (%u%%) "
+		      "stale=%u cached=%u cache_full=%u idle_closed=%u "
+		      "open=%u",
+		      stat_gets, stat_reused,
+		      stat_gets ? ((stat_reused * 100) / stat_gets) : 0,
+		      stat_stale, stat_cached, stat_full, stat_idle,
+		      cache_cnt);
+	}
+	stat_gets = stat_reused = stat_stale = 0;
+	stat_cached = stat_full = stat_idle = 0;
+	slurm_mutex_unlock(&cache_lock);
+}
+
+extern void conn_cache_fini(void)
+{
+	conn_cache_init(0);
+}
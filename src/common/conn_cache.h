@@ -0,0 +1,92 @@
+/*****************************************************************************\
+ *  conn_cache.h - cache of idle connections to slurmd daemons for reuse
+ *	by later RPCs
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _CONN_CACHE_H
+#define _CONN_CACHE_H
+
+#include "src/common/slurm_protocol_api.h"
+
+/*
+ * Opening a connection to a slurmd and having it spawn a thread to service
+ * the connection costs more than most of the RPCs which slurmctld's agent
+ * sends. When enabled (ConnCacheSize in slurm.conf), a request sent with
+ * the SLURM_KEEP_CONN flag asks the slurmd to keep the connection open
+ * after replying. If the reply also has the SLURM_KEEP_CONN flag set, the
+ * connection is saved here so that a later request to the same address
+ * can be sent over it. Connections left idle for CONN_CACHE_IDLE_TIME
+ * seconds are closed. The slurmd closes connections left idle for longer
+ * than that.
+ */
+
+/* Seconds a cached connection may remain idle */
+#define CONN_CACHE_IDLE_TIME	30
+
+/*
+ * conn_cache_init - enable or disable the connection cache
+ * IN max_conns - maximum count of idle connections to cache, zero to
+ *	disable the cache and close all cached connections
+ */
+extern void conn_cache_init(uint16_t max_conns);
+
+/* conn_cache_enabled - return true if connections may be cached */
+extern bool conn_cache_enabled(void);
+
+/*
+ * conn_cache_get - remove a live cached connection to an address from the
+ *	cache
+ * IN addr - address of the slurmd
+ * RET open connection or -1 if none is cached
+ */
+extern slurm_fd_t conn_cache_get(slurm_addr_t *addr);
+
+/*
+ * conn_cache_put - save an idle connection for reuse, or close it if the
+ *	cache is disabled or full
+ * IN addr - address of the slurmd
+ * IN fd - open connection, with no unread data
+ */
+extern void conn_cache_put(slurm_addr_t *addr, slurm_fd_t fd);
+
+/* conn_cache_stats_report - Log connection reuse statistics accumulated
+ *	since the last report, then clear them */
+extern void conn_cache_stats_report(void);
+
+/* conn_cache_fini - close all cached connections and disable the cache */
+extern void conn_cache_fini(void);
+
+#endif	/* !_CONN_CACHE_H */
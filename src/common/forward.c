@@ -313,6 +313,11 @@ void *_fwd_tree_thread(void *arg)
 	slurm_msg_t_init(&send_msg);
 	send_msg.msg_type = fwd_tree->orig_msg->msg_type;
 	send_msg.data = fwd_tree->orig_msg->data;
+	/* The connection to the head of each subtree is reused as for a
+	 * direct send: slurm_send_addr_recv_msgs() drops the flag if the
+	 * connection cache is disabled and only retries a cached connection
+	 * if the request could not be written */
+	send_msg.flags = fwd_tree->orig_msg->flags & SLURM_KEEP_CONN;
 
 	/* repeat until we are sure the message was sent */
 	while((name = hostlist_shift(fwd_tree->tree_hl))) {
@@ -471,7 +476,8 @@ extern int forward_msg(forward_struct_t *forward_struct,
 		       sizeof(slurm_addr_t));
 
 		forward_msg->header.version = header->version;
-		forward_msg->header.flags = header->flags;
+		/* Connections opened to forward a message are not kept */
+		forward_msg->header.flags = header->flags & (~SLURM_KEEP_CONN);
 		forward_msg->header.msg_type = header->msg_type;
 		forward_msg->header.body_length = header->body_length;
 		forward_msg->header.ret_list = NULL;
@@ -81,6 +81,7 @@ extern int jobacct_common_init_struct(struct jobacctinfo *jobacct,
 		jobacct_id_t temp_id;
 		temp_id.taskid = (uint16_t)NO_VAL;
 		temp_id.nodeid = (uint32_t)NO_VAL;
+		temp_id.job = NULL;
 		jobacct_id = &temp_id;
 	}
 	memset(jobacct, 0, sizeof(struct jobacctinfo));
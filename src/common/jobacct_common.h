@@ -72,6 +72,8 @@
 typedef struct {
 	uint16_t taskid; /* contains which task number it was on */
 	uint32_t nodeid; /* contains which node number it was on */
+	struct slurmd_job *job; /* step of the task, set by slurmstepd when
+				 * adding a task, not packed */
 } jobacct_id_t;
 
 struct jobacctinfo {
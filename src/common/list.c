@@ -85,6 +85,11 @@ strong_alias(list_find,		slurm_list_find);
 strong_alias(list_remove,	slurm_list_remove);
 strong_alias(list_delete_item,	slurm_list_delete_item);
 strong_alias(list_install_fork_handlers, slurm_list_install_fork_handlers);
+strong_alias(list_queue_create,	slurm_list_queue_create);
+strong_alias(list_queue_destroy,	slurm_list_queue_destroy);
+strong_alias(list_queue_push,	slurm_list_queue_push);
+strong_alias(list_queue_pop,	slurm_list_queue_pop);
+strong_alias(list_queue_count,	slurm_list_queue_count);
 /*********************
  *  lsd_fatal_error  *
  *********************/
@@ -147,6 +152,23 @@ strong_alias(list_install_fork_handlers, slurm_list_install_fork_handlers);
 #endif
 #define LIST_MAGIC 0xDEADBEEF
 
+/*  Each thread keeps a cache of free list nodes and iterators so that the
+ *    global freelists (and list_free_lock) are only used to move objects
+ *    into or out of a cache in batches of LIST_CACHE_BATCH objects.
+ */
+#if defined(WITH_PTHREADS) && !defined(MEMORY_LEAK_DEBUG) && defined(__GNUC__)
+#  define LIST_THREAD_CACHE 1
+#  define LIST_CACHE_BATCH 64
+#endif
+
+/*  ListQueue operations use the compiler's atomic builtins when available,
+ *    or otherwise a mutex around the shared end of the queue.
+ */
+#if defined(__GNUC__) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 1)))
+#  define LIST_ATOMICS 1
+#endif
+
 
 /****************
  *  Data Types  *
@@ -181,8 +203,28 @@ struct list {
 #endif /* !NDEBUG */
 };
 
+struct listQueue {
+    struct listNode      *head;         /* items pushed, newest first        */
+    struct listNode      *fifo;         /* consumer's items, oldest first    */
+    ListDelF              fDel;         /* function to delete node data      */
+    int                   count;        /* number of items in queue          */
+#if !defined(LIST_ATOMICS) && defined(WITH_PTHREADS)
+    pthread_mutex_t       mutex;        /* mutex to protect head and count   */
+#endif /* !LIST_ATOMICS && WITH_PTHREADS */
+#ifndef NDEBUG
+    unsigned int          magic;        /* sentinel for asserting validity   */
+#endif /* !NDEBUG */
+};
+
 typedef struct listNode * ListNode;
 
+#ifdef LIST_THREAD_CACHE
+struct listCache {
+    void                 *free;         /* free objects held by this thread  */
+    int                   count;        /* number of objects in free         */
+};
+#endif /* LIST_THREAD_CACHE */
+
 
 /****************
  *  Prototypes  *
@@ -198,6 +240,14 @@ static ListIterator list_iterator_alloc (void);
 static void list_iterator_free (ListIterator i);
 static void * list_alloc_aux (int size, void *pfreelist);
 static void list_free_aux (void *x, void *pfreelist);
+static int list_alloc_chunk (int size, void *pfreelist);
+#ifdef LIST_THREAD_CACHE
+static void * list_cache_alloc (int size, void *pfreelist,
+				struct listCache *c);
+static void list_cache_free (void *x, void *pfreelist, struct listCache *c);
+static void list_cache_drain (struct listCache *c, void *pfreelist);
+static void list_cache_register (void);
+#endif /* LIST_THREAD_CACHE */
 
 
 /***************
@@ -212,6 +262,14 @@ static ListIterator list_free_iterators = NULL;
 static pthread_mutex_t list_free_lock = PTHREAD_MUTEX_INITIALIZER;
 #endif /* WITH_PTHREADS */
 
+#ifdef LIST_THREAD_CACHE
+static __thread struct listCache list_node_cache;
+static __thread struct listCache list_iterator_cache;
+static __thread int list_cache_registered = 0;
+static pthread_key_t list_cache_key;
+static pthread_once_t list_cache_once = PTHREAD_ONCE_INIT;
+#endif /* LIST_THREAD_CACHE */
+
 
 /************
  *  Macros  *
@@ -690,6 +748,127 @@ list_dequeue (List l)
 }
 
 
+ListQueue
+list_queue_create (ListDelF f)
+{
+    ListQueue q;
+
+    if (!(q = xmalloc(sizeof(struct listQueue))))
+	return(lsd_nomem_error(__FILE__, __LINE__, "list queue create"));
+    q->head = NULL;
+    q->fifo = NULL;
+    q->fDel = f;
+    q->count = 0;
+#ifndef LIST_ATOMICS
+    list_mutex_init(&q->mutex);
+#endif /* !LIST_ATOMICS */
+    assert(q->magic = LIST_MAGIC);      /* set magic via assert abuse */
+    return(q);
+}
+
+
+void
+list_queue_destroy (ListQueue q)
+{
+    void *v;
+
+    assert(q != NULL);
+    assert(q->magic == LIST_MAGIC);
+    while ((v = list_queue_pop(q))) {
+	if (q->fDel)
+	    q->fDel(v);
+    }
+#ifndef LIST_ATOMICS
+    list_mutex_destroy(&q->mutex);
+#endif /* !LIST_ATOMICS */
+    assert(q->magic = ~LIST_MAGIC);     /* clear magic via assert abuse */
+    xfree(q);
+    return;
+}
+
+
+int
+list_queue_push (ListQueue q, void *x)
+{
+    ListNode p, head;
+
+    assert(q != NULL);
+    assert(q->magic == LIST_MAGIC);
+    assert(x != NULL);
+    if (!(p = list_node_alloc())) {
+	(void) lsd_nomem_error(__FILE__, __LINE__, "list queue push");
+	return(-1);
+    }
+    p->data = x;
+#ifdef LIST_ATOMICS
+    do {
+	head = q->head;
+	p->next = head;
+    } while (!__sync_bool_compare_and_swap(&q->head, head, p));
+    __sync_fetch_and_add(&q->count, 1);
+#else /* !LIST_ATOMICS */
+    list_mutex_lock(&q->mutex);
+    head = q->head;
+    p->next = head;
+    q->head = p;
+    q->count++;
+    list_mutex_unlock(&q->mutex);
+#endif /* !LIST_ATOMICS */
+    return(head == NULL);
+}
+
+
+void *
+list_queue_pop (ListQueue q)
+{
+    ListNode p, pNext, fifo;
+    void *v;
+
+    assert(q != NULL);
+    assert(q->magic == LIST_MAGIC);
+    if (!q->fifo) {
+	/*  Take every item pushed so far, and reverse their order.
+	 */
+#ifdef LIST_ATOMICS
+	p = __sync_lock_test_and_set(&q->head, NULL);
+#else /* !LIST_ATOMICS */
+	list_mutex_lock(&q->mutex);
+	p = q->head;
+	q->head = NULL;
+	list_mutex_unlock(&q->mutex);
+#endif /* !LIST_ATOMICS */
+	for (fifo = NULL; p; p = pNext) {
+	    pNext = p->next;
+	    p->next = fifo;
+	    fifo = p;
+	}
+	if (!(q->fifo = fifo))
+	    return(NULL);
+    }
+    p = q->fifo;
+    q->fifo = p->next;
+#ifdef LIST_ATOMICS
+    __sync_fetch_and_sub(&q->count, 1);
+#else /* !LIST_ATOMICS */
+    list_mutex_lock(&q->mutex);
+    q->count--;
+    list_mutex_unlock(&q->mutex);
+#endif /* !LIST_ATOMICS */
+    v = p->data;
+    list_node_free(p);
+    return(v);
+}
+
+
+int
+list_queue_count (ListQueue q)
+{
+    assert(q != NULL);
+    assert(q->magic == LIST_MAGIC);
+    return(*(volatile int *) &q->count);
+}
+
+
 ListIterator
 list_iterator_create (List l)
 {
@@ -917,14 +1096,23 @@ list_free (List l)
 static ListNode
 list_node_alloc (void)
 {
+#ifdef LIST_THREAD_CACHE
+    return(list_cache_alloc(sizeof(struct listNode), &list_free_nodes,
+			    &list_node_cache));
+#else /* !LIST_THREAD_CACHE */
     return(list_alloc_aux(sizeof(struct listNode), &list_free_nodes));
+#endif /* !LIST_THREAD_CACHE */
 }
 
 
 static void
 list_node_free (ListNode p)
 {
+#ifdef LIST_THREAD_CACHE
+    list_cache_free(p, &list_free_nodes, &list_node_cache);
+#else /* !LIST_THREAD_CACHE */
     list_free_aux(p, &list_free_nodes);
+#endif /* !LIST_THREAD_CACHE */
     return;
 }
 
@@ -932,14 +1120,23 @@ list_node_free (ListNode p)
 static ListIterator
 list_iterator_alloc (void)
 {
+#ifdef LIST_THREAD_CACHE
+    return(list_cache_alloc(sizeof(struct listIterator), &list_free_iterators,
+			    &list_iterator_cache));
+#else /* !LIST_THREAD_CACHE */
     return(list_alloc_aux(sizeof(struct listIterator), &list_free_iterators));
+#endif /* !LIST_THREAD_CACHE */
 }
 
 
 static void
 list_iterator_free (ListIterator i)
 {
+#ifdef LIST_THREAD_CACHE
+    list_cache_free(i, &list_free_iterators, &list_iterator_cache);
+#else /* !LIST_THREAD_CACHE */
     list_free_aux(i, &list_free_iterators);
+#endif /* !LIST_THREAD_CACHE */
     return;
 }
 
@@ -953,22 +1150,14 @@ list_alloc_aux (int size, void *pfreelist)
  */
     void **px;
     void **pfree = pfreelist;
-    void **plast;
 
     assert(sizeof(char) == 1);
     assert(size >= sizeof(void *));
     assert(pfreelist != NULL);
     assert(LIST_ALLOC > 0);
     list_mutex_lock(&list_free_lock);
-    if (!*pfree) {
-	if ((*pfree = xmalloc(LIST_ALLOC * size))) {
-	    px = *pfree;
-	    plast = (void **) ((char *) *pfree + ((LIST_ALLOC - 1) * size));
-	    while (px < plast)
-		*px = (char *) px + size, px = *px;
-	    *plast = NULL;
-	}
-    }
+    if (!*pfree)
+	(void) list_alloc_chunk(size, pfree);
     if ((px = *pfree))
 	*pfree = *px;
     else
@@ -978,6 +1167,29 @@ list_alloc_aux (int size, void *pfreelist)
 }
 
 
+static int
+list_alloc_chunk (int size, void *pfreelist)
+{
+/*  Adds LIST_ALLOC objects of [size] bytes to the empty freelist [*pfreelist].
+ *  Returns 1 on success, or 0 if the memory request fails.
+ *  This routine assumes list_free_lock is already locked upon entry.
+ */
+    void **px;
+    void **pfree = pfreelist;
+    void **plast;
+
+    assert(*pfree == NULL);
+    if (!(*pfree = xmalloc(LIST_ALLOC * size)))
+	return(0);
+    px = *pfree;
+    plast = (void **) ((char *) *pfree + ((LIST_ALLOC - 1) * size));
+    while (px < plast)
+	*px = (char *) px + size, px = *px;
+    *plast = NULL;
+    return(1);
+}
+
+
 static void
 list_free_aux (void *x, void *pfreelist)
 {
@@ -999,6 +1211,134 @@ list_free_aux (void *x, void *pfreelist)
     return;
 }
 
+#ifdef LIST_THREAD_CACHE
+static void *
+list_cache_alloc (int size, void *pfreelist, struct listCache *c)
+{
+/*  Allocates an object of [size] bytes from this thread's cache [c],
+ *    first moving up to LIST_CACHE_BATCH objects into the cache from the
+ *    freelist [*pfreelist] if it is empty.
+ *  Returns a ptr to the object, or NULL if the memory request fails.
+ */
+    void **px;
+    void **pfree = pfreelist;
+    int n;
+
+    assert(size >= sizeof(void *));
+    if (!c->free) {
+	list_cache_register();
+	list_mutex_lock(&list_free_lock);
+	for (n = 0; n < LIST_CACHE_BATCH; n++) {
+	    if (!*pfree && !list_alloc_chunk(size, pfree))
+		break;
+	    px = *pfree;
+	    *pfree = *px;
+	    *px = c->free;
+	    c->free = px;
+	    c->count++;
+	}
+	list_mutex_unlock(&list_free_lock);
+	if (!c->free) {
+	    errno = ENOMEM;
+	    return(NULL);
+	}
+    }
+    px = c->free;
+    c->free = *px;
+    c->count--;
+    return(px);
+}
+
+
+static void
+list_cache_free (void *x, void *pfreelist, struct listCache *c)
+{
+/*  Frees the object [x], returning it to this thread's cache [c].
+ *  Once the cache holds twice LIST_CACHE_BATCH objects, a batch of them
+ *    is returned to the freelist [*pfreelist] for use by other threads.
+ */
+    void **px = x;
+    void **pfree = pfreelist;
+    void *first;
+    int n;
+
+    assert(x != NULL);
+    list_cache_register();
+    *px = c->free;
+    c->free = px;
+    if (++c->count < 2 * LIST_CACHE_BATCH)
+	return;
+
+    first = c->free;
+    for (n = 1; n < LIST_CACHE_BATCH; n++)
+	px = *px;
+    c->free = *px;
+    c->count -= LIST_CACHE_BATCH;
+    list_mutex_lock(&list_free_lock);
+    *px = *pfree;
+    *pfree = first;
+    list_mutex_unlock(&list_free_lock);
+    return;
+}
+
+
+static void
+list_cache_drain (struct listCache *c, void *pfreelist)
+{
+/*  Returns all objects in the cache [c] to the freelist [*pfreelist].
+ */
+    void **px;
+    void **pfree = pfreelist;
+
+    if (!(px = c->free))
+	return;
+    while (*px)
+	px = *px;
+    list_mutex_lock(&list_free_lock);
+    *px = *pfree;
+    *pfree = c->free;
+    list_mutex_unlock(&list_free_lock);
+    c->free = NULL;
+    c->count = 0;
+    return;
+}
+
+
+static void
+list_cache_destructor (void *arg)
+{
+/*  Returns the objects cached by an exiting thread to the freelists.
+ */
+    list_cache_drain(&list_node_cache, &list_free_nodes);
+    list_cache_drain(&list_iterator_cache, &list_free_iterators);
+    list_cache_registered = 0;
+    return;
+}
+
+
+static void
+list_cache_key_create (void)
+{
+    if (pthread_key_create(&list_cache_key, list_cache_destructor))
+	lsd_fatal_error(__FILE__, __LINE__, "list cache key create");
+    return;
+}
+
+
+static void
+list_cache_register (void)
+{
+/*  Arranges for this thread's caches to be drained when it exits.
+ */
+    if (list_cache_registered)
+	return;
+    pthread_once(&list_cache_once, list_cache_key_create);
+    pthread_setspecific(list_cache_key, &list_node_cache);
+    list_cache_registered = 1;
+    return;
+}
+#endif /* LIST_THREAD_CACHE */
+
 #ifdef WITH_PTHREADS
 static void
 list_reinit_mutexes (void)
@@ -111,6 +111,11 @@ typedef int (*ListForF) (void *x, void *arg);
  */
 #endif
 
+typedef struct listQueue * ListQueue;
+/*
+ *  Concurrent queue opaque data type.
+ */
+
 
 /*******************************
  *  General-Purpose Functions  *
@@ -269,6 +274,55 @@ void * list_dequeue (List l);
  */
 
 
+/********************************
+ *  Concurrent Queue Functions  *
+ *******************************/
+
+/*
+ *  A ListQueue passes items from any number of producer threads to a
+ *    single consumer.  Producers never block one another or the consumer:
+ *    an item is added with one atomic compare-and-swap.  The consumer
+ *    takes all items added since its last visit with one atomic exchange.
+ *    Callers must make sure that only one thread at a time calls
+ *    list_queue_pop(), for example by holding a lock of their own.
+ */
+
+ListQueue list_queue_create (ListDelF f);
+/*
+ *  Creates and returns a new empty queue, or lsd_nomem_error() on failure.
+ *  The deletion function [f] is used to deallocate memory used by items
+ *    still in the queue when it is destroyed.
+ */
+
+void list_queue_destroy (ListQueue q);
+/*
+ *  Destroys queue [q], freeing the items it still holds with the deletion
+ *    function specified when the queue was created.
+ *  Note: No other thread may use the queue during or after this call.
+ */
+
+int list_queue_push (ListQueue q, void *x);
+/*
+ *  Adds data [x] to the tail of queue [q].  May be called by any thread.
+ *  Returns 1 if no earlier items were waiting to be collected by the
+ *    consumer (so the consumer may need to be woken), 0 if there were,
+ *    or -1 with lsd_nomem_error() if insertion failed.
+ */
+
+void * list_queue_pop (ListQueue q);
+/*
+ *  Removes the data item at the head of queue [q].  Only one thread at a
+ *    time may call this function.
+ *  Returns the data's ptr, or NULL if the queue is empty.
+ */
+
+int list_queue_count (ListQueue q);
+/*
+ *  Returns the number of items in queue [q].  The count may be out of date
+ *    by the time it is returned if other threads are using the queue.
+ */
+
+
 /*****************************
  *  List Iterator Functions  *
  *****************************/
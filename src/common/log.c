@@ -60,6 +60,8 @@
 
 #include <stdarg.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <time.h>
 
 #ifdef WITH_PTHREADS
 #  include <pthread.h>
@@ -90,6 +92,19 @@
 #  define LINEBUFSIZE 256
 #endif
 
+/*  Output to the log files, syslog and stderr can be handed to a writer
+ *    thread through a ring of LOG_RING_SIZE messages (see log_async_init()).
+ *    Slots of the ring are claimed with the compiler's atomic builtins.
+ */
+#if defined(WITH_PTHREADS) && defined(__GNUC__) && \
+    ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 1)))
+#  define LOG_ASYNC 1
+#  define LOG_RING_SIZE		4096	/* must be a power of 2 */
+#  define LOG_WRITER_BATCH	64	/* messages written per fflush() */
+#endif
+
+#define LOG_BUF_KEEP	16384	/* larger message buffers are not reused */
+
 /*
 ** Define slurm-specific aliases for use by plugins, see slurm_xlator.h
 ** for details.
@@ -143,6 +158,47 @@ static log_t            *sched_log = NULL;
 
 #define LOG_INITIALIZED ((log != NULL) && (log->initialized))
 #define SCHED_LOG_INITIALIZED ((sched_log != NULL) && (sched_log->initialized))
+
+/* log_max_level is the highest level accepted by any facility of the log
+ * (LOG_LEVEL_END until it is initialized) and log_sched_on is set while
+ * the scheduler log is written. Both are only changed with log_lock held,
+ * but log_msg() reads them without it to discard disabled messages. */
+static volatile log_level_t log_max_level = LOG_LEVEL_END;
+static volatile bool        log_sched_on  = false;
+
+#ifdef WITH_PTHREADS
+/* each thread formats its messages into a buffer of its own */
+static pthread_key_t   log_buf_key;
+static pthread_once_t  log_buf_once = PTHREAD_ONCE_INIT;
+#endif /* WITH_PTHREADS */
+
+#ifdef LOG_ASYNC
+/* A slot for message number N is free when seq == N, holds the message
+ * once seq == N + 1 and is free again for N + LOG_RING_SIZE once written.
+ * The buffer of a written message is kept in the slot and handed back to
+ * the next thread that queues a message there. */
+typedef struct {
+	volatile uint32_t seq;
+	log_level_t level;
+	bool        sched;	/* message format started with "sched: " */
+	time_t      time;
+	char       *msg;
+} log_slot_t;
+
+static log_slot_t        log_ring[LOG_RING_SIZE];
+static volatile uint32_t log_ring_head = 0;	/* next slot to claim */
+static volatile uint32_t log_ring_tail = 0;	/* next slot to write */
+static volatile uint32_t log_dropped = 0;	/* messages lost, ring full */
+static volatile bool     log_writer_running = false;
+static bool              log_writer_atexit = false;
+static volatile bool     log_writer_idle = false;
+static bool              log_writer_stop = false;
+static pthread_t         log_writer_tid;
+static pid_t             log_writer_pid = 0;	/* process running writer */
+static pthread_mutex_t   log_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t    log_writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t    log_drain_cond  = PTHREAD_COND_INITIALIZER;
+#endif /* LOG_ASYNC */
 /* define a default argv0 */
 #if HAVE_PROGRAM_INVOCATION_NAME
 /* This used to use program_invocation_short_name, but on some systems
@@ -158,9 +214,29 @@ extern char * program_invocation_name;
  * pthread_atfork handlers:
  */
 #ifdef WITH_PTHREADS
-static void _atfork_prep()   { slurm_mutex_lock(&log_lock);   }
-static void _atfork_parent() { slurm_mutex_unlock(&log_lock); }
-static void _atfork_child()  { slurm_mutex_unlock(&log_lock); }
+static void _atfork_prep()
+{
+	slurm_mutex_lock(&log_lock);
+#  ifdef LOG_ASYNC
+	slurm_mutex_lock(&log_writer_lock);
+#  endif
+}
+static void _atfork_parent()
+{
+#  ifdef LOG_ASYNC
+	slurm_mutex_unlock(&log_writer_lock);
+#  endif
+	slurm_mutex_unlock(&log_lock);
+}
+static void _atfork_child()
+{
+#  ifdef LOG_ASYNC
+	/* the writer thread is not forked, log directly in the child */
+	log_writer_running = false;
+	slurm_mutex_unlock(&log_writer_lock);
+#  endif
+	slurm_mutex_unlock(&log_lock);
+}
 static bool at_forked = false;
 #  define atfork_install_handlers()                                           \
           while (!at_forked) {                                                \
@@ -171,6 +247,7 @@ static bool at_forked = false;
 #  define atfork_install_handlers() (NULL)
 #endif
 static void _log_flush(log_t *log);
+static void _log_async_fini(void);
 
 /* check to see if a file is writeable,
  * RET 1 if file can be written now,
@@ -216,6 +293,20 @@ static int _fd_writeable(int fd)
 	return 1;
 }
 
+/* recompute log_max_level and log_sched_on, log_lock must be held */
+static void _log_levels_update(void)
+{
+	log_level_t max_level = LOG_LEVEL_END;
+
+	if (LOG_INITIALIZED) {
+		max_level = MAX(log->opt.stderr_level, log->opt.syslog_level);
+		max_level = MAX(max_level, log->opt.logfile_level);
+	}
+	log_max_level = max_level;
+	log_sched_on  = (SCHED_LOG_INITIALIZED && (sched_log->logfp != NULL) &&
+			 (sched_log->opt.logfile_level > LOG_LEVEL_QUIET));
+}
+
 /*
  * Initialize log with
  * prog = program name to tag error messages with
@@ -302,6 +393,7 @@ _log_init(char *prog, log_options_t opt, log_facility_t fac, char *logfile )
 
 	log->initialized = 1;
  out:
+	_log_levels_update();
 	return rc;
 }
 
@@ -380,6 +472,7 @@ _sched_log_init(char *prog, log_options_t opt, log_facility_t fac,
 
 	sched_log->initialized = 1;
  out:
+	_log_levels_update();
 	return rc;
 }
 
@@ -414,6 +507,7 @@ void log_fini()
 	if (!log)
 		return;
 
+	_log_async_fini();
 	slurm_mutex_lock(&log_lock);
 	_log_flush(log);
 	xfree(log->argv0);
@@ -425,6 +519,7 @@ void log_fini()
 	if (log->logfp)
 		fclose(log->logfp);
 	xfree(log);
+	_log_levels_update();
 	slurm_mutex_unlock(&log_lock);
 }
 
@@ -444,6 +539,7 @@ void sched_log_fini(void)
 	if (sched_log->logfp)
 		fclose(sched_log->logfp);
 	xfree(sched_log);
+	_log_levels_update();
 	slurm_mutex_unlock(&log_lock);
 }
 
@@ -517,8 +613,8 @@ FILE *log_fp(void)
 	return fp;
 }
 
-/* return a heap allocated string formed from fmt and ap arglist
- * returned string is allocated with xmalloc, so must free with xfree.
+/* append the string formed from fmt and ap arglist to *dst, which is
+ * allocated (or expanded) with xmalloc, so must free with xfree.
  *
  * args are like printf, with the addition of the following format chars:
  * - %m expands to strerror(errno)
@@ -531,11 +627,12 @@ FILE *log_fp(void)
  * (inc. newline)
  *
  */
-static char *vxstrfmt(const char *fmt, va_list ap)
+static void _vxstrfmtcat(char **dst, const char *fmt, va_list ap)
 {
-	char        *buf = NULL;
+	char        *buf = *dst;
 	char        *p   = NULL;
 	size_t      len = (size_t) 0;
+	size_t      offset = buf ? strlen(buf) : 0;
 	char        tmp[LINEBUFSIZE];
 	int         unprocessed = 0;
 	int         long_long = 0;
@@ -701,30 +798,23 @@ static char *vxstrfmt(const char *fmt, va_list ap)
 	}
 
 	if (unprocessed > 0) {
-		vsnprintf(tmp, sizeof(tmp)-1, buf, ap);
-		xfree(buf);
-		return xstrdup(tmp);
+		vsnprintf(tmp, sizeof(tmp)-1, buf + offset, ap);
+		buf[offset] = '\0';
+		xstrcat(buf, tmp);
 	}
 
-	return buf;
+	*dst = buf;
 }
 
-/*
- * concatenate result of xstrfmt() to dst, expanding dst if necessary
+/* return a heap allocated string formed from fmt and ap arglist
+ * returned string is allocated with xmalloc, so must free with xfree.
  */
-static void xlogfmtcat(char **dst, const char *fmt, ...)
+static char *vxstrfmt(const char *fmt, va_list ap)
 {
-	va_list ap;
 	char *buf = NULL;
 
-	va_start(ap, fmt);
-	buf = vxstrfmt(fmt, ap);
-	va_end(ap);
-
-	xstrcat(*dst, buf);
-
-	xfree(buf);
-
+	_vxstrfmtcat(&buf, fmt, ap);
+	return buf;
 }
 
 static void
@@ -756,40 +846,44 @@ _log_printf(log_t *log, cbuf_t cb, FILE *stream, const char *fmt, ...)
 
 }
 
+/* format the "[time] " prefix of log file lines, like "%M" would */
+static void _log_stamp(char *stamp, size_t size, time_t when)
+{
+	struct tm tm;
+
+	if (!localtime_r(&when, &tm)) {
+		stamp[0] = '\0';
+		return;
+	}
+#ifdef USE_ISO_8601
+	strftime(stamp, size, "[%Y-%m-%dT%T] ", &tm);
+#else
+	strftime(stamp, size, "[%b %d %T] ", &tm);
+#endif
+}
+
 /*
- * log a message at the specified level to facilities that have been
- * configured to receive messages at that level
+ * write a formatted message, logged at time when, to the scheduler log
+ * (if sched is set) and to the facilities configured to receive messages
+ * at its level. log_lock must be held, the log files are not flushed.
  */
-static void log_msg(log_level_t level, const char *fmt, va_list args)
+static void _log_write(log_level_t level, bool sched, time_t when, char *buf)
 {
 	char *pfx = "";
-	char *buf = NULL;
-	char *msgbuf = NULL;
+	char stamp[64];
 	int priority = LOG_INFO;
 
-	slurm_mutex_lock(&log_lock);
-	if (!LOG_INITIALIZED) {
-		log_options_t opts = LOG_OPTS_STDERR_ONLY;
-		_log_init(NULL, opts, 0, NULL);
-	}
-
-	if (SCHED_LOG_INITIALIZED &&
-	    (sched_log->opt.logfile_level > LOG_LEVEL_QUIET) &&
-	    (strncmp(fmt, "sched: ", 7) == 0)) {
-		buf = vxstrfmt(fmt, args);
-		xlogfmtcat(&msgbuf, "[%M] %s%s%s", sched_log->fpfx, pfx, buf);
-		_log_printf(sched_log, sched_log->fbuf, sched_log->logfp, 
-			    "%s\n", msgbuf);
-		fflush(sched_log->logfp);
-		xfree(msgbuf);
+	stamp[0] = '\0';
+	if (sched && SCHED_LOG_INITIALIZED && (sched_log->logfp != NULL) &&
+	    (sched_log->opt.logfile_level > LOG_LEVEL_QUIET)) {
+		_log_stamp(stamp, sizeof(stamp), when);
+		_log_printf(sched_log, sched_log->fbuf, sched_log->logfp,
+			    "%s%s%s\n", stamp, sched_log->fpfx, buf);
 	}
 	if ((level > log->opt.syslog_level)  &&
 	    (level > log->opt.logfile_level) &&
-	    (level > log->opt.stderr_level)) {
-		slurm_mutex_unlock(&log_lock);
-		xfree(buf);
+	    (level > log->opt.stderr_level))
 		return;
-	}
 
 	if (log->opt.prefix_level || (log->opt.syslog_level > level)) {
 		switch (level) {
@@ -842,40 +936,304 @@ static void log_msg(log_level_t level, const char *fmt, va_list args)
 
 	}
 
-	if (!buf) {
-		/* format the basic message,
-		 * if not already done for scheduling log */
-		buf = vxstrfmt(fmt, args);
-	}
-
 	if (level <= log->opt.stderr_level) {
 		fflush(stdout);
-		_log_printf(log, log->buf, stderr, "%s: %s%s\n", 
+		_log_printf(log, log->buf, stderr, "%s: %s%s\n",
 			    log->argv0, pfx, buf);
 		fflush(stderr);
 	}
 
 	if ((level <= log->opt.logfile_level) && (log->logfp != NULL)) {
-		xlogfmtcat(&msgbuf, "[%M] %s%s%s", log->fpfx, pfx, buf);
-		_log_printf(log, log->fbuf, log->logfp, "%s\n", msgbuf);
-		fflush(log->logfp);
-
-		xfree(msgbuf);
+		if (stamp[0] == '\0')
+			_log_stamp(stamp, sizeof(stamp), when);
+		_log_printf(log, log->fbuf, log->logfp, "%s%s%s%s\n",
+			    stamp, log->fpfx, pfx, buf);
 	}
 
 	if (level <=  log->opt.syslog_level) {
-		xlogfmtcat(&msgbuf, "%s%s", pfx, buf);
+		char msgbuf[501];
 
+		snprintf(msgbuf, sizeof(msgbuf), "%s%s", pfx, buf);
 		openlog(log->argv0, LOG_PID, log->facility);
-		syslog(priority, "%.500s", msgbuf);
+		syslog(priority, "%s", msgbuf);
 		closelog();
+	}
+}
+
+/* flush the log files after _log_write(), log_lock must be held */
+static void _log_write_flush(void)
+{
+	if (LOG_INITIALIZED && log->logfp)
+		fflush(log->logfp);
+	if (SCHED_LOG_INITIALIZED && sched_log->logfp)
+		fflush(sched_log->logfp);
+}
+
+#ifdef WITH_PTHREADS
+static void _log_buf_destroy(void *arg)
+{
+	xfree(arg);
+}
+
+static void _log_buf_key_create(void)
+{
+	if (pthread_key_create(&log_buf_key, _log_buf_destroy))
+		abort();
+}
+#endif /* WITH_PTHREADS */
+
+/* return this thread's (empty) message buffer, may be NULL */
+static char *_log_buf_get(void)
+{
+	char *buf = NULL;
+
+#ifdef WITH_PTHREADS
+	pthread_once(&log_buf_once, _log_buf_key_create);
+	buf = pthread_getspecific(log_buf_key);
+	if (buf)
+		buf[0] = '\0';
+#endif /* WITH_PTHREADS */
+	return buf;
+}
+
+/* keep buf as this thread's message buffer for its next message */
+static void _log_buf_put(char *buf)
+{
+	if (buf && (xsize(buf) > LOG_BUF_KEEP))
+		xfree(buf);
+#ifdef WITH_PTHREADS
+	pthread_setspecific(log_buf_key, buf);
+#else
+	xfree(buf);
+#endif /* WITH_PTHREADS */
+}
+
+#ifdef LOG_ASYNC
+/*
+ * queue the message in *buf for the writer thread. The buffer is swapped
+ * with the one left in the ring slot by the message written before.
+ * If the ring is full the message is dropped and counted.
+ */
+static void _log_enqueue(log_level_t level, bool sched, char **buf)
+{
+	log_slot_t *slot;
+	uint32_t pos, seq;
+	char *tmp;
+
+	pos = log_ring_head;
+	while (1) {
+		slot = &log_ring[pos & (LOG_RING_SIZE - 1)];
+		seq = slot->seq;
+		if (seq == pos) {
+			if (__sync_bool_compare_and_swap(&log_ring_head,
+							 pos, pos + 1))
+				break;
+		} else if ((int32_t) (seq - pos) < 0) {
+			__sync_fetch_and_add(&log_dropped, 1);
+			return;
+		}
+		pos = log_ring_head;
+	}
+
+	slot->level = level;
+	slot->sched = sched;
+	slot->time  = time(NULL);
+	tmp = slot->msg;
+	slot->msg = *buf;
+	*buf = tmp;
+	__sync_synchronize();
+	slot->seq = pos + 1;
+	__sync_synchronize();
+
+	if (log_writer_idle) {
+		slurm_mutex_lock(&log_writer_lock);
+		pthread_cond_signal(&log_writer_cond);
+		slurm_mutex_unlock(&log_writer_lock);
+	}
+}
+
+/* write queued messages until log_async_fini() stops us */
+static void *_log_writer(void *arg)
+{
+	log_slot_t *slot;
+	uint32_t dropped;
+	int cnt;
+	char tmp[64];
+	struct timespec ts;
+
+	while (1) {
+		slurm_mutex_lock(&log_lock);
+		for (cnt = 0; cnt < LOG_WRITER_BATCH; cnt++) {
+			slot = &log_ring[log_ring_tail & (LOG_RING_SIZE - 1)];
+			if (slot->seq != (log_ring_tail + 1))
+				break;
+			__sync_synchronize();
+			if (LOG_INITIALIZED)
+				_log_write(slot->level, slot->sched,
+					   slot->time, slot->msg);
+			__sync_synchronize();
+			slot->seq = log_ring_tail + LOG_RING_SIZE;
+			log_ring_tail++;
+		}
+		dropped = __sync_fetch_and_and(&log_dropped, 0);
+		if (dropped && LOG_INITIALIZED) {
+			snprintf(tmp, sizeof(tmp),
+				 "%u log messages dropped, queue full",
+				 dropped);
+			_log_write(LOG_LEVEL_ERROR, false, time(NULL), tmp);
+		}
+		if (cnt || dropped)
+			_log_write_flush();
+		slurm_mutex_unlock(&log_lock);
+		if (cnt == LOG_WRITER_BATCH) {
+			/* wake anyone in _log_async_drain() waiting for
+			 * the messages just written */
+			slurm_mutex_lock(&log_writer_lock);
+			pthread_cond_broadcast(&log_drain_cond);
+			slurm_mutex_unlock(&log_writer_lock);
+			continue;
+		}
+
+		slurm_mutex_lock(&log_writer_lock);
+		log_writer_idle = true;
+		__sync_synchronize();
+		slot = &log_ring[log_ring_tail & (LOG_RING_SIZE - 1)];
+		if (slot->seq != (log_ring_tail + 1)) {
+			pthread_cond_broadcast(&log_drain_cond);
+			if (log_writer_stop) {
+				slurm_mutex_unlock(&log_writer_lock);
+				break;
+			}
+			ts.tv_sec  = time(NULL) + 1;
+			ts.tv_nsec = 0;
+			pthread_cond_timedwait(&log_writer_cond,
+					       &log_writer_lock, &ts);
+		}
+		log_writer_idle = false;
+		slurm_mutex_unlock(&log_writer_lock);
+	}
+	return NULL;
+}
 
-		xfree(msgbuf);
+/* wait until the writer thread has written the messages queued before the
+ * call. Messages queued meanwhile by other threads are not waited for. */
+static void _log_async_drain(void)
+{
+	uint32_t target;
+
+	if (!log_writer_running || (getpid() != log_writer_pid))
+		return;		/* no writer thread in this process */
+	target = log_ring_head;
+	slurm_mutex_lock(&log_writer_lock);
+	while (log_writer_running &&
+	       ((int32_t) (log_ring_tail - target) < 0)) {
+		pthread_cond_signal(&log_writer_cond);
+		pthread_cond_wait(&log_drain_cond, &log_writer_lock);
 	}
+	slurm_mutex_unlock(&log_writer_lock);
+}
 
+/* atexit() handler, write messages queued before exit() was called */
+static void _log_async_atexit(void)
+{
+	_log_async_drain();
+}
+#endif /* LOG_ASYNC */
+
+void log_async_init(void)
+{
+#ifdef LOG_ASYNC
+	pthread_attr_t attr;
+	uint32_t i;
+
+	if (log_writer_running)
+		return;
+	if (!log_writer_atexit) {
+		if (atexit(_log_async_atexit))
+			error("Unable to register log writer exit handler");
+		log_writer_atexit = true;
+	}
+	for (i = 0; i < LOG_RING_SIZE; i++) {
+		log_ring[(log_ring_head + i) & (LOG_RING_SIZE - 1)].seq =
+			log_ring_head + i;
+	}
+	log_ring_tail = log_ring_head;
+	log_writer_stop = false;
+
+	slurm_attr_init(&attr);
+	if (pthread_create(&log_writer_tid, &attr, _log_writer, NULL))
+		error("Unable to start log writer thread: %m");
+	else {
+		log_writer_pid = getpid();
+		log_writer_running = true;
+	}
+	slurm_attr_destroy(&attr);
+#endif /* LOG_ASYNC */
+}
+
+/* write all queued messages and stop the writer thread */
+static void _log_async_fini(void)
+{
+#ifdef LOG_ASYNC
+	uint32_t i;
+
+	if (!log_writer_running)
+		return;
+	slurm_mutex_lock(&log_writer_lock);
+	log_writer_stop = true;
+	pthread_cond_signal(&log_writer_cond);
+	slurm_mutex_unlock(&log_writer_lock);
+	pthread_join(log_writer_tid, NULL);
+	log_writer_running = false;
+
+	for (i = 0; i < LOG_RING_SIZE; i++)
+		xfree(log_ring[i].msg);
+#endif /* LOG_ASYNC */
+}
+
+/*
+ * log a message at the specified level to facilities that have been
+ * configured to receive messages at that level
+ */
+static void log_msg(log_level_t level, const char *fmt, va_list args)
+{
+	char *buf;
+	bool sched;
+
+	sched = log_sched_on && (strncmp(fmt, "sched: ", 7) == 0);
+	if ((level > log_max_level) && !sched)
+		return;
+
+	/* format the message outside of log_lock */
+	buf = _log_buf_get();
+	_vxstrfmtcat(&buf, fmt, args);
+	if (buf == NULL)
+		buf = xstrdup("");
+
+#ifdef LOG_ASYNC
+	if (log_writer_running) {
+		/* error() and fatal() are written before returning, so they
+		 * are not lost if the caller then exits or crashes */
+		if (level <= LOG_LEVEL_ERROR)
+			_log_async_drain();
+		else {
+			_log_enqueue(level, sched, &buf);
+			_log_buf_put(buf);
+			return;
+		}
+	}
+#endif /* LOG_ASYNC */
+
+	slurm_mutex_lock(&log_lock);
+	if (!LOG_INITIALIZED) {
+		log_options_t opts = LOG_OPTS_STDERR_ONLY;
+		_log_init(NULL, opts, 0, NULL);
+	}
+	_log_write(level, sched, time(NULL), buf);
+	_log_write_flush();
 	slurm_mutex_unlock(&log_lock);
 
-	xfree(buf);
+	_log_buf_put(buf);
 }
 
 bool
@@ -904,6 +1262,9 @@ _log_flush(log_t *log)
 void
 log_flush()
 {
+#ifdef LOG_ASYNC
+	_log_async_drain();
+#endif /* LOG_ASYNC */
 	slurm_mutex_lock(&log_lock);
 	_log_flush(log);
 	slurm_mutex_unlock(&log_lock);
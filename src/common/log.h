@@ -179,6 +179,18 @@ void schedlog(const char *fmt, ...);
  */
 void log_reinit(void);
 
+/*
+ * Start a thread which writes all further log file, scheduler log, syslog
+ * and stderr output, so that logging threads only format their messages
+ * and queue them. If the queue is full, messages are dropped and counted.
+ * error() and fatal() messages are not queued: they are written directly
+ * after the queue has drained. Queued messages are also written when the
+ * process calls exit(). Call after the process has daemonized; the thread
+ * does not survive fork() and is stopped by log_fini(). log_flush() waits
+ * for the queue.
+ */
+void log_async_init(void);
+
 /*
  * Close log and free associated memory
  */
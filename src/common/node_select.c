@@ -64,6 +64,7 @@ static int select_context_cnt = -1;
 static int select_context_default = -1;
 /* If there is a new select plugin, list it here */
 static slurm_select_context_t * select_context = NULL;
+static volatile uint32_t select_jobinfo_change_cnt = 0;
 static pthread_mutex_t		select_context_lock =
 	PTHREAD_MUTEX_INITIALIZER;
 
@@ -987,10 +988,21 @@ extern int select_g_select_jobinfo_set(dynamic_plugin_data_t *jobinfo,
 	} else
 		plugin_id = select_context_default;
 
+	select_jobinfo_changed();
 	return (*(select_context[plugin_id].ops.jobinfo_set))
 		(jobdata, data_type, data);
 }
 
+extern void select_jobinfo_changed(void)
+{
+	__sync_fetch_and_add(&select_jobinfo_change_cnt, 1);
+}
+
+extern uint32_t select_jobinfo_gen(void)
+{
+	return select_jobinfo_change_cnt;
+}
+
 /* get data from a select job credential
  * IN jobinfo  - updated select job credential
  * IN data_type - type of data to enter into job credential
@@ -522,6 +522,16 @@ extern int select_g_select_jobinfo_set(dynamic_plugin_data_t *jobinfo,
 				       enum select_jobdata_type data_type,
 				       void *data);
 
+/* note that the contents of some select job credential changed, called by
+ * select_g_select_jobinfo_set() and by select plugins which modify their job
+ * credentials directly */
+extern void select_jobinfo_changed(void);
+
+/* return a count of select job credential changes, see
+ * select_jobinfo_changed(). Information derived from any credential is
+ * current as long as the count is unchanged. */
+extern uint32_t select_jobinfo_gen(void);
+
 /* get data from a select job credential
  * IN jobinfo  - updated select job credential
  * IN data_type - type of data to enter into job credential
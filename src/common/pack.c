@@ -47,8 +47,11 @@
 #include <errno.h>
 #include <netinet/in.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <inttypes.h>
+#include <unistd.h>
 
 #include "slurm/slurm_errno.h"
 
@@ -68,9 +71,12 @@
  * for details.
  */
 strong_alias(create_buf,	slurm_create_buf);
+strong_alias(create_mmap_buf,	slurm_create_mmap_buf);
 strong_alias(free_buf,		slurm_free_buf);
 strong_alias(grow_buf,		slurm_grow_buf);
 strong_alias(init_buf,		slurm_init_buf);
+strong_alias(init_buf_ref,	slurm_init_buf_ref);
+strong_alias(get_buf_iovec,	slurm_get_buf_iovec);
 strong_alias(xfer_buf_data,	slurm_xfer_buf_data);
 strong_alias(pack_time,		slurm_pack_time);
 strong_alias(unpack_time,	slurm_unpack_time);
@@ -96,8 +102,38 @@ strong_alias(unpackmem_malloc,	slurm_unpackmem_malloc);
 strong_alias(packstr_array,	slurm_packstr_array);
 strong_alias(unpackstr_array,	slurm_unpackstr_array);
 strong_alias(packmem_array,	slurm_packmem_array);
+strong_alias(packmem_array_ref,	slurm_packmem_array_ref);
 strong_alias(unpackmem_array,	slurm_unpackmem_array);
 
+/* Grow a buffer to hold at least size more bytes. The buffer's size is
+ * increased by at least half so that packing a large message does not
+ * reallocate (and copy) the buffer for every BUF_SIZE bytes packed.
+ * RET 0 on success, -1 if the buffer would exceed MAX_BUF_SIZE */
+static int _grow_buf(Buf buffer, uint32_t size, char *caller)
+{
+	uint32_t need, new_size;
+
+	if (size > (MAX_BUF_SIZE - buffer->processed)) {
+		error("%s: buffer size too large", caller);
+		return -1;
+	}
+	need = buffer->processed + size;
+	if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE))
+		new_size = MAX_BUF_SIZE;
+	else
+		new_size = buffer->size + MAX(BUF_SIZE, buffer->size / 2);
+	if (new_size < need) {
+		if (need > (MAX_BUF_SIZE - BUF_SIZE))
+			new_size = MAX_BUF_SIZE;
+		else
+			new_size = need + BUF_SIZE;
+	}
+
+	buffer->size = new_size;
+	xrealloc(buffer->head, buffer->size);
+	return 0;
+}
+
 /* Basic buffer management routines */
 /* create_buf - create a buffer with the supplied contents, contents must
  * be xalloc'ed */
@@ -120,11 +156,64 @@ Buf create_buf(char *data, int size)
 	return my_buf;
 }
 
+/* create_mmap_buf - create a buffer holding the contents of an open file
+ *	for unpacking. The file is mapped into memory rather than read if
+ *	possible, in which case the buffer's data must not be modified.
+ *	The file descriptor may be closed once the buffer is created.
+ * RET the buffer or NULL on error */
+Buf create_mmap_buf(int fd)
+{
+	struct stat stat_buf;
+	Buf my_buf;
+	char *data;
+	int size, pos = 0, amount;
+
+	if (fstat(fd, &stat_buf) < 0)
+		return NULL;
+	if (stat_buf.st_size > MAX_BUF_SIZE) {
+		error("create_mmap_buf: file too large (%"PRIu64" > %u)",
+		      (uint64_t) stat_buf.st_size, MAX_BUF_SIZE);
+		errno = EFBIG;
+		return NULL;
+	}
+	size = stat_buf.st_size;
+	if (size == 0)
+		return create_buf(NULL, 0);
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data != MAP_FAILED) {
+		(void) madvise(data, size, MADV_SEQUENTIAL);
+		(void) madvise(data, size, MADV_WILLNEED);
+		my_buf = create_buf(data, size);
+		my_buf->mmap_size = size;
+		return my_buf;
+	}
+
+	/* Not a file system supporting mmap(), read the file */
+	data = xmalloc(size);
+	while (pos < size) {
+		amount = read(fd, &data[pos], size - pos);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			xfree(data);
+			return NULL;
+		} else if (amount == 0)	/* truncated since fstat() */
+			break;
+		pos += amount;
+	}
+	return create_buf(data, pos);
+}
+
 /* free_buf - release memory associated with a given buffer */
 void free_buf(Buf my_buf)
 {
 	assert(my_buf->magic == BUF_MAGIC);
-	xfree(my_buf->head);
+	if (my_buf->mmap_size)
+		(void) munmap(my_buf->head, my_buf->mmap_size);
+	else
+		xfree(my_buf->head);
+	xfree(my_buf->ref);
 	xfree(my_buf);
 }
 
@@ -159,6 +248,21 @@ Buf init_buf(int size)
 	return my_buf;
 }
 
+/* init_buf_ref - create an empty buffer of the given size which may
+ * reference large memory regions rather than copying them, see
+ * packmem_array_ref(). Use get_buf_iovec() to get the buffer's data. */
+Buf init_buf_ref(int size)
+{
+	Buf my_buf;
+
+	my_buf = init_buf(size);
+	if (my_buf) {
+		my_buf->ref = xmalloc(sizeof(struct slurm_buf_ref) *
+				      BUF_REF_MAX);
+	}
+	return my_buf;
+}
+
 /* xfer_buf_data - return a pointer to the buffer's data and release the
  * buffer's structure */
 void *xfer_buf_data(Buf my_buf)
@@ -166,11 +270,44 @@ void *xfer_buf_data(Buf my_buf)
 	void *data_ptr;
 
 	assert(my_buf->magic == BUF_MAGIC);
+	assert(my_buf->ref_cnt == 0);
 	data_ptr = (void *) my_buf->head;
+	xfree(my_buf->ref);
 	xfree(my_buf);
 	return data_ptr;
 }
 
+/* get_buf_iovec - describe a buffer's data, including any memory regions
+ *	it references, as an array of I/O vectors for writev() or sendmsg()
+ * OUT iov - array of I/O vectors, the caller must xfree() this
+ * RET count of I/O vectors
+ */
+int get_buf_iovec(Buf my_buf, struct iovec **iov)
+{
+	struct iovec *vec;
+	uint32_t offset = 0;
+	int i, cnt = 0;
+
+	assert(my_buf->magic == BUF_MAGIC);
+	vec = xmalloc(sizeof(struct iovec) * (my_buf->ref_cnt * 2 + 1));
+	for (i = 0; i < my_buf->ref_cnt; i++) {
+		if (my_buf->ref[i].offset > offset) {
+			vec[cnt].iov_base = &my_buf->head[offset];
+			vec[cnt++].iov_len = my_buf->ref[i].offset - offset;
+			offset = my_buf->ref[i].offset;
+		}
+		vec[cnt].iov_base = my_buf->ref[i].data;
+		vec[cnt++].iov_len = my_buf->ref[i].size;
+	}
+	if (my_buf->processed > offset) {
+		vec[cnt].iov_base = &my_buf->head[offset];
+		vec[cnt++].iov_len = my_buf->processed - offset;
+	}
+
+	*iov = vec;
+	return cnt;
+}
+
 /*
  * Given a time_t in host byte order, promote it to int64_t, convert to
  * network byte order, store in buffer and adjust buffer acc'd'ngly
@@ -179,14 +316,9 @@ void pack_time(time_t val, Buf buffer)
 {
 	int64_t n64 = HTON_int64((int64_t) val);
 
-	if (remaining_buf(buffer) < sizeof(n64)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack_time: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < sizeof(n64)) &&
+	    _grow_buf(buffer, sizeof(n64), "pack_time"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &n64, sizeof(n64));
 	buffer->processed += sizeof(n64);
@@ -223,14 +355,9 @@ void 	packdouble(double val, Buf buffer)
 	  * more than 15 decimals will mess things up, but this corrects it. */
 	uval.d =  (val * FLOAT_MULT);
 	nl =  HTON_uint64(uval.u);
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("packdouble: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < sizeof(nl)) &&
+	    _grow_buf(buffer, sizeof(nl), "packdouble"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -269,14 +396,9 @@ void pack64(uint64_t val, Buf buffer)
 {
 	uint64_t nl =  HTON_uint64(val);
 
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack64: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < sizeof(nl)) &&
+	    _grow_buf(buffer, sizeof(nl), "pack64"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -306,14 +428,9 @@ void pack32(uint32_t val, Buf buffer)
 {
 	uint32_t nl = htonl(val);
 
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack32: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < sizeof(nl)) &&
+	    _grow_buf(buffer, sizeof(nl), "pack32"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -401,14 +518,9 @@ void pack16(uint16_t val, Buf buffer)
 {
 	uint16_t ns = htons(val);
 
-	if (remaining_buf(buffer) < sizeof(ns)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack16: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < sizeof(ns)) &&
+	    _grow_buf(buffer, sizeof(ns), "pack16"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -437,14 +549,9 @@ int unpack16(uint16_t * valp, Buf buffer)
  */
 void pack8(uint8_t val, Buf buffer)
 {
-	if (remaining_buf(buffer) < sizeof(uint8_t)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack8: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < sizeof(uint8_t)) &&
+	    _grow_buf(buffer, sizeof(uint8_t), "pack8"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &val, sizeof(uint8_t));
 	buffer->processed += sizeof(uint8_t);
@@ -473,14 +580,9 @@ void packmem(char *valp, uint32_t size_val, Buf buffer)
 {
 	uint32_t ns = htonl(size_val);
 
-	if (remaining_buf(buffer) < (sizeof(ns) + size_val)) {
-		if (buffer->size > (MAX_BUF_SIZE -  size_val - BUF_SIZE)) {
-			error("packmem: buffer size too large");
-			return;
-		}
-		buffer->size += (size_val + BUF_SIZE);
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < (sizeof(ns) + size_val)) &&
+	    _grow_buf(buffer, sizeof(ns) + size_val, "packmem"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -632,14 +734,9 @@ void packstr_array(char **valp, uint32_t size_val, Buf buffer)
 	int i;
 	uint32_t ns = htonl(size_val);
 
-	if (remaining_buf(buffer) < sizeof(ns)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("packstr_array: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < sizeof(ns)) &&
+	    _grow_buf(buffer, sizeof(ns), "packstr_array"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -692,19 +789,46 @@ int unpackstr_array(char ***valp, uint32_t * size_valp, Buf buffer)
  */
 void packmem_array(char *valp, uint32_t size_val, Buf buffer)
 {
-	if (remaining_buf(buffer) < size_val) {
-		if (buffer->size > (MAX_BUF_SIZE - size_val - BUF_SIZE)) {
-			error("packmem_array: buffer size too large");
-			return;
-		}
-		buffer->size += (size_val + BUF_SIZE);
-		xrealloc(buffer->head, buffer->size);
-	}
+	if ((remaining_buf(buffer) < size_val) &&
+	    _grow_buf(buffer, size_val, "packmem_array"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], valp, size_val);
 	buffer->processed += size_val;
 }
 
+/*
+ * Given a pointer to memory (valp), size (size_val), and buffer, add the
+ * memory contents to the buffer as packmem_array() does. If the buffer was
+ * created by init_buf_ref() and the memory is large, the buffer only
+ * references the memory rather than copying it.
+ * NOTE: The memory must not be changed or freed until the buffer's data
+ *	is no longer needed. The buffer's offset must not subsequently be set
+ *	to a position before the memory, except to rewrite data of the same
+ *	size.
+ */
+void packmem_array_ref(char *valp, uint32_t size_val, Buf buffer)
+{
+	struct slurm_buf_ref *ref;
+
+	if ((buffer->ref == NULL) || (buffer->ref_cnt >= BUF_REF_MAX) ||
+	    (size_val < BUF_REF_MIN)) {
+		packmem_array(valp, size_val, buffer);
+		return;
+	}
+	if (size_val > (MAX_BUF_SIZE - buffer->processed -
+			buffer->ref_size)) {
+		error("packmem_array_ref: buffer size too large");
+		return;
+	}
+
+	ref = &buffer->ref[buffer->ref_cnt++];
+	ref->data = valp;
+	ref->size = size_val;
+	ref->offset = buffer->processed;
+	buffer->ref_size += size_val;
+}
+
 /*
  * Given a pointer to memory (valp), size (size_val), and buffer,
  * store the buffer contents into memory
@@ -57,17 +57,33 @@
 #include <assert.h>
 #include <time.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #define BUF_MAGIC 0x42554545
 #define BUF_SIZE (16 * 1024)
 #define MAX_BUF_SIZE ((uint32_t) 0xffff0000)	/* avoid going over 32-bits */
 #define FLOAT_MULT 1000000
+#define BUF_REF_MIN (64 * 1024)	/* smallest memory region to reference */
+#define BUF_REF_MAX 8		/* regions referenced by one buffer */
+
+/* A memory region sent as part of a buffer's data without being copied
+ * into it, see packmem_array_ref() */
+struct slurm_buf_ref {
+	char *data;
+	uint32_t size;
+	uint32_t offset;	/* position in head which the region follows */
+};
 
 struct slurm_buf {
 	uint32_t magic;
 	char *head;
 	uint32_t size;
 	uint32_t processed;
+	struct slurm_buf_ref *ref;	/* set only by init_buf_ref() */
+	uint16_t ref_cnt;
+	uint32_t ref_size;	/* total bytes referenced */
+	uint32_t mmap_size;	/* size of mapped file, set only by
+				 * create_mmap_buf() */
 };
 
 typedef struct slurm_buf * Buf;
@@ -77,12 +93,16 @@ typedef struct slurm_buf * Buf;
 #define set_buf_offset(__buf,__val)	(__buf->processed = __val)
 #define remaining_buf(__buf)		(__buf->size - __buf->processed)
 #define size_buf(__buf)			(__buf->size)
+#define get_buf_ref_size(__buf)		(__buf->ref_size)
 
 Buf	create_buf (char *data, int size);
+Buf	create_mmap_buf(int fd);
 void	free_buf(Buf my_buf);
 Buf	init_buf(int size);
+Buf	init_buf_ref(int size);
 void    grow_buf (Buf my_buf, int size);
 void	*xfer_buf_data(Buf my_buf);
+int	get_buf_iovec(Buf my_buf, struct iovec **iov);
 
 void	pack_time(time_t val, Buf buffer);
 int	unpack_time(time_t *valp, Buf buffer);
@@ -118,6 +138,7 @@ void	packstr_array(char **valp, uint32_t size_val, Buf buffer);
 int	unpackstr_array(char ***valp, uint32_t* size_val, Buf buffer);
 
 void	packmem_array(char *valp, uint32_t size_val, Buf buffer);
+void	packmem_array_ref(char *valp, uint32_t size_val, Buf buffer);
 int	unpackmem_array(char *valp, uint32_t size_valp, Buf buffer);
 
 #define safe_pack_time(val,buf) do {			\
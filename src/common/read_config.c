@@ -161,6 +161,7 @@ s_p_options_t slurm_conf_options[] = {
 	{"CacheGroups", S_P_UINT16},
 	{"ClusterName", S_P_STRING},
 	{"CompleteWait", S_P_UINT16},
+	{"ConnCacheSize", S_P_UINT16},
 	{"ControlAddr", S_P_STRING},
 	{"ControlMachine", S_P_STRING},
 	{"CryptoType", S_P_STRING},
@@ -1840,6 +1841,7 @@ init_slurm_conf (slurm_ctl_conf_t *ctl_conf_ptr)
 	xfree (ctl_conf_ptr->checkpoint_type);
 	xfree (ctl_conf_ptr->cluster_name);
 	ctl_conf_ptr->complete_wait		= (uint16_t) NO_VAL;
+	ctl_conf_ptr->conn_cache_size		= 0;
 	xfree (ctl_conf_ptr->control_addr);
 	xfree (ctl_conf_ptr->control_machine);
 	xfree (ctl_conf_ptr->crypto_type);
@@ -2201,6 +2203,9 @@ _validate_and_set_defaults(slurm_ctl_conf_t *conf, s_p_hashtbl_t *hashtbl)
 	if (!s_p_get_uint16(&conf->complete_wait, "CompleteWait", hashtbl))
 		conf->complete_wait = DEFAULT_COMPLETE_WAIT;
 
+	if (!s_p_get_uint16(&conf->conn_cache_size, "ConnCacheSize", hashtbl))
+		conf->conn_cache_size = DEFAULT_CONN_CACHE_SIZE;
+
 	if (!s_p_get_string(&conf->control_machine, "ControlMachine", hashtbl))
 		fatal ("ControlMachine not specified.");
 	else if (strcasecmp("localhost", conf->control_machine) == 0) {
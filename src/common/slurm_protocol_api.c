@@ -58,6 +58,7 @@
 #include <ctype.h>
 
 /* PROJECT INCLUDES */
+#include "src/common/conn_cache.h"
 #include "src/common/macros.h"
 #include "src/common/pack.h"
 #include "src/common/parse_spec.h"
@@ -90,6 +91,8 @@ static int message_timeout = -1;
 
 /* STATIC FUNCTIONS */
 static char *_global_auth_key(void);
+static List  _receive_msgs(slurm_fd_t fd, int steps, int timeout,
+			   uint16_t *resp_flags);
 static void  _remap_slurmctld_errno(void);
 static int   _unpack_msg_uid(Buf buffer);
 
@@ -2109,10 +2112,7 @@ int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout)
 {
 	char *buf = NULL;
 	size_t buflen = 0;
-	header_t header;
 	int rc;
-	void *auth_cred = NULL;
-	Buf buffer;
 
 	xassert(fd >= 0);
 
@@ -2138,11 +2138,38 @@ int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout)
 	 *  the message.
 	 */
 	if (_slurm_msg_recvfrom_timeout(fd, &buf, &buflen, 0, timeout) < 0) {
-		forward_init(&header.forward, NULL);
 		rc = errno;
-		goto total_return;
+		slurm_seterrno(rc);
+		msg->auth_cred = (void *) NULL;
+		error("slurm_receive_msg: %s", slurm_strerror(rc));
+		return -1;
 	}
 
+	return slurm_unpack_received_msg(msg, fd, buf, buflen);
+}
+
+/*
+ * slurm_unpack_received_msg - unpack a message that has already been read
+ *	in its entirety (length prefix stripped) from the connection fd.
+ *	Used by servers that read messages without blocking and hand
+ *	complete messages to worker threads.
+ * OUT msg	- a slurm_msg struct to be filled in by the function
+ * IN fd	- file descriptor the message was received on
+ * IN buf	- message data, consumed (xfree'd) by this function
+ * IN buflen	- size of buf in bytes
+ * RET int	- returns 0 on success, -1 on failure and sets errno
+ */
+int slurm_unpack_received_msg(slurm_msg_t *msg, slurm_fd_t fd,
+			      char *buf, size_t buflen)
+{
+	header_t header;
+	int rc;
+	void *auth_cred = NULL;
+	Buf buffer;
+
+	slurm_msg_t_init(msg);
+	msg->conn_fd = fd;
+
 #if	_DEBUG
 	_print_data (buf, buflen);
 #endif
@@ -2250,6 +2277,14 @@ total_return:
  *		  (ret_data_info_t).
  */
 List slurm_receive_msgs(slurm_fd_t fd, int steps, int timeout)
+{
+	return _receive_msgs(fd, steps, timeout, NULL);
+}
+
+/* As slurm_receive_msgs(), also setting resp_flags to the header flags of a
+ * successfully received message if it is not NULL */
+static List _receive_msgs(slurm_fd_t fd, int steps, int timeout,
+			  uint16_t *resp_flags)
 {
 	char *buf = NULL;
 	size_t buflen = 0;
@@ -2388,6 +2423,8 @@ List slurm_receive_msgs(slurm_fd_t fd, int steps, int timeout)
 
 	free_buf(buffer);
 	rc = SLURM_SUCCESS;
+	if (resp_flags)
+		*resp_flags = header.flags;
 
 total_return:
 	destroy_forward(&header.forward);
@@ -2650,9 +2687,9 @@ _pack_msg(slurm_msg_t *msg, header_t *hdr, Buf buffer)
 {
 	unsigned int tmplen, msglen;
 
-	tmplen = get_buf_offset(buffer);
+	tmplen = get_buf_offset(buffer) + get_buf_ref_size(buffer);
 	pack_msg(msg, buffer);
-	msglen = get_buf_offset(buffer) - tmplen;
+	msglen = get_buf_offset(buffer) + get_buf_ref_size(buffer) - tmplen;
 
 	/* update header with correct cred and msg lengths */
 	update_header(hdr, msglen);
@@ -2672,9 +2709,10 @@ int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 {
 	header_t header;
 	Buf      buffer;
-	int      rc;
+	int      rc, iov_cnt;
 	void *   auth_cred;
 	uint16_t auth_flags = SLURM_PROTOCOL_NO_FLAGS;
+	struct iovec *iov;
 
 	/*
 	 * Initialize header with Auth credential and message type.
@@ -2699,9 +2737,11 @@ int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 	init_header(&header, msg, msg->flags);
 
 	/*
-	 * Pack header into buffer for transmission
+	 * Pack header into buffer for transmission. Large packed responses
+	 * are referenced by the buffer and sent from where they are rather
+	 * than being copied into it.
 	 */
-	buffer = init_buf(BUF_SIZE);
+	buffer = init_buf_ref(BUF_SIZE);
 	pack_header(&header, buffer);
 
 	/*
@@ -2727,9 +2767,11 @@ int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 	/*
 	 * Send message
 	 */
-	rc = _slurm_msg_sendto( fd, get_buf_data(buffer),
-				get_buf_offset(buffer),
-				SLURM_PROTOCOL_NO_SEND_RECV_FLAGS );
+	iov_cnt = get_buf_iovec(buffer, &iov);
+	rc = _slurm_msg_sendv_timeout(fd, iov, iov_cnt,
+				      SLURM_PROTOCOL_NO_SEND_RECV_FLAGS,
+				      (slurm_get_msg_timeout() * 1000));
+	xfree(iov);
 
 	if ((rc < 0) && (errno == ENOTCONN)) {
 		debug3("slurm_msg_sendto: peer has disappeared for msg_type=%u",
@@ -3138,16 +3180,23 @@ _send_and_recv_msg(slurm_fd_t fd, slurm_msg_t *req,
  * IN fd	- file descriptor to receive msg on
  * IN req	- a slurm_msg struct to be sent by the function
  * IN timeout	- how long to wait in milliseconds
+ * OUT keep_conn - if not NULL, set if the response indicates that the
+ *		  connection may be used for another request, in which case
+ *		  the connection is left open
+ * OUT send_failed - if not NULL, set if the request could not be written
+ *		  in full, so the peer can not have processed it
  * RET List	- List containing the responses of the childern (if any) we
  *		  forwarded the message to. List containing type
  *		  (ret_data_info_t).
  */
 static List
-_send_and_recv_msgs(slurm_fd_t fd, slurm_msg_t *req, int timeout)
+_send_and_recv_msgs(slurm_fd_t fd, slurm_msg_t *req, int timeout,
+		    bool *keep_conn, bool *send_failed)
 {
 	int retry = 0;
 	List ret_list = NULL;
 	int steps = 0;
+	uint16_t resp_flags = 0;
 
 	if (!req->forward.timeout) {
 		if (!timeout)
@@ -3169,9 +3218,14 @@ _send_and_recv_msgs(slurm_fd_t fd, slurm_msg_t *req, int timeout)
 
 			timeout += (req->forward.timeout*steps);
 		}
-		ret_list = slurm_receive_msgs(fd, steps, timeout);
-	}
+		ret_list = _receive_msgs(fd, steps, timeout, &resp_flags);
+	} else if (send_failed)
+		*send_failed = true;
 
+	if (keep_conn && (resp_flags & SLURM_KEEP_CONN)) {
+		*keep_conn = true;
+		return ret_list;
+	}
 
 	/*
 	 *  Attempt to close an open connection
@@ -3407,6 +3461,9 @@ List slurm_send_recv_msgs(const char *nodelist, slurm_msg_t *msg,
  * RET List	  - List containing the responses of the childern
  *		    (if any) we forwarded the message to. List
  *		    containing type (ret_types_t).
+ * NOTE: If msg->flags includes SLURM_KEEP_CONN and the connection cache is
+ *	enabled, a cached connection to the address is used if possible and
+ *	the connection is cached afterwards if the peer agrees.
  */
 List slurm_send_addr_recv_msgs(slurm_msg_t *msg, char *name, int timeout)
 {
@@ -3414,8 +3471,15 @@ List slurm_send_addr_recv_msgs(slurm_msg_t *msg, char *name, int timeout)
 	slurm_fd_t fd = -1;
 	ret_data_info_t *ret_data_info = NULL;
 	ListIterator itr;
-
-	if ((fd = slurm_open_msg_conn(&msg->address)) < 0) {
+	bool cached = false, keep_conn = false, send_failed = false;
+
+	/* Only ask the peer to keep the connection if it can be cached */
+	if ((msg->flags & SLURM_KEEP_CONN) && !conn_cache_enabled())
+		msg->flags &= (~SLURM_KEEP_CONN);
+	if ((msg->flags & SLURM_KEEP_CONN) &&
+	    ((fd = conn_cache_get(&msg->address)) >= 0))
+		cached = true;
+	else if ((fd = slurm_open_msg_conn(&msg->address)) < 0) {
 		mark_as_failed_forward(&ret_list, name,
 				       SLURM_COMMUNICATIONS_CONNECTION_ERROR);
 		errno = SLURM_COMMUNICATIONS_CONNECTION_ERROR;
@@ -3424,7 +3488,29 @@ List slurm_send_addr_recv_msgs(slurm_msg_t *msg, char *name, int timeout)
 
 	msg->ret_list = NULL;
 	msg->forward_struct = NULL;
-	if (!(ret_list = _send_and_recv_msgs(fd, msg, timeout))) {
+	ret_list = _send_and_recv_msgs(fd, msg, timeout,
+				       (msg->flags & SLURM_KEEP_CONN) ?
+				       &keep_conn : NULL, &send_failed);
+	if (!ret_list && cached && send_failed) {
+		/* The slurmd closed the cached connection before the request
+		 * could be written, retry once on a new connection. Once the
+		 * request has been written the slurmd may have processed it,
+		 * so a failure to read the reply is never retried. */
+		debug2("slurm_send_addr_recv_msgs: cached connection to %s "
+		       "failed, reconnecting", name);
+		if ((fd = slurm_open_msg_conn(&msg->address)) < 0) {
+			mark_as_failed_forward(
+				&ret_list, name,
+				SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+			errno = SLURM_COMMUNICATIONS_CONNECTION_ERROR;
+			return ret_list;
+		}
+		ret_list = _send_and_recv_msgs(fd, msg, timeout, &keep_conn,
+					       NULL);
+	}
+	if (keep_conn)
+		conn_cache_put(&msg->address, fd);
+	if (!ret_list) {
 		mark_as_failed_forward(&ret_list, name, errno);
 		errno = SLURM_COMMUNICATIONS_CONNECTION_ERROR;
 		return ret_list;
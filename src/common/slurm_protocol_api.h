@@ -679,6 +679,20 @@ extern int slurm_shutdown_msg_engine(slurm_fd_t open_fd);
  */
 int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout);
 
+/*
+ *  Unpack a slurm message which has already been read in its entirety
+ *    from a connection, e.g. by a non-blocking event loop. The message
+ *    data must not include the leading length field.
+ *
+ * OUT msg	- a slurm_msg struct to be filled in by the function
+ * IN fd	- file descriptor the message was received on
+ * IN buf	- message data, xfree'd by this function
+ * IN buflen	- size of buf in bytes
+ * RET int	- returns 0 on success, -1 on failure and sets errno
+ */
+int slurm_unpack_received_msg(slurm_msg_t *msg, slurm_fd_t fd,
+			      char *buf, size_t buflen);
+
 /*
  *  Receive a slurm message on the open slurm descriptor "fd" waiting
  *    at most "timeout" seconds for the message data. If timeout is
@@ -1787,6 +1787,7 @@ extern void slurm_free_slurmd_status(slurmd_status_t* slurmd_status_ptr)
 		xfree(slurmd_status_ptr->slurmd_logfile);
 		xfree(slurmd_status_ptr->step_list);
 		xfree(slurmd_status_ptr->version);
+		xfree(slurmd_status_ptr->rpc_stats);
 		xfree(slurmd_status_ptr);
 	}
 }
@@ -1807,6 +1808,20 @@ extern void slurm_free_job_info_msg(job_info_msg_t * job_buffer_ptr)
 	}
 }
 
+/*
+ * slurm_free_job_info_delta_msg - free the incremental job information
+ *	response message
+ * IN msg - pointer to incremental job information response message
+ */
+extern void slurm_free_job_info_delta_msg(job_info_delta_msg_t *msg)
+{
+	if (msg) {
+		slurm_free_job_info_msg(msg->job_info);
+		xfree(msg->removed_ids);
+		xfree(msg);
+	}
+}
+
 static void _free_all_job_info(job_info_msg_t *msg)
 {
 	int i;
@@ -2249,8 +2264,12 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 		slurm_free_last_update_msg(data);
 		break;
 	case REQUEST_JOB_INFO:
+	case REQUEST_JOB_INFO_DELTA:
 		slurm_free_job_info_request_msg(data);
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		slurm_free_job_info_delta_msg(data);
+		break;
 	case REQUEST_NODE_INFO:
 		slurm_free_node_info_request_msg(data);
 		break;
@@ -215,6 +215,8 @@ typedef enum {
 	RESPONSE_FRONT_END_INFO,
 	REQUEST_SPANK_ENVIRONMENT,
 	RESPONCE_SPANK_ENVIRONMENT,
+	REQUEST_JOB_INFO_DELTA,
+	RESPONSE_JOB_INFO_DELTA,
 
 	REQUEST_UPDATE_JOB = 3001,
 	REQUEST_UPDATE_NODE,
@@ -487,6 +489,16 @@ typedef struct job_info_request_msg {
 	uint16_t show_flags;
 } job_info_request_msg_t;
 
+typedef struct job_info_delta_msg {
+	uint16_t full;			/* set if job_info includes all jobs,
+					 * otherwise only jobs changed since
+					 * the request's last_update */
+	job_info_msg_t *job_info;	/* job information */
+	uint32_t removed_cnt;		/* count of removed_ids */
+	uint32_t *removed_ids;		/* IDs of jobs removed since the
+					 * request's last_update */
+} job_info_delta_msg_t;
+
 typedef struct job_step_info_request_msg {
 	time_t last_update;
 	uint32_t job_id;
@@ -851,6 +863,11 @@ typedef struct kvs_get_msg {
 	char * hostname;	/* hostname to be sent the kvs data */
 } kvs_get_msg_t;
 
+#define FILE_BCAST_APPEND 0xffffffffffffffffULL	/* block_offset of blocks
+							 * to append to a file */
+#define FILE_BCAST_MAX_BLOCK (64 * 1024 * 1024)	/* largest block, once
+							 * uncompressed */
+
 typedef struct file_bcast_msg {
 	char *fname;		/* name of the destination file */
 	uint16_t block_no;	/* block number of this data */
@@ -864,6 +881,9 @@ typedef struct file_bcast_msg {
 	sbcast_cred_t *cred;	/* credential for the RPC */
 	uint32_t block_len;	/* length of this data block */
 	char *block;		/* data for this block */
+	uint16_t compress;	/* block is compressed with zlib if set */
+	uint32_t uncomp_len;	/* length of block once uncompressed */
+	uint64_t block_offset;	/* offset of this data in the file */
 } file_bcast_msg_t;
 
 typedef struct multi_core_data {
@@ -1065,6 +1085,7 @@ extern void slurm_free_submit_response_response_msg(
 		submit_response_msg_t * msg);
 extern void slurm_free_ctl_conf(slurm_ctl_conf_info_msg_t * config_ptr);
 extern void slurm_free_job_info_msg(job_info_msg_t * job_buffer_ptr);
+extern void slurm_free_job_info_delta_msg(job_info_delta_msg_t *msg);
 extern void slurm_free_job_step_info_response_msg(
 		job_step_info_response_msg_t * msg);
 extern void slurm_free_job_step_info_members (job_step_info_t * msg);
@@ -68,6 +68,7 @@
 #include "src/common/slurmdbd_defs.h"
 
 #define _pack_job_info_msg(msg,buf)		_pack_buffer_msg(msg,buf)
+#define _pack_job_info_delta_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_job_step_info_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_block_info_resp_msg(msg,buf)	_pack_buffer_msg(msg,buf)
 #define _pack_front_end_info_msg(msg,buf)	_pack_buffer_msg(msg,buf)
@@ -397,6 +398,8 @@ static int _unpack_job_desc_msg(job_desc_msg_t ** job_desc_buffer_ptr,
 				uint16_t protocol_version);
 static int _unpack_job_info_msg(job_info_msg_t ** msg, Buf buffer,
 				uint16_t protocol_version);
+static int _unpack_job_info_delta_msg(job_info_delta_msg_t ** msg, Buf buffer,
+				      uint16_t protocol_version);
 
 static void _pack_last_update_msg(last_update_msg_t * msg, Buf buffer,
 				  uint16_t protocol_version);
@@ -712,6 +715,9 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 	case RESPONSE_JOB_INFO:
 		_pack_job_info_msg((slurm_msg_t *) msg, buffer);
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		_pack_job_info_delta_msg((slurm_msg_t *) msg, buffer);
+		break;
 	case RESPONSE_PARTITION_INFO:
 		_pack_partition_info_msg((slurm_msg_t *) msg, buffer);
 		break;
@@ -866,6 +872,7 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 					    msg->protocol_version);
 		break;
 	case REQUEST_JOB_INFO:
+	case REQUEST_JOB_INFO_DELTA:
 		_pack_job_info_request_msg((job_info_request_msg_t *)
 					   msg->data, buffer,
 					   msg->protocol_version);
@@ -1213,6 +1220,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 					  buffer,
 					  msg->protocol_version);
 		break;
+	case RESPONSE_JOB_INFO_DELTA:
+		rc = _unpack_job_info_delta_msg(
+			(job_info_delta_msg_t **) &(msg->data), buffer,
+			msg->protocol_version);
+		break;
 	case RESPONSE_PARTITION_INFO:
 		rc = _unpack_partition_info_msg((partition_info_msg_t **) &
 						(msg->data), buffer,
@@ -1382,6 +1394,7 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 		break;
 		/********  job_step_id_t Messages  ********/
 	case REQUEST_JOB_INFO:
+	case REQUEST_JOB_INFO_DELTA:
 		rc = _unpack_job_info_request_msg((job_info_request_msg_t**)
 						  & (msg->data), buffer,
 						  msg->protocol_version);
@@ -3887,7 +3900,7 @@ static void
 _pack_buffer_msg(slurm_msg_t * msg, Buf buffer)
 {
 	xassert(msg != NULL);
-	packmem_array(msg->data, msg->data_size, buffer);
+	packmem_array_ref(msg->data, msg->data_size, buffer);
 }
 
 static int
@@ -3922,6 +3935,30 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static int
+_unpack_job_info_delta_msg(job_info_delta_msg_t ** msg, Buf buffer,
+			   uint16_t protocol_version)
+{
+	job_info_delta_msg_t *delta_ptr;
+
+	xassert(msg != NULL);
+	delta_ptr = xmalloc(sizeof(job_info_delta_msg_t));
+	*msg = delta_ptr;
+
+	safe_unpack16(&delta_ptr->full, buffer);
+	if (_unpack_job_info_msg(&delta_ptr->job_info, buffer,
+				 protocol_version))
+		goto unpack_error;
+	safe_unpack32_array(&delta_ptr->removed_ids, &delta_ptr->removed_cnt,
+			    buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_job_info_delta_msg(delta_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 /* _unpack_job_info_members
  * unpacks a set of slurm job info for one job
  * OUT job - pointer to the job info buffer
@@ -4295,6 +4332,7 @@ _pack_slurm_ctl_conf_msg(slurm_ctl_conf_info_msg_t * build_ptr, Buf buffer,
 		packstr(build_ptr->checkpoint_type, buffer);
 		packstr(build_ptr->cluster_name, buffer);
 		pack16(build_ptr->complete_wait, buffer);
+		pack16(build_ptr->conn_cache_size, buffer);
 		packstr(build_ptr->control_addr, buffer);
 		packstr(build_ptr->control_machine, buffer);
 		packstr(build_ptr->crypto_type, buffer);
@@ -4911,6 +4949,7 @@ _unpack_slurm_ctl_conf_msg(slurm_ctl_conf_info_msg_t **build_buffer_ptr,
 		safe_unpackstr_xmalloc(&build_ptr->cluster_name,
 				       &uint32_tmp, buffer);
 		safe_unpack16(&build_ptr->complete_wait, buffer);
+		safe_unpack16(&build_ptr->conn_cache_size, buffer);
 		safe_unpackstr_xmalloc(&build_ptr->control_addr,
 				       &uint32_tmp, buffer);
 		safe_unpackstr_xmalloc(&build_ptr->control_machine,
@@ -8996,6 +9035,11 @@ static void _pack_file_bcast(file_bcast_msg_t * msg , Buf buffer,
 	pack32 ( msg->block_len, buffer );
 	packmem ( msg->block, msg->block_len, buffer );
 	pack_sbcast_cred( msg->cred, buffer );
+	if (protocol_version >= SLURM_2_3_PROTOCOL_VERSION) {
+		pack16 ( msg->compress, buffer );
+		pack32 ( msg->uncomp_len, buffer );
+		pack64 ( msg->block_offset, buffer );
+	}
 }
 
 static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
@@ -9030,6 +9074,15 @@ static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
 	if (msg->cred == NULL)
 		goto unpack_error;
 
+	if (protocol_version >= SLURM_2_3_PROTOCOL_VERSION) {
+		safe_unpack16 ( & msg->compress, buffer );
+		safe_unpack32 ( & msg->uncomp_len, buffer );
+		safe_unpack64 ( & msg->block_offset, buffer );
+	} else {
+		/* Older versions send blocks in order to be appended */
+		msg->block_offset = FILE_BCAST_APPEND;
+	}
+
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -9369,6 +9422,8 @@ static void _pack_slurmd_status(slurmd_status_t *msg, Buf buffer,
 	packstr(msg->slurmd_logfile, buffer);
 	packstr(msg->step_list, buffer);
 	packstr(msg->version, buffer);
+	if (protocol_version >= SLURM_2_3_PROTOCOL_VERSION)
+		packstr(msg->rpc_stats, buffer);
 }
 
 static int _unpack_slurmd_status(slurmd_status_t **msg_ptr, Buf buffer,
@@ -9398,6 +9453,10 @@ static int _unpack_slurmd_status(slurmd_status_t **msg_ptr, Buf buffer,
 	safe_unpackstr_xmalloc(&msg->slurmd_logfile, &uint32_tmp, buffer);
 	safe_unpackstr_xmalloc(&msg->step_list,      &uint32_tmp, buffer);
 	safe_unpackstr_xmalloc(&msg->version,        &uint32_tmp, buffer);
+	if (protocol_version >= SLURM_2_3_PROTOCOL_VERSION) {
+		safe_unpackstr_xmalloc(&msg->rpc_stats, &uint32_tmp,
+				       buffer);
+	}
 
 	*msg_ptr = msg;
 	return SLURM_SUCCESS;
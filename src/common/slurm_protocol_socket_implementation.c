@@ -212,8 +212,20 @@ ssize_t _slurm_msg_sendto(slurm_fd_t fd, char *buffer, size_t size,
 ssize_t _slurm_msg_sendto_timeout(slurm_fd_t fd, char *buffer, size_t size,
 				  uint32_t flags, int timeout)
 {
-	int   len;
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len  = size;
+	return _slurm_msg_sendv_timeout(fd, &iov, 1, flags, timeout);
+}
+
+ssize_t _slurm_msg_sendv_timeout(slurm_fd_t fd, struct iovec *iov,
+				 int iov_cnt, uint32_t flags, int timeout)
+{
+	int   i, len;
+	size_t size = 0;
 	uint32_t usize;
+	struct iovec *msg_iov;
 	SigFunc *ohandler;
 
 	/*
@@ -222,18 +234,22 @@ ssize_t _slurm_msg_sendto_timeout(slurm_fd_t fd, char *buffer, size_t size,
 	 */
 	ohandler = xsignal(SIGPIPE, SIG_IGN);
 
+	for (i = 0; i < iov_cnt; i++)
+		size += iov[i].iov_len;
 	usize = htonl(size);
 
-	if ((len = _slurm_send_timeout(
-				fd, (char *)&usize, sizeof(usize), 0,
-				timeout)) < 0)
-		goto done;
+	/* Send the message length and data with as few system calls as
+	 * possible, without first copying the data into one buffer */
+	msg_iov = xmalloc(sizeof(struct iovec) * (iov_cnt + 1));
+	msg_iov[0].iov_base = &usize;
+	msg_iov[0].iov_len  = sizeof(usize);
+	memcpy(&msg_iov[1], iov, sizeof(struct iovec) * iov_cnt);
 
-	if ((len = _slurm_send_timeout(fd, buffer, size, 0, timeout)) < 0)
-		goto done;
+	len = _slurm_sendv_timeout(fd, msg_iov, iov_cnt + 1, 0, timeout);
+	if (len > 0)
+		len -= sizeof(usize);
+	xfree(msg_iov);
 
-
-     done:
 	xsignal(SIGPIPE, ohandler);
 	return len;
 }
@@ -243,14 +259,35 @@ ssize_t _slurm_msg_sendto_timeout(slurm_fd_t fd, char *buffer, size_t size,
 int _slurm_send_timeout(slurm_fd_t fd, char *buf, size_t size,
 			uint32_t flags, int timeout)
 {
-	int rc;
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len  = size;
+	return _slurm_sendv_timeout(fd, &iov, 1, flags, timeout);
+}
+
+/* Send data described by an array of I/O vectors with timeout
+ * NOTE: The I/O vectors are modified
+ * RET total size of the data or SLURM_ERROR on error */
+int _slurm_sendv_timeout(slurm_fd_t fd, struct iovec *iov, int iov_cnt,
+			 uint32_t flags, int timeout)
+{
+	int rc, i;
 	int sent = 0;
+	size_t size = 0;
 	int fd_flags;
 	struct pollfd ufds;
 	struct timeval tstart;
+	struct msghdr msg;
 	int timeleft = timeout;
 	char temp[2];
 
+	for (i = 0; i < iov_cnt; i++)
+		size += iov[i].iov_len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iov_cnt;
+
 	ufds.fd     = fd;
 	ufds.events = POLLOUT;
 
@@ -307,7 +344,7 @@ int _slurm_send_timeout(slurm_fd_t fd, char *buf, size_t size,
 			      ufds.revents);
 		}
 
-		rc = _slurm_send(fd, &buf[sent], (size - sent), flags);
+		rc = sendmsg(fd, &msg, flags);
 		if (rc < 0) {
  			if (errno == EINTR)
 				continue;
@@ -331,6 +368,17 @@ int _slurm_send_timeout(slurm_fd_t fd, char *buf, size_t size,
 		}
 
 		sent += rc;
+		/* Skip over the data sent */
+		while ((msg.msg_iovlen > 0) && (rc >= msg.msg_iov->iov_len)) {
+			rc -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (rc > 0) {
+			msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base
+						+ rc;
+			msg.msg_iov->iov_len -= rc;
+		}
 	}
 
     done:
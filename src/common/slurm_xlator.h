@@ -86,10 +86,12 @@
 #define	bit_nset		slurm_bit_nset
 #define	bit_ffc			slurm_bit_ffc
 #define	bit_ffs			slurm_bit_ffs
+#define	bit_ffs_and_not		slurm_bit_ffs_and_not
 #define	bit_free		slurm_bit_free
 #define	bit_realloc		slurm_bit_realloc
 #define	bit_size		slurm_bit_size
 #define	bit_and			slurm_bit_and
+#define	bit_and_not		slurm_bit_and_not
 #define	bit_not			slurm_bit_not
 #define	bit_or			slurm_bit_or
 #define	bit_set_count		slurm_bit_set_count
@@ -108,6 +110,7 @@
 #define	bit_fls			slurm_bit_fls
 #define	bit_fill_gaps		slurm_bit_fill_gaps
 #define	bit_super_set		slurm_bit_super_set
+#define	bit_overlap_any		slurm_bit_overlap_any
 #define	bit_copy		slurm_bit_copy
 #define	bit_pick_cnt		slurm_bit_pick_cnt
 #define bit_nffc		slurm_bit_nffc
@@ -191,6 +194,11 @@
 #define	list_remove		slurm_list_remove
 #define	list_delete_item	slurm_list_delete_item
 #define	list_install_fork_handlers slurm_list_install_fork_handlers
+#define	list_queue_create	slurm_list_queue_create
+#define	list_queue_destroy	slurm_list_queue_destroy
+#define	list_queue_push		slurm_list_queue_push
+#define	list_queue_pop		slurm_list_queue_pop
+#define	list_queue_count	slurm_list_queue_count
 
 /* log.[ch] functions */
 #define	log_init		slurm_log_init
@@ -228,10 +236,13 @@
 
 /* pack.[ch] functions */
 #define	create_buf		slurm_create_buf
+#define	create_mmap_buf		slurm_create_mmap_buf
 #define	free_buf		slurm_free_buf
 #define grow_buf		slurm_grow_buf
 #define	init_buf		slurm_init_buf
+#define	init_buf_ref		slurm_init_buf_ref
 #define	xfer_buf_data		slurm_xfer_buf_data
+#define	get_buf_iovec		slurm_get_buf_iovec
 #define	pack_time		slurm_pack_time
 #define	unpack_time		slurm_unpack_time
 #define	packdouble		slurm_packdouble
@@ -254,6 +265,7 @@
 #define	packstr_array		slurm_packstr_array
 #define	unpackstr_array		slurm_unpackstr_array
 #define	packmem_array		slurm_packmem_array
+#define	packmem_array_ref	slurm_packmem_array_ref
 #define	unpackmem_array		slurm_unpackmem_array
 
 /* env.[ch] functions */
@@ -60,6 +60,10 @@
 #include <time.h>
 #include <unistd.h>
 
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#  include <zlib.h>
+#endif
+
 #include "slurm/slurm_errno.h"
 #include "src/common/fd.h"
 #include "src/common/pack.h"
@@ -84,10 +88,27 @@ strong_alias(slurmdbd_free_id_rc_msg,	slurmdb_slurmdbd_free_id_rc_msg);
 
 
 #define DBD_MAGIC		0xDEAD3219
-#define MAX_AGENT_QUEUE		10000
+#define MAX_AGENT_QUEUE		10000	/* records held in memory */
 #define MAX_DBD_MSG_LEN		16384
 #define SLURMDBD_TIMEOUT	900	/* Seconds SlurmDBD for response */
 
+/* Limits on each DBD_SEND_MULT_MSG sent by the agent, slurmdbd rejects
+ * messages over 16MB */
+#define DBD_BATCH_MAX_MSGS	1000
+#define DBD_BATCH_MAX_SIZE	(4 * 1024 * 1024)
+
+/* Records which do not fit in the agent's queue are written to a journal
+ * file in blocks of up to DBD_JOURNAL_BLOCK_MSGS records or about
+ * DBD_JOURNAL_BLOCK_SIZE bytes, compressed if zlib is available. No block
+ * is larger than DBD_JOURNAL_BLOCK_MAX, slurmdbd rejects larger RPCs. */
+#define DBD_JOURNAL_MAGIC	0xDEAD321A
+#define DBD_JOURNAL_HDR_SIZE	12	/* magic, read offset */
+#define DBD_JOURNAL_BLK_HDR_SIZE 18	/* magic, version, counts, sizes */
+#define DBD_JOURNAL_BLOCK_MSGS	1000
+#define DBD_JOURNAL_BLOCK_SIZE	(256 * 1024)
+#define DBD_JOURNAL_BLOCK_MAX	(16 * 1024 * 1024)	/* uncompressed */
+#define DBD_JOURNAL_FLUSH_TIME	10	/* seconds to hold a partial block */
+
 uint16_t running_cache = 0;
 pthread_mutex_t assoc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t assoc_cache_cond = PTHREAD_COND_INITIALIZER;
@@ -98,6 +119,32 @@ static List      agent_list     = (List) NULL;
 static pthread_t agent_tid      = 0;
 static time_t    agent_shutdown = 0;
 
+/* Records sent while the agent is keeping up are added to agent_inbox
+ * without taking agent_lock. The agent moves them to agent_list (or the
+ * journal) in order. agent_inbox is never freed, since other threads may
+ * use it at any time once it exists.
+ * agent_inbox_lock is held for reading while adding to agent_inbox and
+ * for writing to change agent_inbox_open or agent_queue_cnt, which is the
+ * number of records last known to be in agent_list and the journal. The
+ * agent clears agent_inbox_open before its final drain of agent_inbox, so
+ * no record can be added after it. */
+static ListQueue agent_inbox    = NULL;
+static pthread_rwlock_t agent_inbox_lock = PTHREAD_RWLOCK_INITIALIZER;
+static bool      agent_inbox_open = false;
+static int       agent_queue_cnt = 0;
+
+/* Journal of records queued beyond MAX_AGENT_QUEUE, protected by agent_lock.
+ * Once records are in the journal, new records are also added to it until
+ * it has been drained back into agent_list, so their order is kept. */
+static int       journal_fd        = -1;
+static bool      journal_failed    = false;	/* file can not be written */
+static uint32_t  journal_cnt       = 0;	/* records in file and buffer */
+static Buf       journal_buf       = NULL;	/* records not yet in file */
+static uint32_t  journal_buf_cnt   = 0;
+static time_t    journal_buf_time  = 0;	/* oldest record in journal_buf */
+static uint64_t  journal_read_off  = 0;	/* next block to load */
+static uint64_t  journal_write_off = 0;	/* end of file */
+
 static pthread_mutex_t slurmdbd_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 static slurm_fd_t  slurmdbd_fd         = -1;
@@ -114,10 +161,21 @@ static void   _create_agent(void);
 static bool   _fd_readable(slurm_fd_t fd, int read_timeout);
 static int    _fd_writeable(slurm_fd_t fd);
 static int    _get_return_code(uint16_t rpc_version, int read_timeout);
+static int    _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout,
+				   uint32_t *ok_cnt);
+static int    _journal_append(Buf buffer);
+static void   _journal_close(void);
+static int    _journal_flush(void);
+static int    _journal_load(void);
+static void   _journal_open(void);
+static void   _journal_refill(void);
+static void   _agent_inbox_drain(void);
+static void   _agent_inbox_set(bool open, int queue_cnt);
+static int    _agent_queue_rec(Buf buffer);
 static Buf    _load_dbd_rec(int fd);
 static void   _load_dbd_state(void);
 static void   _open_slurmdbd_fd(bool db_needed);
-static int    _purge_job_start_req(void);
+static Buf    _pack_mult_msg(uint32_t *rec_cnt);
 static Buf    _recv_msg(int read_timeout);
 static void   _reopen_slurmdbd_fd(void);
 static int    _save_dbd_rec(int fd, Buf buffer);
@@ -125,6 +183,8 @@ static void   _save_dbd_state(void);
 static int    _send_init_msg(void);
 static int    _send_fini_msg(void);
 static int    _send_msg(Buf buffer);
+static int    _send_mult_msgs(int read_timeout);
+static int    _send_single_msg(int read_timeout);
 static void   _sig_handler(int signal);
 static void   _shutdown_agent(void);
 static void   _slurmdbd_packstr(void *str, uint16_t rpc_version, Buf buffer);
@@ -339,6 +399,8 @@ end_it:
 
 /* Send an RPC to the SlurmDBD. Do not wait for the reply. The RPC
  * will be queued and processed later if the SlurmDBD is not responding.
+ * Once MAX_AGENT_QUEUE RPCs are queued in memory, further RPCs are saved
+ * in a journal file until the SlurmDBD catches up.
  * NOTE: slurm_open_slurmdbd_conn() must have been called with callbacks set
  *
  * Returns SLURM_SUCCESS or an error code */
@@ -350,6 +412,32 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 
 	buffer = pack_slurmdbd_msg(req, rpc_version);
 
+	/* Avoid waiting for agent_lock, which the agent holds while packing
+	 * batches of records or using the journal, unless the queue is
+	 * getting long enough to need attention. The queue count includes
+	 * the journal, so records go through agent_lock while it is used. */
+	if (agent_inbox) {
+		pthread_rwlock_rdlock(&agent_inbox_lock);
+		if (agent_inbox_open &&
+		    ((agent_queue_cnt + list_queue_count(agent_inbox)) <
+		     (MAX_AGENT_QUEUE / 2)))
+			rc = list_queue_push(agent_inbox, buffer);
+		else
+			rc = -2;
+		pthread_rwlock_unlock(&agent_inbox_lock);
+		if (rc == -1)
+			fatal("list_queue_push: memory allocation failure");
+		if (rc == 1) {
+			/* The agent may be waiting for work */
+			slurm_mutex_lock(&agent_lock);
+			pthread_cond_broadcast(&agent_cond);
+			slurm_mutex_unlock(&agent_lock);
+		}
+		if (rc >= 0)
+			return SLURM_SUCCESS;
+		rc = SLURM_SUCCESS;
+	}
+
 	slurm_mutex_lock(&agent_lock);
 	if ((agent_tid == 0) || (agent_list == NULL)) {
 		_create_agent();
@@ -359,27 +447,20 @@ extern int slurm_send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 			return SLURM_ERROR;
 		}
 	}
+	_agent_inbox_drain();
 	cnt = list_count(agent_list);
-	if ((cnt >= (MAX_AGENT_QUEUE / 2)) &&
+	if (((cnt + journal_cnt) >= (MAX_AGENT_QUEUE / 2)) &&
 	    (difftime(time(NULL), syslog_time) > 120)) {
 		/* Record critical error every 120 seconds */
 		syslog_time = time(NULL);
-		error("slurmdbd: agent queue filling, RESTART SLURMDBD NOW");
+		error("slurmdbd: agent queue filling (%u), RESTART SLURMDBD NOW",
+		      cnt + journal_cnt);
 		syslog(LOG_CRIT, "*** RESTART SLURMDBD NOW ***");
 		if (callbacks_requested)
 			(callback.dbd_fail)();
 	}
-	if (cnt == (MAX_AGENT_QUEUE - 1))
-		cnt -= _purge_job_start_req();
-	if (cnt < MAX_AGENT_QUEUE) {
-		if (list_enqueue(agent_list, buffer) == NULL)
-			fatal("list_enqueue: memory allocation failure");
-	} else {
-		error("slurmdbd: agent queue is full, discarding request");
-		if (callbacks_requested)
-			(callback.acct_full)();
-		rc = SLURM_ERROR;
-	}
+	rc = _agent_queue_rec(buffer);
+	_agent_inbox_set(true, list_count(agent_list) + journal_cnt);
 
 	pthread_cond_broadcast(&agent_cond);
 	slurm_mutex_unlock(&agent_lock);
@@ -1628,7 +1709,13 @@ static int _get_return_code(uint16_t rpc_version, int read_timeout)
 	return rc;
 }
 
-static int _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout)
+/* Read the reply to a DBD_SEND_MULT_MSG and remove the records which were
+ * processed successfully from agent_list
+ * OUT ok_cnt - count of records processed successfully
+ * RET SLURM_SUCCESS if all records were processed, EAGAIN if no reply was
+ *	received or another error code */
+static int _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout,
+			       uint32_t *ok_cnt)
 {
 	Buf buffer;
 	uint16_t msg_type;
@@ -1637,9 +1724,10 @@ static int _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout)
 	int rc = SLURM_ERROR;
 	Buf out_buf = NULL;
 
+	*ok_cnt = 0;
 	buffer = _recv_msg(read_timeout);
 	if (buffer == NULL)
-		return rc;
+		return EAGAIN;
 
 	safe_unpack16(&msg_type, buffer);
 	switch(msg_type) {
@@ -1655,14 +1743,20 @@ static int _handle_mult_rc_ret(uint16_t rpc_version, int read_timeout)
 		if (agent_list) {
 			ListIterator itr =
 				list_iterator_create(list_msg->my_list);
+			ListIterator agent_itr =
+				list_iterator_create(agent_list);
 			while((out_buf = list_next(itr))) {
 				if((rc = _unpack_return_code(
 					    rpc_version, out_buf))
 				    != SLURM_SUCCESS)
 					break;
 
-				free_buf(list_dequeue(agent_list));
+				if (list_next(agent_itr) == NULL)
+					break;
+				list_delete_item(agent_itr);
+				(*ok_cnt)++;
 			}
+			list_iterator_destroy(agent_itr);
 			list_iterator_destroy(itr);
 		}
 		slurm_mutex_unlock(&agent_lock);
@@ -1885,11 +1979,18 @@ static void _create_agent(void)
 	   nothing if the connection was closed and then opened again */
 	agent_shutdown = 0;
 
+	if (agent_inbox == NULL) {
+		agent_inbox = list_queue_create(slurmdbd_free_buffer);
+		if (agent_inbox == NULL)
+			fatal("list_queue_create: malloc failure");
+	}
 	if (agent_list == NULL) {
 		agent_list = list_create(slurmdbd_free_buffer);
 		if (agent_list == NULL)
 			fatal("list_create: malloc failure");
 		_load_dbd_state();
+		if (journal_fd < 0)
+			_journal_open();
 	}
 
 	if (agent_tid == 0) {
@@ -1900,6 +2001,7 @@ static void _create_agent(void)
 			fatal("pthread_create: %m");
 		slurm_attr_destroy(&agent_attr);
 	}
+	_agent_inbox_set(true, list_count(agent_list) + journal_cnt);
 }
 
 static void _shutdown_agent(void)
@@ -1926,6 +2028,8 @@ static void _shutdown_agent(void)
 		}
 		pthread_join(agent_tid,  NULL);
 		agent_tid = 0;
+		/* In case the agent was cancelled */
+		_agent_inbox_set(false, 0);
 	}
 }
 
@@ -1943,20 +2047,136 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* Pack a DBD_SEND_MULT_MSG containing the records at the head of
+ * agent_list, within the DBD_BATCH_MAX limits
+ * OUT rec_cnt - count of records packed
+ * RET packed message or NULL if there are no more records to send
+ * NOTE: agent_lock must be held */
+static Buf _pack_mult_msg(uint32_t *rec_cnt)
+{
+	slurmdbd_msg_t list_req;
+	dbd_list_msg_t list_msg;
+	ListIterator iter;
+	Buf buffer;
+	uint32_t size = 0;
+
+	*rec_cnt = 0;
+	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
+	list_msg.my_list = list_create(NULL);
+	if (list_msg.my_list == NULL)
+		fatal("list_create: malloc failure");
+	iter = list_iterator_create(agent_list);
+	while ((*rec_cnt < DBD_BATCH_MAX_MSGS) &&
+	       (buffer = (Buf) list_next(iter))) {
+		size += get_buf_offset(buffer);
+		if (*rec_cnt && (size > DBD_BATCH_MAX_SIZE))
+			break;
+		if (list_append(list_msg.my_list, buffer) == NULL)
+			fatal("list_append: malloc failure");
+		(*rec_cnt)++;
+	}
+	list_iterator_destroy(iter);
+
+	if (*rec_cnt) {
+		list_req.msg_type = DBD_SEND_MULT_MSG;
+		list_req.data = &list_msg;
+		buffer = pack_slurmdbd_msg(&list_req, SLURMDBD_VERSION);
+	} else
+		buffer = NULL;
+	list_destroy(list_msg.my_list);
+	return buffer;
+}
+
+/* Send the record at the head of agent_list and remove it once processed
+ * NOTE: slurmdbd_lock must be held, agent_lock must not be held */
+static int _send_single_msg(int read_timeout)
+{
+	Buf buffer;
+	int rc;
+
+	/* Leave item on the queue until processing complete */
+	slurm_mutex_lock(&agent_lock);
+	buffer = (Buf) list_peek(agent_list);
+	slurm_mutex_unlock(&agent_lock);
+	if (buffer == NULL)
+		return SLURM_SUCCESS;
+
+	/* NOTE: agent_lock is clear here, so we can add more
+	 * requests to the queue while waiting for this RPC to
+	 * complete. */
+	rc = _send_msg(buffer);
+	if (rc != SLURM_SUCCESS) {
+		if (agent_shutdown == 0)
+			error("slurmdbd: Failure sending message: %d: %m", rc);
+		return rc;
+	}
+	rc = _get_return_code(SLURMDBD_VERSION, read_timeout);
+	if (rc == EAGAIN) {
+		if (agent_shutdown == 0)
+			error("slurmdbd: Failure with "
+			      "message need to resend: %d: %m", rc);
+		return rc;
+	}
+	if (rc == SLURM_SUCCESS) {
+		slurm_mutex_lock(&agent_lock);
+		buffer = (Buf) list_dequeue(agent_list);
+		free_buf(buffer);
+		slurm_mutex_unlock(&agent_lock);
+	}
+	return rc;
+}
+
+/* Send the records of agent_list in DBD_SEND_MULT_MSG batches, removing
+ * each record once processed. Only one batch is outstanding at a time:
+ * slurmdbd applies every batch it receives, so a batch sent after one
+ * which failed part way would be applied ahead of the failed records.
+ * Sending stops at the first batch not fully processed, its remaining
+ * records stay at the head of agent_list and are sent again later.
+ * NOTE: slurmdbd_lock must be held, agent_lock must not be held */
+static int _send_mult_msgs(int read_timeout)
+{
+	uint32_t ok_cnt, rec_cnt;
+	int rc = SLURM_SUCCESS;
+	Buf buffer;
+
+	while (agent_shutdown == 0) {
+		slurm_mutex_lock(&agent_lock);
+		buffer = _pack_mult_msg(&rec_cnt);
+		slurm_mutex_unlock(&agent_lock);
+		if (buffer == NULL)
+			break;	/* all records sent */
+		rc = _send_msg(buffer);
+		free_buf(buffer);
+		if (rc != SLURM_SUCCESS) {
+			if (agent_shutdown == 0)
+				error("slurmdbd: Failure sending message: "
+				      "%d: %m", rc);
+			break;
+		}
+
+		rc = _handle_mult_rc_ret(SLURMDBD_VERSION, read_timeout,
+					 &ok_cnt);
+		if (rc == EAGAIN) {
+			if (agent_shutdown == 0)
+				error("slurmdbd: Failure with message need "
+				      "to resend: %m");
+			break;
+		}
+		if ((rc != SLURM_SUCCESS) || (ok_cnt < rec_cnt))
+			break;
+	}
+
+	return rc;
+}
+
 static void *_agent(void *x)
 {
 	int cnt, rc;
-	Buf buffer;
 	struct timespec abs_time;
 	static time_t fail_time = 0;
 	int sigarray[] = {SIGUSR1, 0};
 	int read_timeout = SLURMDBD_TIMEOUT * 1000;
-	slurmdbd_msg_t list_req;
-	dbd_list_msg_t list_msg;
 
-	list_req.msg_type = DBD_SEND_MULT_MSG;
-	list_req.data = &list_msg;
-	memset(&list_msg, 0, sizeof(dbd_list_msg_t));
 	/* DEF_TIMERS; */
 
 	/* Prepare to catch SIGUSR1 to interrupt pending
@@ -1979,10 +2199,13 @@ static void *_agent(void *x)
 		}
 
 		slurm_mutex_lock(&agent_lock);
+		_agent_inbox_drain();
+		_journal_refill();
 		if (agent_list && slurmdbd_fd)
 			cnt = list_count(agent_list);
 		else
 			cnt = 0;
+		_agent_inbox_set(true, cnt + journal_cnt);
 		if ((cnt == 0) || (slurmdbd_fd < 0) ||
 		    (fail_time && (difftime(time(NULL), fail_time) < 10))) {
 			slurm_mutex_unlock(&slurmdbd_lock);
@@ -1993,52 +2216,16 @@ static void *_agent(void *x)
 			slurm_mutex_unlock(&agent_lock);
 			continue;
 		} else if ((cnt > 0) && ((cnt % 50) == 0))
-			info("slurmdbd: agent queue size %u", cnt);
-		/* Leave item on the queue until processing complete */
-		if (agent_list) {
-			if(list_count(agent_list) > 1) {
-				list_msg.my_list = agent_list;
-				buffer = pack_slurmdbd_msg(&list_req,
-							   SLURMDBD_VERSION);
-			} else
-				buffer = (Buf) list_peek(agent_list);
-		} else
-			buffer = NULL;
+			info("slurmdbd: agent queue size %u", cnt + journal_cnt);
 		slurm_mutex_unlock(&agent_lock);
-		if (buffer == NULL) {
-			slurm_mutex_unlock(&slurmdbd_lock);
-
-			slurm_mutex_lock(&assoc_cache_mutex);
-			if(slurmdbd_fd >= 0 && running_cache)
-				pthread_cond_signal(&assoc_cache_cond);
-			slurm_mutex_unlock(&assoc_cache_mutex);
 
-			continue;
-		}
-
-		/* NOTE: agent_lock is clear here, so we can add more
-		 * requests to the queue while waiting for this RPC to
-		 * complete. */
-		rc = _send_msg(buffer);
-		if (rc != SLURM_SUCCESS) {
-			if (agent_shutdown) {
-				slurm_mutex_unlock(&slurmdbd_lock);
-				break;
-			}
-			error("slurmdbd: Failure sending message: %d: %m", rc);
-		} else if(list_msg.my_list) {
-			rc = _handle_mult_rc_ret(SLURMDBD_VERSION,
-						 read_timeout);
-		} else {
-			rc = _get_return_code(SLURMDBD_VERSION, read_timeout);
-			if (rc == EAGAIN) {
-				if (agent_shutdown) {
-					slurm_mutex_unlock(&slurmdbd_lock);
-					break;
-				}
-				error("slurmdbd: Failure with "
-				      "message need to resend: %d: %m", rc);
-			}
+		if (cnt > 1)
+			rc = _send_mult_msgs(read_timeout);
+		else
+			rc = _send_single_msg(read_timeout);
+		if ((rc != SLURM_SUCCESS) && agent_shutdown) {
+			slurm_mutex_unlock(&slurmdbd_lock);
+			break;
 		}
 		slurm_mutex_unlock(&slurmdbd_lock);
 		slurm_mutex_lock(&assoc_cache_mutex);
@@ -2046,37 +2233,18 @@ static void *_agent(void *x)
 			pthread_cond_signal(&assoc_cache_cond);
 		slurm_mutex_unlock(&assoc_cache_mutex);
 
-		slurm_mutex_lock(&agent_lock);
-		if (agent_list && (rc == SLURM_SUCCESS)) {
-			/* If we sent a mult_msg we just need to free
-			   buffer, we don't need to requeue, just mark
-			   list_msg.my_list as NULL as that is the
-			   sign we sent a mult_msg.
-			*/
-			if(list_msg.my_list)
-				list_msg.my_list = NULL;
-			else
-				buffer = (Buf) list_dequeue(agent_list);
-
-			free_buf(buffer);
+		if (rc == SLURM_SUCCESS)
 			fail_time = 0;
-		} else {
-			/* We still need to free a mult_msg even if we
-			   got a failure.
-			*/
-			if(list_msg.my_list) {
-				list_msg.my_list = NULL;
-				free_buf(buffer);
-			}
-
+		else
 			fail_time = time(NULL);
-		}
-		slurm_mutex_unlock(&agent_lock);
 		/* END_TIMER; */
 		/* info("at the end with %s", TIME_STR); */
 	}
 
 	slurm_mutex_lock(&agent_lock);
+	_agent_inbox_set(false, 0);
+	_agent_inbox_drain();
+	_journal_close();
 	_save_dbd_state();
 	if (agent_list) {
 		list_destroy(agent_list);
@@ -2086,6 +2254,49 @@ static void *_agent(void *x)
 	return NULL;
 }
 
+/* Add a record to agent_list, or to the journal if it is in use or
+ * agent_list is full. The record is freed if it can not be saved.
+ * NOTE: agent_lock must be held */
+static int _agent_queue_rec(Buf buffer)
+{
+	if ((journal_cnt == 0) &&
+	    (list_count(agent_list) < MAX_AGENT_QUEUE)) {
+		if (list_enqueue(agent_list, buffer) == NULL)
+			fatal("list_enqueue: memory allocation failure");
+	} else if (_journal_append(buffer) != SLURM_SUCCESS) {
+		error("slurmdbd: agent queue is full, discarding request");
+		free_buf(buffer);
+		if (callbacks_requested)
+			(callback.acct_full)();
+		return SLURM_ERROR;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Set whether records may be added to agent_inbox and the count of records
+ * queued in agent_list and the journal */
+static void _agent_inbox_set(bool open, int queue_cnt)
+{
+	pthread_rwlock_wrlock(&agent_inbox_lock);
+	agent_inbox_open = open;
+	agent_queue_cnt = queue_cnt;
+	pthread_rwlock_unlock(&agent_inbox_lock);
+}
+
+/* Move the records of agent_inbox to agent_list (or the journal) in the
+ * order they were sent
+ * NOTE: agent_lock must be held, which also ensures that only one thread
+ * at a time removes records from agent_inbox */
+static void _agent_inbox_drain(void)
+{
+	Buf buffer;
+
+	if ((agent_inbox == NULL) || (agent_list == NULL))
+		return;
+	while ((buffer = (Buf) list_queue_pop(agent_inbox)))
+		(void) _agent_queue_rec(buffer);
+}
+
 static void _save_dbd_state(void)
 {
 	char *dbd_fname;
@@ -2344,33 +2555,432 @@ static void _sig_handler(int signal)
 {
 }
 
-/* Purge queued job/step start records from the agent queue
- * RET number of records purged */
-static int _purge_job_start_req(void)
+static int _journal_write(char *data, uint32_t size, uint64_t offset)
 {
-	int purged = 0;
-	ListIterator iter;
-	uint16_t msg_type;
-	uint32_t offset;
-	Buf buffer;
+	ssize_t wrote;
 
-	iter = list_iterator_create(agent_list);
-	while ((buffer = list_next(iter))) {
-		offset = get_buf_offset(buffer);
-		if (offset < 2)
+	while (size > 0) {
+		wrote = pwrite(journal_fd, data, size, (off_t) offset);
+		if (wrote > 0) {
+			data += wrote;
+			size -= wrote;
+			offset += wrote;
+		} else if ((wrote == -1) && (errno == EINTR))
 			continue;
-		set_buf_offset(buffer, 0);
-		unpack16(&msg_type, buffer);
-		set_buf_offset(buffer, offset);
-		if ((msg_type == DBD_JOB_START) ||
-		    (msg_type == DBD_STEP_START)) {
-			list_remove(iter);
-			purged++;
+		else {
+			error("slurmdbd: journal write error: %m");
+			return SLURM_ERROR;
 		}
 	}
-	list_iterator_destroy(iter);
-	info("slurmdbd: purge %d job/step start records", purged);
-	return purged;
+	return SLURM_SUCCESS;
+}
+
+static int _journal_read(char *data, uint32_t size, uint64_t offset)
+{
+	ssize_t rd_size;
+
+	while (size > 0) {
+		rd_size = pread(journal_fd, data, size, (off_t) offset);
+		if (rd_size > 0) {
+			data += rd_size;
+			size -= rd_size;
+			offset += rd_size;
+		} else if ((rd_size == -1) && (errno == EINTR))
+			continue;
+		else {
+			error("slurmdbd: journal read error: %m");
+			return SLURM_ERROR;
+		}
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Record the offset of the first block not yet loaded in the journal's
+ * header, so that loaded records are not sent again after a restart */
+static int _journal_write_header(void)
+{
+	Buf buffer;
+	int rc;
+
+	buffer = init_buf(DBD_JOURNAL_HDR_SIZE);
+	pack32(DBD_JOURNAL_MAGIC, buffer);
+	pack64(journal_read_off, buffer);
+	rc = _journal_write(get_buf_data(buffer), get_buf_offset(buffer), 0);
+	free_buf(buffer);
+	return rc;
+}
+
+/* Read the header of the journal block at the given offset */
+static int _journal_read_block_header(uint64_t offset, uint16_t *rpc_version,
+				      uint32_t *rec_cnt, uint32_t *raw_size,
+				      uint32_t *data_size)
+{
+	char *data;
+	Buf buffer;
+	uint32_t magic;
+	int rc = SLURM_ERROR;
+
+	if ((offset + DBD_JOURNAL_BLK_HDR_SIZE) > journal_write_off)
+		return SLURM_ERROR;
+	data = xmalloc(DBD_JOURNAL_BLK_HDR_SIZE);
+	if (_journal_read(data, DBD_JOURNAL_BLK_HDR_SIZE, offset)) {
+		xfree(data);
+		return SLURM_ERROR;
+	}
+	buffer = create_buf(data, DBD_JOURNAL_BLK_HDR_SIZE);
+	safe_unpack32(&magic, buffer);
+	safe_unpack16(rpc_version, buffer);
+	safe_unpack32(rec_cnt, buffer);
+	safe_unpack32(raw_size, buffer);
+	safe_unpack32(data_size, buffer);
+	/* Blocks are only compressed if that makes them smaller */
+	if ((magic == DBD_JOURNAL_MAGIC) &&
+	    (*raw_size <= DBD_JOURNAL_BLOCK_MAX) &&
+	    (*data_size <= *raw_size) &&
+	    ((offset + DBD_JOURNAL_BLK_HDR_SIZE + *data_size) <=
+	     journal_write_off))
+		rc = SLURM_SUCCESS;
+
+unpack_error:
+	free_buf(buffer);
+	return rc;
+}
+
+/* Empty the journal file */
+static void _journal_reset(void)
+{
+	journal_read_off = journal_write_off = DBD_JOURNAL_HDR_SIZE;
+	if (ftruncate(journal_fd, DBD_JOURNAL_HDR_SIZE) ||
+	    _journal_write_header()) {
+		error("slurmdbd: unable to reset journal: %m");
+		journal_failed = true;
+	}
+}
+
+/* Open the journal file and count the records it holds which were not
+ * yet loaded into agent_list
+ * NOTE: agent_lock must be held */
+static void _journal_open(void)
+{
+	char *fname, *data;
+	struct stat stat_buf;
+	Buf buffer;
+	uint32_t magic = 0, rec_cnt, raw_size, data_size;
+	uint64_t offset;
+	uint16_t rpc_version;
+
+	journal_cnt = 0;
+	journal_failed = false;
+	fname = slurm_get_state_save_location();
+	xstrcat(fname, "/dbd.journal");
+	journal_fd = open(fname, O_RDWR | O_CREAT, 0600);
+	if (journal_fd < 0) {
+		error("slurmdbd: Opening journal file %s: %m", fname);
+		journal_failed = true;
+		xfree(fname);
+		return;
+	}
+	fd_set_close_on_exec(journal_fd);
+
+	if (fstat(journal_fd, &stat_buf) == 0)
+		journal_write_off = stat_buf.st_size;
+	else
+		journal_write_off = 0;
+	if (journal_write_off >= DBD_JOURNAL_HDR_SIZE) {
+		data = xmalloc(DBD_JOURNAL_HDR_SIZE);
+		buffer = create_buf(data, DBD_JOURNAL_HDR_SIZE);
+		if (_journal_read(data, DBD_JOURNAL_HDR_SIZE, 0) ||
+		    unpack32(&magic, buffer) ||
+		    unpack64(&journal_read_off, buffer))
+			magic = 0;
+		free_buf(buffer);
+	}
+	if ((magic != DBD_JOURNAL_MAGIC) ||
+	    (journal_read_off < DBD_JOURNAL_HDR_SIZE) ||
+	    (journal_read_off > journal_write_off)) {
+		if (journal_write_off)
+			error("slurmdbd: journal file %s is invalid", fname);
+		_journal_reset();
+		xfree(fname);
+		return;
+	}
+
+	for (offset = journal_read_off; offset < journal_write_off;
+	     offset += DBD_JOURNAL_BLK_HDR_SIZE + data_size) {
+		if (_journal_read_block_header(offset, &rpc_version, &rec_cnt,
+					       &raw_size, &data_size)) {
+			error("slurmdbd: journal file %s is truncated at "
+			      "offset %"PRIu64, fname, offset);
+			journal_write_off = offset;
+			if (ftruncate(journal_fd, offset))
+				error("slurmdbd: ftruncate: %m");
+			break;
+		}
+		journal_cnt += rec_cnt;
+	}
+	if (journal_cnt == 0)
+		_journal_reset();
+	else
+		verbose("slurmdbd: %u pending RPCs in journal", journal_cnt);
+	xfree(fname);
+}
+
+/* Write any buffered records to the journal file and close it. If the
+ * journal can not be written, its records are moved to agent_list so they
+ * are saved by _save_dbd_state().
+ * NOTE: agent_lock must be held */
+static void _journal_close(void)
+{
+	if (journal_failed || (journal_buf_cnt && _journal_flush())) {
+		while (agent_list && journal_cnt && _journal_load())
+			;
+	} else if (journal_cnt) {
+		verbose("slurmdbd: saved %u pending RPCs in journal",
+			journal_cnt);
+	}
+	if (journal_fd >= 0) {
+		(void) close(journal_fd);
+		journal_fd = -1;
+	}
+	if (journal_buf) {
+		free_buf(journal_buf);
+		journal_buf = NULL;
+	}
+	journal_buf_cnt = 0;
+	journal_cnt = 0;
+}
+
+/* Write the records in journal_buf to the journal file as one block
+ * NOTE: agent_lock must be held */
+static int _journal_flush(void)
+{
+	Buf buffer;
+	char *data;
+	uint32_t raw_size, data_size;
+	int rc;
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+	char *comp_data;
+	uLongf comp_size;
+#endif
+
+	if (journal_buf_cnt == 0)
+		return SLURM_SUCCESS;
+
+	data = get_buf_data(journal_buf);
+	raw_size = data_size = get_buf_offset(journal_buf);
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+	comp_size = compressBound(raw_size);
+	comp_data = xmalloc(comp_size);
+	if ((compress2((Bytef *) comp_data, &comp_size, (Bytef *) data,
+		       raw_size, Z_BEST_SPEED) == Z_OK) &&
+	    (comp_size < raw_size)) {
+		data = comp_data;
+		data_size = comp_size;
+	}
+#endif
+
+	buffer = init_buf(DBD_JOURNAL_BLK_HDR_SIZE + data_size);
+	pack32(DBD_JOURNAL_MAGIC, buffer);
+	pack16(SLURMDBD_VERSION, buffer);
+	pack32(journal_buf_cnt, buffer);
+	pack32(raw_size, buffer);
+	pack32(data_size, buffer);
+	packmem_array(data, data_size, buffer);
+	rc = _journal_write(get_buf_data(buffer), get_buf_offset(buffer),
+			    journal_write_off);
+	if (rc == SLURM_SUCCESS) {
+		journal_write_off += get_buf_offset(buffer);
+		set_buf_offset(journal_buf, 0);
+		journal_buf_cnt = 0;
+	} else {
+		/* Discard any partially written block */
+		if (ftruncate(journal_fd, journal_write_off))
+			error("slurmdbd: ftruncate: %m");
+	}
+	free_buf(buffer);
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+	xfree(comp_data);
+#endif
+	return rc;
+}
+
+/* Add a record to the journal. If the journal file can not be written,
+ * up to MAX_AGENT_QUEUE records are held in memory.
+ * RET SLURM_SUCCESS if buffer was consumed
+ * NOTE: agent_lock must be held */
+static int _journal_append(Buf buffer)
+{
+	uint32_t rec_size = get_buf_offset(buffer) + sizeof(uint32_t);
+
+	if (journal_failed && (journal_buf_cnt >= MAX_AGENT_QUEUE))
+		return SLURM_ERROR;
+	if (rec_size > DBD_JOURNAL_BLOCK_MAX) {
+		error("slurmdbd: RPC of %u bytes is too large to journal",
+		      rec_size);
+		return SLURM_ERROR;
+	}
+
+	if (journal_buf == NULL)
+		journal_buf = init_buf(DBD_JOURNAL_BLOCK_SIZE + BUF_SIZE);
+	/* Keep the block within DBD_JOURNAL_BLOCK_MAX */
+	if (!journal_failed &&
+	    ((get_buf_offset(journal_buf) + rec_size) >
+	     DBD_JOURNAL_BLOCK_MAX) &&
+	    _journal_flush()) {
+		error("slurmdbd: journal failure, holding pending RPCs in "
+		      "memory");
+		journal_failed = true;
+	}
+	if (journal_buf_cnt == 0)
+		journal_buf_time = time(NULL);
+	packmem(get_buf_data(buffer), get_buf_offset(buffer), journal_buf);
+	journal_buf_cnt++;
+	journal_cnt++;
+	free_buf(buffer);
+
+	if (!journal_failed &&
+	    ((journal_buf_cnt >= DBD_JOURNAL_BLOCK_MSGS) ||
+	     (get_buf_offset(journal_buf) >= DBD_JOURNAL_BLOCK_SIZE)) &&
+	    _journal_flush()) {
+		error("slurmdbd: journal failure, holding pending RPCs in "
+		      "memory");
+		journal_failed = true;
+	}
+	return SLURM_SUCCESS;
+}
+
+/* Move the records packed in raw_buf to agent_list, converting them from
+ * rpc_version to SLURMDBD_VERSION as needed
+ * RET count of records moved */
+static int _journal_unpack(Buf raw_buf, uint16_t rpc_version)
+{
+	slurmdbd_msg_t msg;
+	Buf buffer;
+	char *data;
+	uint32_t size;
+	int rc, recovered = 0;
+
+	while (remaining_buf(raw_buf)) {
+		if (unpackmem_ptr(&data, &size, raw_buf)) {
+			error("slurmdbd: journal block is corrupted");
+			break;
+		}
+		buffer = init_buf(size);
+		packmem_array(data, size, buffer);
+		if (rpc_version != SLURMDBD_VERSION) {
+			set_buf_offset(buffer, 0);
+			rc = unpack_slurmdbd_msg(&msg, rpc_version, buffer);
+			free_buf(buffer);
+			if (rc != SLURM_SUCCESS) {
+				error("slurmdbd: unable to convert journal "
+				      "record from version %u", rpc_version);
+				continue;
+			}
+			buffer = pack_slurmdbd_msg(&msg, SLURMDBD_VERSION);
+		}
+		if (!list_enqueue(agent_list, buffer))
+			fatal("slurmdbd: list_enqueue, no memory");
+		recovered++;
+	}
+	return recovered;
+}
+
+/* Load the oldest block of records from the journal into agent_list
+ * RET count of records in the block
+ * NOTE: agent_lock must be held */
+static int _journal_load(void)
+{
+	Buf raw_buf;
+	char *data;
+	uint32_t rec_cnt = 0, raw_size, data_size;
+	uint16_t rpc_version;
+
+	if (journal_read_off < journal_write_off) {
+		if (_journal_read_block_header(journal_read_off, &rpc_version,
+					       &rec_cnt, &raw_size,
+					       &data_size))
+			goto corrupt;
+		data = xmalloc(data_size);
+		if (_journal_read(data, data_size, journal_read_off +
+				  DBD_JOURNAL_BLK_HDR_SIZE)) {
+			xfree(data);
+			goto corrupt;
+		}
+		if (data_size != raw_size) {
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+			uLongf size = raw_size;
+			char *raw_data = xmalloc(raw_size);
+			int zrc = uncompress((Bytef *) raw_data, &size,
+					     (Bytef *) data, data_size);
+			xfree(data);
+			if ((zrc != Z_OK) || (size != raw_size)) {
+				xfree(raw_data);
+				goto corrupt;
+			}
+			data = raw_data;
+#else
+			error("slurmdbd: journal is compressed, but zlib "
+			      "is not available");
+			xfree(data);
+			goto corrupt;
+#endif
+		}
+		raw_buf = create_buf(data, raw_size);
+		(void) _journal_unpack(raw_buf, rpc_version);
+		free_buf(raw_buf);
+		journal_read_off += DBD_JOURNAL_BLK_HDR_SIZE + data_size;
+		if (_journal_write_header())
+			journal_failed = true;
+	} else if (journal_buf_cnt) {
+		/* All older records have been loaded from the file */
+		rec_cnt = journal_buf_cnt;
+		raw_size = get_buf_offset(journal_buf);
+		raw_buf = create_buf(xfer_buf_data(journal_buf), raw_size);
+		journal_buf = NULL;
+		journal_buf_cnt = 0;
+		(void) _journal_unpack(raw_buf, SLURMDBD_VERSION);
+		free_buf(raw_buf);
+	}
+
+	if (rec_cnt > journal_cnt)
+		journal_cnt = 0;
+	else
+		journal_cnt -= rec_cnt;
+	if ((journal_cnt == 0) && (journal_fd >= 0) && !journal_failed)
+		_journal_reset();
+	return rec_cnt;
+
+corrupt:
+	error("slurmdbd: journal is corrupted at offset %"PRIu64", "
+	      "discarding %u pending RPCs", journal_read_off,
+	      journal_cnt - journal_buf_cnt);
+	journal_write_off = journal_read_off;
+	if (ftruncate(journal_fd, journal_write_off))
+		error("slurmdbd: ftruncate: %m");
+	journal_cnt = journal_buf_cnt;
+	return _journal_load();	/* any records still in journal_buf */
+}
+
+/* Move records from the journal into agent_list as space permits, and
+ * write records which have been buffered too long to the journal file
+ * NOTE: agent_lock must be held */
+static void _journal_refill(void)
+{
+	while (agent_list && journal_cnt &&
+	       ((list_count(agent_list) + DBD_JOURNAL_BLOCK_MSGS) <=
+		MAX_AGENT_QUEUE)) {
+		if (_journal_load() == 0)
+			break;
+	}
+
+	if (journal_buf_cnt && !journal_failed &&
+	    (difftime(time(NULL), journal_buf_time) >=
+	     DBD_JOURNAL_FLUSH_TIME) &&
+	    _journal_flush()) {
+		error("slurmdbd: journal failure, holding pending RPCs in "
+		      "memory");
+		journal_failed = true;
+	}
 }
 
 /****************************************************************************\
@@ -147,13 +147,15 @@ _step_connect(const char *directory, const char *nodename,
 	len = strlen(addr.sun_path)+1 + sizeof(addr.sun_family);
 
 	if (connect(fd, (struct sockaddr *) &addr, len) < 0) {
-		if (errno == ECONNREFUSED) {
+		int err = errno;	/* callers test for ENOENT */
+		if (err == ECONNREFUSED) {
 			_handle_stray_socket(name);
 		} else {
 			debug("_step_connect: connect: %m");
 		}
 		xfree(name);
 		close(fd);
+		errno = err;
 		return -1;
 	}
 
@@ -0,0 +1,1180 @@
+/*****************************************************************************\
+ *  jobacct_gather_cgroup.c - slurm job accounting gather plugin using the
+ *  cpuacct and memory cgroup subsystems.
+ *****************************************************************************
+ *  Copyright (C) 2005 Hewlett-Packard Development Company, L.P.
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+ *
+ *  This file is patterned after jobacct_gather_linux.c
+\*****************************************************************************/
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include "src/common/slurm_xlator.h"
+#include "src/common/jobacct_common.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xcgroup_read_config.h"
+#include "src/common/xcgroup.h"
+#include "src/slurmd/common/proctrack.h"
+#include "src/slurmd/slurmstepd/slurmstepd_job.h"
+
+#define _DEBUG 0
+
+/* These are defined here so when we link with something other than
+ * the slurmd we will have these symbols defined.  They will get
+ * overwritten when linking with the slurmd.
+ */
+#if defined (__APPLE__)
+uint32_t jobacct_job_id __attribute__((weak_import));
+pthread_mutex_t jobacct_lock __attribute__((weak_import));
+uint32_t jobacct_mem_limit __attribute__((weak_import));
+uint32_t jobacct_step_id __attribute__((weak_import));
+uint32_t jobacct_vmem_limit __attribute__((weak_import));
+#else
+uint32_t jobacct_job_id;
+pthread_mutex_t jobacct_lock;
+uint32_t jobacct_mem_limit;
+uint32_t jobacct_step_id;
+uint32_t jobacct_vmem_limit;
+#endif
+
+/*
+ * These variables are required by the generic plugin interface.  If they
+ * are not found in the plugin, the plugin loader will ignore it.
+ *
+ * plugin_name - a string giving a human-readable description of the
+ * plugin.  There is no maximum length, but the symbol must refer to
+ * a valid string.
+ *
+ * plugin_type - a string suggesting the type of the plugin or its
+ * applicability to a particular form of data or method of data handling.
+ * If the low-level plugin API is used, the contents of this string are
+ * unimportant and may be anything.  SLURM uses the higher-level plugin
+ * interface which requires this string to be of the form
+ *
+ *	<application>/<method>
+ *
+ * where <application> is a description of the intended application of
+ * the plugin (e.g., "jobacct" for SLURM job completion logging) and <method>
+ * is a description of how this plugin satisfies that application.  SLURM will
+ * only load job completion logging plugins if the plugin_type string has a
+ * prefix of "jobacct/".
+ *
+ * plugin_version - an unsigned 32-bit integer giving the version number
+ * of the plugin.  If major and minor revisions are desired, the major
+ * version number may be multiplied by a suitable magnitude constant such
+ * as 100 or 1000.  Various SLURM versions will likely require a certain
+ * minimum version for their plugins as the job accounting API
+ * matures.
+ */
+const char plugin_name[] = "Job accounting gather cgroup plugin";
+const char plugin_type[] = "jobacct_gather/cgroup";
+const uint32_t plugin_version = 100;
+
+/* Other useful declarations */
+
+typedef struct prec {	/* process record */
+	pid_t	pid;
+	pid_t	ppid;
+	int     usec;   /* user cpu time */
+	int     ssec;   /* system cpu time */
+	int     pages;  /* pages */
+	int	rss;	/* rss */
+	int	vsize;	/* virtual size */
+} prec_t;
+
+static int freq = 0;
+static DIR  *slash_proc = NULL;
+static pthread_mutex_t reading_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool jobacct_shutdown = 0;
+static bool jobacct_suspended = 0;
+static List task_list = NULL;
+static uint64_t cont_id = (uint64_t)NO_VAL;
+static bool pgid_plugin = false;
+
+#ifndef PATH_MAX
+#define PATH_MAX 256
+#endif
+
+/* A task's cgroups, whose counters include those of all its offspring */
+typedef struct task_cg {
+	pid_t		pid;
+	xcgroup_t	cpuacct_cg;
+	xcgroup_t	memory_cg;
+} task_cg_t;
+
+/* If set, usage is read from cgroups rather than /proc */
+static bool cgroup_acct = false;
+static pthread_mutex_t cgroup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xcgroup_ns_t cpuacct_ns;
+static xcgroup_ns_t memory_ns;
+static char jobstep_cgroup_path[PATH_MAX];
+static List task_cg_list = NULL;	/* task_cg_t records */
+
+/* Finally, pre-define all local routines. */
+
+static void _acct_kill_step(void);
+static int  _cgroup_create_task(pid_t pid, jobacct_id_t *jobacct_id);
+static void _cgroup_fini(void);
+static void _cgroup_get_data(List prec_list);
+static int  _cgroup_init(void);
+static void _destroy_prec(void *object);
+static int  _is_a_lwp(uint32_t pid);
+static void _get_offspring_data(List prec_list, prec_t *ancestor, pid_t pid);
+static void _get_process_data(void);
+static int  _get_process_data_line(int in, prec_t *prec);
+static void *_watch_tasks(void *arg);
+
+/*
+ * _get_offspring_data() -- collect memory usage data for the offspring
+ *
+ * For each process that lists <pid> as its parent, add its memory
+ * usage data to the ancestor's <prec> record. Recurse to gather data
+ * for *all* subsequent generations.
+ *
+ * IN:	prec_list       list of prec's
+ *      ancestor	The entry in precTable[] to which the data
+ * 			should be added. Even as we recurse, this will
+ * 			always be the prec for the base of the family
+ * 			tree.
+ * 	pid		The process for which we are currently looking
+ * 			for offspring.
+ *
+ * OUT:	none.
+ *
+ * RETVAL:	none.
+ *
+ * THREADSAFE! Only one thread ever gets here.
+ */
+static void
+_get_offspring_data(List prec_list, prec_t *ancestor, pid_t pid) {
+
+	ListIterator itr;
+	prec_t *prec = NULL;
+
+	itr = list_iterator_create(prec_list);
+	while((prec = list_next(itr))) {
+		if (prec->ppid == pid) {
+#if _DEBUG
+			info("pid:%u ppid:%u rss:%d KB",
+			     prec->pid, prec->ppid, prec->rss);
+#endif
+			_get_offspring_data(prec_list, ancestor, prec->pid);
+			ancestor->usec += prec->usec;
+			ancestor->ssec += prec->ssec;
+			ancestor->pages += prec->pages;
+			ancestor->rss += prec->rss;
+			ancestor->vsize += prec->vsize;
+		}
+	}
+	list_iterator_destroy(itr);
+	return;
+}
+
+/*
+ * _get_process_data() - Build a table of all current processes
+ *
+ * IN:	pid.
+ *
+ * OUT:	none
+ *
+ * THREADSAFE! Only one thread ever gets here.
+ *
+ * Assumption:
+ *    Any file with a name of the form "/proc/[0-9]+/stat"
+ *    is a Linux-style stat entry. We disregard the data if they look
+ *    wrong.
+ */
+static void _get_process_data(void)
+{
+	static	int	slash_proc_open = 0;
+
+	struct	dirent *slash_proc_entry;
+	char		*iptr = NULL, *optr = NULL;
+	FILE		*stat_fp = NULL;
+	char		proc_stat_file[256];	/* Allow ~20x extra length */
+	List prec_list = NULL;
+	pid_t *pids = NULL;
+	int npids = 0;
+	uint32_t total_job_mem = 0, total_job_vsize = 0;
+	int		i, fd;
+	ListIterator itr;
+	ListIterator itr2;
+	prec_t *prec = NULL;
+	struct jobacctinfo *jobacct = NULL;
+	static int processing = 0;
+	long		hertz;
+
+	if (!cgroup_acct && !pgid_plugin && (cont_id == (uint64_t)NO_VAL)) {
+		debug("cont_id hasn't been set yet not running poll");
+		return;
+	}
+
+	if(processing) {
+		debug("already running, returning");
+		return;
+	}
+	processing = 1;
+	prec_list = list_create(_destroy_prec);
+
+	hertz = sysconf(_SC_CLK_TCK);
+	if (hertz < 1) {
+		error ("_get_process_data: unable to get clock rate");
+		hertz = 100;	/* default on many systems */
+	}
+
+	if (cgroup_acct) {
+		/* one record per task, read from its cgroups */
+		_cgroup_get_data(prec_list);
+	} else if(!pgid_plugin) {
+		/* get only the processes in the proctrack container */
+		slurm_container_get_pids(cont_id, &pids, &npids);
+		if(!npids) {
+			debug4("no pids in this container %"PRIu64"", cont_id);
+			goto finished;
+		}
+		for (i = 0; i < npids; i++) {
+			snprintf(proc_stat_file, 256,
+				 "/proc/%d/stat", pids[i]);
+			if ((stat_fp = fopen(proc_stat_file, "r"))==NULL)
+				continue;  /* Assume the process went away */
+			/*
+			 * Close the file on exec() of user tasks.
+			 *
+			 * NOTE: If we fork() slurmstepd after the
+			 * fopen() above and before the fcntl() below,
+			 * then the user task may have this extra file
+			 * open, which can cause problems for
+			 * checkpoint/restart, but this should be a very rare
+			 * problem in practice.
+			 */
+			fd = fileno(stat_fp);
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+			prec = xmalloc(sizeof(prec_t));
+			if (_get_process_data_line(fd, prec))
+				list_append(prec_list, prec);
+			else
+				xfree(prec);
+			fclose(stat_fp);
+		}
+	} else {
+		slurm_mutex_lock(&reading_mutex);
+
+		if (slash_proc_open) {
+			rewinddir(slash_proc);
+		} else {
+			slash_proc=opendir("/proc");
+			if (slash_proc == NULL) {
+				perror("opening /proc");
+				slurm_mutex_unlock(&reading_mutex);
+				goto finished;
+			}
+			slash_proc_open=1;
+		}
+		strcpy(proc_stat_file, "/proc/");
+
+		while ((slash_proc_entry = readdir(slash_proc))) {
+
+			/* Save a few cyles by simulating
+			   strcat(statFileName, slash_proc_entry->d_name);
+			   strcat(statFileName, "/stat");
+			   while checking for a numeric filename (which really
+			   should be a pid).
+			*/
+			optr = proc_stat_file + sizeof("/proc");
+			iptr = slash_proc_entry->d_name;
+			i = 0;
+			do {
+				if((*iptr < '0')
+				   || ((*optr++ = *iptr++) > '9')) {
+					i = -1;
+					break;
+				}
+			} while (*iptr);
+
+			if(i == -1)
+				continue;
+			iptr = (char*)"/stat";
+
+			do {
+				*optr++ = *iptr++;
+			} while (*iptr);
+			*optr = 0;
+
+			if ((stat_fp = fopen(proc_stat_file,"r"))==NULL)
+				continue;  /* Assume the process went away */
+			/*
+			 * Close the file on exec() of user tasks.
+			 *
+			 * NOTE: If we fork() slurmstepd after the
+			 * fopen() above and before the fcntl() below,
+			 * then the user task may have this extra file
+			 * open, which can cause problems for
+			 * checkpoint/restart, but this should be a very rare
+			 * problem in practice.
+			 */
+			fd = fileno(stat_fp);
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+			prec = xmalloc(sizeof(prec_t));
+			if (_get_process_data_line(fd, prec))
+				list_append(prec_list, prec);
+			else
+				xfree(prec);
+			fclose(stat_fp);
+		}
+		slurm_mutex_unlock(&reading_mutex);
+
+	}
+
+	if (!list_count(prec_list)) {
+		goto finished;	/* We have no business being here! */
+	}
+
+	slurm_mutex_lock(&jobacct_lock);
+	if(!task_list || !list_count(task_list)) {
+		slurm_mutex_unlock(&jobacct_lock);
+		goto finished;
+	}
+
+	itr = list_iterator_create(task_list);
+	while((jobacct = list_next(itr))) {
+		itr2 = list_iterator_create(prec_list);
+		while((prec = list_next(itr2))) {
+			if (prec->pid == jobacct->pid) {
+#if _DEBUG
+				info("pid:%u ppid:%u rss:%d KB",
+				     prec->pid, prec->ppid, prec->rss);
+#endif
+				/* find all my descendents, a task's
+				 * cgroups already include them */
+				if (!cgroup_acct) {
+					_get_offspring_data(prec_list,
+							    prec, prec->pid);
+				}
+				/* tally their usage */
+				jobacct->max_rss = jobacct->tot_rss =
+					MAX(jobacct->max_rss, prec->rss);
+				total_job_mem += prec->rss;
+				jobacct->max_vsize = jobacct->tot_vsize =
+					MAX(jobacct->max_vsize, prec->vsize);
+				total_job_vsize += prec->vsize;
+				jobacct->max_pages = jobacct->tot_pages =
+					MAX(jobacct->max_pages, prec->pages);
+				jobacct->min_cpu = jobacct->tot_cpu =
+					MAX(jobacct->min_cpu,
+					    (prec->ssec / hertz +
+					     prec->usec / hertz));
+				debug2("%d mem size %u %u time %u(%u+%u)",
+				       jobacct->pid, jobacct->max_rss,
+				       jobacct->max_vsize, jobacct->tot_cpu,
+				       prec->usec, prec->ssec);
+				break;
+			}
+		}
+		list_iterator_destroy(itr2);
+	}
+	list_iterator_destroy(itr);
+	slurm_mutex_unlock(&jobacct_lock);
+
+	if (jobacct_mem_limit) {
+		if (jobacct_step_id == NO_VAL) {
+			debug("Job %u memory used:%u limit:%u KB",
+			      jobacct_job_id, total_job_mem, jobacct_mem_limit);
+		} else {
+			debug("Step %u.%u memory used:%u limit:%u KB",
+			      jobacct_job_id, jobacct_step_id,
+			      total_job_mem, jobacct_mem_limit);
+		}
+	}
+	if (jobacct_job_id && jobacct_mem_limit &&
+	    (total_job_mem > jobacct_mem_limit)) {
+		if (jobacct_step_id == NO_VAL) {
+			error("Job %u exceeded %u KB memory limit, being "
+			      "killed", jobacct_job_id, jobacct_mem_limit);
+		} else {
+			error("Step %u.%u exceeded %u KB memory limit, being "
+			      "killed", jobacct_job_id, jobacct_step_id,
+			      jobacct_mem_limit);
+		}
+		_acct_kill_step();
+	} else if (jobacct_job_id && jobacct_vmem_limit &&
+	           (total_job_vsize > jobacct_vmem_limit)) {
+		if (jobacct_step_id == NO_VAL) {
+			error("Job %u exceeded %u KB virtual memory limit, "
+			      "being killed", jobacct_job_id,
+			      jobacct_vmem_limit);
+		} else {
+			error("Step %u.%u exceeded %u KB virtual memory "
+			      "limit, being killed", jobacct_job_id,
+			      jobacct_step_id, jobacct_vmem_limit);
+		}
+		_acct_kill_step();
+	}
+
+finished:
+	list_destroy(prec_list);
+	processing = 0;
+	return;
+}
+
+/* _acct_kill_step() issue RPC to kill a slurm job step */
+static void _acct_kill_step(void)
+{
+	slurm_msg_t msg;
+	job_step_kill_msg_t req;
+	job_notify_msg_t notify_req;
+
+	slurm_msg_t_init(&msg);
+	notify_req.job_id      = jobacct_job_id;
+	notify_req.job_step_id = jobacct_step_id;
+	notify_req.message     = "Exceeded job memory limit";
+	msg.msg_type    = REQUEST_JOB_NOTIFY;
+	msg.data        = &notify_req;
+	slurm_send_only_controller_msg(&msg);
+
+	/*
+	 * Request message:
+	 */
+	req.job_id      = jobacct_job_id;
+	req.job_step_id = jobacct_step_id;
+	req.signal      = SIGKILL;
+	req.batch_flag  = 0;
+	msg.msg_type    = REQUEST_CANCEL_JOB_STEP;
+	msg.data        = &req;
+
+	slurm_send_only_controller_msg(&msg);
+}
+
+static int _is_a_lwp(uint32_t pid) {
+
+	FILE		*status_fp = NULL;
+	char		proc_status_file[256];
+	uint32_t        tgid;
+	int             rc;
+
+	if ( snprintf(proc_status_file, 256,
+		      "/proc/%d/status",pid) > 256 ) {
+ 		debug("jobacct_gather_cgroup: unable to build proc_status "
+		      "fpath");
+		return -1;
+	}
+	if ((status_fp = fopen(proc_status_file, "r"))==NULL) {
+		debug3("jobacct_gather_cgroup: unable to open %s",
+		       proc_status_file);
+		return -1;
+	}
+
+
+	do {
+		rc = fscanf(status_fp,
+			    "Name:\t%*s\n%*[ \ta-zA-Z0-9:()]\nTgid:\t%d\n",
+			    &tgid);
+	} while ( rc < 0 && errno == EINTR );
+	fclose(status_fp);
+
+	/* unable to read /proc/[pid]/status content */
+	if ( rc != 1 ) {
+		debug3("jobacct_gather_cgroup: unable to read requested "
+		       "pattern in %s",proc_status_file);
+		return -1;
+	}
+
+	/* if tgid differs from pid, this is a LWP (Thread POSIX) */
+	if ( (uint32_t) tgid != (uint32_t) pid ) {
+		debug3("jobacct_gather_cgroup: pid=%d is a lightweight process",
+		       tgid);
+		return 1;
+	} else
+		return 0;
+
+}
+
+/* _get_process_data_line() - get line of data from /proc/<pid>/stat
+ *
+ * IN:	in - input file descriptor
+ * OUT:	prec - the destination for the data
+ *
+ * RETVAL:	==0 - no valid data
+ * 		!=0 - data are valid
+ *
+ * Based upon stat2proc() from the ps command. It can handle arbitrary executable
+ * file basenames for `cmd', i.e. those with embedded whitespace or embedded ')'s.
+ * Such names confuse %s (see scanf(3)), so the string is split and %39c is used
+ * instead. (except for embedded ')' "(%[^)]c)" would work.
+ */
+static int _get_process_data_line(int in, prec_t *prec) {
+	char sbuf[256], *tmp;
+	int num_read, nvals;
+	char cmd[40], state[1];
+	int ppid, pgrp, session, tty_nr, tpgid;
+	long unsigned flags, minflt, cminflt, majflt, cmajflt;
+	long unsigned utime, stime, starttime, vsize;
+	long int cutime, cstime, priority, nice, timeout, itrealvalue, rss;
+
+	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
+	if (num_read <= 0)
+		return 0;
+	sbuf[num_read] = '\0';
+
+	tmp = strrchr(sbuf, ')');	/* split into "PID (cmd" and "<rest>" */
+	*tmp = '\0';			/* replace trailing ')' with NUL */
+	/* parse these two strings separately, skipping the leading "(". */
+	nvals = sscanf(sbuf, "%d (%39c", &prec->pid, cmd);
+	if (nvals < 2)
+		return 0;
+
+	nvals = sscanf(tmp + 2,		/* skip space after ')' too */
+		"%c %d %d %d %d %d "
+		"%lu %lu %lu %lu %lu "
+		"%lu %lu %ld %ld %ld %ld "
+		"%ld %ld %lu %lu %ld",
+		state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
+		&flags, &minflt, &cminflt, &majflt, &cmajflt,
+		&utime, &stime, &cutime, &cstime, &priority, &nice,
+		&timeout, &itrealvalue, &starttime, &vsize, &rss);
+	/* There are some additional fields, which we do not scan or use */
+	if ((nvals < 22) || (rss < 0))
+		return 0;
+
+	/* If current pid corresponds to a Light Weight Process (Thread POSIX) */
+	/* skip it, we will only account the original process (pid==tgid) */
+	if (_is_a_lwp(prec->pid) > 0)
+  		return 0;
+
+	/* Copy the values that slurm records into our data structure */
+	prec->ppid  = ppid;
+	prec->pages = majflt;
+	prec->usec  = utime;
+	prec->ssec  = stime;
+	prec->vsize = vsize / 1024;		 /* convert from bytes to KB */
+	prec->rss   = rss * getpagesize() / 1024;/* convert from pages to KB */
+	return 1;
+}
+
+/* Return the value of a "name value" line of a cgroup statistics file, or
+ * zero if the file has no such line */
+static uint64_t _cgroup_stat_value(char *buf, char *name)
+{
+	int len = strlen(name);
+	char *ptr = buf;
+
+	while ((ptr = strstr(ptr, name))) {
+		if (((ptr == buf) || (ptr[-1] == '\n')) && (ptr[len] == ' '))
+			return strtoull(ptr + len + 1, NULL, 10);
+		ptr += len;
+	}
+	return 0;
+}
+
+/* _cgroup_get_data_line() - get a task's usage from its cgroups
+ *
+ * IN:	task_cg - the task's cgroups
+ * OUT:	prec - the destination for the data
+ *
+ * RETVAL:	==0 - no valid data
+ * 		!=0 - data are valid
+ *
+ * Virtual memory is not tracked by cgroups, so the task's resident and
+ * swapped memory are reported as its virtual size.
+ */
+static int _cgroup_get_data_line(task_cg_t *task_cg, prec_t *prec)
+{
+	char *buf = NULL;
+	size_t size;
+	uint64_t rss, swap;
+
+	if (xcgroup_get_param(&task_cg->cpuacct_cg, "cpuacct.stat",
+			      &buf, &size) != XCGROUP_SUCCESS)
+		return 0;
+	/* in USER_HZ, as are the /proc/<pid>/stat times */
+	prec->usec = (int) _cgroup_stat_value(buf, "user");
+	prec->ssec = (int) _cgroup_stat_value(buf, "system");
+	xfree(buf);
+
+	if (xcgroup_get_param(&task_cg->memory_cg, "memory.stat",
+			      &buf, &size) != XCGROUP_SUCCESS)
+		return 0;
+	rss  = _cgroup_stat_value(buf, "total_rss");
+	swap = _cgroup_stat_value(buf, "total_swap");
+	prec->pages = (int) _cgroup_stat_value(buf, "total_pgmajfault");
+	xfree(buf);
+
+	prec->pid   = task_cg->pid;
+	prec->ppid  = 0;
+	prec->rss   = (int) (rss / 1024);		/* bytes to KB */
+	prec->vsize = (int) ((rss + swap) / 1024);
+	return 1;
+}
+
+/* Add a record for each of the step's tasks to prec_list */
+static void _cgroup_get_data(List prec_list)
+{
+	ListIterator itr;
+	task_cg_t *task_cg;
+	prec_t *prec;
+
+	slurm_mutex_lock(&cgroup_mutex);
+	if (task_cg_list) {
+		itr = list_iterator_create(task_cg_list);
+		while ((task_cg = list_next(itr))) {
+			prec = xmalloc(sizeof(prec_t));
+			if (_cgroup_get_data_line(task_cg, prec))
+				list_append(prec_list, prec);
+			else
+				xfree(prec);
+		}
+		list_iterator_destroy(itr);
+	}
+	slurm_mutex_unlock(&cgroup_mutex);
+}
+
+/* Create a user, job or step cgroup in a namespace if it does not exist.
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+static int _cgroup_instanciate(xcgroup_ns_t *ns, char *path,
+			       uid_t uid, gid_t gid, bool hierarchy)
+{
+	xcgroup_t cg;
+	int rc = SLURM_SUCCESS;
+
+	if (xcgroup_create(ns, &cg, path, uid, gid) != XCGROUP_SUCCESS)
+		return SLURM_ERROR;
+	if (xcgroup_instanciate(&cg) != XCGROUP_SUCCESS) {
+		error("jobacct_gather/cgroup: unable to create %s cgroup "
+		      "'%s'", ns->subsystems, path);
+		rc = SLURM_ERROR;
+	} else if (hierarchy) {
+		xcgroup_set_param(&cg, "memory.use_hierarchy", "1");
+	}
+	xcgroup_destroy(&cg);
+	return rc;
+}
+
+/* Create the step's user, job and step cgroups in a namespace, holding a
+ * lock on its root cgroup so that a release agent does not remove them
+ * while doing so. RET SLURM_SUCCESS or SLURM_ERROR */
+static int _cgroup_create_step(xcgroup_ns_t *ns, slurmd_job_t *job)
+{
+	char user_cgroup_path[PATH_MAX], job_cgroup_path[PATH_MAX];
+	xcgroup_t root_cg;
+	bool memory = (ns == &memory_ns);
+	int rc = SLURM_ERROR;
+
+	snprintf(user_cgroup_path, PATH_MAX, "/uid_%u", job->uid);
+	snprintf(job_cgroup_path, PATH_MAX, "%s/job_%u",
+		 user_cgroup_path, job->jobid);
+
+	if (xcgroup_create(ns, &root_cg, "", 0, 0) != XCGROUP_SUCCESS)
+		return SLURM_ERROR;
+	if (xcgroup_lock(&root_cg) != XCGROUP_SUCCESS) {
+		error("jobacct_gather/cgroup: unable to lock root %s cgroup",
+		      ns->subsystems);
+		xcgroup_destroy(&root_cg);
+		return SLURM_ERROR;
+	}
+	/* Ask for hierarchical memory accounting, as task/cgroup does */
+	if ((_cgroup_instanciate(ns, user_cgroup_path, getuid(), getgid(),
+				 memory) == SLURM_SUCCESS) &&
+	    (_cgroup_instanciate(ns, job_cgroup_path, getuid(), getgid(),
+				 memory) == SLURM_SUCCESS) &&
+	    (_cgroup_instanciate(ns, jobstep_cgroup_path, job->uid, job->gid,
+				 false) == SLURM_SUCCESS))
+		rc = SLURM_SUCCESS;
+	xcgroup_unlock(&root_cg);
+	xcgroup_destroy(&root_cg);
+	return rc;
+}
+
+/* Create a cgroup of each namespace for a task and move the task into them.
+ * The task has not yet called exec, so its offspring will be in them too.
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+static int _cgroup_create_task(pid_t pid, jobacct_id_t *jobacct_id)
+{
+	slurmd_job_t *job = jobacct_id->job;
+	char task_cgroup_path[PATH_MAX];
+	task_cg_t *task_cg;
+	int rc = SLURM_ERROR;
+
+	if (job == NULL) {
+		error("jobacct_gather/cgroup: no step given for task %u",
+		      jobacct_id->taskid);
+		return SLURM_ERROR;
+	}
+
+	slurm_mutex_lock(&cgroup_mutex);
+	if (jobstep_cgroup_path[0] == '\0') {
+		snprintf(jobstep_cgroup_path, PATH_MAX,
+			 "/uid_%u/job_%u/step_%u",
+			 job->uid, job->jobid, job->stepid);
+		if ((_cgroup_create_step(&cpuacct_ns, job) != SLURM_SUCCESS)
+		    || (_cgroup_create_step(&memory_ns, job) !=
+			SLURM_SUCCESS)) {
+			jobstep_cgroup_path[0] = '\0';
+			goto fini;
+		}
+		task_cg_list = list_create(NULL);
+	}
+
+	snprintf(task_cgroup_path, PATH_MAX, "%s/task_%u",
+		 jobstep_cgroup_path, jobacct_id->taskid);
+	task_cg = xmalloc(sizeof(task_cg_t));
+	task_cg->pid = pid;
+	xcgroup_create(&cpuacct_ns, &task_cg->cpuacct_cg, task_cgroup_path,
+		       job->uid, job->gid);
+	xcgroup_create(&memory_ns, &task_cg->memory_cg, task_cgroup_path,
+		       job->uid, job->gid);
+	if ((xcgroup_instanciate(&task_cg->cpuacct_cg) != XCGROUP_SUCCESS) ||
+	    (xcgroup_instanciate(&task_cg->memory_cg) != XCGROUP_SUCCESS) ||
+	    (xcgroup_add_pids(&task_cg->cpuacct_cg, &pid, 1) !=
+	     XCGROUP_SUCCESS) ||
+	    (xcgroup_add_pids(&task_cg->memory_cg, &pid, 1) !=
+	     XCGROUP_SUCCESS)) {
+		error("jobacct_gather/cgroup: unable to add task %u pid %d "
+		      "to cgroup '%s'", jobacct_id->taskid, pid,
+		      task_cgroup_path);
+		xcgroup_delete(&task_cg->cpuacct_cg);
+		xcgroup_delete(&task_cg->memory_cg);
+		xcgroup_destroy(&task_cg->cpuacct_cg);
+		xcgroup_destroy(&task_cg->memory_cg);
+		xfree(task_cg);
+		goto fini;
+	}
+	list_append(task_cg_list, task_cg);
+	rc = SLURM_SUCCESS;
+
+fini:	slurm_mutex_unlock(&cgroup_mutex);
+	return rc;
+}
+
+/* Remove the step's cgroups, and its job and user cgroups if no other step
+ * uses them. Cgroups still holding processes are left for the release
+ * agent. */
+static void _cgroup_remove_step(xcgroup_ns_t *ns)
+{
+	char path[PATH_MAX], *sep;
+	xcgroup_t root_cg, cg;
+	int i;
+
+	if (xcgroup_create(ns, &root_cg, "", 0, 0) != XCGROUP_SUCCESS)
+		return;
+	if (xcgroup_lock(&root_cg) != XCGROUP_SUCCESS) {
+		xcgroup_destroy(&root_cg);
+		return;
+	}
+	strlcpy(path, jobstep_cgroup_path, PATH_MAX);
+	for (i = 0; i < 3; i++) {	/* step, job, then user */
+		if (xcgroup_create(ns, &cg, path, 0, 0) != XCGROUP_SUCCESS)
+			break;
+		(void) xcgroup_delete(&cg);
+		xcgroup_destroy(&cg);
+		if ((sep = strrchr(path, '/')) == NULL)
+			break;
+		*sep = '\0';
+	}
+	xcgroup_unlock(&root_cg);
+	xcgroup_destroy(&root_cg);
+}
+
+/* Open the cpuacct and memory cgroup namespaces, mounting them if so
+ * configured in cgroup.conf. RET SLURM_SUCCESS or SLURM_ERROR if cgroups
+ * can not be used */
+static int _cgroup_init(void)
+{
+	slurm_cgroup_conf_t slurm_cgroup_conf;
+	char cpuacct_agent_path[PATH_MAX], memory_agent_path[PATH_MAX];
+	char *release_agent_dir;
+	int rc = SLURM_SUCCESS;
+
+	jobstep_cgroup_path[0] = '\0';
+	memset(&slurm_cgroup_conf, 0, sizeof(slurm_cgroup_conf_t));
+	if (read_slurm_cgroup_conf(&slurm_cgroup_conf) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	release_agent_dir = slurm_cgroup_conf.cgroup_release_agent;
+	if (release_agent_dir == NULL)
+		release_agent_dir = "/etc/slurm/cgroup";
+	snprintf(cpuacct_agent_path, PATH_MAX, "%s/release_cpuacct",
+		 release_agent_dir);
+	snprintf(memory_agent_path, PATH_MAX, "%s/release_memory",
+		 release_agent_dir);
+	xcgroup_ns_create(&cpuacct_ns, CGROUP_BASEDIR "/cpuacct", "",
+			  "cpuacct", cpuacct_agent_path);
+	xcgroup_ns_create(&memory_ns, CGROUP_BASEDIR "/memory", "",
+			  "memory", memory_agent_path);
+
+	if (!xcgroup_ns_is_available(&cpuacct_ns) &&
+	    (!slurm_cgroup_conf.cgroup_automount ||
+	     xcgroup_ns_mount(&cpuacct_ns))) {
+		info("jobacct_gather/cgroup: cpuacct cgroup namespace is "
+		     "not available");
+		rc = SLURM_ERROR;
+	} else if (!xcgroup_ns_is_available(&memory_ns) &&
+		   (!slurm_cgroup_conf.cgroup_automount ||
+		    xcgroup_ns_mount(&memory_ns))) {
+		info("jobacct_gather/cgroup: memory cgroup namespace is "
+		     "not available");
+		rc = SLURM_ERROR;
+	}
+	if (rc != SLURM_SUCCESS) {
+		xcgroup_ns_destroy(&cpuacct_ns);
+		xcgroup_ns_destroy(&memory_ns);
+	}
+
+	free_slurm_cgroup_conf(&slurm_cgroup_conf);
+	return rc;
+}
+
+/* Remove the step's cgroups and close the namespaces */
+static void _cgroup_fini(void)
+{
+	task_cg_t *task_cg;
+
+	slurm_mutex_lock(&cgroup_mutex);
+	if (task_cg_list) {
+		while ((task_cg = list_pop(task_cg_list))) {
+			(void) xcgroup_delete(&task_cg->cpuacct_cg);
+			(void) xcgroup_delete(&task_cg->memory_cg);
+			xcgroup_destroy(&task_cg->cpuacct_cg);
+			xcgroup_destroy(&task_cg->memory_cg);
+			xfree(task_cg);
+		}
+		list_destroy(task_cg_list);
+		task_cg_list = NULL;
+	}
+	if (jobstep_cgroup_path[0]) {
+		_cgroup_remove_step(&cpuacct_ns);
+		_cgroup_remove_step(&memory_ns);
+		jobstep_cgroup_path[0] = '\0';
+	}
+	slurm_mutex_unlock(&cgroup_mutex);
+}
+
+static void _task_sleep(int rem)
+{
+	while (rem)
+		rem = sleep(rem);	/* subject to interupt */
+}
+
+/* _watch_tasks() -- monitor slurm jobs and track their memory usage
+ *
+ * IN, OUT:	Irrelevant; this is invoked by pthread_create()
+ */
+
+static void *_watch_tasks(void *arg)
+{
+	/* Give chance for processes to spawn before starting
+	 * the polling. This should largely eliminate the
+	 * the chance of having /proc open when the tasks are
+	 * spawned, which would prevent a valid checkpoint/restart
+	 * with some systems */
+	_task_sleep(1);
+
+	while(!jobacct_shutdown) {  /* Do this until shutdown is requested */
+		if(!jobacct_suspended) {
+			_get_process_data();	/* Update the data */
+		}
+		_task_sleep(freq);
+	}
+	return NULL;
+}
+
+
+static void _destroy_prec(void *object)
+{
+	prec_t *prec = (prec_t *)object;
+	xfree(prec);
+	return;
+}
+
+/*
+ * init() is called when the plugin is loaded, before any other functions
+ * are called.  Put global initialization here.
+ */
+extern int init ( void )
+{
+	char *temp = slurm_get_proctrack_type();
+	if(!strcasecmp(temp, "proctrack/pgid"))
+		pgid_plugin = true;
+	xfree(temp);
+	temp = slurm_get_accounting_storage_type();
+	if(!strcasecmp(temp, ACCOUNTING_STORAGE_TYPE_NONE)) {
+		error("WARNING: Even though we are collecting accounting "
+		      "information you have asked for it not to be stored "
+		      "(%s) if this is not what you have in mind you will "
+		      "need to change it.", ACCOUNTING_STORAGE_TYPE_NONE);
+	}
+	xfree(temp);
+	verbose("%s loaded", plugin_name);
+	return SLURM_SUCCESS;
+}
+
+extern int fini ( void )
+{
+	if (cgroup_acct) {
+		_cgroup_fini();
+		xcgroup_ns_destroy(&cpuacct_ns);
+		xcgroup_ns_destroy(&memory_ns);
+		cgroup_acct = false;
+	}
+	return SLURM_SUCCESS;
+}
+
+extern struct jobacctinfo *jobacct_gather_p_create(jobacct_id_t *jobacct_id)
+{
+	return jobacct_common_alloc_jobacct(jobacct_id);
+}
+
+extern void jobacct_gather_p_destroy(struct jobacctinfo *jobacct)
+{
+	jobacct_common_free_jobacct(jobacct);
+}
+
+extern int jobacct_gather_p_setinfo(struct jobacctinfo *jobacct,
+				    enum jobacct_data_type type, void *data)
+{
+	return jobacct_common_setinfo(jobacct, type, data);
+}
+
+extern int jobacct_gather_p_getinfo(struct jobacctinfo *jobacct,
+				    enum jobacct_data_type type, void *data)
+{
+	return jobacct_common_getinfo(jobacct, type, data);
+}
+
+extern void jobacct_gather_p_pack(struct jobacctinfo *jobacct,
+				  uint16_t rpc_version,  Buf buffer)
+{
+	jobacct_common_pack(jobacct, rpc_version, buffer);
+}
+
+extern int jobacct_gather_p_unpack(struct jobacctinfo **jobacct,
+				   uint16_t rpc_version, Buf buffer)
+{
+	return jobacct_common_unpack(jobacct, rpc_version, buffer);
+}
+
+extern void jobacct_gather_p_aggregate(struct jobacctinfo *dest,
+				       struct jobacctinfo *from)
+{
+	jobacct_common_aggregate(dest, from);
+}
+
+/*
+ * jobacct_startpoll() is called when the plugin is loaded by
+ * slurmd, before any other functions are called.  Put global
+ * initialization here.
+ */
+
+extern int jobacct_gather_p_startpoll(uint16_t frequency)
+{
+	int rc = SLURM_SUCCESS;
+
+	pthread_attr_t attr;
+	pthread_t _watch_tasks_thread_id;
+
+	debug("%s loaded", plugin_name);
+
+	debug("jobacct-gather: frequency = %d", frequency);
+
+	/* Only slurmstepd polls, so cgroups are set up here rather than in
+	 * init() */
+	if (_cgroup_init() == SLURM_SUCCESS) {
+		cgroup_acct = true;
+		debug("jobacct-gather: using cpuacct and memory cgroups");
+	} else if (pgid_plugin) {
+		info("WARNING: cgroups are not available and we will use a "
+		     "much slower algorithm with proctrack/pgid, use "
+		     "Proctracktype=proctrack/linuxproc or "
+		     "Proctracktype=proctrack/rms with %s", plugin_name);
+	} else
+		info("jobacct-gather: cgroups are not available, reading "
+		     "usage from /proc");
+
+	jobacct_shutdown = false;
+
+	task_list = list_create(jobacct_common_free_jobacct);
+
+	if (frequency == 0) {	/* don't want dynamic monitoring? */
+		debug2("jobacct-gather cgroup dynamic logging disabled");
+		return rc;
+	}
+
+	freq = frequency;
+	/* create polling thread */
+	slurm_attr_init(&attr);
+	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+		error("pthread_attr_setdetachstate error %m");
+
+	if  (pthread_create(&_watch_tasks_thread_id, &attr,
+			    &_watch_tasks, NULL)) {
+		debug("jobacct-gather failed to create _watch_tasks "
+		      "thread: %m");
+		frequency = 0;
+	}
+	else
+		debug3("jobacct-gather cgroup dynamic logging enabled");
+	slurm_attr_destroy(&attr);
+
+	return rc;
+}
+
+extern int jobacct_gather_p_endpoll()
+{
+	jobacct_shutdown = true;
+	slurm_mutex_lock(&jobacct_lock);
+	if(task_list)
+		list_destroy(task_list);
+	task_list = NULL;
+	slurm_mutex_unlock(&jobacct_lock);
+
+	if (slash_proc) {
+		slurm_mutex_lock(&reading_mutex);
+		(void) closedir(slash_proc);
+		slurm_mutex_unlock(&reading_mutex);
+	}
+
+	if (cgroup_acct)
+		_cgroup_fini();
+
+
+	return SLURM_SUCCESS;
+}
+
+extern void jobacct_gather_p_change_poll(uint16_t frequency)
+{
+	if(freq == 0 && frequency != 0) {
+		pthread_attr_t attr;
+		pthread_t _watch_tasks_thread_id;
+		/* create polling thread */
+		slurm_attr_init(&attr);
+		if (pthread_attr_setdetachstate(&attr,
+						PTHREAD_CREATE_DETACHED))
+			error("pthread_attr_setdetachstate error %m");
+
+		if  (pthread_create(&_watch_tasks_thread_id, &attr,
+				    &_watch_tasks, NULL)) {
+			debug("jobacct-gather failed to create _watch_tasks "
+			      "thread: %m");
+			frequency = 0;
+		}
+		else
+			debug3("jobacct-gather cgroup dynamic logging enabled");
+		slurm_attr_destroy(&attr);
+		jobacct_shutdown = false;
+	}
+
+	freq = frequency;
+	debug("jobacct-gather: frequency changed = %d", frequency);
+	if (freq == 0)
+		jobacct_shutdown = true;
+	return;
+}
+
+extern void jobacct_gather_p_suspend_poll()
+{
+	jobacct_suspended = true;
+}
+
+extern void jobacct_gather_p_resume_poll()
+{
+	jobacct_suspended = false;
+}
+
+extern int jobacct_gather_p_set_proctrack_container_id(uint64_t id)
+{
+	if(pgid_plugin || cgroup_acct)
+		return SLURM_SUCCESS;
+
+	if (cont_id != (uint64_t)NO_VAL)
+		info("Warning: jobacct: set_proctrack_container_id: cont_id "
+		     "is already set to %"PRIu64" you are setting it to "
+		     "%"PRIu64"", cont_id, id);
+	if (id <= 0) {
+		error("jobacct: set_proctrack_container_id: "
+		      "I was given most likely an unset cont_id %"PRIu64"",
+		      id);
+		return SLURM_ERROR;
+	}
+	cont_id = id;
+
+	return SLURM_SUCCESS;
+}
+
+extern int jobacct_gather_p_add_task(pid_t pid, jobacct_id_t *jobacct_id)
+{
+	if (jobacct_shutdown)
+		return SLURM_ERROR;
+	if (cgroup_acct && (_cgroup_create_task(pid, jobacct_id) !=
+			    SLURM_SUCCESS))
+		return SLURM_ERROR;
+	return jobacct_common_add_task(pid, jobacct_id, task_list);
+}
+
+
+extern struct jobacctinfo *jobacct_gather_p_stat_task(pid_t pid)
+{
+	if (jobacct_shutdown)
+		return NULL;
+	else if(pid) {
+		_get_process_data();
+		return jobacct_common_stat_task(pid, task_list);
+	} else {
+		/* In this situation, we are just trying to get a
+		 * basis of information since we are not pollng.  So
+		 * we will give a chance for processes to spawn before we
+		 * gather information. This should largely eliminate the
+		 * the chance of having /proc open when the tasks are
+		 * spawned, which would prevent a valid checkpoint/restart
+		 * with some systems */
+		_task_sleep(1);
+		_get_process_data();
+		return NULL;
+	}
+}
+
+extern struct jobacctinfo *jobacct_gather_p_remove_task(pid_t pid)
+{
+	if (jobacct_shutdown)
+		return NULL;
+	return jobacct_common_remove_task(pid, task_list);
+}
+
+extern void jobacct_gather_p_2_stats(slurmdb_stats_t *stats,
+				     struct jobacctinfo *jobacct)
+{
+	jobacct_common_2_stats(stats, jobacct);
+}
@@ -55,9 +55,11 @@
 #include <fcntl.h>
 
 #include <math.h>
+#include <unistd.h>
 #include "slurm/slurm_errno.h"
 
 #include "src/common/slurm_priority.h"
+#include "src/common/timers.h"
 #include "src/common/xstring.h"
 #include "src/common/assoc_mgr.h"
 #include "src/common/parse_time.h"
@@ -66,6 +68,12 @@
 
 #define SECS_PER_DAY	(24 * 60 * 60)
 #define SECS_PER_WEEK	(7 * SECS_PER_DAY)
+
+/* Pending job priorities are calculated by up to MAX_PRIO_THREADS threads,
+ * each given at least MIN_PRIO_THREAD_JOBS jobs */
+#define MAX_PRIO_THREADS	8
+#define MIN_PRIO_THREAD_JOBS	2000
+
 /* These are defined here so when we link with something other than
  * the slurmctld we will have these symbols defined.  They will get
  * overwritten when linking with the slurmctld.
@@ -127,6 +135,43 @@ static uint32_t weight_js; /* weight for Job Size factor */
 static uint32_t weight_part; /* weight for Partition factor */
 static uint32_t weight_qos; /* weight for QOS factor */
 
+/* The inputs to a pending job's priority, copied from the job and its
+ * partition, QOS and association so that the priority can be calculated
+ * without holding any locks, and the result */
+typedef struct prio_job {
+	struct job_record *job_ptr;	/* only valid if find_job_record()
+					 * still returns it for job_id */
+	uint32_t job_id;
+	void *assoc_ptr;		/* to detect changes to the job */
+	void *qos_ptr;
+	struct part_record *part_ptr;
+	uint16_t nice;
+
+	time_t begin_time;
+	uint32_t cpu_cnt;		/* CPUs allocated or requested */
+	uint32_t min_nodes;
+	double part_prio;		/* partition's normalized priority */
+	double qos_prio;		/* QOS's normalized priority */
+	bool use_fs;			/* set if fairshare is calculated */
+	long double usage_efctv;	/* of the association giving the */
+	long double shares_norm;	/* job's fairshare */
+	char *user, *acct;		/* for priority_debug only */
+
+	bool calc;			/* set if priority must be calculated,
+					 * otherwise it is final */
+	uint32_t priority;
+	priority_factors_object_t factors;	/* weighted factors */
+} prio_job_t;
+
+/* Pending jobs whose priorities are calculated by one thread */
+typedef struct prio_thread_args {
+	prio_job_t *prio_jobs;
+	uint32_t begin, end;		/* range of prio_jobs */
+	time_t start_time;
+	uint32_t node_cnt;		/* node_record_count */
+	uint32_t cpu_cnt;		/* cluster_cpus */
+} prio_thread_args_t;
+
 extern void priority_p_set_assoc_usage(slurmdb_association_rec_t *assoc);
 extern double priority_p_calc_fs_factor(long double usage_efctv,
 					long double shares_norm);
@@ -388,31 +433,78 @@ static int _set_children_usage_efctv(List childern_list)
 	return SLURM_SUCCESS;
 }
 
-/* job_ptr should already have the partition priority and such added
- * here before had we will be adding to it
+/*
+ * Copy the inputs to a job's priority into prio_job. Fairshare is taken from
+ * the job's association, or its parent if FairShare=parent.
+ * Caller must hold a read lock on the job and read locks on associations and
+ * QOS.
+ * IN start_time - time the priority is calculated for
+ * IN job_ptr - the job
+ * OUT prio_job - the inputs, or the job's final priority if prio_job->calc
+ *	is not set (the job's priority was set directly, the job is not yet
+ *	eligible to run or it has no details)
  */
-static double _get_fairshare_priority( struct job_record *job_ptr)
+static void _snap_job(time_t start_time, struct job_record *job_ptr,
+		      prio_job_t *prio_job)
 {
 	slurmdb_association_rec_t *job_assoc =
 		(slurmdb_association_rec_t *)job_ptr->assoc_ptr;
 	slurmdb_association_rec_t *fs_assoc = NULL;
-	double priority_fs = 0.0;
-	assoc_mgr_lock_t locks = { READ_LOCK, NO_LOCK,
-				   NO_LOCK, NO_LOCK, NO_LOCK };
+	slurmdb_qos_rec_t *qos_ptr = (slurmdb_qos_rec_t *)job_ptr->qos_ptr;
 
-	if (!calc_fairshare)
-		return 0;
+	memset(prio_job, 0, sizeof(prio_job_t));
+	prio_job->job_ptr   = job_ptr;
+	prio_job->job_id    = job_ptr->job_id;
+	prio_job->assoc_ptr = job_ptr->assoc_ptr;
+	prio_job->qos_ptr   = job_ptr->qos_ptr;
+	prio_job->part_ptr  = job_ptr->part_ptr;
 
-	if (!job_assoc) {
-		error("Job %u has no association.  Unable to "
-		      "compute fairshare.", job_ptr->job_id);
-		return 0;
+	if (job_ptr->direct_set_prio) {
+		prio_job->priority = job_ptr->priority;
+		return;
 	}
 
-	fs_assoc = job_assoc;
+	if (!job_ptr->details) {
+		error("_get_priority_internal: job %u does not have a "
+		      "details symbol set, can't set priority",
+		      job_ptr->job_id);
+		prio_job->priority = 0;
+		return;
+	}
+	/*
+	 * This means the job is not eligible yet
+	 */
+	if (!job_ptr->details->begin_time
+	    || (job_ptr->details->begin_time > start_time)) {
+		prio_job->priority = 1;
+		return;
+	}
 
-	assoc_mgr_lock(&locks);
+	prio_job->calc = true;
+	prio_job->nice = job_ptr->details->nice;
+	prio_job->begin_time = job_ptr->details->begin_time;
+	prio_job->min_nodes = job_ptr->details->min_nodes;
+	/* On the initial run of this we don't have total_cpus
+	   so go off the requesting.  After the first shot
+	   total_cpus should be filled in.
+	*/
+	if (job_ptr->total_cpus)
+		prio_job->cpu_cnt = job_ptr->total_cpus;
+	else if (job_ptr->details->max_cpus != NO_VAL)
+		prio_job->cpu_cnt = job_ptr->details->max_cpus;
+	else if (job_ptr->details->min_cpus)
+		prio_job->cpu_cnt = job_ptr->details->min_cpus;
+
+	if (job_ptr->part_ptr && job_ptr->part_ptr->priority && weight_part)
+		prio_job->part_prio = job_ptr->part_ptr->norm_priority;
+
+	if (qos_ptr && qos_ptr->priority && weight_qos)
+		prio_job->qos_prio = qos_ptr->usage->norm_priority;
 
+	if (!job_assoc || !weight_fs || !calc_fairshare)
+		return;
+
+	fs_assoc = job_assoc;
 	/* Use values from parent when FairShare=SLURMDB_FS_USE_PARENT */
 	while ((fs_assoc->shares_raw == SLURMDB_FS_USE_PARENT)
 	       && fs_assoc->usage->parent_assoc_ptr
@@ -423,147 +515,98 @@ static double _get_fairshare_priority( struct job_record *job_ptr)
 	if (fuzzy_equal(fs_assoc->usage->usage_efctv, NO_VAL))
 		priority_p_set_assoc_usage(fs_assoc);
 
-	/* Priority is 0 -> 1 */
-	priority_fs = priority_p_calc_fs_factor(
-		fs_assoc->usage->usage_efctv,
-		(long double)fs_assoc->usage->shares_norm);
+	prio_job->use_fs = true;
+	prio_job->usage_efctv = fs_assoc->usage->usage_efctv;
+	prio_job->shares_norm = (long double)fs_assoc->usage->shares_norm;
 	if (priority_debug) {
-		info("Fairshare priority of job %u for user %s in acct"
-		     " %s is 2**(-%Lf/%f) = %f",
-		     job_ptr->job_id, job_assoc->user, job_assoc->acct,
-		     fs_assoc->usage->usage_efctv,
-		     fs_assoc->usage->shares_norm, priority_fs);
+		prio_job->user = xstrdup(job_assoc->user);
+		prio_job->acct = xstrdup(job_assoc->acct);
 	}
-
-	assoc_mgr_unlock(&locks);
-
-	return priority_fs;
 }
 
-static void _get_priority_factors(time_t start_time, struct job_record *job_ptr)
+/*
+ * Calculate a job's priority factors and priority from the inputs copied by
+ * _snap_job(). No locks are needed.
+ * IN/OUT prio_job - inputs, the weighted factors and priority are set
+ * IN start_time - time the priority is calculated for
+ * IN node_cnt - count of nodes in the cluster (node_record_count)
+ * IN cpu_cnt - count of CPUs in the cluster (cluster_cpus)
+ */
+static void _calc_priority(prio_job_t *prio_job, time_t start_time,
+			   uint32_t node_cnt, uint32_t cpu_cnt)
 {
-	slurmdb_qos_rec_t *qos_ptr = NULL;
-
-	xassert(job_ptr);
-
-	if (!job_ptr->prio_factors)
-		job_ptr->prio_factors =
-			xmalloc(sizeof(priority_factors_object_t));
-	else
-		memset(job_ptr->prio_factors, 0,
-		       sizeof(priority_factors_object_t));
+	priority_factors_object_t *factors = &prio_job->factors;
+	priority_factors_object_t pre_factors;
+	double priority = 0.0;
 
-	qos_ptr = (slurmdb_qos_rec_t *)job_ptr->qos_ptr;
+	memset(factors, 0, sizeof(priority_factors_object_t));
 
 	if (weight_age) {
-		uint32_t diff = start_time - job_ptr->details->begin_time;
-		if (job_ptr->details->begin_time) {
-			if (diff < max_age)
-				job_ptr->prio_factors->priority_age =
-					(double)diff / (double)max_age;
-			else
-				job_ptr->prio_factors->priority_age = 1.0;
-		}
+		uint32_t diff = start_time - prio_job->begin_time;
+		if (diff < max_age)
+			factors->priority_age = (double)diff / (double)max_age;
+		else
+			factors->priority_age = 1.0;
 	}
 
-	if (job_ptr->assoc_ptr && weight_fs) {
-		job_ptr->prio_factors->priority_fs =
-				_get_fairshare_priority(job_ptr);
+	if (prio_job->use_fs) {
+		/* Priority is 0 -> 1 */
+		factors->priority_fs = priority_p_calc_fs_factor(
+			prio_job->usage_efctv, prio_job->shares_norm);
+		if (priority_debug) {
+			info("Fairshare priority of job %u for user %s in acct"
+			     " %s is 2**(-%Lf/%Lf) = %f",
+			     prio_job->job_id, prio_job->user, prio_job->acct,
+			     prio_job->usage_efctv, prio_job->shares_norm,
+			     factors->priority_fs);
+		}
 	}
 
 	if (weight_js) {
-		uint32_t cpu_cnt = 0;
-		/* On the initial run of this we don't have total_cpus
-		   so go off the requesting.  After the first shot
-		   total_cpus should be filled in.
-		*/
-		if (job_ptr->total_cpus)
-			cpu_cnt = job_ptr->total_cpus;
-		else if (job_ptr->details
-			 && (job_ptr->details->max_cpus != NO_VAL))
-			cpu_cnt = job_ptr->details->max_cpus;
-		else if (job_ptr->details && job_ptr->details->min_cpus)
-			cpu_cnt = job_ptr->details->min_cpus;
-
 		if (favor_small) {
-			job_ptr->prio_factors->priority_js =
-				(double)(node_record_count
-					 - job_ptr->details->min_nodes)
-				/ (double)node_record_count;
-			if (cpu_cnt) {
-				job_ptr->prio_factors->priority_js +=
-					(double)(cluster_cpus - cpu_cnt)
-					/ (double)cluster_cpus;
-				job_ptr->prio_factors->priority_js /= 2;
+			factors->priority_js =
+				(double)(node_cnt - prio_job->min_nodes)
+				/ (double)node_cnt;
+			if (prio_job->cpu_cnt) {
+				factors->priority_js +=
+					(double)(cpu_cnt - prio_job->cpu_cnt)
+					/ (double)cpu_cnt;
+				factors->priority_js /= 2;
 			}
 		} else {
-			job_ptr->prio_factors->priority_js =
-				(double)job_ptr->details->min_nodes
-				/ (double)node_record_count;
-			if (cpu_cnt) {
-				job_ptr->prio_factors->priority_js +=
-					(double)cpu_cnt / (double)cluster_cpus;
-				job_ptr->prio_factors->priority_js /= 2;
+			factors->priority_js =
+				(double)prio_job->min_nodes
+				/ (double)node_cnt;
+			if (prio_job->cpu_cnt) {
+				factors->priority_js +=
+					(double)prio_job->cpu_cnt
+					/ (double)cpu_cnt;
+				factors->priority_js /= 2;
 			}
 		}
-		if (job_ptr->prio_factors->priority_js < .0)
-			job_ptr->prio_factors->priority_js = 0.0;
-		else if (job_ptr->prio_factors->priority_js > 1.0)
-			job_ptr->prio_factors->priority_js = 1.0;
+		if (factors->priority_js < .0)
+			factors->priority_js = 0.0;
+		else if (factors->priority_js > 1.0)
+			factors->priority_js = 1.0;
 	}
 
-	if (job_ptr->part_ptr && job_ptr->part_ptr->priority && weight_part) {
-		job_ptr->prio_factors->priority_part =
-			job_ptr->part_ptr->norm_priority;
-	}
-
-	if (qos_ptr && qos_ptr->priority && weight_qos) {
-		job_ptr->prio_factors->priority_qos =
-			qos_ptr->usage->norm_priority;
-	}
+	factors->priority_part = prio_job->part_prio;
+	factors->priority_qos = prio_job->qos_prio;
+	factors->nice = prio_job->nice;
+	memcpy(&pre_factors, factors, sizeof(priority_factors_object_t));
 
-	job_ptr->prio_factors->nice = job_ptr->details->nice;
-}
+	factors->priority_age *= (double)weight_age;
+	factors->priority_fs *= (double)weight_fs;
+	factors->priority_js *= (double)weight_js;
+	factors->priority_part *= (double)weight_part;
+	factors->priority_qos *= (double)weight_qos;
 
-static uint32_t _get_priority_internal(time_t start_time,
-				       struct job_record *job_ptr)
-{
-	double priority		= 0.0;
-	priority_factors_object_t pre_factors;
-
-	if (job_ptr->direct_set_prio)
-		return job_ptr->priority;
-
-	if (!job_ptr->details) {
-		error("_get_priority_internal: job %u does not have a "
-		      "details symbol set, can't set priority",
-		      job_ptr->job_id);
-		return 0;
-	}
-	/*
-	 * This means the job is not eligible yet
-	 */
-	if (!job_ptr->details->begin_time
-	    || (job_ptr->details->begin_time > start_time))
-		return 1;
-
-	/* figure out the priority */
-	_get_priority_factors(start_time, job_ptr);
-	memcpy(&pre_factors, job_ptr->prio_factors,
-	       sizeof(job_ptr->prio_factors));
-
-	job_ptr->prio_factors->priority_age *= (double)weight_age;
-	job_ptr->prio_factors->priority_fs *= (double)weight_fs;
-	job_ptr->prio_factors->priority_js *= (double)weight_js;
-	job_ptr->prio_factors->priority_part *= (double)weight_part;
-	job_ptr->prio_factors->priority_qos *= (double)weight_qos;
-
-	priority = job_ptr->prio_factors->priority_age
-		+ job_ptr->prio_factors->priority_fs
-		+ job_ptr->prio_factors->priority_js
-		+ job_ptr->prio_factors->priority_part
-		+ job_ptr->prio_factors->priority_qos
-		- (double)(job_ptr->prio_factors->nice - NICE_OFFSET);
+	priority = factors->priority_age
+		+ factors->priority_fs
+		+ factors->priority_js
+		+ factors->priority_part
+		+ factors->priority_qos
+		- (double)(factors->nice - NICE_OFFSET);
 
 	/*
 	 * 0 means the job is held; 1 means system hold
@@ -575,30 +618,134 @@ static uint32_t _get_priority_internal(time_t start_time,
 	if (priority_debug) {
 		info("Weighted Age priority is %f * %u = %.2f",
 		     pre_factors.priority_age, weight_age,
-		     job_ptr->prio_factors->priority_age);
+		     factors->priority_age);
 		info("Weighted Fairshare priority is %f * %u = %.2f",
 		     pre_factors.priority_fs, weight_fs,
-		     job_ptr->prio_factors->priority_fs);
+		     factors->priority_fs);
 		info("Weighted JobSize priority is %f * %u = %.2f",
 		     pre_factors.priority_js, weight_js,
-		     job_ptr->prio_factors->priority_js);
+		     factors->priority_js);
 		info("Weighted Partition priority is %f * %u = %.2f",
 		     pre_factors.priority_part, weight_part,
-		     job_ptr->prio_factors->priority_part);
+		     factors->priority_part);
 		info("Weighted QOS priority is %f * %u = %.2f",
 		     pre_factors.priority_qos, weight_qos,
-		     job_ptr->prio_factors->priority_qos);
+		     factors->priority_qos);
 		info("Job %u priority: %.2f + %.2f + %.2f + %.2f + %.2f - %d "
 		     "= %.2f",
-		     job_ptr->job_id, job_ptr->prio_factors->priority_age,
-		     job_ptr->prio_factors->priority_fs,
-		     job_ptr->prio_factors->priority_js,
-		     job_ptr->prio_factors->priority_part,
-		     job_ptr->prio_factors->priority_qos,
-		     (job_ptr->prio_factors->nice - NICE_OFFSET),
+		     prio_job->job_id, factors->priority_age,
+		     factors->priority_fs,
+		     factors->priority_js,
+		     factors->priority_part,
+		     factors->priority_qos,
+		     (factors->nice - NICE_OFFSET),
 		     priority);
 	}
-	return (uint32_t)priority;
+	prio_job->priority = (uint32_t)priority;
+}
+
+/* Copy the priority factors calculated for a job into its record */
+static void _set_prio_factors(struct job_record *job_ptr,
+			      prio_job_t *prio_job)
+{
+	if (!job_ptr->prio_factors)
+		job_ptr->prio_factors =
+			xmalloc(sizeof(priority_factors_object_t));
+	memcpy(job_ptr->prio_factors, &prio_job->factors,
+	       sizeof(priority_factors_object_t));
+}
+
+static uint32_t _get_priority_internal(time_t start_time,
+				       struct job_record *job_ptr)
+{
+	prio_job_t prio_job;
+	assoc_mgr_lock_t locks = { READ_LOCK, NO_LOCK,
+				   READ_LOCK, NO_LOCK, NO_LOCK };
+
+	assoc_mgr_lock(&locks);
+	_snap_job(start_time, job_ptr, &prio_job);
+	assoc_mgr_unlock(&locks);
+
+	if (prio_job.calc) {
+		_calc_priority(&prio_job, start_time, node_record_count,
+			       cluster_cpus);
+		_set_prio_factors(job_ptr, &prio_job);
+		xfree(prio_job.user);
+		xfree(prio_job.acct);
+	}
+	return prio_job.priority;
+}
+
+/* Calculate the priorities of a range of pending jobs */
+static void *_calc_priority_thread(void *arg)
+{
+	prio_thread_args_t *args = (prio_thread_args_t *) arg;
+	uint32_t i;
+
+	for (i = args->begin; i < args->end; i++) {
+		if (args->prio_jobs[i].calc) {
+			_calc_priority(&args->prio_jobs[i], args->start_time,
+				       args->node_cnt, args->cpu_cnt);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Calculate the priorities of pending jobs, splitting them between threads
+ * if there are many
+ * IN/OUT prio_jobs - jobs as set by _snap_job()
+ * IN prio_job_cnt - count of prio_jobs
+ * IN start_time - time the priorities are calculated for
+ * RET count of threads used
+ */
+static int _calc_priorities(prio_job_t *prio_jobs, uint32_t prio_job_cnt,
+			    time_t start_time)
+{
+	prio_thread_args_t args[MAX_PRIO_THREADS];
+	pthread_t thread_id[MAX_PRIO_THREADS];
+	pthread_attr_t thread_attr;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, thread_cnt;
+
+	thread_cnt = prio_job_cnt / MIN_PRIO_THREAD_JOBS;
+	thread_cnt = MIN(thread_cnt, cpus);
+	thread_cnt = MIN(thread_cnt, MAX_PRIO_THREADS);
+	/* Keep the log in job order */
+	if ((thread_cnt < 1) || priority_debug)
+		thread_cnt = 1;
+
+	for (i = 0; i < thread_cnt; i++) {
+		args[i].prio_jobs  = prio_jobs;
+		args[i].begin      = ((uint64_t) prio_job_cnt * i) / thread_cnt;
+		args[i].end        = ((uint64_t) prio_job_cnt * (i + 1)) /
+				     thread_cnt;
+		args[i].start_time = start_time;
+		args[i].node_cnt   = node_record_count;
+		args[i].cpu_cnt    = cluster_cpus;
+	}
+	if (thread_cnt == 1) {
+		_calc_priority_thread(&args[0]);
+		return thread_cnt;
+	}
+
+	/* This thread takes the first range */
+	slurm_attr_init(&thread_attr);
+	for (i = 1; i < thread_cnt; i++) {
+		if (pthread_create(&thread_id[i], &thread_attr,
+				   _calc_priority_thread, &args[i])) {
+			error("pthread_create error %m");
+			_calc_priority_thread(&args[i]);
+			thread_id[i] = 0;
+		}
+	}
+	slurm_attr_destroy(&thread_attr);
+	_calc_priority_thread(&args[0]);
+	for (i = 1; i < thread_cnt; i++) {
+		if (thread_id[i])
+			pthread_join(thread_id[i], NULL);
+	}
+	return thread_cnt;
 }
 
 /* based upon the last reset time, compute when the next reset should be */
@@ -662,6 +809,14 @@ static time_t _next_reset(uint16_t reset_period, time_t last_reset)
 	return mktime(&last_tm);
 }
 
+/* Cancellation cleanup for _decay_thread, free the pending job copies */
+static void _decay_cleanup(void *arg)
+{
+	prio_job_t **prio_jobs = (prio_job_t **) arg;
+
+	xfree(*prio_jobs);
+}
+
 static void *_decay_thread(void *no_data)
 {
 	struct job_record *job_ptr = NULL;
@@ -677,11 +832,22 @@ static void *_decay_thread(void *no_data)
 	double decay_factor = 1;
 	uint16_t reset_period = slurm_get_priority_reset_period();
 
-	/* Write lock on jobs, read lock on nodes and partitions */
+	prio_job_t *prio_jobs = NULL;
+	uint32_t i, prio_job_cnt, prio_job_size = 0, publish_cnt;
+	int thread_cnt;
+	long usage_usec, calc_usec, publish_usec;
+	DEF_TIMERS;
+
+	/* Read lock on jobs, nodes and partitions to collect usage and
+	 * copy pending jobs, write lock on jobs to set their priorities */
+	slurmctld_lock_t job_read_lock =
+		{ NO_LOCK, READ_LOCK, READ_LOCK, READ_LOCK };
 	slurmctld_lock_t job_write_lock =
-		{ NO_LOCK, WRITE_LOCK, READ_LOCK, READ_LOCK };
+		{ NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
 	assoc_mgr_lock_t locks = { WRITE_LOCK, NO_LOCK,
 				   WRITE_LOCK, NO_LOCK, NO_LOCK };
+	assoc_mgr_lock_t read_locks = { READ_LOCK, NO_LOCK,
+					READ_LOCK, NO_LOCK, NO_LOCK };
 
 	if (decay_hl > 0)
 		decay_factor = 1 - (0.693 / decay_hl);
@@ -700,6 +866,8 @@ static void *_decay_thread(void *no_data)
 	if (last_reset == 0)
 		last_reset = start_time;
 
+	/* fini() cancels this thread, release the copies with it */
+	pthread_cleanup_push(_decay_cleanup, &prio_jobs);
 	while (1) {
 		time_t now = time(NULL);
 		int run_delta = 0;
@@ -778,7 +946,17 @@ static void *_decay_thread(void *no_data)
 			slurm_mutex_unlock(&decay_lock);
 			break;
 		}
-		lock_slurmctld(job_write_lock);
+		/* Apply usage and copy the pending jobs whose priorities
+		 * will be calculated. Pointers to the jobs are gathered
+		 * first since the association locks used to apply usage
+		 * and to copy the jobs differ. */
+		START_TIMER;
+		lock_slurmctld(job_read_lock);
+		prio_job_cnt = 0;
+		if (prio_job_size < list_count(job_list)) {
+			prio_job_size = list_count(job_list);
+			xrealloc(prio_jobs, sizeof(prio_job_t) * prio_job_size);
+		}
 		itr = list_iterator_create(job_list);
 		while ((job_ptr = list_next(itr))) {
 			/* apply new usage */
@@ -888,14 +1066,73 @@ static void *_decay_thread(void *no_data)
 			    || !IS_JOB_PENDING(job_ptr))
 				continue;
 
-			job_ptr->priority =
-				_get_priority_internal(start_time, job_ptr);
-			last_job_update = time(NULL);
+			prio_jobs[prio_job_cnt++].job_ptr = job_ptr;
+		}
+		list_iterator_destroy(itr);
+		assoc_mgr_lock(&read_locks);
+		for (i = 0; i < prio_job_cnt; i++) {
+			_snap_job(start_time, prio_jobs[i].job_ptr,
+				  &prio_jobs[i]);
+		}
+		assoc_mgr_unlock(&read_locks);
+		unlock_slurmctld(job_read_lock);
+		END_TIMER;
+		usage_usec = DELTA_TIMER;
+
+		/* Calculate the priorities without holding any locks */
+		START_TIMER;
+		thread_cnt = _calc_priorities(prio_jobs, prio_job_cnt,
+					      start_time);
+		END_TIMER;
+		calc_usec = DELTA_TIMER;
+
+		/* Set the priorities of jobs which are still pending and
+		 * whose priority inputs did not change meanwhile. Those which
+		 * changed had their priority set by the change. */
+		START_TIMER;
+		publish_cnt = 0;
+		lock_slurmctld(job_write_lock);
+		for (i = 0; i < prio_job_cnt; i++) {
+			prio_job_t *prio_job = &prio_jobs[i];
+
+			job_ptr = find_job_record(prio_job->job_id);
+			if ((job_ptr != prio_job->job_ptr)
+			    || (job_ptr->priority <= 1)
+			    || !IS_JOB_PENDING(job_ptr)
+			    || (job_ptr->assoc_ptr != prio_job->assoc_ptr)
+			    || (job_ptr->qos_ptr != prio_job->qos_ptr)
+			    || (job_ptr->part_ptr != prio_job->part_ptr)
+			    || (prio_job->calc &&
+				(job_ptr->direct_set_prio
+				 || !job_ptr->details
+				 || (job_ptr->details->nice !=
+				     prio_job->nice)))) {
+				xfree(prio_job->user);
+				xfree(prio_job->acct);
+				continue;
+			}
+
+			if (prio_job->calc) {
+				_set_prio_factors(job_ptr, prio_job);
+				xfree(prio_job->user);
+				xfree(prio_job->acct);
+			}
+			job_ptr->priority = prio_job->priority;
+			last_job_update = job_ptr->last_update = time(NULL);
+			mark_job_state_dirty(job_ptr);
 			debug2("priority for job %u is now %u",
 			       job_ptr->job_id, job_ptr->priority);
+			publish_cnt++;
 		}
-		list_iterator_destroy(itr);
 		unlock_slurmctld(job_write_lock);
+		END_TIMER;
+		publish_usec = DELTA_TIMER;
+
+		debug("priority/multifactor: usage and copy of %u pending "
+		      "jobs took %ld usec, calculation with %d threads %ld "
+		      "usec, setting %u priorities %ld usec",
+		      prio_job_cnt, usage_usec, thread_cnt, calc_usec,
+		      publish_cnt, publish_usec);
 
 	get_usage:
 		/* now calculate all the normalized usage here */
@@ -921,6 +1158,7 @@ static void *_decay_thread(void *no_data)
 		start_time = next_time;
 		/* repeat ;) */
 	}
+	pthread_cleanup_pop(1);
 	return NULL;
 }
 
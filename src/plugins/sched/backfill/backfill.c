@@ -90,6 +90,17 @@
 #define   BACKFILL_WINDOW		(24 * 60 * 60)
 #endif
 
+/* Seconds to release locks for when a backfill cycle yields */
+#ifndef BACKFILL_YIELD_SLEEP
+#define   BACKFILL_YIELD_SLEEP		1
+#endif
+
+/* Start a new backfill cycle once this many seconds old, so changes in job
+ * priority are reflected, currently five minutes */
+#ifndef BACKFILL_CYCLE_AGE
+#define   BACKFILL_CYCLE_AGE		(5 * 60)
+#endif
+
 #define SLURMCTLD_THREAD_LIMIT	5
 
 typedef struct node_space_map {
@@ -98,6 +109,51 @@ typedef struct node_space_map {
 	bitstr_t *avail_bitmap;
 	int next;	/* next record, by time, zero termination */
 } node_space_map_t;
+
+/* Pending job to be tested by a backfill cycle */
+typedef struct bf_job {
+	job_queue_rec_t rec;	/* job and partition */
+	uint32_t job_id;	/* rec.job_ptr is only valid if this job is
+				 * found by find_job_record() */
+	uint32_t priority;	/* job priority at cycle start */
+} bf_job_t;
+
+/* Reservation made by a backfill cycle for a pending job */
+typedef struct bf_resv {
+	uint32_t job_id;
+	time_t start_time;
+	time_t end_reserve;
+	bitstr_t *avail_bitmap;	/* nodes not reserved for the job */
+} bf_resv_t;
+
+/*
+ * A backfill cycle tests each pending job in priority order. Its state (the
+ * cursor into the job queue and the reservations made for pending jobs)
+ * persists when locks are yielded and from one backfill pass to the next,
+ * so a cycle continues where it left off rather than starting over. The
+ * node_space timeline is rebuilt from the reservations whenever job or node
+ * state changes, dropping reservations for jobs which are no longer
+ * pending. A change to partitions or the configuration starts a new cycle,
+ * as does a job submitted during the cycle with a higher priority than the
+ * next job to be tested. Other changes in job priority are reflected once
+ * the cycle is BACKFILL_CYCLE_AGE seconds old, when a new cycle starts.
+ */
+static struct {
+	bf_job_t *job_array;	/* pending jobs in priority order */
+	int job_cnt;		/* records in job_array */
+	int job_inx;		/* next job_array record to test */
+	List resv_list;		/* bf_resv_t records for this cycle */
+	node_space_map_t *node_space;	/* built from resv_list */
+	int node_space_recs;	/* records used in node_space */
+	int node_space_size;	/* records allocated in node_space */
+	time_t cycle_start;	/* time cycle began */
+	time_t job_update;	/* last_job_update reflected in node_space */
+	time_t node_update;	/* last_node_update reflected in node_space */
+	time_t part_update;	/* last_part_update at cycle start */
+	int tested;		/* jobs tested with _try_sched() */
+	int yields;		/* times locks were yielded */
+} bf_cycle;
+
 int backfilled_jobs = 0;
 
 /*********************** local variables *********************/
@@ -117,6 +173,13 @@ static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
 			     node_space_map_t *node_space,
 			     int *node_space_recs);
 static int  _attempt_backfill(void);
+static void _bf_build_node_space(time_t now);
+static void _bf_cycle_end(void);
+static bool _bf_cycle_resume(void);
+static bool _bf_cycle_start(void);
+static bool _bf_job_part_valid(struct job_record *job_ptr,
+			       struct part_record *part_ptr);
+static void _bf_resv_del(void *x);
 static bool _job_is_completing(void);
 static void _load_config(void);
 static bool _many_pending_rpcs(void);
@@ -398,7 +461,8 @@ extern void *backfill_agent(void *args)
 		wait_time = difftime(now, last_backfill_time);
 		if ((wait_time < backfill_interval) ||
 		    _job_is_completing() || _many_pending_rpcs() ||
-		    !avail_front_end() || !_more_work(last_backfill_time))
+		    !avail_front_end() ||
+		    (!bf_cycle.job_array && !_more_work(last_backfill_time)))
 			continue;
 
 		START_TIMER;
@@ -410,41 +474,247 @@ extern void *backfill_agent(void *args)
 		if (debug_flags & DEBUG_FLAG_BACKFILL)
 			info("backfill: completed, %s", TIME_STR);
 	}
+	/* Free the saved state of a suspended cycle */
+	_bf_cycle_end();
 	return NULL;
 }
 
-/* Return non-zero to break the backfill loop if change in job, node or
- * partition state or the backfill scheduler needs to be stopped. */
-static int _yield_locks(void)
+/* Release locks briefly so other threads can run. Return true to suspend
+ * the backfill cycle if the backfill scheduler needs to be stopped or
+ * slurmctld has become busy. The cycle resumes with the next pass. */
+static bool _yield_locks(void)
 {
 	slurmctld_lock_t all_locks = {
 		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
-	time_t job_update, node_update, part_update;
-
-	job_update  = last_job_update;
-	node_update = last_node_update;
-	part_update = last_part_update;
 
+	bf_cycle.yields++;
 	unlock_slurmctld(all_locks);
-	_my_sleep(backfill_interval);
+	_my_sleep(BACKFILL_YIELD_SLEEP);
 	lock_slurmctld(all_locks);
 
-	if ((last_job_update  == job_update)  &&
-	    (last_node_update == node_update) &&
-	    (last_part_update == part_update) &&
-	    (! stop_backfill) && (! config_flag))
-		return 0;
-	else
-		return 1;
+	if (stop_backfill || _many_pending_rpcs())
+		return true;
+	return false;
+}
+
+/* Test if a job can still run in the partition it was queued for */
+static bool _bf_job_part_valid(struct job_record *job_ptr,
+			       struct part_record *part_ptr)
+{
+	ListIterator part_iterator;
+	struct part_record *part_ptr2;
+	bool valid = false;
+
+	if (job_ptr->part_ptr_list == NULL)
+		return (job_ptr->part_ptr == part_ptr);
+
+	part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+	if (part_iterator == NULL)
+		fatal("list_iterator_create: malloc failure");
+	while ((part_ptr2 = (struct part_record *) list_next(part_iterator))) {
+		if (part_ptr2 == part_ptr) {
+			valid = true;
+			break;
+		}
+	}
+	list_iterator_destroy(part_iterator);
+	return valid;
+}
+
+static void _bf_resv_del(void *x)
+{
+	bf_resv_t *resv_ptr = (bf_resv_t *) x;
+
+	if (resv_ptr) {
+		FREE_NULL_BITMAP(resv_ptr->avail_bitmap);
+		xfree(resv_ptr);
+	}
+}
+
+/* Build the node_space timeline starting now from the cycle's reservations
+ * for jobs which are still pending */
+static void _bf_build_node_space(time_t now)
+{
+	node_space_map_t *node_space = bf_cycle.node_space;
+	struct job_record *job_ptr;
+	ListIterator resv_iterator;
+	bf_resv_t *resv_ptr;
+	int i;
+
+	for (i = 0; i < bf_cycle.node_space_recs; i++)
+		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
+
+	node_space[0].begin_time = now;
+	node_space[0].end_time = now + backfill_window;
+	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
+	node_space[0].next = 0;
+	bf_cycle.node_space_recs = 1;
+
+	resv_iterator = list_iterator_create(bf_cycle.resv_list);
+	if (resv_iterator == NULL)
+		fatal("list_iterator_create: malloc failure");
+	while ((resv_ptr = (bf_resv_t *) list_next(resv_iterator))) {
+		job_ptr = find_job_record(resv_ptr->job_id);
+		if (!job_ptr || !IS_JOB_PENDING(job_ptr) ||
+		    (resv_ptr->end_reserve <= now)) {
+			list_delete_item(resv_iterator);
+			continue;
+		}
+		/* Each reservation adds at most two records. Times moved up to
+		 * now can split records which were shared before. */
+		if ((bf_cycle.node_space_recs + 2) > bf_cycle.node_space_size) {
+			bf_cycle.node_space_size *= 2;
+			xrealloc(bf_cycle.node_space, sizeof(node_space_map_t) *
+				 bf_cycle.node_space_size);
+			node_space = bf_cycle.node_space;
+		}
+		_add_reservation(MAX(resv_ptr->start_time, now),
+				 resv_ptr->end_reserve, resv_ptr->avail_bitmap,
+				 node_space, &bf_cycle.node_space_recs);
+	}
+	list_iterator_destroy(resv_iterator);
+
+	bf_cycle.job_update  = last_job_update;
+	bf_cycle.node_update = last_node_update;
+}
+
+/* Begin a new backfill cycle. RET false if there are no jobs to test */
+static bool _bf_cycle_start(void)
+{
+	job_queue_view_t *job_queue;
+	int i = 0, inx;
+
+	job_queue = build_job_queue_view(true);
+	if (job_queue->count <= 1) {
+		debug("backfill: no jobs to backfill");
+		free_job_queue_view(job_queue);
+		return false;
+	}
+
+	/* Order the jobs once rather than finding the highest priority job
+	 * remaining each time a job is tested */
+	bf_cycle.job_cnt = job_queue->count;
+	bf_cycle.job_array = xmalloc(sizeof(bf_job_t) * bf_cycle.job_cnt);
+	while ((inx = job_queue_view_next(job_queue)) >= 0) {
+		bf_cycle.job_array[i].rec.job_ptr  = job_queue->job_ptr[inx];
+		bf_cycle.job_array[i].rec.part_ptr = job_queue->part_ptr[inx];
+		bf_cycle.job_array[i].job_id = job_queue->job_id[inx];
+		bf_cycle.job_array[i].priority =
+			job_queue->job_ptr[inx]->priority;
+		i++;
+	}
+	free_job_queue_view(job_queue);
+	bf_cycle.job_inx = 0;
+
+	bf_cycle.resv_list = list_create(_bf_resv_del);
+	if (bf_cycle.resv_list == NULL)
+		fatal("list_create: malloc failure");
+	bf_cycle.node_space_size = max_backfill_job_cnt + 3;
+	bf_cycle.node_space = xmalloc(sizeof(node_space_map_t) *
+				      bf_cycle.node_space_size);
+	bf_cycle.node_space_recs = 0;
+	bf_cycle.cycle_start = time(NULL);
+	bf_cycle.part_update = last_part_update;
+	bf_cycle.tested = 0;
+	bf_cycle.yields = 0;
+	_bf_build_node_space(bf_cycle.cycle_start);
+	if (debug_flags & DEBUG_FLAG_BACKFILL)
+		_dump_node_space_table(bf_cycle.node_space);
+
+	return true;
+}
+
+/* Test if the backfill cycle's job order is out of date: the cycle is over
+ * BACKFILL_CYCLE_AGE seconds old or a job submitted since it began outranks
+ * the next job to be tested */
+static bool _bf_cycle_stale(time_t now)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	uint32_t next_prio;
+	bool stale = false;
+
+	if (difftime(now, bf_cycle.cycle_start) >= BACKFILL_CYCLE_AGE)
+		return true;
+	if ((last_job_update == bf_cycle.job_update) ||
+	    (bf_cycle.job_inx >= bf_cycle.job_cnt))
+		return false;
+
+	next_prio = bf_cycle.job_array[bf_cycle.job_inx].priority;
+	job_iterator = list_iterator_create(job_list);
+	if (job_iterator == NULL)
+		fatal("list_iterator_create: malloc failure");
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (IS_JOB_PENDING(job_ptr) && job_ptr->details &&
+		    (job_ptr->details->submit_time > bf_cycle.cycle_start) &&
+		    (job_ptr->priority > next_prio)) {
+			stale = true;
+			break;
+		}
+	}
+	list_iterator_destroy(job_iterator);
+	return stale;
+}
+
+/* Update the backfill cycle's state after locks were released.
+ * RET false if the cycle was ended and must be started over */
+static bool _bf_cycle_resume(void)
+{
+	time_t now = time(NULL);
+
+	if ((last_part_update != bf_cycle.part_update) || config_flag) {
+		debug("backfill: partitions or configuration changed, "
+		      "starting over");
+		_bf_cycle_end();
+		return false;
+	}
+	if (_bf_cycle_stale(now)) {
+		debug("backfill: job priorities changed, starting over");
+		_bf_cycle_end();
+		return false;
+	}
+	if ((last_job_update  != bf_cycle.job_update) ||
+	    (last_node_update != bf_cycle.node_update)) {
+		_bf_build_node_space(now);
+		if (debug_flags & DEBUG_FLAG_BACKFILL)
+			_dump_node_space_table(bf_cycle.node_space);
+	}
+	return true;
+}
+
+/* Free the backfill cycle's state */
+static void _bf_cycle_end(void)
+{
+	int i;
+
+	if (bf_cycle.job_array == NULL)
+		return;
+
+	if (debug_flags & DEBUG_FLAG_BACKFILL) {
+		info("backfill: cycle reached %d of %d jobs, tested %d in %ld "
+		     "seconds with %d lock yields", bf_cycle.job_inx,
+		     bf_cycle.job_cnt, bf_cycle.tested,
+		     (long) difftime(time(NULL), bf_cycle.cycle_start),
+		     bf_cycle.yields);
+	}
+	for (i = 0; i < bf_cycle.node_space_recs; i++)
+		FREE_NULL_BITMAP(bf_cycle.node_space[i].avail_bitmap);
+	xfree(bf_cycle.node_space);
+	bf_cycle.node_space_recs = 0;
+	list_destroy(bf_cycle.resv_list);
+	bf_cycle.resv_list = NULL;
+	xfree(bf_cycle.job_array);
+	bf_cycle.job_cnt = 0;
+	bf_cycle.job_inx = 0;
 }
 
 static int _attempt_backfill(void)
 {
 	bool filter_root = false;
-	List job_queue;
-	job_queue_rec_t *job_queue_rec;
+	bf_job_t *bf_job_ptr;
+	bf_resv_t *resv_ptr;
 	slurmdb_qos_rec_t *qos_ptr = NULL;
-	int i, j, node_space_recs;
+	int j;
 	struct job_record *job_ptr;
 	struct part_record *part_ptr;
 	uint32_t end_time, end_reserve;
@@ -454,7 +724,7 @@ static int _attempt_backfill(void)
 	time_t now = time(NULL), sched_start, later_start, start_res;
 	node_space_map_t *node_space;
 	static int sched_timeout = 0;
-	int this_sched_timeout = 0, rc = 0;
+	int rc = 0;
 
 	sched_start = now;
 	if (sched_timeout == 0) {
@@ -462,7 +732,6 @@ static int _attempt_backfill(void)
 		sched_timeout = MAX(sched_timeout, 1);
 		sched_timeout = MIN(sched_timeout, 10);
 	}
-	this_sched_timeout = sched_timeout;
 
 #ifdef HAVE_CRAY
 	/*
@@ -479,30 +748,39 @@ static int _attempt_backfill(void)
 	if (slurm_get_root_filter())
 		filter_root = true;
 
-	job_queue = build_job_queue(true);
-	if (list_count(job_queue) <= 1) {
-		debug("backfill: no jobs to backfill");
-		list_destroy(job_queue);
+	if (bf_cycle.job_array) {
+		debug("backfill: resuming cycle at job %d of %d",
+		      bf_cycle.job_inx, bf_cycle.job_cnt);
+		if (!_bf_cycle_resume() && !_bf_cycle_start())
+			return 0;
+	} else if (!_bf_cycle_start())
 		return 0;
-	}
+	node_space = bf_cycle.node_space;
 
-	node_space = xmalloc(sizeof(node_space_map_t) *
-			     (max_backfill_job_cnt + 3));
-	node_space[0].begin_time = sched_start;
-	node_space[0].end_time = sched_start + backfill_window;
-	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
-	node_space[0].next = 0;
-	node_space_recs = 1;
-	if (debug_flags & DEBUG_FLAG_BACKFILL)
-		_dump_node_space_table(node_space);
-
-	while ((job_queue_rec = (job_queue_rec_t *)
-				list_pop_bottom(job_queue, sort_job_queue2))) {
-		job_ptr  = job_queue_rec->job_ptr;
-		part_ptr = job_queue_rec->part_ptr;
-		xfree(job_queue_rec);
-		if (!IS_JOB_PENDING(job_ptr))
+	while (bf_cycle.job_inx < bf_cycle.job_cnt) {
+		if ((time(NULL) - sched_start) >= sched_timeout) {
+			debug("backfill: loop taking too long, yielding locks");
+			if (_yield_locks()) {
+				debug("backfill: suspending cycle at job %d "
+				      "of %d", bf_cycle.job_inx,
+				      bf_cycle.job_cnt);
+				break;
+			}
+			if (!_bf_cycle_resume()) {
+				rc = 1;	/* start a new cycle */
+				break;
+			}
+			node_space = bf_cycle.node_space;
+			sched_start = now = time(NULL);
+		}
+
+		bf_job_ptr = &bf_cycle.job_array[bf_cycle.job_inx++];
+		job_ptr = find_job_record(bf_job_ptr->job_id);
+		part_ptr = bf_job_ptr->rec.part_ptr;
+		if (!job_ptr || !IS_JOB_PENDING(job_ptr))
 			continue;	/* started in other partition */
+		if (!_bf_job_part_valid(job_ptr, part_ptr))
+			continue;	/* partition changed */
 		job_ptr->part_ptr = part_ptr;
 
 		if (debug_flags & DEBUG_FLAG_BACKFILL)
@@ -602,10 +880,8 @@ static int _attempt_backfill(void)
 		}
 
 		if (job_ptr->details->exc_node_bitmap) {
-			bit_not(job_ptr->details->exc_node_bitmap);
-			bit_and(avail_bitmap,
-				job_ptr->details->exc_node_bitmap);
-			bit_not(job_ptr->details->exc_node_bitmap);
+			bit_and_not(avail_bitmap,
+				    job_ptr->details->exc_node_bitmap);
 		}
 
 		/* Test if insufficient nodes remain OR
@@ -629,20 +905,10 @@ static int _attempt_backfill(void)
 		resv_bitmap = bit_copy(avail_bitmap);
 		bit_not(resv_bitmap);
 
-		if ((time(NULL) - sched_start) >= this_sched_timeout) {
-			debug("backfill: loop taking too long, yielding locks");
-			if (_yield_locks()) {
-				debug("backfill: system state changed, "
-				      "breaking out");
-				rc = 1;
-				break;
-			} else {
-				this_sched_timeout += sched_timeout;
-			}
-		}
 		/* this is the time consuming operation */
 		debug2("backfill: entering _try_sched for job %u.",
 		       job_ptr->job_id);
+		bf_cycle.tested++;
 		j = _try_sched(job_ptr, &avail_bitmap,
 			       min_nodes, max_nodes, req_nodes);
 		debug2("backfill: finished _try_sched for job %u.",
@@ -656,7 +922,8 @@ static int _attempt_backfill(void)
 
 		if (start_res > job_ptr->start_time) {
 			job_ptr->start_time = start_res;
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
+			mark_job_state_dirty(job_ptr);
 		}
 		if (job_ptr->start_time <= now) {
 			int rc = _start_job(job_ptr, resv_bitmap);
@@ -681,6 +948,7 @@ static int _attempt_backfill(void)
 				/* Planned to start job, but something bad
 				 * happended. */
 				job_ptr->start_time = 0;	
+				_bf_cycle_end();
 				break;
 			} else {
 				/* Started this job, move to next one */
@@ -701,8 +969,9 @@ static int _attempt_backfill(void)
 			continue;
 		}
 
-		if (node_space_recs >= max_backfill_job_cnt) {
+		if (bf_cycle.node_space_recs >= max_backfill_job_cnt) {
 			/* Already have too many jobs to deal with */
+			_bf_cycle_end();
 			break;
 		}
 
@@ -725,20 +994,22 @@ static int _attempt_backfill(void)
 			continue;
 		bit_not(avail_bitmap);
 		_add_reservation(job_ptr->start_time, end_reserve,
-				 avail_bitmap, node_space, &node_space_recs);
+				 avail_bitmap, node_space,
+				 &bf_cycle.node_space_recs);
+		resv_ptr = xmalloc(sizeof(bf_resv_t));
+		resv_ptr->job_id = job_ptr->job_id;
+		resv_ptr->start_time = job_ptr->start_time;
+		resv_ptr->end_reserve = end_reserve;
+		resv_ptr->avail_bitmap = bit_copy(avail_bitmap);
+		list_append(bf_cycle.resv_list, resv_ptr);
 		if (debug_flags & DEBUG_FLAG_BACKFILL)
 			_dump_node_space_table(node_space);
 	}
 	FREE_NULL_BITMAP(avail_bitmap);
 	FREE_NULL_BITMAP(resv_bitmap);
 
-	for (i=0; ; ) {
-		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
-		if ((i = node_space[i].next) == 0)
-			break;
-	}
-	xfree(node_space);
-	list_destroy(job_queue);
+	if (bf_cycle.job_array && (bf_cycle.job_inx >= bf_cycle.job_cnt))
+		_bf_cycle_end();
 	return rc;
 }
 
@@ -760,7 +1031,8 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
 	job_ptr->details->exc_node_bitmap = orig_exc_nodes;
 	if (rc == SLURM_SUCCESS) {
 		/* job initiated */
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
 		info("backfill: Started JobId=%u on %s",
 		     job_ptr->job_id, job_ptr->nodes);
 		if (job_ptr->batch_flag == 0)
@@ -132,8 +132,8 @@ static void _load_config(void)
 static void _compute_start_times(void)
 {
 	int j, rc = SLURM_SUCCESS, job_cnt = 0;
-	List job_queue;
-	job_queue_rec_t *job_queue_rec;
+	int inx;
+	job_queue_view_t *job_queue;
 	List preemptee_candidates = NULL;
 	struct job_record *job_ptr;
 	struct part_record *part_ptr;
@@ -146,12 +146,10 @@ static void _compute_start_times(void)
 	alloc_bitmap = bit_alloc(node_record_count);
 	if (alloc_bitmap == NULL)
 		fatal("bit_alloc: malloc failure");
-	job_queue = build_job_queue(true);
-	while ((job_queue_rec = (job_queue_rec_t *) 
-				list_pop_bottom(job_queue, sort_job_queue2))) {
-		job_ptr  = job_queue_rec->job_ptr;
-		part_ptr = job_queue_rec->part_ptr;
-		xfree(job_queue_rec);
+	job_queue = build_job_queue_view(true);
+	while ((inx = job_queue_view_next(job_queue)) >= 0) {
+		job_ptr  = job_queue->job_ptr[inx];
+		part_ptr = job_queue->part_ptr[inx];
 		if (part_ptr != job_ptr->part_ptr)
 			continue;	/* Only test one partition */
 
@@ -190,7 +188,8 @@ static void _compute_start_times(void)
 				       min_nodes, max_nodes, req_nodes,
 				       SELECT_MODE_WILL_RUN,
 				       preemptee_candidates, NULL);
-		last_job_update = now;
+		last_job_update = job_ptr->last_update = now;
+		mark_job_state_dirty(job_ptr);
 
 		if (job_ptr->time_limit == INFINITE)
 			time_limit = 365 * 24 * 60 * 60;
@@ -214,7 +213,7 @@ static void _compute_start_times(void)
 			break;
 		}
 	}
-	list_destroy(job_queue);
+	free_job_queue_view(job_queue);
 	FREE_NULL_BITMAP(alloc_bitmap);
 }
 
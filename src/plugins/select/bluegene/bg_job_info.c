@@ -123,6 +123,9 @@ extern int set_select_jobinfo(select_jobinfo_t *jobinfo,
 
 	xassert(jobinfo);
 
+	/* also called directly by this plugin, not only through
+	 * select_g_select_jobinfo_set() */
+	select_jobinfo_changed();
 	if (jobinfo->magic != JOBINFO_MAGIC) {
 		error("set_select_jobinfo: jobinfo magic bad");
 		return SLURM_ERROR;
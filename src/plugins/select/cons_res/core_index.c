@@ -0,0 +1,343 @@
+/*****************************************************************************\
+ *  core_index.c - incrementally maintained index of free cores and memory
+ *	for the select/cons_res plugin
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <string.h>
+
+#include "core_index.h"
+
+struct cr_index {
+	struct part_res_record *part_ptr;	/* indexed partition data */
+	struct node_use_record *node_usage;	/* indexed node usage */
+	uint32_t  node_cnt;
+	uint32_t  leaf_cnt;	/* power of two >= node_cnt */
+	uint16_t *core_use;	/* count of jobs using each core */
+	uint16_t *node_free_cores;	/* count of idle cores per node */
+	uint16_t *tree_cpus;	/* max idle CPUs in each node range */
+	uint32_t *tree_mem;	/* max free memory in each node range */
+	struct cr_index *next;
+};
+
+/* The index of the global state followed by those of its copies */
+static struct cr_index *index_list = NULL;
+
+/* Return the index of the given node usage data or NULL if not indexed */
+static struct cr_index *_find_index(struct node_use_record *node_usage)
+{
+	struct cr_index *idx;
+
+	for (idx = index_list; idx; idx = idx->next) {
+		if (idx->node_usage == node_usage)
+			return idx;
+	}
+	return NULL;
+}
+
+static void _free_index(struct cr_index *idx)
+{
+	xfree(idx->core_use);
+	xfree(idx->node_free_cores);
+	xfree(idx->tree_cpus);
+	xfree(idx->tree_mem);
+	xfree(idx);
+}
+
+/* Recompute a node's leaf of the summary tree and its ancestors */
+static void _update_leaf(struct cr_index *idx, int node_inx)
+{
+	uint32_t k, alloc_mem, real_mem, mem;
+	uint16_t cpus;
+
+	cpus = idx->node_free_cores[node_inx] *
+	       select_node_record[node_inx].vpus;
+	real_mem  = select_node_record[node_inx].real_memory;
+	alloc_mem = idx->node_usage[node_inx].alloc_memory;
+	if (alloc_mem < real_mem)
+		mem = real_mem - alloc_mem;
+	else
+		mem = 0;
+
+	k = idx->leaf_cnt + node_inx;
+	idx->tree_cpus[k] = cpus;
+	idx->tree_mem[k]  = mem;
+	for (k >>= 1; k > 0; k >>= 1) {
+		cpus = MAX(idx->tree_cpus[2*k], idx->tree_cpus[2*k+1]);
+		mem  = MAX(idx->tree_mem[2*k],  idx->tree_mem[2*k+1]);
+		if ((idx->tree_cpus[k] == cpus) && (idx->tree_mem[k] == mem))
+			break;	/* no change to propagate */
+		idx->tree_cpus[k] = cpus;
+		idx->tree_mem[k]  = mem;
+	}
+}
+
+/* Add "change" (+1 or -1) to the use count of each core allocated to the
+ * job on nodes first_inx through last_inx */
+static void _change_job_cores(struct cr_index *idx, struct job_resources *job,
+			      int first_inx, int last_inx, int change)
+{
+	int i, c, first_bit, last_bit;
+	uint32_t core_begin, job_bit_inx = 0;
+
+	if (!idx || !job || !job->node_bitmap || !job->core_bitmap)
+		return;
+
+	first_bit = bit_ffs(job->node_bitmap);
+	if (first_bit == -1)
+		return;
+	last_bit = bit_fls(job->node_bitmap);
+	if (last_bit > last_inx)
+		last_bit = last_inx;
+	for (i = first_bit; i <= last_bit; i++) {
+		if (!bit_test(job->node_bitmap, i))
+			continue;
+		if (i < first_inx) {
+			job_bit_inx += cr_node_num_cores[i];
+			continue;
+		}
+		core_begin = cr_get_coremap_offset(i);
+		for (c = 0; c < cr_node_num_cores[i]; c++) {
+			if (!bit_test(job->core_bitmap, job_bit_inx + c))
+				continue;
+			if (change > 0) {
+				if (idx->core_use[core_begin + c]++ == 0)
+					idx->node_free_cores[i]--;
+			} else if (idx->core_use[core_begin + c] == 0) {
+				error("cons_res: core %d of node %s use "
+				      "underflow", c,
+				      select_node_record[i].node_ptr->name);
+			} else if (--idx->core_use[core_begin + c] == 0)
+				idx->node_free_cores[i]++;
+		}
+		job_bit_inx += cr_node_num_cores[i];
+		_update_leaf(idx, i);
+	}
+}
+
+extern void cr_index_init(uint32_t node_cnt)
+{
+	struct cr_index *idx;
+	uint32_t i;
+
+	cr_index_fini();
+	if (node_cnt == 0)
+		return;
+
+	idx = xmalloc(sizeof(struct cr_index));
+	idx->part_ptr   = select_part_record;
+	idx->node_usage = select_node_usage;
+	idx->node_cnt   = node_cnt;
+	for (idx->leaf_cnt = 1; idx->leaf_cnt < node_cnt; idx->leaf_cnt *= 2)
+		;
+	idx->core_use  = xmalloc(cr_get_coremap_offset(node_cnt) *
+				 sizeof(uint16_t));
+	idx->node_free_cores = xmalloc(node_cnt * sizeof(uint16_t));
+	idx->tree_cpus = xmalloc(2 * idx->leaf_cnt * sizeof(uint16_t));
+	idx->tree_mem  = xmalloc(2 * idx->leaf_cnt * sizeof(uint32_t));
+	for (i = 0; i < node_cnt; i++) {
+		idx->node_free_cores[i] = cr_node_num_cores[i];
+		_update_leaf(idx, i);
+	}
+	index_list = idx;
+}
+
+extern void cr_index_fini(void)
+{
+	struct cr_index *idx;
+
+	while ((idx = index_list)) {
+		index_list = idx->next;
+		_free_index(idx);
+	}
+}
+
+extern void cr_index_dup(struct node_use_record *orig_usage,
+			 struct part_res_record *new_part,
+			 struct node_use_record *new_usage)
+{
+	struct cr_index *orig, *idx;
+	uint32_t core_cnt;
+
+	if (!(orig = _find_index(orig_usage)) || !new_part || !new_usage)
+		return;
+
+	core_cnt = cr_get_coremap_offset(orig->node_cnt);
+	idx = xmalloc(sizeof(struct cr_index));
+	idx->part_ptr   = new_part;
+	idx->node_usage = new_usage;
+	idx->node_cnt   = orig->node_cnt;
+	idx->leaf_cnt   = orig->leaf_cnt;
+	idx->core_use   = xmalloc(core_cnt * sizeof(uint16_t));
+	memcpy(idx->core_use, orig->core_use, core_cnt * sizeof(uint16_t));
+	idx->node_free_cores = xmalloc(idx->node_cnt * sizeof(uint16_t));
+	memcpy(idx->node_free_cores, orig->node_free_cores,
+	       idx->node_cnt * sizeof(uint16_t));
+	idx->tree_cpus = xmalloc(2 * idx->leaf_cnt * sizeof(uint16_t));
+	memcpy(idx->tree_cpus, orig->tree_cpus,
+	       2 * idx->leaf_cnt * sizeof(uint16_t));
+	idx->tree_mem  = xmalloc(2 * idx->leaf_cnt * sizeof(uint32_t));
+	memcpy(idx->tree_mem, orig->tree_mem,
+	       2 * idx->leaf_cnt * sizeof(uint32_t));
+
+	/* keep the global index at the head of the list */
+	idx->next  = orig->next;
+	orig->next = idx;
+}
+
+extern void cr_index_free(struct node_use_record *node_usage)
+{
+	struct cr_index **prev, *idx;
+
+	for (prev = &index_list; (idx = *prev); prev = &idx->next) {
+		if (idx->node_usage == node_usage) {
+			*prev = idx->next;
+			_free_index(idx);
+			return;
+		}
+	}
+}
+
+extern bool cr_index_valid(struct part_res_record *cr_part_ptr,
+			   struct node_use_record *node_usage,
+			   uint32_t node_cnt)
+{
+	struct cr_index *idx = _find_index(node_usage);
+
+	if (!idx || (idx->node_cnt != node_cnt) ||
+	    (idx->part_ptr != cr_part_ptr))
+		return false;
+	return true;
+}
+
+extern void cr_index_add_job(struct node_use_record *node_usage,
+			     struct job_resources *job)
+{
+	struct cr_index *idx = _find_index(node_usage);
+
+	if (idx)
+		_change_job_cores(idx, job, 0, idx->node_cnt - 1, 1);
+}
+
+extern void cr_index_rm_job(struct node_use_record *node_usage,
+			    struct job_resources *job)
+{
+	struct cr_index *idx = _find_index(node_usage);
+
+	if (idx)
+		_change_job_cores(idx, job, 0, idx->node_cnt - 1, -1);
+}
+
+extern void cr_index_rm_job_node(struct node_use_record *node_usage,
+				 struct job_resources *job, int node_inx)
+{
+	struct cr_index *idx = _find_index(node_usage);
+
+	if (idx)
+		_change_job_cores(idx, job, node_inx, node_inx, -1);
+}
+
+extern void cr_index_update_node(struct node_use_record *node_usage,
+				 int node_inx)
+{
+	struct cr_index *idx = _find_index(node_usage);
+
+	if (!idx || (node_inx < 0) || (node_inx >= idx->node_cnt))
+		return;
+	_update_leaf(idx, node_inx);
+}
+
+/* Set in cand_map the nodes under tree element k which satisfy the limits */
+static void _filter_tree(struct cr_index *idx, bitstr_t *cand_map, uint32_t k,
+			 uint16_t min_cpus, uint32_t min_mem)
+{
+	if ((idx->tree_cpus[k] < min_cpus) || (idx->tree_mem[k] < min_mem))
+		return;
+	if (k >= idx->leaf_cnt) {
+		bit_set(cand_map, k - idx->leaf_cnt);
+		return;
+	}
+	_filter_tree(idx, cand_map, 2*k,   min_cpus, min_mem);
+	_filter_tree(idx, cand_map, 2*k+1, min_cpus, min_mem);
+}
+
+extern void cr_index_filter(struct node_use_record *node_usage,
+			    bitstr_t *node_map, uint16_t min_cpus,
+			    uint32_t min_mem)
+{
+	struct cr_index *idx = _find_index(node_usage);
+	bitstr_t *cand_map;
+
+	if (!idx || (bit_size(node_map) != idx->node_cnt))
+		return;
+
+	cand_map = bit_alloc(idx->node_cnt);
+	if (cand_map == NULL)
+		fatal("bit_alloc: malloc failure");
+	/* Leaves past node_cnt are zero, so min_cpus of at least one
+	 * keeps them out of cand_map */
+	_filter_tree(idx, cand_map, 1, MAX(min_cpus, 1), min_mem);
+	bit_and(node_map, cand_map);
+	FREE_NULL_BITMAP(cand_map);
+}
+
+extern void cr_index_free_cores(struct node_use_record *node_usage,
+				bitstr_t *node_map, bitstr_t *core_map)
+{
+	struct cr_index *idx = _find_index(node_usage);
+	int i, first_bit, last_bit;
+	uint32_t c, core_end;
+
+	if (!idx)
+		return;
+
+	first_bit = bit_ffs(node_map);
+	if (first_bit == -1)
+		return;
+	last_bit = bit_fls(node_map);
+	for (i = first_bit; i <= last_bit; i++) {
+		if (!bit_test(node_map, i) || (idx->node_free_cores[i] == 0))
+			continue;
+		core_end = cr_get_coremap_offset(i + 1);
+		for (c = cr_get_coremap_offset(i); c < core_end; c++) {
+			if (idx->core_use[c] == 0)
+				bit_set(core_map, c);
+		}
+	}
+}
@@ -0,0 +1,117 @@
+/*****************************************************************************\
+ *  core_index.h - incrementally maintained index of free cores and memory
+ *	for the select/cons_res plugin
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _CR_CORE_INDEX_H
+#define _CR_CORE_INDEX_H
+
+#include "select_cons_res.h"
+
+/*
+ * The core index tracks, for every core in the cluster, how many jobs in
+ * select_part_record rows are using it and, for every node, the number of
+ * CPUs on cores which no job uses and the memory which no job has reserved.
+ * A summary tree over node ranges holds the maximum free CPU and memory
+ * counts of each range, so that nodes able to satisfy a per-node request
+ * can be found without examining the other nodes. The index is updated in
+ * time proportional to the size of a job as jobs are added and removed.
+ *
+ * An index describes one pair of partition and node usage data and is
+ * found by its node usage array. The global data is indexed from
+ * cr_index_init(), the copies used to simulate future resource
+ * availability get a copy of it with cr_index_dup(). Updates for node
+ * usage data without an index are ignored.
+ */
+
+/* cr_index_init - (re)build an empty index of select_part_record and
+ *	select_node_usage for the given node count, all cores idle and
+ *	memory as reported by select_node_usage. Frees all other indexes. */
+extern void cr_index_init(uint32_t node_cnt);
+
+/* cr_index_fini - free all index data */
+extern void cr_index_fini(void);
+
+/* cr_index_dup - index new_part and new_usage, copies of the data indexed
+ *	for orig_usage, with a copy of that index */
+extern void cr_index_dup(struct node_use_record *orig_usage,
+			 struct part_res_record *new_part,
+			 struct node_use_record *new_usage);
+
+/* cr_index_free - free the index of node_usage, call before freeing a copy
+ *	made for cr_index_dup() */
+extern void cr_index_free(struct node_use_record *node_usage);
+
+/* cr_index_valid - return true if an index describes the given partition
+ *	and node usage data */
+extern bool cr_index_valid(struct part_res_record *cr_part_ptr,
+			   struct node_use_record *node_usage,
+			   uint32_t node_cnt);
+
+/* cr_index_add_job - record the job's cores as in use */
+extern void cr_index_add_job(struct node_use_record *node_usage,
+			     struct job_resources *job);
+
+/* cr_index_rm_job - record the job's cores as no longer in use */
+extern void cr_index_rm_job(struct node_use_record *node_usage,
+			    struct job_resources *job);
+
+/* cr_index_rm_job_node - record the job's cores on one node (identified
+ *	by its global node index) as no longer in use. Call before the cores
+ *	are cleared from the job's core_bitmap. */
+extern void cr_index_rm_job_node(struct node_use_record *node_usage,
+				 struct job_resources *job, int node_inx);
+
+/* cr_index_update_node - refresh a node's free memory after a change in
+ *	node_usage[node_inx].alloc_memory */
+extern void cr_index_update_node(struct node_use_record *node_usage,
+				 int node_inx);
+
+/*
+ * cr_index_filter - clear from node_map all nodes with fewer than min_cpus
+ *	CPUs on idle cores or less than min_mem MB of unreserved memory.
+ *	Only nodes which satisfy both limits are examined.
+ */
+extern void cr_index_filter(struct node_use_record *node_usage,
+			    bitstr_t *node_map, uint16_t min_cpus,
+			    uint32_t min_mem);
+
+/* cr_index_free_cores - set in core_map the idle cores of each node set in
+ *	node_map, core_map must be cleared by the caller */
+extern void cr_index_free_cores(struct node_use_record *node_usage,
+				bitstr_t *node_map, bitstr_t *core_map);
+
+#endif /* !_CR_CORE_INDEX_H */
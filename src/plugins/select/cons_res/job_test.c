@@ -101,6 +101,7 @@
 #  endif
 #endif
 
+#include "core_index.h"
 #include "dist_tasks.h"
 #include "job_test.h"
 #include "select_cons_res.h"
@@ -698,6 +699,26 @@ static int _is_node_busy(struct part_res_record *p_ptr, uint32_t node_i,
 }
 
 
+/* Return the memory in MB which the job requires on each node */
+static uint32_t _job_min_mem(struct job_record *job_ptr)
+{
+	uint32_t min_mem;
+
+	if (job_ptr->details->pn_min_memory & MEM_PER_CPU) {
+		uint16_t min_cpus;
+		min_mem = job_ptr->details->pn_min_memory & (~MEM_PER_CPU);
+		min_cpus = MAX(job_ptr->details->ntasks_per_node,
+			       job_ptr->details->pn_min_cpus);
+		min_cpus = MAX(min_cpus, job_ptr->details->cpus_per_task);
+		if (min_cpus > 0)
+			min_mem *= min_cpus;
+	} else {
+		min_mem = job_ptr->details->pn_min_memory;
+	}
+	return min_mem;
+}
+
+
 /*
  * Determine which of these nodes are usable by this job
  *
@@ -726,17 +747,7 @@ static int _verify_node_state(struct part_res_record *cr_part_ptr,
 	uint32_t i, free_mem, gres_cpus, min_mem, size;
 	List gres_list;
 
-	if (job_ptr->details->pn_min_memory & MEM_PER_CPU) {
-		uint16_t min_cpus;
-		min_mem = job_ptr->details->pn_min_memory & (~MEM_PER_CPU);
-		min_cpus = MAX(job_ptr->details->ntasks_per_node,
-			       job_ptr->details->pn_min_cpus);
-		min_cpus = MAX(min_cpus, job_ptr->details->cpus_per_task);
-		if (min_cpus > 0)
-			min_mem *= min_cpus;
-	} else {
-		min_mem = job_ptr->details->pn_min_memory;
-	}
+	min_mem = _job_min_mem(job_ptr);
 	size = bit_size(bitmap);
 	for (i = 0; i < size; i++) {
 		if (!bit_test(bitmap, i))
@@ -1361,7 +1372,7 @@ static int _eval_nodes_topo(struct job_record *job_ptr, bitstr_t *bitmap,
 		bit_or(avail_nodes_bitmap, switches_bitmap[i]);
 		switches_node_cnt[i] = bit_set_count(switches_bitmap[i]);
 		if (req_nodes_bitmap &&
-		    bit_overlap(req_nodes_bitmap, switches_bitmap[i])) {
+		    bit_overlap_any(req_nodes_bitmap, switches_bitmap[i])) {
 			switches_required[i] = 1;
 		}
 	}
@@ -1882,6 +1893,67 @@ static uint16_t *_select_nodes(struct job_record *job_ptr, uint32_t min_nodes,
 }
 
 
+/*
+ * Perform Step 1 of cr_job_test() using the core index: only nodes with
+ * enough idle CPUs and free memory for the job and only their idle cores
+ * are considered, so nodes which cannot be used are never examined.
+ * IN/OUT bitmap - usable nodes, set to the selected nodes on success
+ * OUT free_cores_ptr - the selected cores on success
+ * RET per-node cpu counts on success, NULL if the job can not use only
+ *	idle resources
+ */
+static uint16_t *_select_idle_nodes(struct job_record *job_ptr,
+				    bitstr_t *bitmap, uint32_t min_nodes,
+				    uint32_t max_nodes, uint32_t req_nodes,
+				    uint16_t cr_type,
+				    enum node_cr_state job_node_req,
+				    uint32_t cr_node_cnt,
+				    struct part_res_record *cr_part_ptr,
+				    struct node_use_record *node_usage,
+				    bitstr_t **free_cores_ptr)
+{
+	struct job_details *details_ptr = job_ptr->details;
+	bitstr_t *idle_map, *free_cores;
+	uint16_t min_cpus, *cpu_count;
+	uint32_t min_mem = 0;
+
+	/* per-node requirements which _allocate_cores() and
+	 * _allocate_sockets() can not satisfy with fewer CPUs */
+	min_cpus = MAX(details_ptr->pn_min_cpus, details_ptr->cpus_per_task);
+	if (details_ptr->ntasks_per_node && !details_ptr->overcommit)
+		min_cpus = MAX(min_cpus, details_ptr->ntasks_per_node);
+	if (details_ptr->pn_min_memory && (cr_type & CR_MEMORY))
+		min_mem = _job_min_mem(job_ptr);
+
+	idle_map = bit_copy(bitmap);
+	if (idle_map == NULL)
+		fatal("bit_copy: malloc failure");
+	cr_index_filter(node_usage, idle_map, min_cpus, min_mem);
+	if ((details_ptr->req_node_bitmap &&
+	     !bit_super_set(details_ptr->req_node_bitmap, idle_map)) ||
+	    (_verify_node_state(cr_part_ptr, job_ptr, idle_map, cr_type,
+				node_usage, job_node_req) != SLURM_SUCCESS)) {
+		FREE_NULL_BITMAP(idle_map);
+		return NULL;
+	}
+
+	free_cores = bit_alloc(cr_get_coremap_offset(cr_node_cnt));
+	if (free_cores == NULL)
+		fatal("bit_alloc: malloc failure");
+	cr_index_free_cores(node_usage, idle_map, free_cores);
+	cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes, req_nodes,
+				  idle_map, cr_node_cnt, free_cores,
+				  node_usage, cr_type, false);
+	if (cpu_count) {
+		bit_copybits(bitmap, idle_map);
+		*free_cores_ptr = free_cores;
+	} else
+		FREE_NULL_BITMAP(free_cores);
+	FREE_NULL_BITMAP(idle_map);
+	return cpu_count;
+}
+
+
 /* cr_job_test - does most of the real work for select_p_job_test(), which
  *	includes contiguous selection, load-leveling and max_share logic
  *
@@ -1907,9 +1979,9 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 {
 	int error_code = SLURM_SUCCESS, ll; /* ll = layout array index */
 	uint16_t *layout_ptr = NULL;
-	bitstr_t *orig_map, *avail_cores, *free_cores;
-	bitstr_t *tmpcore = NULL, *reqmap = NULL;
-	bool test_only;
+	bitstr_t *orig_map = NULL, *avail_cores = NULL, *free_cores = NULL;
+	bitstr_t *reqmap = NULL;
+	bool test_only, idle_tested = false;
 	uint32_t c, i, k, n, csize, total_cpus, save_mem = 0;
 	int32_t build_cnt;
 	job_resources_t *job_res;
@@ -1928,16 +2000,6 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 	else	/* SELECT_MODE_RUN_NOW || SELECT_MODE_WILL_RUN  */
 		test_only = false;
 
-	/* check node_state and update the node bitmap as necessary */
-	if (!test_only) {
-		error_code = _verify_node_state(cr_part_ptr, job_ptr,
-						bitmap, cr_type, node_usage,
-						job_node_req);
-		if (error_code != SLURM_SUCCESS) {
-			return error_code;
-		}
-	}
-
 	/* This is the case if -O/--overcommit  is true */
 	if (details_ptr->min_cpus == details_ptr->min_nodes) {
 		struct multi_core_data *mc_ptr = details_ptr->mc_ptr;
@@ -1953,6 +2015,36 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 			details_ptr->min_cpus *= mc_ptr->sockets_per_node;
 	}
 
+	/* check node_state and update the node bitmap as necessary */
+	if (!test_only) {
+		/* Most jobs fit on idle resources (Step 1 below), which the
+		 * core index can find without examining every node */
+		if (cr_index_valid(cr_part_ptr, node_usage, cr_node_cnt)) {
+			cpu_count = _select_idle_nodes(job_ptr, bitmap,
+						       min_nodes, max_nodes,
+						       req_nodes, cr_type,
+						       job_node_req,
+						       cr_node_cnt,
+						       cr_part_ptr, node_usage,
+						       &free_cores);
+			if (cpu_count) {
+				if (select_debug_flags & DEBUG_FLAG_CPU_BIND) {
+					info("cons_res: cr_job_test: test 1 "
+					     "pass - idle resources indexed");
+				}
+				goto alloc_job;
+			}
+			idle_tested = true;
+		}
+
+		error_code = _verify_node_state(cr_part_ptr, job_ptr,
+						bitmap, cr_type, node_usage,
+						job_node_req);
+		if (error_code != SLURM_SUCCESS) {
+			return error_code;
+		}
+	}
+
 	if (select_debug_flags & DEBUG_FLAG_CPU_BIND) {
 		info("cons_res: cr_job_test: evaluating job %u on %u nodes",
 		     job_ptr->job_id, bit_set_count(bitmap));
@@ -2038,21 +2130,24 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 	bit_copybits(free_cores, avail_cores);
 
 	/* remove all existing allocations from free_cores */
-	tmpcore = bit_copy(free_cores);
-	for (p_ptr = cr_part_ptr; p_ptr; p_ptr = p_ptr->next) {
+	for (p_ptr = cr_part_ptr; p_ptr && !idle_tested; p_ptr = p_ptr->next) {
 		if (!p_ptr->row)
 			continue;
 		for (i = 0; i < p_ptr->num_rows; i++) {
 			if (!p_ptr->row[i].row_bitmap)
 				continue;
-			bit_copybits(tmpcore, p_ptr->row[i].row_bitmap);
-			bit_not(tmpcore); /* set bits now "free" resources */
-			bit_and(free_cores, tmpcore);
+			bit_and_not(free_cores, p_ptr->row[i].row_bitmap);
 		}
 	}
-	cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes, req_nodes,
-				  bitmap, cr_node_cnt, free_cores,
-				  node_usage, cr_type, test_only);
+	if (idle_tested) {
+		/* already failed with the core index above */
+		cpu_count = NULL;
+	} else {
+		cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes,
+					  req_nodes, bitmap, cr_node_cnt,
+					  free_cores, node_usage, cr_type,
+					  test_only);
+	}
 	if (cpu_count) {
 		/* job fits! We're done. */
 		if (select_debug_flags & DEBUG_FLAG_CPU_BIND) {
@@ -2102,9 +2197,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 		for (i = 0; i < p_ptr->num_rows; i++) {
 			if (!p_ptr->row[i].row_bitmap)
 				continue;
-			bit_copybits(tmpcore, p_ptr->row[i].row_bitmap);
-			bit_not(tmpcore); /* set bits now "free" resources */
-			bit_and(free_cores, tmpcore);
+			bit_and_not(free_cores, p_ptr->row[i].row_bitmap);
 		}
 	}
 	/* make these changes permanent */
@@ -2141,9 +2234,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 		for (i = 0; i < p_ptr->num_rows; i++) {
 			if (!p_ptr->row[i].row_bitmap)
 				continue;
-			bit_copybits(tmpcore, p_ptr->row[i].row_bitmap);
-			bit_not(tmpcore); /* set bits now "free" resources */
-			bit_and(free_cores, tmpcore);
+			bit_and_not(free_cores, p_ptr->row[i].row_bitmap);
 		}
 	}
 	cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes, req_nodes,
@@ -2170,7 +2261,6 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 	/*** Step 4 ***/
 	/* try to fit the job into an existing row
 	 *
-	 * tmpcore = worker core_bitmap
 	 * free_cores = core_bitmap to be built
 	 * avail_cores = static core_bitmap of all available cores
 	 */
@@ -2204,9 +2294,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *bitmap,
 			break;
 		bit_copybits(bitmap, orig_map);
 		bit_copybits(free_cores, avail_cores);
-		bit_copybits(tmpcore, jp_ptr->row[i].row_bitmap);
-		bit_not(tmpcore);
-		bit_and(free_cores, tmpcore);
+		bit_and_not(free_cores, jp_ptr->row[i].row_bitmap);
 		cpu_count = _select_nodes(job_ptr, min_nodes, max_nodes,
 					  req_nodes, bitmap, cr_node_cnt,
 					  free_cores, node_usage, cr_type,
@@ -2266,7 +2354,6 @@ alloc_job:
 	 */
 	FREE_NULL_BITMAP(orig_map);
 	FREE_NULL_BITMAP(avail_cores);
-	FREE_NULL_BITMAP(tmpcore);
 	if (!cpu_count) {
 		/* we were sent here to cleanup and exit */
 		FREE_NULL_BITMAP(free_cores);
@@ -102,7 +102,9 @@
 #endif
 
 #include "src/common/slurm_xlator.h"
+#include "src/common/timers.h"
 #include "select_cons_res.h"
+#include "core_index.h"
 #include "dist_tasks.h"
 #include "job_test.h"
 
@@ -358,7 +360,9 @@ static struct part_row_data *_dup_row_data(struct part_row_data *orig_row,
 }
 
 
-/* Create a duplicate part_res_record list */
+/* Create a duplicate part_res_record list. The row data is shared with
+ * the original records until _unshare_part_rows() is called for a record,
+ * so the original must not be changed while the duplicate exists. */
 static struct part_res_record *_dup_part_data(struct part_res_record *orig_ptr)
 {
 	struct part_res_record *new_part_ptr, *new_ptr;
@@ -372,8 +376,9 @@ static struct part_res_record *_dup_part_data(struct part_res_record *orig_ptr)
 	while (orig_ptr) {
 		new_ptr->part_ptr = orig_ptr->part_ptr;
 		new_ptr->num_rows = orig_ptr->num_rows;
-		new_ptr->row = _dup_row_data(orig_ptr->row,
-					     orig_ptr->num_rows);
+		new_ptr->row = orig_ptr->row;
+		new_ptr->rows_shared = (orig_ptr->row != NULL);
+		new_ptr->rows_overlap = orig_ptr->rows_overlap;
 		if (orig_ptr->next) {
 			new_ptr->next = xmalloc(sizeof(struct part_res_record));
 			new_ptr = new_ptr->next;
@@ -384,7 +389,20 @@ static struct part_res_record *_dup_part_data(struct part_res_record *orig_ptr)
 }
 
 
-/* Create a duplicate part_res_record list */
+/* Give a duplicate part_res_record its own copy of the row data before
+ * changing it */
+static void _unshare_part_rows(struct part_res_record *p_ptr)
+{
+	if (!p_ptr->rows_shared)
+		return;
+	p_ptr->row = _dup_row_data(p_ptr->row, p_ptr->num_rows);
+	p_ptr->rows_shared = false;
+}
+
+
+/* Create a duplicate node_use_record array. A node's gres state is only
+ * copied if the original has its own, otherwise the duplicate reads the
+ * node's gres_list until _rm_job_from_res() needs to change it. */
 static struct node_use_record *_dup_node_usage(struct node_use_record *orig_ptr)
 {
 	struct node_use_record *new_use_ptr, *new_ptr;
@@ -400,11 +418,11 @@ static struct node_use_record *_dup_node_usage(struct node_use_record *orig_ptr)
 	for (i = 0; i < select_node_cnt; i++) {
 		new_ptr[i].node_state   = orig_ptr[i].node_state;
 		new_ptr[i].alloc_memory = orig_ptr[i].alloc_memory;
-		if (orig_ptr[i].gres_list)
-			gres_list = orig_ptr[i].gres_list;
-		else
-			gres_list = node_record_table_ptr[i].gres_list;
-		new_ptr[i].gres_list = gres_plugin_node_state_dup(gres_list);
+		gres_list = orig_ptr[i].gres_list;
+		if (gres_list) {
+			new_ptr[i].gres_list =
+				gres_plugin_node_state_dup(gres_list);
+		}
 	}
 	return new_use_ptr;
 }
@@ -432,7 +450,7 @@ static void _destroy_part_data(struct part_res_record *this_ptr)
 		this_ptr = this_ptr->next;
 		tmp->part_ptr = NULL;
 
-		if (tmp->row) {
+		if (tmp->row && !tmp->rows_shared) {
 			_destroy_row_data(tmp->row, tmp->num_rows);
 			tmp->row = NULL;
 		}
@@ -486,12 +504,17 @@ static void _create_part_data(void)
 }
 
 
-/* List sort function: sort by the job's expected end time */
-static int _cr_job_list_sort(void *x, void *y)
+/* qsort function: sort job records by expected end time */
+static int _cr_job_end_sort(const void *x, const void *y)
 {
-	struct job_record *job1_ptr = (struct job_record *) x;
-	struct job_record *job2_ptr = (struct job_record *) y;
-	return (int) difftime(job1_ptr->end_time, job2_ptr->end_time);
+	struct job_record *job1_ptr = *(struct job_record **) x;
+	struct job_record *job2_ptr = *(struct job_record **) y;
+
+	if (job1_ptr->end_time < job2_ptr->end_time)
+		return -1;
+	if (job1_ptr->end_time > job2_ptr->end_time)
+		return 1;
+	return 0;
 }
 
 
@@ -545,6 +568,39 @@ static int _can_job_fit_in_row(struct job_resources *job,
 }
 
 
+/* remove the job's cores from the row_bitmap, the job must not overlap any
+ * other job in the row */
+static void _rm_job_from_row_bitmap(struct job_resources *job,
+				    struct part_row_data *r_ptr)
+{
+	int i, c, first_bit, last_bit;
+	uint32_t core_begin, job_bit_inx = 0;
+
+	if (!r_ptr->row_bitmap)
+		return;
+	if (r_ptr->num_jobs == 0) {
+		bit_nclear(r_ptr->row_bitmap, 0,
+			   bit_size(r_ptr->row_bitmap) - 1);
+		return;
+	}
+
+	first_bit = bit_ffs(job->node_bitmap);
+	if (first_bit == -1)
+		return;
+	last_bit = bit_fls(job->node_bitmap);
+	for (i = first_bit; i <= last_bit; i++) {
+		if (!bit_test(job->node_bitmap, i))
+			continue;
+		core_begin = cr_get_coremap_offset(i);
+		for (c = 0; c < cr_node_num_cores[i]; c++) {
+			if (bit_test(job->core_bitmap, job_bit_inx + c))
+				bit_clear(r_ptr->row_bitmap, core_begin + c);
+		}
+		job_bit_inx += cr_node_num_cores[i];
+	}
+}
+
+
 /* helper script for cr_sort_part_rows() */
 static void _swap_rows(struct part_row_data *a, struct part_row_data *b)
 {
@@ -569,7 +625,9 @@ static void _swap_rows(struct part_row_data *a, struct part_row_data *b)
 }
 
 
-/* sort the rows of a partition from "most allocated" to "least allocated" */
+/* sort the rows of a partition from "most allocated" to "least allocated".
+ * The order of rows does not change the partition's allocations, so rows
+ * shared with a duplicate record may be sorted in place. */
 extern void cr_sort_part_rows(struct part_res_record *p_ptr)
 {
 	uint32_t i, j, a, b;
@@ -620,6 +678,7 @@ static void _build_row_bitmaps(struct part_res_record *p_ptr)
 				size = bit_size(this_row->row_bitmap);
 				bit_nclear(this_row->row_bitmap, 0, size-1);
 			}
+			p_ptr->rows_overlap = false;
 			return;
 		}
 
@@ -653,6 +712,7 @@ static void _build_row_bitmaps(struct part_res_record *p_ptr)
 					   size-1);
 			}
 		}
+		p_ptr->rows_overlap = false;
 		return;
 	}
 
@@ -872,6 +932,7 @@ static int _add_job_to_res(struct job_record *job_ptr, int action)
 				continue;	/* node lost by job resizing */
 			select_node_usage[i].alloc_memory +=
 				job->memory_allocated[n];
+			cr_index_update_node(select_node_usage, i);
 			if ((select_node_usage[i].alloc_memory >
 			     select_node_record[i].real_memory)) {
 				error("cons_res: node %s memory is "
@@ -914,7 +975,9 @@ static int _add_job_to_res(struct job_record *job_ptr, int action)
 			      "could not find row for job");
 			/* just add the job to the last row for now */
 			_add_job_to_row(job, &(p_ptr->row[p_ptr->num_rows-1]));
+			p_ptr->rows_overlap = true;
 		}
+		cr_index_add_job(select_node_usage, job);
 		/* update the node state */
 		for (i = 0; i < select_node_cnt; i++) {
 			if (bit_test(job->node_bitmap, i))
@@ -1197,6 +1260,14 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 
 		node_ptr = node_record_table_ptr + i;
 		if (action != 2) {
+			if ((node_usage[i].gres_list == NULL) &&
+			    (node_usage != select_node_usage) &&
+			    job_ptr->gres_list) {
+				/* copy the node's gres state on write */
+				node_usage[i].gres_list =
+					gres_plugin_node_state_dup(
+						node_ptr->gres_list);
+			}
 			if (node_usage[i].gres_list)
 				gres_list = node_usage[i].gres_list;
 			else
@@ -1223,6 +1294,7 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 				node_usage[i].alloc_memory -=
 					job->memory_allocated[n];
 			}
+			cr_index_update_node(node_usage, i);
 		}
 	}
 
@@ -1262,6 +1334,7 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 				       "part %s row %u",
 				       job_ptr->job_id,
 				       p_ptr->part_ptr->name, i);
+				_unshare_part_rows(p_ptr);
 				for (; j < p_ptr->row[i].num_jobs-1; j++) {
 					p_ptr->row[i].job_list[j] =
 						p_ptr->row[i].job_list[j+1];
@@ -1270,14 +1343,22 @@ static int _rm_job_from_res(struct part_res_record *part_record_ptr,
 				p_ptr->row[i].num_jobs -= 1;
 				/* found job - we're done */
 				n = 1;
-				i = p_ptr->num_rows;
 				break;
 			}
+			if (n)
+				break;
 		}
 
 		if (n) {
-			/* job was found and removed, so refresh the bitmaps */
-			_build_row_bitmaps(p_ptr);
+			/* job was found and removed, so refresh the bitmaps.
+			 * A single row without overlapping jobs only needs
+			 * this job's cores cleared, otherwise repack the
+			 * remaining jobs into the rows. */
+			if ((p_ptr->num_rows == 1) && !p_ptr->rows_overlap)
+				_rm_job_from_row_bitmap(job, &(p_ptr->row[i]));
+			else
+				_build_row_bitmaps(p_ptr);
+			cr_index_rm_job(node_usage, job);
 
 			/* Adjust the node_state of all nodes affected by
 			 * the removal of this job. If all cores are now
@@ -1353,6 +1434,8 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 					job_ptr->job_id, node_ptr->name);
 		gres_plugin_node_state_log(gres_list, node_ptr->name);
 
+		if (!IS_JOB_SUSPENDED(job_ptr))
+			cr_index_rm_job_node(node_usage, job, i);
 		job->cpus[n] = 0;
 		job->ncpus = build_job_resources_cpu_array(job);
 		clear_job_resources_node(job, n);
@@ -1365,6 +1448,7 @@ static int _rm_job_from_one_node(struct job_record *job_ptr,
 		} else
 			node_usage[i].alloc_memory -= job->memory_allocated[n];
 		job->memory_allocated[n] = 0;
+		cr_index_update_node(node_usage, i);
 		break;
 	}
 
@@ -1539,6 +1623,7 @@ static int _run_now(struct job_record *job_ptr, bitstr_t *bitmap,
 			FREE_NULL_BITMAP(orig_map);
 			return SLURM_ERROR;
 		}
+		cr_index_dup(select_node_usage, future_part, future_usage);
 
 		job_iterator = list_iterator_create(job_list);
 		if (job_iterator == NULL)
@@ -1591,8 +1676,8 @@ static int _run_now(struct job_record *job_ptr, bitstr_t *bitmap,
 				    (mode != PREEMPT_MODE_CHECKPOINT) &&
 				    (mode != PREEMPT_MODE_CANCEL))
 					continue;
-				if (bit_overlap(bitmap,
-						tmp_job_ptr->node_bitmap) == 0)
+				if (!bit_overlap_any(bitmap,
+						tmp_job_ptr->node_bitmap))
 					continue;
 				list_append(*preemptee_job_list,
 					    tmp_job_ptr);
@@ -1605,6 +1690,7 @@ static int _run_now(struct job_record *job_ptr, bitstr_t *bitmap,
 			}
 		}
 
+		cr_index_free(future_usage);
 		_destroy_part_data(future_part);
 		_destroy_node_data(future_usage, NULL);
 	}
@@ -1623,13 +1709,15 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 {
 	struct part_res_record *future_part;
 	struct node_use_record *future_usage;
-	struct job_record *tmp_job_ptr;
-	List cr_job_list;
+	struct job_record *tmp_job_ptr, **cr_job_array;
 	ListIterator job_iterator, preemptee_iterator;
 	bitstr_t *orig_map;
 	int action, rc = SLURM_ERROR;
+	int i, cr_job_cnt = 0, run_job_cnt = 0, test_cnt = 1;
 	time_t now = time(NULL);
+	DEF_TIMERS;
 
+	START_TIMER;
 	orig_map = bit_copy(bitmap);
 	if (!orig_map)
 		fatal("bit_copy: malloc failure");
@@ -1642,6 +1730,12 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 	if (rc == SLURM_SUCCESS) {
 		FREE_NULL_BITMAP(orig_map);
 		job_ptr->start_time = time(NULL);
+		if (select_debug_flags & DEBUG_FLAG_SELECT_TYPE) {
+			END_TIMER;
+			info("cons_res: _will_run_test: job %u can start now, "
+			     "%d nodes %s", job_ptr->job_id, select_node_cnt,
+			     TIME_STR);
+		}
 		return SLURM_SUCCESS;
 	}
 
@@ -1658,11 +1752,11 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 		FREE_NULL_BITMAP(orig_map);
 		return SLURM_ERROR;
 	}
+	cr_index_dup(select_node_usage, future_part, future_usage);
 
-	/* Build list of running and suspended jobs */
-	cr_job_list = list_create(NULL);
-	if (!cr_job_list)
-		fatal("list_create: memory allocation error");
+	/* Build array of running and suspended jobs */
+	cr_job_array = xmalloc(sizeof(struct job_record *) *
+			       MAX(list_count(job_list), 1));
 	job_iterator = list_iterator_create(job_list);
 	if (job_iterator == NULL)
 		fatal ("memory allocation failure");
@@ -1670,6 +1764,7 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 		if (!IS_JOB_RUNNING(tmp_job_ptr) &&
 		    !IS_JOB_SUSPENDED(tmp_job_ptr))
 			continue;
+		run_job_cnt++;
 		if (tmp_job_ptr->end_time == 0) {
 			error("Job %u has zero end_time", tmp_job_ptr->job_id);
 			continue;
@@ -1686,7 +1781,7 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 			_rm_job_from_res(future_part, future_usage,
 					 tmp_job_ptr, action);
 		} else
-			list_append(cr_job_list, tmp_job_ptr);
+			cr_job_array[cr_job_cnt++] = tmp_job_ptr;
 	}
 	list_iterator_destroy(job_iterator);
 
@@ -1697,6 +1792,7 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 				 req_nodes, SELECT_MODE_WILL_RUN, cr_type,
 				 job_node_req, select_node_cnt, future_part,
 				 future_usage);
+		test_cnt++;
 		if (rc == SLURM_SUCCESS)
 			job_ptr->start_time = now + 1;
 	}
@@ -1704,12 +1800,11 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 	/* Remove the running jobs one at a time from exp_node_cr and try
 	 * scheduling the pending job after each one. */
 	if (rc != SLURM_SUCCESS) {
-		list_sort(cr_job_list, _cr_job_list_sort);
-		job_iterator = list_iterator_create(cr_job_list);
-		if (job_iterator == NULL)
-			fatal ("memory allocation failure");
-		while ((tmp_job_ptr = list_next(job_iterator))) {
+		qsort(cr_job_array, cr_job_cnt, sizeof(struct job_record *),
+		      _cr_job_end_sort);
+		for (i = 0; i < cr_job_cnt; i++) {
 		        int ovrlap;
+			tmp_job_ptr = cr_job_array[i];
 			bit_or(bitmap, orig_map);
 			ovrlap = bit_overlap(bitmap, tmp_job_ptr->node_bitmap);
 			if (ovrlap == 0)	/* job has no usable nodes */
@@ -1723,6 +1818,7 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 					 SELECT_MODE_WILL_RUN, cr_type,
 					 job_node_req, select_node_cnt,
 					 future_part, future_usage);
+			test_cnt++;
 			if (rc == SLURM_SUCCESS) {
 				if (tmp_job_ptr->end_time <= now)
 					job_ptr->start_time = now + 1;
@@ -1732,7 +1828,6 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 				break;
 			}
 		}
-		list_iterator_destroy(job_iterator);
 	}
 
 	if ((rc == SLURM_SUCCESS) && preemptee_job_list &&
@@ -1750,18 +1845,26 @@ static int _will_run_test(struct job_record *job_ptr, bitstr_t *bitmap,
 			fatal ("memory allocation failure");
 		while ((tmp_job_ptr = (struct job_record *)
 			list_next(preemptee_iterator))) {
-			if (bit_overlap(bitmap,
-					tmp_job_ptr->node_bitmap) == 0)
+			if (!bit_overlap_any(bitmap,
+					     tmp_job_ptr->node_bitmap))
 				continue;
 			list_append(*preemptee_job_list, tmp_job_ptr);
 		}
 		list_iterator_destroy(preemptee_iterator);
 	}
 
-	list_destroy(cr_job_list);
+	xfree(cr_job_array);
+	cr_index_free(future_usage);
 	_destroy_part_data(future_part);
 	_destroy_node_data(future_usage, NULL);
 	FREE_NULL_BITMAP(orig_map);
+	if (select_debug_flags & DEBUG_FLAG_SELECT_TYPE) {
+		END_TIMER;
+		info("cons_res: _will_run_test: job %u %s, %d nodes "
+		     "%d running jobs %d tests %s", job_ptr->job_id,
+		     (rc == SLURM_SUCCESS) ? "can start later" : "can not start",
+		     select_node_cnt, run_job_cnt, test_cnt, TIME_STR);
+	}
 	return rc;
 }
 
@@ -1786,6 +1889,7 @@ extern int fini(void)
 	select_node_usage = NULL;
 	_destroy_part_data(select_part_record);
 	select_part_record = NULL;
+	cr_index_fini();
 	xfree(cr_node_num_cores);
 	xfree(cr_node_cores_offset);
 
@@ -1902,6 +2006,7 @@ extern int select_p_node_init(struct node_record *node_ptr, int node_cnt)
 						   node_ptr->gres_list);
 	}
 	_create_part_data();
+	cr_index_init(node_cnt);
 
 	return SLURM_SUCCESS;
 }
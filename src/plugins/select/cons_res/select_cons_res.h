@@ -98,6 +98,11 @@ struct part_res_record {
 	uint16_t num_rows;		/* Number of row_bitmaps */
 	struct part_record *part_ptr;   /* controller part record pointer */
 	struct part_row_data *row;	/* array of rows containing jobs */
+	bool rows_overlap;		/* set if a job was forced into a row
+					 * where it overlaps other jobs, rows
+					 * must then be rebuilt on job removal */
+	bool rows_shared;		/* row array belongs to the record
+					 * this one was copied from */
 };
 
 /* per-node resource data */
@@ -126,6 +131,7 @@ extern uint16_t select_fast_schedule;
 extern struct part_res_record *select_part_record;
 extern struct node_res_record *select_node_record;
 extern struct node_use_record *select_node_usage;
+extern uint16_t *cr_node_num_cores;
 
 extern void cr_sort_part_rows(struct part_res_record *p_ptr);
 extern uint32_t cr_get_coremap_offset(uint32_t node_index);
@@ -29,6 +29,7 @@ static int _set_select_jobinfo(select_jobinfo_t *jobinfo,
 		return SLURM_ERROR;
 	}
 
+	select_jobinfo_changed();
 	switch (data_type) {
 	case SELECT_JOBDATA_RESV_ID:
 		jobinfo->reservation_id = *uint32;
@@ -64,23 +64,42 @@
 #define MAX_RETRIES     10
 #define MAX_THREADS      8	/* These can be huge messages, so
 				 * only run MAX_THREADS at one time */
+#define MAX_BLOCKS       4	/* Blocks being transferred at one time,
+				 * so nodes relay a block to the next level
+				 * of the tree while the following block is
+				 * sent to them */
+
+struct bcast_block;
+
 typedef struct thd {
-	pthread_t thread;	/* thread ID */
 	slurm_msg_t msg;	/* message to send */
 	int rc;			/* highest return codes from RPC */
 	char *nodelist;
+	struct bcast_block *block;	/* block being sent */
 } thd_t;
 
+/* A block being transferred to all nodes, one thread per span of nodes */
+typedef struct bcast_block {
+	file_bcast_msg_t *msg;
+	thd_t thread_info[MAX_THREADS];
+	int thread_cnt;		/* threads still running */
+} bcast_block_t;
+
 static pthread_mutex_t agent_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cnt_cond  = PTHREAD_COND_INITIALIZER;
-static int agent_cnt = 0;
+static int agent_cnt = 0;	/* blocks being transferred */
+static int agent_rc = 0;	/* highest return code of any RPC */
+static char *nodelists[MAX_THREADS];
+static int threads_used = 0;
 
 static void *_agent_thread(void *args);
+static void  _split_nodes(job_sbcast_cred_msg_t *sbcast_cred);
 
 static void *_agent_thread(void *args)
 {
 	List ret_list = NULL;
 	thd_t *thread_ptr = (thd_t *) args;
+	bcast_block_t *block = thread_ptr->block;
 	ListIterator itr;
 	ret_data_info_t *ret_data_info = NULL;
 	int rc = 0, msg_rc;
@@ -111,70 +130,90 @@ static void *_agent_thread(void *args)
 	if (ret_list)
 		list_destroy(ret_list);
 	slurm_mutex_lock(&agent_cnt_mutex);
-	agent_cnt--;
-	pthread_cond_broadcast(&agent_cnt_cond);
+	agent_rc = MAX(agent_rc, rc);
+	if (--block->thread_cnt == 0) {
+		/* fname and cred are shared by all blocks */
+		xfree(block->msg->block);
+		xfree(block->msg);
+		xfree(block);
+		agent_cnt--;
+		pthread_cond_broadcast(&agent_cnt_cond);
+	}
 	slurm_mutex_unlock(&agent_cnt_mutex);
 	return NULL;
 }
 
-/* Issue the RPC to transfer the file's data */
-extern void send_rpc(file_bcast_msg_t *bcast_msg,
-		     job_sbcast_cred_msg_t *sbcast_cred)
+/* Split the job's nodes into one list per thread sending each block */
+static void _split_nodes(job_sbcast_cred_msg_t *sbcast_cred)
 {
-	/* Preserve some data structures across calls for better performance */
-	static int threads_used = 0;
-	static thd_t thread_info[MAX_THREADS];
-
-	int i, fanout, rc = SLURM_SUCCESS;
-	int retries = 0;
-	pthread_attr_t attr;
+	hostlist_t hl;
+	hostlist_t new_hl;
+	int i, fanout, *span = NULL;
+	char *name = NULL;
 
-	if (threads_used == 0) {
-		hostlist_t hl;
-		hostlist_t new_hl;
-		int *span = NULL;
-		char *name = NULL;
+	if (params.fanout)
+		fanout = MIN(MAX_THREADS, params.fanout);
+	else
+		fanout = MAX_THREADS;
 
-		if (params.fanout)
-			fanout = MIN(MAX_THREADS, params.fanout);
-		else
-			fanout = MAX_THREADS;
+	span = set_span(sbcast_cred->node_cnt, fanout);
 
-		span = set_span(sbcast_cred->node_cnt, fanout);
+	hl = hostlist_create(sbcast_cred->node_list);
 
-		hl = hostlist_create(sbcast_cred->node_list);
-
-		i = 0;
-		while (i < sbcast_cred->node_cnt) {
-			int j = 0;
+	i = 0;
+	while (i < sbcast_cred->node_cnt) {
+		int j = 0;
+		name = hostlist_shift(hl);
+		if(!name) {
+			debug3("no more nodes to send to");
+			break;
+		}
+		new_hl = hostlist_create(name);
+		free(name);
+		i++;
+		for(j = 0; j < span[threads_used]; j++) {
 			name = hostlist_shift(hl);
-			if(!name) {
-				debug3("no more nodes to send to");
+			if(!name)
 				break;
-			}
-			new_hl = hostlist_create(name);
+			hostlist_push(new_hl, name);
 			free(name);
 			i++;
-			for(j = 0; j < span[threads_used]; j++) {
-				name = hostlist_shift(hl);
-				if(!name)
-					break;
-				hostlist_push(new_hl, name);
-				free(name);
-				i++;
-			}
-			thread_info[threads_used].nodelist = 
-				hostlist_ranged_string_xmalloc(new_hl);
-			hostlist_destroy(new_hl);
-			slurm_msg_t_init(&thread_info[threads_used].msg);
-			thread_info[threads_used].msg.msg_type =
-				REQUEST_FILE_BCAST;
-			threads_used++;
 		}
-		xfree(span);
-		hostlist_destroy(hl);
-		debug("using %d threads", threads_used);
+		nodelists[threads_used] = hostlist_ranged_string_xmalloc(new_hl);
+		hostlist_destroy(new_hl);
+		threads_used++;
+	}
+	xfree(span);
+	hostlist_destroy(hl);
+	debug("using %d threads", threads_used);
+}
+
+/* Issue the RPCs to transfer a block of the file's data */
+extern void send_rpc(file_bcast_msg_t *bcast_msg,
+		     job_sbcast_cred_msg_t *sbcast_cred)
+{
+	bcast_block_t *block;
+	int i;
+	int retries = 0;
+	pthread_attr_t attr;
+	pthread_t thread_id;
+
+	if (threads_used == 0)
+		_split_nodes(sbcast_cred);
+
+	block = xmalloc(sizeof(bcast_block_t));
+	block->msg = bcast_msg;
+	block->thread_cnt = threads_used;
+
+	slurm_mutex_lock(&agent_cnt_mutex);
+	while ((agent_cnt >= MAX_BLOCKS) && (agent_rc == 0))
+		pthread_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
+	if (agent_rc) {
+		slurm_mutex_unlock(&agent_cnt_mutex);
+		send_rpc_wait();	/* exits */
 	}
+	agent_cnt++;
+	slurm_mutex_unlock(&agent_cnt_mutex);
 
 	slurm_attr_init(&attr);
 	if (pthread_attr_setstacksize(&attr, 3 * 1024*1024))
@@ -184,30 +223,36 @@ extern void send_rpc(file_bcast_msg_t *bcast_msg,
 		error("pthread_attr_setdetachstate error %m");
 
 	for (i=0; i<threads_used; i++) {
-		thread_info[i].msg.data = bcast_msg;
-		slurm_mutex_lock(&agent_cnt_mutex);
-		agent_cnt++;
-		slurm_mutex_unlock(&agent_cnt_mutex);
-
-		while (pthread_create(&thread_info[i].thread,
+		block->thread_info[i].nodelist = nodelists[i];
+		block->thread_info[i].block = block;
+		slurm_msg_t_init(&block->thread_info[i].msg);
+		block->thread_info[i].msg.msg_type = REQUEST_FILE_BCAST;
+		block->thread_info[i].msg.data = bcast_msg;
+	}
+	/* The block may be freed as soon as its last thread is created */
+	for (i=0; i<threads_used; i++) {
+		while (pthread_create(&thread_id,
 				      &attr, _agent_thread,
-				      (void *) &thread_info[i])) {
+				      (void *) &block->thread_info[i])) {
 			error("pthread_create error %m");
 			if (++retries > MAX_RETRIES)
 				fatal("Can't create pthread");
 			sleep(1);	/* sleep and retry */
 		}
 	}
+	pthread_attr_destroy(&attr);
+}
+
+/* Wait for all blocks to be transferred */
+extern void send_rpc_wait(void)
+{
+	int rc;
 
-	/* wait until pthreads complete */
 	slurm_mutex_lock(&agent_cnt_mutex);
 	while (agent_cnt)
 		pthread_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
+	rc = agent_rc;
 	slurm_mutex_unlock(&agent_cnt_mutex);
-	pthread_attr_destroy(&attr);
-
-	for (i=0; i<threads_used; i++)
-		 rc = MAX(rc, thread_info[i].rc);
 
 	if (rc)
 		exit(1);
@@ -45,10 +45,14 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#  include <zlib.h>
+#endif
 
 #include "slurm/slurm_errno.h"
 #include "src/common/forward.h"
@@ -68,6 +72,7 @@ struct stat f_stat;			/* source file stats */
 job_sbcast_cred_msg_t *sbcast_cred;	/* job alloc info and sbcast cred */
 
 static void _bcast_file(void);
+static void _compress_block(file_bcast_msg_t *bcast_msg);
 static void _get_job_info(void);
 
 
@@ -179,19 +184,58 @@ static ssize_t _get_block(char *buffer, size_t buf_size)
 	return buf_used;
 }
 
-/* read and broadcast the file */
+/* Compress a block's data, keeping it uncompressed unless that makes it
+ * smaller */
+static void _compress_block(file_bcast_msg_t *bcast_msg)
+{
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+	uLongf comp_len = compressBound(bcast_msg->block_len);
+	char *comp_block = xmalloc(comp_len);
+
+	/* Favor speed, the file is read and sent as it is compressed */
+	if ((compress2((Bytef *) comp_block, &comp_len,
+		       (Bytef *) bcast_msg->block, bcast_msg->block_len,
+		       Z_BEST_SPEED) == Z_OK) &&
+	    (comp_len < bcast_msg->block_len)) {
+		debug("block %d, compressed from %u to %lu bytes",
+		      bcast_msg->block_no, bcast_msg->block_len,
+		      (unsigned long) comp_len);
+		xfree(bcast_msg->block);
+		bcast_msg->block      = comp_block;
+		bcast_msg->compress   = 1;
+		bcast_msg->uncomp_len = bcast_msg->block_len;
+		bcast_msg->block_len  = comp_len;
+	} else
+		xfree(comp_block);
+#endif
+}
+
+/* read and broadcast the file
+ * The first block, which creates the file, is transferred before any
+ * other and the last block, which sets the file's modes and times, after
+ * all others. Blocks in between are sent while earlier blocks are still
+ * being relayed to the nodes (see send_rpc()). */
 static void _bcast_file(void)
 {
 	int buf_size;
 	ssize_t size_read = 0;
-	file_bcast_msg_t bcast_msg;
-	char *buffer;
+	uint16_t last_block;
+	file_bcast_msg_t bcast_msg, *block_msg;
 
 	if (params.block_size)
 		buf_size = MIN(params.block_size, f_stat.st_size);
 	else
 		buf_size = MIN((512 * 1024), f_stat.st_size);
+	buf_size = MIN(buf_size, FILE_BCAST_MAX_BLOCK);
 
+#if !defined(HAVE_LIBZ) || !defined(HAVE_ZLIB_H)
+	if (params.compress) {
+		info("compression is not supported, sending `%s` "
+		     "uncompressed", params.src_fname);
+	}
+#endif
+
+	memset(&bcast_msg, 0, sizeof(file_bcast_msg_t));
 	bcast_msg.fname		= params.dst_fname;
 	bcast_msg.block_no	= 1;
 	bcast_msg.last_block	= 0;
@@ -199,9 +243,6 @@ static void _bcast_file(void)
 	bcast_msg.modes		= f_stat.st_mode;
 	bcast_msg.uid		= f_stat.st_uid;
 	bcast_msg.gid		= f_stat.st_gid;
-	buffer			= xmalloc(buf_size);
-	bcast_msg.block		= buffer;
-	bcast_msg.block_len	= 0;
 	bcast_msg.cred          = sbcast_cred->sbcast_cred;
 
 	if (params.preserve) {
@@ -213,18 +254,30 @@ static void _bcast_file(void)
 	}
 
 	while (1) {
-		bcast_msg.block_len = _get_block(buffer, buf_size);
-		debug("block %d, size %u", bcast_msg.block_no,
-		      bcast_msg.block_len);
-		size_read += bcast_msg.block_len;
+		/* Each block is freed by send_rpc() once transferred */
+		block_msg = xmalloc(sizeof(file_bcast_msg_t));
+		memcpy(block_msg, &bcast_msg, sizeof(file_bcast_msg_t));
+		block_msg->block	= xmalloc(MAX(buf_size, 1));
+		block_msg->block_len	= _get_block(block_msg->block,
+						     buf_size);
+		block_msg->block_offset	= size_read;
+		debug("block %d, size %u", block_msg->block_no,
+		      block_msg->block_len);
+		size_read += block_msg->block_len;
 		if (size_read >= f_stat.st_size)
-			bcast_msg.last_block = 1;
+			block_msg->last_block = 1;
+		if (params.compress && block_msg->block_len)
+			_compress_block(block_msg);
 
-		send_rpc(&bcast_msg, sbcast_cred);
-		if (bcast_msg.last_block)
+		last_block = block_msg->last_block;
+
+		if (last_block && (bcast_msg.block_no > 1))
+			send_rpc_wait();
+		send_rpc(block_msg, sbcast_cred);
+		if ((bcast_msg.block_no == 1) || last_block)
+			send_rpc_wait();
+		if (last_block)
 			break;	/* end of file */
 		bcast_msg.block_no++;
 	}
-
-	xfree(buffer);
 }
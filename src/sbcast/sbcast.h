@@ -63,7 +63,13 @@ struct sbcast_parameters {
 extern struct sbcast_parameters params;
 
 extern void parse_command_line(int argc, char *argv[]);
+/* Start the RPCs to transfer a block of the file's data to all nodes,
+ * returning while earlier blocks may still be in transfer (see MAX_BLOCKS
+ * in agent.c). bcast_msg and its data are freed once transferred. Exits on
+ * failure. */
 extern void send_rpc(file_bcast_msg_t *bcast_msg,
 		     job_sbcast_cred_msg_t *sbcast_cred);
+/* Wait for all blocks to be transferred. Exits on failure. */
+extern void send_rpc_wait(void);
 
 #endif
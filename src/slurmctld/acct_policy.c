@@ -58,28 +58,17 @@ enum {
 };
 
 static slurmdb_used_limits_t *_get_used_limits_for_user(
-	List user_limit_list, uint32_t user_id)
+	slurmdb_qos_rec_t *qos_ptr, uint32_t user_id)
 {
-	slurmdb_used_limits_t *used_limits = NULL;
-	ListIterator itr = NULL;
-
-	if (!user_limit_list)
-		return NULL;
-
-	itr = list_iterator_create(user_limit_list);
-	while ((used_limits = list_next(itr))) {
-		if (used_limits->uid == user_id)
-			break;
-	}
-	list_iterator_destroy(itr);
-
-	return used_limits;
+	return assoc_mgr_get_used_limits(qos_ptr->usage, user_id, false);
 }
+
 static void _cancel_job(struct job_record *job_ptr)
 {
 	time_t now = time(NULL);
 
-	last_job_update = now;
+	last_job_update = job_ptr->last_update = now;
+	mark_job_state_dirty(job_ptr);
 	job_ptr->job_state = JOB_FAILED;
 	job_ptr->exit_code = 1;
 	job_ptr->state_reason = FAIL_ACCOUNT;
@@ -136,18 +125,9 @@ static void _adjust_limit_usage(int type, struct job_record *job_ptr)
 		slurmdb_used_limits_t *used_limits = NULL;
 
 		qos_ptr = (slurmdb_qos_rec_t *)job_ptr->qos_ptr;
-		if (!qos_ptr->usage->user_limit_list)
-			qos_ptr->usage->user_limit_list =
-				list_create(slurmdb_destroy_used_limits);
-		used_limits = _get_used_limits_for_user(
-			qos_ptr->usage->user_limit_list,
-			job_ptr->user_id);
-		if (!used_limits) {
-			used_limits = xmalloc(sizeof(slurmdb_used_limits_t));
-			used_limits->uid = job_ptr->user_id;
-			list_append(qos_ptr->usage->user_limit_list,
-				    used_limits);
-		}
+		used_limits = assoc_mgr_get_used_limits(qos_ptr->usage,
+							job_ptr->user_id,
+							true);
 		switch(type) {
 		case ACCT_POLICY_ADD_SUBMIT:
 			qos_ptr->usage->grp_used_submit_jobs++;
@@ -561,8 +541,7 @@ extern bool acct_policy_validate(job_desc_msg_t *job_desc,
 		if (qos_ptr->max_submit_jobs_pu != INFINITE) {
 			if (!used_limits)
 				used_limits = _get_used_limits_for_user(
-					qos_ptr->usage->user_limit_list,
-					job_desc->user_id);
+					qos_ptr, job_desc->user_id);
 			if (used_limits && (used_limits->submit_jobs
 					    >= qos_ptr->max_submit_jobs_pu)) {
 				info("job submit for user %s(%u): "
@@ -1084,8 +1063,7 @@ extern bool acct_policy_job_runnable(struct job_record *job_ptr)
 			 * current usage */
 			if (!used_limits)
 				used_limits = _get_used_limits_for_user(
-					qos_ptr->usage->user_limit_list,
-					job_ptr->user_id);
+					qos_ptr, job_ptr->user_id);
 			if (used_limits && (used_limits->cpus
 					    >= qos_ptr->max_cpus_pu)) {
 				job_ptr->state_reason =
@@ -1106,8 +1084,7 @@ extern bool acct_policy_job_runnable(struct job_record *job_ptr)
 		if (qos_ptr->max_jobs_pu != INFINITE) {
 			if (!used_limits)
 				used_limits = _get_used_limits_for_user(
-					qos_ptr->usage->user_limit_list,
-					job_ptr->user_id);
+					qos_ptr, job_ptr->user_id);
 
 			if (used_limits && (used_limits->jobs
 					    >= qos_ptr->max_jobs_pu)) {
@@ -1166,8 +1143,7 @@ extern bool acct_policy_job_runnable(struct job_record *job_ptr)
 			*/
 			if (!used_limits)
 				used_limits = _get_used_limits_for_user(
-					qos_ptr->usage->user_limit_list,
-					job_ptr->user_id);
+					qos_ptr, job_ptr->user_id);
 			if (used_limits && (used_limits->nodes
 					    >= qos_ptr->max_nodes_pu)) {
 				job_ptr->state_reason =
@@ -1569,7 +1545,8 @@ extern int acct_policy_update_pending_job(struct job_record *job_ptr)
 	}
 
 	if (update_accounting) {
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
 		debug("limits changed for job %u: updating accounting",
 		      job_ptr->job_id);
 		if (details_ptr->begin_time) {
@@ -50,15 +50,26 @@
  *  be possible to execute the agent as an pthread, process, or even a daemon
  *  on some other computer.
  *
- *  The main agent thread creates a separate thread for each node to be
- *  communicated with up to AGENT_THREAD_COUNT. A special watchdog thread
- *  sends SIGLARM to any threads that have been active (in DSH_ACTIVE state)
- *  for more than COMMAND_TIMEOUT seconds.
- *  The agent responds to slurmctld via a function call or an RPC as required.
- *  For example, informing slurmctld that some node is not responding.
+ *  The agent splits the work into a task for each node (or group of nodes
+ *  to which the message is forwarded) and queues the tasks for a pool of
+ *  worker threads shared by all agents. The pool grows as needed, up to
+ *  MAX_AGENT_CNT * AGENT_THREAD_COUNT threads (the concurrency formerly
+ *  permitted to simultaneous agents), and its threads persist. Tasks are
+ *  queued by priority, so job launch and termination RPCs are sent ahead of
+ *  pings. Each task also has a deadline, COMMAND_TIMEOUT seconds after it
+ *  was queued. A task waiting for over half of that time is run ahead of
+ *  tasks of a higher priority, so low priority RPCs are not starved. A task
+ *  still queued at its deadline is not sent at all: it completes as
+ *  DSH_EXPIRED and is retried if the agent requested retries, but its
+ *  nodes are not marked as not responding. Every RPC is sent with a finite
+ *  message timeout, so no watchdog is needed to interrupt hung
+ *  communications.
+ *  The worker thread which completes an agent's last task tallies the
+ *  results and responds to slurmctld via a function call or an RPC as
+ *  required. For example, informing slurmctld that some node is not
+ *  responding.
  *
- *  All the state for each thread is maintained in thd_t struct, which is
- *  used by the watchdog thread as well as the communication threads.
+ *  All the state for each task is maintained in thd_t struct.
 \*****************************************************************************/
 
 #ifdef HAVE_CONFIG_H
@@ -71,11 +82,13 @@
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <stdlib.h>
 
+#include "src/common/conn_cache.h"
 #include "src/common/forward.h"
 #include "src/common/list.h"
 #include "src/common/log.h"
@@ -85,7 +98,6 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/uid.h"
-#include "src/common/xsignal.h"
 #include "src/common/xassert.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
@@ -104,21 +116,26 @@ typedef enum {
 	DSH_ACTIVE,     /* Request in progress */
 	DSH_DONE,       /* Request completed normally */
 	DSH_NO_RESP,    /* Request timed out */
-	DSH_FAILED      /* Request resulted in error */
+	DSH_FAILED,     /* Request resulted in error */
+	DSH_EXPIRED     /* Request not sent before its deadline */
 } state_t;
 
+/* Agent task priorities, highest first */
+enum {
+	AGENT_PRIO_HIGH,	/* job launch and termination */
+	AGENT_PRIO_NORMAL,
+	AGENT_PRIO_LOW,		/* pings and health checks */
+	AGENT_PRIO_CNT
+};
+
 typedef struct thd_complete {
-	bool work_done; 	/* assume all threads complete */
 	int fail_cnt;		/* assume no threads failures */
 	int no_resp_cnt;	/* assume all threads respond */
 	int retry_cnt;		/* assume no required retries */
 	int max_delay;
-	time_t now;
 } thd_complete_t;
 
 typedef struct thd {
-	pthread_t thread;		/* thread ID */
-	pthread_attr_t attr;		/* thread attributes */
 	state_t state;			/* thread state */
 	time_t start_time;		/* start time */
 	time_t end_time;		/* end time or delta time
@@ -131,26 +148,26 @@ typedef struct thd {
 
 typedef struct agent_info {
 	pthread_mutex_t thread_mutex;	/* agent specific mutex */
-	pthread_cond_t thread_cond;	/* agent specific condition */
 	uint32_t thread_count;		/* number of threads records */
-	uint32_t threads_active;	/* currently active threads */
+	uint32_t tasks_pending;		/* tasks not yet complete */
 	uint16_t retry;			/* if set, keep trying */
 	thd_t *thread_struct;		/* thread structures */
 	bool get_reply;			/* flag if reply expected */
 	slurm_msg_type_t msg_type;	/* RPC to be issued */
 	void **msg_args_pptr;		/* RPC data to be used */
+	agent_arg_t *agent_arg_ptr;	/* request, purged on completion */
+	time_t begin_time;		/* time agent was started */
 } agent_info_t;
 
 typedef struct task_info {
-	pthread_mutex_t *thread_mutex_ptr; /* pointer to agent specific
-					    * mutex */
-	pthread_cond_t *thread_cond_ptr;/* pointer to agent specific
-					 * condition */
-	uint32_t *threads_active_ptr;	/* currently active thread ptr */
+	agent_info_t *agent_ptr;	/* agent the task belongs to */
 	thd_t *thread_struct_ptr;	/* thread structures ptr */
 	bool get_reply;			/* flag if reply expected */
 	slurm_msg_type_t msg_type;	/* RPC to be issued */
 	void *msg_args_ptr;		/* ptr to RPC data to be used */
+	int priority;			/* AGENT_PRIO_* */
+	time_t deadline;		/* time after which task is not sent */
+	struct timeval queue_time;	/* time queued for a worker */
 } task_info_t;
 
 typedef struct queued_request {
@@ -165,7 +182,12 @@ typedef struct mail_info {
 	char *message;
 } mail_info_t;
 
-static void _sig_handler(int dummy);
+static void _agent_cnt_decr(bool retry);
+static void _agent_complete(agent_info_t *agent_ptr);
+static task_info_t *_agent_pool_next(time_t now);
+static void _agent_pool_queue(task_info_t **task_array, int task_cnt);
+static void *_agent_pool_worker(void *no_data);
+static int  _agent_priority(slurm_msg_type_t msg_type);
 static int  _batch_launch_defer(queued_request_t *queued_req_ptr);
 static inline int _comm_err(char *node_name, slurm_msg_type_t msg_type);
 static void _list_delete_retry(void *retry_entry);
@@ -173,16 +195,16 @@ static agent_info_t *_make_agent_info(agent_arg_t *agent_arg_ptr);
 static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx);
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr);
 static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
-		int no_resp_cnt, int retry_cnt);
+		int retry_cnt);
 static void _purge_agent_args(agent_arg_t *agent_arg_ptr);
 static void _queue_agent_retry(agent_info_t * agent_info_ptr, int count);
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
 			  int count, int *spot);
 static void _slurmctld_free_batch_job_launch_msg(batch_job_launch_msg_t * msg);
 static void _spawn_retry_agent(agent_arg_t * agent_arg_ptr);
-static void *_thread_per_group_rpc(void *args);
+static void _task_expired(task_info_t *task_ptr);
+static void _task_per_group_rpc(task_info_t *task_ptr);
 static int   _valid_agent_arg(agent_arg_t *agent_arg_ptr);
-static void *_wdog(void *args);
 
 static mail_info_t *_mail_alloc(void);
 static void  _mail_free(void *arg);
@@ -195,9 +217,25 @@ static List retry_list = NULL;		/* agent_arg_t list for retry */
 static List mail_list = NULL;		/* pending e-mail requests */
 
 static pthread_mutex_t agent_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t  agent_cnt_cond  = PTHREAD_COND_INITIALIZER;
 static int agent_cnt = 0;
 
+/* Agent thread pool and task queues, protected by pool_mutex */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pool_cond  = PTHREAD_COND_INITIALIZER;
+static List pool_queue[AGENT_PRIO_CNT];	/* task_info_t lists by priority */
+static int  pool_threads = 0;		/* worker threads started */
+static int  pool_idle = 0;		/* worker threads awaiting work */
+static int  pool_max = 0;		/* worker thread limit */
+static struct {
+	uint32_t queue_depth;	/* tasks waiting for a worker */
+	uint32_t queue_max;	/* high water mark of queue_depth */
+	uint32_t cnt;		/* tasks started */
+	uint32_t late;		/* tasks run ahead of their priority */
+	uint32_t expired;	/* tasks not sent by their deadline */
+	uint64_t wait_usec;	/* total time tasks waited for a worker */
+	uint64_t wait_max_usec;	/* longest time a task waited */
+} pool_stats;
+
 static bool run_scheduler    = false;
 static bool wiki2_sched      = false;
 static bool wiki2_sched_test = false;
@@ -205,21 +243,19 @@ static bool wiki2_sched_test = false;
 /*
  * agent - party responsible for transmitting an common RPC in parallel
  *	across a set of nodes. Use agent_queue_request() if immediate
- *	execution is not essential.
+ *	execution is not essential. The RPCs are queued for the agent thread
+ *	pool, this function does not wait for them to be sent.
  * IN pointer to agent_arg_t, which is xfree'd (including hostlist,
  *	and msg_args) upon completion
  * RET always NULL (function format just for use as pthread)
  */
 void *agent(void *args)
 {
-	int i, delay, rc, retries = 0;
-	pthread_attr_t attr_wdog;
-	pthread_t thread_wdog;
+	int i;
 	agent_arg_t *agent_arg_ptr = args;
 	agent_info_t *agent_info_ptr = NULL;
-	thd_t *thread_ptr;
-	task_info_t *task_specific_ptr;
-	time_t begin_time;
+	task_info_t **task_array;
+	time_t deadline;
 
 #if 0
 	info("Agent_cnt is %d of %d with msg_type %d",
@@ -233,127 +269,261 @@ void *agent(void *args)
 		xfree(sched_type);
 		wiki2_sched_test = true;
 	}
-
-	while (1) {
-		if (slurmctld_config.shutdown_time ||
-		    (agent_cnt < MAX_AGENT_CNT)) {
-			agent_cnt++;
-			break;
-		} else {	/* wait for state change and retry */
-			pthread_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
-		}
-	}
+	agent_cnt++;
 	slurm_mutex_unlock(&agent_cnt_mutex);
-	if (slurmctld_config.shutdown_time)
-		goto cleanup;
 
 	/* basic argument value tests */
-	begin_time = time(NULL);
-	if (_valid_agent_arg(agent_arg_ptr))
-		goto cleanup;
+	if (slurmctld_config.shutdown_time ||
+	    _valid_agent_arg(agent_arg_ptr)) {
+		_purge_agent_args(agent_arg_ptr);
+		_agent_cnt_decr(false);
+		return NULL;
+	}
 
 	/* initialize the agent data structures */
 	agent_info_ptr = _make_agent_info(agent_arg_ptr);
-	thread_ptr = agent_info_ptr->thread_struct;
-
-	/* start the watchdog thread */
-	slurm_attr_init(&attr_wdog);
-	if (pthread_attr_setdetachstate
-	    (&attr_wdog, PTHREAD_CREATE_JOINABLE))
-		error("pthread_attr_setdetachstate error %m");
-	while (pthread_create(&thread_wdog, &attr_wdog, _wdog,
-				(void *) agent_info_ptr)) {
-		error("pthread_create error %m");
-		if (++retries > MAX_RETRIES)
-			fatal("Can't create pthread");
-		usleep(10000);	/* sleep and retry */
+	agent_info_ptr->begin_time = time(NULL);
+	if (agent_info_ptr->thread_count == 0) {
+		/* Not expected after _valid_agent_arg(). Do not complete the
+		 * agent here, the caller may hold slurmctld locks. */
+		error("agent msg_type=%u has no nodes to send to",
+		      agent_arg_ptr->msg_type);
+		slurm_mutex_destroy(&agent_info_ptr->thread_mutex);
+		xfree(agent_info_ptr->thread_struct);
+		xfree(agent_info_ptr);
+		_purge_agent_args(agent_arg_ptr);
+		_agent_cnt_decr(false);
+		return NULL;
 	}
-	slurm_attr_destroy(&attr_wdog);
-#if 	AGENT_THREAD_COUNT < 1
-	fatal("AGENT_THREAD_COUNT value is invalid");
-#endif
+
 	debug2("got %d threads to send out",agent_info_ptr->thread_count);
-	/* start all the other threads (up to AGENT_THREAD_COUNT active) */
+	/* create task specific data, NOTE: freed from
+	 *      _task_per_group_rpc() */
+	agent_info_ptr->tasks_pending = agent_info_ptr->thread_count;
+	task_array = xmalloc(sizeof(task_info_t *) *
+			     agent_info_ptr->thread_count);
+	deadline = agent_info_ptr->begin_time + COMMAND_TIMEOUT;
 	for (i = 0; i < agent_info_ptr->thread_count; i++) {
+		task_array[i] = _make_task_data(agent_info_ptr, i);
+		task_array[i]->deadline = deadline;
+	}
+	/* The agent may complete and be freed as soon as its tasks are
+	 * queued, so agent_info_ptr can not be used after this */
+	_agent_pool_queue(task_array, i);
+	xfree(task_array);
 
-		/* wait until "room" for another thread */
-		slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-		while (agent_info_ptr->threads_active >=
-		       AGENT_THREAD_COUNT) {
-			pthread_cond_wait(&agent_info_ptr->thread_cond,
-					  &agent_info_ptr->thread_mutex);
-		}
+	return NULL;
+}
+
+/*
+ * _agent_cnt_decr - Note that an agent has completed
+ * IN retry - if set, start a queued request if not too busy
+ */
+static void _agent_cnt_decr(bool retry)
+{
+	slurm_mutex_lock(&agent_cnt_mutex);
+	if (agent_cnt > 0)
+		agent_cnt--;
+	else {
+		error("agent_cnt underflow");
+		agent_cnt = 0;
+	}
+	if (!agent_cnt || (agent_cnt >= MAX_AGENT_CNT))
+		retry = false;
+	slurm_mutex_unlock(&agent_cnt_mutex);
+
+	/* Pending e-mail is sent by the slurmctld background thread rather
+	 * than holding up an agent thread */
+	if (retry)
+		agent_retry(RPC_RETRY_INTERVAL, false);
+}
+
+/* Map an RPC type to the priority of its agent tasks */
+static int _agent_priority(slurm_msg_type_t msg_type)
+{
+	switch (msg_type) {
+	case REQUEST_ABORT_JOB:
+	case REQUEST_BATCH_JOB_LAUNCH:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_SHUTDOWN:
+	case REQUEST_TERMINATE_JOB:
+	case RESPONSE_RESOURCE_ALLOCATION:
+		return AGENT_PRIO_HIGH;
+	case REQUEST_HEALTH_CHECK:
+	case REQUEST_NODE_REGISTRATION_STATUS:
+	case REQUEST_PING:
+	case SRUN_PING:
+		return AGENT_PRIO_LOW;
+	default:
+		return AGENT_PRIO_NORMAL;
+	}
+}
 
-		/* create thread specific data, NOTE: freed from
-		 *      _thread_per_group_rpc() */
-		task_specific_ptr = _make_task_data(agent_info_ptr, i);
+/*
+ * _agent_pool_queue - Queue tasks for the agent thread pool, starting
+ *	more worker threads if the queue has outgrown the idle workers
+ * IN task_array - tasks to queue, the array itself is not retained
+ * IN task_cnt - number of tasks in task_array
+ */
+static void _agent_pool_queue(task_info_t **task_array, int task_cnt)
+{
+	pthread_attr_t attr;
+	pthread_t thread_id;
+	struct timeval now;
+	int i, need, retries = 0;
+
+	gettimeofday(&now, NULL);
+	slurm_mutex_lock(&pool_mutex);
+	if (pool_max == 0) {
+		/* Agent threads spend most of their time waiting for
+		 * replies, so permit as many RPCs in flight as the
+		 * former per-agent threads did */
+		pool_max = MAX_AGENT_CNT * AGENT_THREAD_COUNT;
+		for (i = 0; i < AGENT_PRIO_CNT; i++) {
+			pool_queue[i] = list_create(NULL);
+			if (pool_queue[i] == NULL)
+				fatal("list_create failed");
+		}
+	}
 
-		slurm_attr_init(&thread_ptr[i].attr);
-		if (pthread_attr_setdetachstate(&thread_ptr[i].attr,
+	for (i = 0; i < task_cnt; i++) {
+		task_array[i]->queue_time = now;
+		list_append(pool_queue[task_array[i]->priority], task_array[i]);
+	}
+	pool_stats.queue_depth += task_cnt;
+	if (pool_stats.queue_depth > pool_stats.queue_max)
+		pool_stats.queue_max = pool_stats.queue_depth;
+
+	need = MIN(((int) pool_stats.queue_depth - pool_idle),
+		   (pool_max - pool_threads));
+	if (need > 0) {
+		slurm_attr_init(&attr);
+		if (pthread_attr_setdetachstate(&attr,
 						PTHREAD_CREATE_DETACHED))
 			error("pthread_attr_setdetachstate error %m");
-		while ((rc = pthread_create(&thread_ptr[i].thread,
-					    &thread_ptr[i].attr,
-					    _thread_per_group_rpc,
-					    (void *) task_specific_ptr))) {
-			error("pthread_create error %m");
-			if (agent_info_ptr->threads_active)
-				pthread_cond_wait(&agent_info_ptr->
-						  thread_cond,
-						  &agent_info_ptr->
-						  thread_mutex);
-			else {
-				slurm_mutex_unlock(&agent_info_ptr->
-						     thread_mutex);
-				usleep(10000);	/* sleep and retry */
-				slurm_mutex_lock(&agent_info_ptr->
-						   thread_mutex);
+		for (i = 0; i < need; i++) {
+			if (pthread_create(&thread_id, &attr,
+					   _agent_pool_worker, NULL) == 0) {
+				pool_threads++;
+				continue;
 			}
+			error("pthread_create error %m");
+			if (pool_threads)
+				break;	/* existing workers will run tasks */
+			if (++retries > MAX_RETRIES)
+				fatal("Can't create pthread");
+			usleep(10000);	/* sleep and retry */
+			i--;
 		}
-		slurm_attr_destroy(&thread_ptr[i].attr);
-		agent_info_ptr->threads_active++;
-		slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+		slurm_attr_destroy(&attr);
 	}
 
-	/* wait for termination of remaining threads */
-	pthread_join(thread_wdog, NULL);
-	delay = (int) difftime(time(NULL), begin_time);
-	if (delay > (slurm_get_msg_timeout() * 2)) {
-		info("agent msg_type=%u ran for %d seconds",
-			agent_arg_ptr->msg_type,  delay);
-	}
-	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-	while (agent_info_ptr->threads_active != 0) {
-		pthread_cond_wait(&agent_info_ptr->thread_cond,
-				&agent_info_ptr->thread_mutex);
-	}
-	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+	if (task_cnt == 1)
+		pthread_cond_signal(&pool_cond);
+	else
+		pthread_cond_broadcast(&pool_cond);
+	slurm_mutex_unlock(&pool_mutex);
+}
 
-      cleanup:
-	_purge_agent_args(agent_arg_ptr);
+/*
+ * _agent_pool_next - Remove the next task to run from the queues. This is
+ *	the task whose deadline is nearest, if any is within half of
+ *	COMMAND_TIMEOUT, otherwise the oldest task of the highest priority.
+ *	Tasks of each priority are queued in deadline order, so only the
+ *	first of each is examined.
+ * IN now - current time
+ * RET task or NULL if none are queued
+ * NOTE: Call with pool_mutex locked
+ */
+static task_info_t *_agent_pool_next(time_t now)
+{
+	task_info_t *task_ptr, *late_ptr = NULL;
+	int i, prio = -1;
 
-	if (agent_info_ptr) {
-		xfree(agent_info_ptr->thread_struct);
-		xfree(agent_info_ptr);
-	}
-	slurm_mutex_lock(&agent_cnt_mutex);
+	if (pool_stats.queue_depth == 0)
+		return NULL;
 
-	if (agent_cnt > 0)
-		agent_cnt--;
-	else {
-		error("agent_cnt underflow");
-		agent_cnt = 0;
+	for (i = 0; i < AGENT_PRIO_CNT; i++) {
+		task_ptr = list_peek(pool_queue[i]);
+		if (task_ptr == NULL)
+			continue;
+		if (prio == -1)
+			prio = i;
+		if ((task_ptr->deadline <= now + (COMMAND_TIMEOUT / 2)) &&
+		    (!late_ptr || (task_ptr->deadline < late_ptr->deadline))) {
+			late_ptr = task_ptr;
+			prio = i;
+		}
 	}
+	if (prio == -1)
+		return NULL;
+
+	task_ptr = list_dequeue(pool_queue[prio]);
+	pool_stats.queue_depth--;
+	if (late_ptr)
+		pool_stats.late++;
+	return task_ptr;
+}
 
-	if (agent_cnt && agent_cnt < MAX_AGENT_CNT)
-		agent_retry(RPC_RETRY_INTERVAL, true);
+/* _agent_pool_worker - Agent thread pool worker, run queued tasks */
+static void *_agent_pool_worker(void *no_data)
+{
+	task_info_t *task_ptr;
+	struct timeval now;
+	uint64_t wait_usec;
+	bool expired;
 
-	pthread_cond_broadcast(&agent_cnt_cond);
-	slurm_mutex_unlock(&agent_cnt_mutex);
+	while (1) {
+		slurm_mutex_lock(&pool_mutex);
+		pool_idle++;
+		while ((task_ptr = _agent_pool_next(time(NULL))) == NULL)
+			pthread_cond_wait(&pool_cond, &pool_mutex);
+		pool_idle--;
+		gettimeofday(&now, NULL);
+		wait_usec = slurm_diff_tv(&task_ptr->queue_time, &now);
+		pool_stats.cnt++;
+		pool_stats.wait_usec += wait_usec;
+		if (wait_usec > pool_stats.wait_max_usec)
+			pool_stats.wait_max_usec = wait_usec;
+		expired = (task_ptr->deadline < now.tv_sec);
+		if (expired)
+			pool_stats.expired++;
+		slurm_mutex_unlock(&pool_mutex);
+
+		if (expired)
+			_task_expired(task_ptr);
+		else
+			_task_per_group_rpc(task_ptr);
+	}
 
 	return NULL;
 }
 
+/* agent_stats_report - Log agent thread pool statistics accumulated since
+ *	the last report, then clear them */
+extern void agent_stats_report(void)
+{
+	slurm_mutex_lock(&pool_mutex);
+	if (pool_stats.cnt) {
+		debug("Agent stats: tasks=%u late=%u expired=%u threads=%d "
+		      "queue_depth=%u max_queue_depth=%u "
+		      "avg_wait_usec=%"PRIu64" max_wait_usec=%"PRIu64,
+		      pool_stats.cnt, pool_stats.late, pool_stats.expired,
+		      pool_threads,
+		      pool_stats.queue_depth, pool_stats.queue_max,
+		      pool_stats.wait_usec / pool_stats.cnt,
+		      pool_stats.wait_max_usec);
+	}
+	pool_stats.queue_max = pool_stats.queue_depth;
+	pool_stats.cnt = 0;
+	pool_stats.late = 0;
+	pool_stats.expired = 0;
+	pool_stats.wait_usec = 0;
+	pool_stats.wait_max_usec = 0;
+	slurm_mutex_unlock(&pool_mutex);
+}
+
 /* Basic validity test of agent argument */
 static int _valid_agent_arg(agent_arg_t *agent_arg_ptr)
 {
@@ -385,11 +555,9 @@ static agent_info_t *_make_agent_info(agent_arg_t *agent_arg_ptr)
 
 	agent_info_ptr = xmalloc(sizeof(agent_info_t));
 	slurm_mutex_init(&agent_info_ptr->thread_mutex);
-	if (pthread_cond_init(&agent_info_ptr->thread_cond, NULL))
-		fatal("pthread_cond_init error %m");
 	agent_info_ptr->thread_count   = agent_arg_ptr->node_count;
 	agent_info_ptr->retry          = agent_arg_ptr->retry;
-	agent_info_ptr->threads_active = 0;
+	agent_info_ptr->agent_arg_ptr  = agent_arg_ptr;
 	thread_ptr = xmalloc(agent_info_ptr->thread_count * sizeof(thd_t));
 	memset(thread_ptr, 0, (agent_info_ptr->thread_count * sizeof(thd_t)));
 	agent_info_ptr->thread_struct  = thread_ptr;
@@ -467,36 +635,21 @@ static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx)
 	task_info_t *task_info_ptr;
 	task_info_ptr = xmalloc(sizeof(task_info_t));
 
-	task_info_ptr->thread_mutex_ptr  = &agent_info_ptr->thread_mutex;
-	task_info_ptr->thread_cond_ptr   = &agent_info_ptr->thread_cond;
-	task_info_ptr->threads_active_ptr= &agent_info_ptr->threads_active;
+	task_info_ptr->agent_ptr         = agent_info_ptr;
 	task_info_ptr->thread_struct_ptr = &agent_info_ptr->thread_struct[inx];
 	task_info_ptr->get_reply         = agent_info_ptr->get_reply;
 	task_info_ptr->msg_type          = agent_info_ptr->msg_type;
 	task_info_ptr->msg_args_ptr      = *agent_info_ptr->msg_args_pptr;
+	task_info_ptr->priority          = _agent_priority(
+						agent_info_ptr->msg_type);
 
 	return task_info_ptr;
 }
 
-static void _update_wdog_state(thd_t *thread_ptr,
-			       state_t *state,
+static void _update_task_state(thd_t *thread_ptr, state_t state,
 			       thd_complete_t *thd_comp)
 {
-	switch(*state) {
-	case DSH_ACTIVE:
-		thd_comp->work_done = false;
-		if (thread_ptr->end_time <= thd_comp->now) {
-			debug3("agent thread %lu timed out",
-			       (unsigned long) thread_ptr->thread);
-			if (pthread_kill(thread_ptr->thread, SIGUSR1) == ESRCH)
-				*state = DSH_NO_RESP;
-			else
-				thread_ptr->end_time += COMMAND_TIMEOUT;
-		}
-		break;
-	case DSH_NEW:
-		thd_comp->work_done = false;
-		break;
+	switch (state) {
 	case DSH_DONE:
 		if (thd_comp->max_delay < (int)thread_ptr->end_time)
 			thd_comp->max_delay = (int)thread_ptr->end_time;
@@ -508,22 +661,24 @@ static void _update_wdog_state(thd_t *thread_ptr,
 	case DSH_FAILED:
 		thd_comp->fail_cnt++;
 		break;
+	case DSH_EXPIRED:
+		thd_comp->retry_cnt++;
+		break;
+	default:	/* DSH_NEW and DSH_ACTIVE can not happen here */
+		break;
 	}
 }
 
 /*
- * _wdog - Watchdog thread. Send SIGUSR1 to threads which have been active
- *	for too long.
- * IN args - pointer to agent_info_t with info on threads to watch
- * Sleep between polls with exponential times (from 0.125 to 1.0 second)
+ * _agent_complete - Tally the results of an agent's RPCs, notify slurmctld
+ *	and free the agent. Called once all of the agent's tasks are complete.
+ * IN agent_ptr - pointer to agent_info_t with info on the completed tasks
  */
-static void *_wdog(void *args)
+static void _agent_complete(agent_info_t *agent_ptr)
 {
 	bool srun_agent = false;
-	int i;
-	agent_info_t *agent_ptr = (agent_info_t *) args;
+	int i, delay;
 	thd_t *thread_ptr = agent_ptr->thread_struct;
-	unsigned long usec = 125000;
 	ListIterator itr;
 	thd_complete_t thd_comp;
 	ret_data_info_t *ret_data_info = NULL;
@@ -538,48 +693,27 @@ static void *_wdog(void *args)
 	     (agent_ptr->msg_type == RESPONSE_RESOURCE_ALLOCATION) )
 		srun_agent = true;
 
-	thd_comp.max_delay = 0;
-
-	while (1) {
-		thd_comp.work_done   = true;/* assume all threads complete */
-		thd_comp.fail_cnt    = 0;   /* assume no threads failures */
-		thd_comp.no_resp_cnt = 0;   /* assume all threads respond */
-		thd_comp.retry_cnt   = 0;   /* assume no required retries */
-		thd_comp.now         = time(NULL);
-
-		usleep(usec);
-		usec = MIN((usec * 2), 1000000);
-
-		slurm_mutex_lock(&agent_ptr->thread_mutex);
-		for (i = 0; i < agent_ptr->thread_count; i++) {
-			//info("thread name %s",thread_ptr[i].node_name);
-			if(!thread_ptr[i].ret_list) {
-				_update_wdog_state(&thread_ptr[i],
-						   &thread_ptr[i].state,
+	memset(&thd_comp, 0, sizeof(thd_complete_t));
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
+	for (i = 0; i < agent_ptr->thread_count; i++) {
+		if (!thread_ptr[i].ret_list) {
+			_update_task_state(&thread_ptr[i], thread_ptr[i].state,
+					   &thd_comp);
+		} else {
+			itr = list_iterator_create(thread_ptr[i].ret_list);
+			while ((ret_data_info = list_next(itr))) {
+				_update_task_state(&thread_ptr[i],
+						   ret_data_info->err,
 						   &thd_comp);
-			} else {
-				itr = list_iterator_create(
-					thread_ptr[i].ret_list);
-				while((ret_data_info = list_next(itr))) {
-					_update_wdog_state(&thread_ptr[i],
-							   &ret_data_info->err,
-							   &thd_comp);
-				}
-				list_iterator_destroy(itr);
 			}
+			list_iterator_destroy(itr);
 		}
-		if (thd_comp.work_done)
-			break;
-
-		slurm_mutex_unlock(&agent_ptr->thread_mutex);
 	}
 
 	if (srun_agent) {
 		_notify_slurmctld_jobs(agent_ptr);
 	} else {
-		_notify_slurmctld_nodes(agent_ptr,
-					thd_comp.no_resp_cnt,
-					thd_comp.retry_cnt);
+		_notify_slurmctld_nodes(agent_ptr, thd_comp.retry_cnt);
 	}
 
 	for (i = 0; i < agent_ptr->thread_count; i++) {
@@ -590,9 +724,19 @@ static void *_wdog(void *args)
 
 	if (thd_comp.max_delay)
 		debug2("agent maximum delay %d seconds", thd_comp.max_delay);
-
 	slurm_mutex_unlock(&agent_ptr->thread_mutex);
-	return (void *) NULL;
+
+	delay = (int) difftime(time(NULL), agent_ptr->begin_time);
+	if (delay > (slurm_get_msg_timeout() * 2)) {
+		info("agent msg_type=%u ran for %d seconds",
+		     agent_ptr->msg_type, delay);
+	}
+
+	_purge_agent_args(agent_ptr->agent_arg_ptr);
+	slurm_mutex_destroy(&agent_ptr->thread_mutex);
+	xfree(agent_ptr->thread_struct);
+	xfree(agent_ptr);
+	_agent_cnt_decr(true);
 }
 
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr)
@@ -637,7 +781,7 @@ static void _notify_slurmctld_jobs(agent_info_t *agent_ptr)
 }
 
 static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
-				    int no_resp_cnt, int retry_cnt)
+				    int retry_cnt)
 {
 	ListIterator itr = NULL;
 	ret_data_info_t *ret_data_info = NULL;
@@ -650,8 +794,9 @@ static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
 	int i;
 
 	/* Notify slurmctld of non-responding nodes */
-	if (no_resp_cnt) {
-		/* Update node table data for non-responding nodes */
+	if (retry_cnt) {
+		/* Requeue batch jobs whose launch RPC got no response or
+		 * was never sent */
 		lock_slurmctld(node_write_lock);
 		if (agent_ptr->msg_type == REQUEST_BATCH_JOB_LAUNCH) {
 			/* Requeue the request */
@@ -712,6 +857,14 @@ static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
 				else
 					node_did_resp(ret_data_info->node_name);
 				break;
+			case DSH_EXPIRED:
+				/* Never sent, so says nothing about the
+				 * nodes. Only possible without ret_list */
+				error("agent msg_type=%u to %s not sent "
+				      "within %d seconds",
+				      agent_ptr->msg_type,
+				      thread_ptr[i].nodelist, COMMAND_TIMEOUT);
+				break;
 			default:
 				if (!is_ret_list) {
 					error("unknown state returned for %s",
@@ -776,40 +929,29 @@ static int _wif_status(void)
 }
 
 /*
- * _thread_per_group_rpc - thread to issue an RPC for a group of nodes
- *                         sending message out to one and forwarding it to
- *                         others if necessary.
- * IN/OUT args - pointer to task_info_t, xfree'd on completion
+ * _task_per_group_rpc - issue an RPC for a group of nodes, sending message
+ *                       out to one and forwarding it to others if
+ *                       necessary. Run by an agent pool worker thread.
+ * IN/OUT task_ptr - pointer to task_info_t, xfree'd on completion
  */
-static void *_thread_per_group_rpc(void *args)
+static void _task_per_group_rpc(task_info_t *task_ptr)
 {
 	int rc = SLURM_SUCCESS;
 	slurm_msg_t msg;
-	task_info_t *task_ptr = (task_info_t *) args;
-	/* we cache some pointers from task_info_t because we need
-	 * to xfree args before being finished with their use. xfree
-	 * is required for timely termination of this pthread because
-	 * xfree could lock it at the end, preventing a timely
-	 * thread_exit */
-	pthread_mutex_t *thread_mutex_ptr   = task_ptr->thread_mutex_ptr;
-	pthread_cond_t  *thread_cond_ptr    = task_ptr->thread_cond_ptr;
-	uint32_t        *threads_active_ptr = task_ptr->threads_active_ptr;
+	agent_info_t    *agent_ptr          = task_ptr->agent_ptr;
 	thd_t           *thread_ptr         = task_ptr->thread_struct_ptr;
 	state_t thread_state = DSH_NO_RESP;
 	slurm_msg_type_t msg_type = task_ptr->msg_type;
-	bool is_kill_msg, srun_agent;
+	bool is_kill_msg, srun_agent, last_task;
 	List ret_list = NULL;
 	ListIterator itr;
 	ret_data_info_t *ret_data_info = NULL;
 	int found = 0;
-	int sig_array[2] = {SIGUSR1, 0};
 	/* Locks: Write job, write node */
 	slurmctld_lock_t job_write_lock = {
 		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK };
 
-	xassert(args != NULL);
-	xsignal(SIGUSR1, _sig_handler);
-	xsignal_unblock(sig_array);
+	xassert(task_ptr != NULL);
 	is_kill_msg = (	(msg_type == REQUEST_KILL_TIMELIMIT)	||
 			(msg_type == REQUEST_TERMINATE_JOB) );
 	srun_agent = (	(msg_type == SRUN_PING)			||
@@ -823,15 +965,17 @@ static void *_thread_per_group_rpc(void *args)
 
 	thread_ptr->start_time = time(NULL);
 
-	slurm_mutex_lock(thread_mutex_ptr);
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
 	thread_ptr->state = DSH_ACTIVE;
-	thread_ptr->end_time = thread_ptr->start_time + COMMAND_TIMEOUT;
-	slurm_mutex_unlock(thread_mutex_ptr);
+	slurm_mutex_unlock(&agent_ptr->thread_mutex);
 
 	/* send request message */
 	slurm_msg_t_init(&msg);
 	msg.msg_type = msg_type;
 	msg.data     = task_ptr->msg_args_ptr;
+	/* Reuse connections to slurmd daemons if so configured */
+	if (task_ptr->get_reply && !srun_agent && conn_cache_enabled())
+		msg.flags |= SLURM_KEEP_CONN;
 #if 0
  	info("sending message type %u to %s", msg_type, thread_ptr->nodelist);
 #endif
@@ -841,7 +985,7 @@ static void *_thread_per_group_rpc(void *args)
 
 			if(!(ret_list = slurm_send_addr_recv_msgs(
 				     &msg, thread_ptr->nodelist, 0))) {
-				error("_thread_per_group_rpc: "
+				error("_task_per_group_rpc: "
 				      "no ret_list given");
 				goto cleanup;
 			}
@@ -851,7 +995,7 @@ static void *_thread_per_group_rpc(void *args)
 			if(!(ret_list = slurm_send_recv_msgs(
 				     thread_ptr->nodelist,
 				     &msg, 0, true))) {
-				error("_thread_per_group_rpc: "
+				error("_task_per_group_rpc: "
 				      "no ret_list given");
 				goto cleanup;
 			}
@@ -864,7 +1008,7 @@ static void *_thread_per_group_rpc(void *args)
 			//info("no address given");
 			if(slurm_conf_get_addr(thread_ptr->nodelist,
 					       &msg.address) == SLURM_ERROR) {
-				error("_thread_per_group_rpc: "
+				error("_task_per_group_rpc: "
 				      "can't find address for host %s, "
 				      "check slurm.conf",
 				      thread_ptr->nodelist);
@@ -987,28 +1131,44 @@ static void *_thread_per_group_rpc(void *args)
 	list_iterator_destroy(itr);
 
 cleanup:
-	xfree(args);
+	xfree(task_ptr);
 
-	/* handled at end of thread just in case resend is needed */
+	/* handled at end of task just in case resend is needed */
 	destroy_forward(&msg.forward);
-	slurm_mutex_lock(thread_mutex_ptr);
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
 	thread_ptr->ret_list = ret_list;
 	thread_ptr->state = thread_state;
 	thread_ptr->end_time = (time_t) difftime(time(NULL),
 						 thread_ptr->start_time);
-	/* Signal completion so another thread can replace us */
-	(*threads_active_ptr)--;
-	pthread_cond_signal(thread_cond_ptr);
-	slurm_mutex_unlock(thread_mutex_ptr);
-	return (void *) NULL;
+	last_task = (--agent_ptr->tasks_pending == 0);
+	slurm_mutex_unlock(&agent_ptr->thread_mutex);
+
+	if (last_task)
+		_agent_complete(agent_ptr);
 }
 
 /*
- * Signal handler.  We are really interested in interrupting hung communictions
- * and causing them to return EINTR. Multiple interupts might be required.
+ * _task_expired - complete a task without sending its RPC, it waited in
+ *	the queue past its deadline. Run by an agent pool worker thread.
+ * IN/OUT task_ptr - pointer to task_info_t, xfree'd on completion
  */
-static void _sig_handler(int dummy)
+static void _task_expired(task_info_t *task_ptr)
 {
+	agent_info_t *agent_ptr = task_ptr->agent_ptr;
+	thd_t        *thread_ptr = task_ptr->thread_struct_ptr;
+	bool last_task;
+
+	xfree(task_ptr);
+
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
+	thread_ptr->start_time = time(NULL);
+	thread_ptr->end_time = 0;
+	thread_ptr->state = DSH_EXPIRED;
+	last_task = (--agent_ptr->tasks_pending == 0);
+	slurm_mutex_unlock(&agent_ptr->thread_mutex);
+
+	if (last_task)
+		_agent_complete(agent_ptr);
 }
 
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
@@ -1065,7 +1225,8 @@ static void _queue_agent_retry(agent_info_t * agent_info_ptr, int count)
 	j = 0;
 	for (i = 0; i < agent_info_ptr->thread_count; i++) {
 		if(!thread_ptr[i].ret_list) {
-			if (thread_ptr[i].state != DSH_NO_RESP)
+			if ((thread_ptr[i].state != DSH_NO_RESP) &&
+			    (thread_ptr[i].state != DSH_EXPIRED))
 				continue;
 
 			debug("got the name %s to resend",
@@ -1256,20 +1417,8 @@ void agent_queue_request(agent_arg_t *agent_arg_ptr)
 
 	if (agent_arg_ptr->msg_type == REQUEST_SHUTDOWN) {
 		/* execute now */
-		pthread_attr_t attr_agent;
-		pthread_t thread_agent;
-		int rc;
-		slurm_attr_init(&attr_agent);
-		if (pthread_attr_setdetachstate
-				(&attr_agent, PTHREAD_CREATE_DETACHED))
-			error("pthread_attr_setdetachstate error %m");
-		rc = pthread_create(&thread_agent, &attr_agent,
-				    agent, (void *) agent_arg_ptr);
-		slurm_attr_destroy(&attr_agent);
-		if (rc == 0) {
-			usleep(10000);	/* give agent a chance to start */
-			return;
-		}
+		(void) agent((void *) agent_arg_ptr);
+		return;
 	}
 
 	queued_req_ptr = xmalloc(sizeof(queued_request_t));
@@ -1291,30 +1440,15 @@ void agent_queue_request(agent_arg_t *agent_arg_ptr)
 	agent_retry(999, false);
 }
 
-/* _spawn_retry_agent - pthread_create an agent for the given task */
+/* _spawn_retry_agent - start an agent for the given task */
 static void _spawn_retry_agent(agent_arg_t * agent_arg_ptr)
 {
-	int retries = 0;
-	pthread_attr_t attr_agent;
-	pthread_t thread_agent;
-
 	if (agent_arg_ptr == NULL)
 		return;
 
 	debug2("Spawning RPC agent for msg_type %u",
 	       agent_arg_ptr->msg_type);
-	slurm_attr_init(&attr_agent);
-	if (pthread_attr_setdetachstate(&attr_agent,
-					PTHREAD_CREATE_DETACHED))
-		error("pthread_attr_setdetachstate error %m");
-	while (pthread_create(&thread_agent, &attr_agent,
-			agent, (void *) agent_arg_ptr)) {
-		error("pthread_create error %m");
-		if (++retries > MAX_RETRIES)
-			fatal("Can't create pthread");
-		usleep(10000);	/* sleep and retry */
-	}
-	slurm_attr_destroy(&attr_agent);
+	(void) agent((void *) agent_arg_ptr);
 }
 
 /* _slurmctld_free_batch_job_launch_msg is a variant of
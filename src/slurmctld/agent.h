@@ -44,13 +44,15 @@
 
 #include "src/slurmctld/slurmctld.h"
 
-#define AGENT_THREAD_COUNT	10	/* maximum active threads per agent */
-#define COMMAND_TIMEOUT 	30	/* command requeue or error, seconds */
+#define AGENT_THREAD_COUNT	10	/* agent threads per agent */
+#define COMMAND_TIMEOUT 	30	/* agent task deadline, seconds, an RPC
+					 *   not sent by then is dropped or
+					 *   retried */
 #define MAX_AGENT_CNT		(MAX_SERVER_THREADS / (AGENT_THREAD_COUNT + 2))
 					/* maximum simultaneous agents, note
-					 *   total thread count is product of
-					 *   MAX_AGENT_CNT and
-					 *   (AGENT_THREAD_COUNT + 2) */
+					 *   the agent thread pool size is
+					 *   the product of MAX_AGENT_CNT
+					 *   and AGENT_THREAD_COUNT */
 
 typedef struct agent_arg {
 	uint32_t	node_count;	/* number of nodes to communicate
@@ -98,6 +100,10 @@ extern void agent_purge (void);
 /* get_agent_count - find out how many active agents we have */
 extern int get_agent_count(void);
 
+/* agent_stats_report - Log agent thread pool statistics accumulated since
+ *	the last report, then clear them */
+extern void agent_stats_report(void);
+
 /*
  * mail_job_info - Send e-mail notice of job state change
  * IN job_ptr - job identification
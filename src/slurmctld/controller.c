@@ -58,10 +58,15 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 
+#ifdef HAVE_SYS_EPOLL_H
+#  include <sys/epoll.h>
+#endif
+
 #include "slurm/slurm_errno.h"
 
 #include "src/common/assoc_mgr.h"
 #include "src/common/checkpoint.h"
+#include "src/common/conn_cache.h"
 #include "src/common/daemonize.h"
 #include "src/common/fd.h"
 #include "src/common/gres.h"
@@ -88,6 +93,7 @@
 #include "src/slurmctld/acct_policy.h"
 #include "src/slurmctld/agent.h"
 #include "src/slurmctld/front_end.h"
+#include "src/slurmctld/info_snapshot.h"
 #include "src/slurmctld/job_scheduler.h"
 #include "src/slurmctld/job_submit.h"
 #include "src/slurmctld/licenses.h"
@@ -115,6 +121,9 @@
 #define MIN_CHECKIN_TIME  3	/* Nodes have this number of seconds to
 				 * check-in before we ping them */
 #define SHUTDOWN_WAIT     2	/* Time to wait for backup server shutdown */
+#define RPC_EPOLL_EVENTS  64	/* Events to collect per epoll_wait() call */
+#define RPC_MAX_MSG_SIZE  (128*1024*1024) /* Same limit as MAX_MSG_SIZE
+					   * in the socket implementation */
 
 #if (0)
 /* If defined and FastSchedule=0 in slurm.conf, then report the CPU count that a
@@ -168,10 +177,31 @@ static int	debug_level = 0;
 static char	*debug_logfile = NULL;
 static bool     dump_core = false;
 static uint32_t max_server_threads = MAX_SERVER_THREADS;
+static int	max_rpc_conns = MAX_RPC_CONNECTIONS;
+static int	rpc_worker_threads = RPC_WORKER_THREADS;
 static int	new_nice = 0;
 static char	node_name[MAX_SLURM_NAME];
 static int	recover   = DEFAULT_RECOVER;
 static pthread_cond_t server_thread_cond = PTHREAD_COND_INITIALIZER;
+
+/* RPC service statistics and work queue, protected by rpc_queue_lock */
+static pthread_mutex_t rpc_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+	uint32_t queue_depth;	/* complete RPCs waiting for a worker */
+	uint32_t queue_max;	/* high water mark of queue_depth */
+	uint32_t cnt;		/* RPCs serviced */
+	uint64_t wait_usec;	/* total time RPCs waited for a worker */
+	uint64_t svc_usec;	/* total time in slurmctld_req() */
+	uint64_t svc_max_usec;	/* longest time in slurmctld_req() */
+} rpc_stats;
+#ifdef HAVE_SYS_EPOLL_H
+static pthread_cond_t rpc_queue_cond = PTHREAD_COND_INITIALIZER;
+/* connections being read, least recently active first */
+static struct connection_arg *rpc_conn_head = NULL, *rpc_conn_tail = NULL;
+static int	rpc_conn_cnt = 0;
+static List	rpc_work_list = NULL;	/* complete RPCs for workers */
+static bool	rpc_workers_fini = false;
+#endif
 static pid_t	slurmctld_pid;
 static char    *slurm_conf_filename;
 static int      primary = 1 ;
@@ -198,6 +228,7 @@ static void         _parse_commandline(int argc, char *argv[]);
 inline static int   _ping_backup_controller(void);
 static void         _remove_assoc(slurmdb_association_rec_t *rec);
 static void         _remove_qos(slurmdb_qos_rec_t *rec);
+static void         _rpc_stats_report(void);
 static void         _update_assoc(slurmdb_association_rec_t *rec);
 static void         _update_qos(slurmdb_qos_rec_t *rec);
 inline static int   _report_locks_set(void);
@@ -211,12 +242,35 @@ inline static void  _update_cred_key(void);
 static void         _update_nice(void);
 inline static void  _usage(char *prog_name);
 static bool         _valid_controller(void);
+#ifndef HAVE_SYS_EPOLL_H
 static bool         _wait_for_server_thread(void);
+#endif
 
 typedef struct connection_arg {
 	int newsockfd;
+#ifdef HAVE_SYS_EPOLL_H
+	bool listen;		/* listening socket rather than a connection */
+	time_t last_active;	/* time data was last received */
+	struct connection_arg *prev, *next; /* rpc_conn_head list links */
+	char len_buf[4];	/* message length prefix, network order */
+	uint32_t len_read;	/* bytes of len_buf received */
+	uint32_t msg_len;	/* message length, host order */
+	char *msg_buf;		/* message body */
+	uint32_t msg_read;	/* bytes of msg_buf received */
+	struct timeval queue_time; /* time queued for a worker thread */
+#endif
 } connection_arg_t;
 
+#ifdef HAVE_SYS_EPOLL_H
+static void         _rpc_conn_add(int epoll_fd, slurm_fd_t newsockfd);
+static void         _rpc_conn_close(int epoll_fd, connection_arg_t *conn_arg);
+static void         _rpc_conn_link(connection_arg_t *conn_arg);
+static void         _rpc_conn_read(int epoll_fd, connection_arg_t *conn_arg);
+static void         _rpc_conn_unlink(connection_arg_t *conn_arg);
+static int          _rpc_queue_depth(void);
+static void *       _rpc_worker(void *no_data);
+#endif
+
 /* main - slurmctld main function, start various threads and process RPCs */
 int main(int argc, char *argv[])
 {
@@ -276,6 +330,7 @@ int main(int argc, char *argv[])
 	} else {
 		slurmctld_config.daemonize = 0;
 	}
+	log_async_init();
 
 	/*
 	 * Need to create pidfile here in case we setuid() below
@@ -643,6 +698,7 @@ int main(int argc, char *argv[])
 	}
 	if (i >= 10)
 		error("Left %d agent threads active", cnt);
+	conn_cache_fini();
 
 	slurm_sched_fini();	/* Stop all scheduling */
 
@@ -653,6 +709,7 @@ int main(int argc, char *argv[])
 	purge_front_end_state();
 	resv_fini();
 	trigger_fini();
+	info_snapshot_fini();
 	dir_name = slurm_get_state_save_location();
 	assoc_mgr_fini(dir_name);
 	xfree(dir_name);
@@ -852,6 +909,378 @@ static void _sig_handler(int signal)
 {
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+/* _slurmctld_rpc_mgr - Read incoming RPCs without blocking and queue each
+ *	fully received message for the pool of RPC worker threads */
+static void *_slurmctld_rpc_mgr(void *no_data)
+{
+	slurm_fd_t newsockfd;
+	slurm_fd_t *sockfd;	/* our set of socket file descriptors */
+	slurm_addr_t cli_addr, srv_addr;
+	uint16_t port;
+	char ip[32];
+	pthread_t *worker_ids;
+	pthread_attr_t thread_attr_rpc_req;
+	int epoll_fd, ev_cnt, i, nports, worker_cnt = 0;
+	bool listening = true;
+	struct epoll_event ev, *events;
+	connection_arg_t *conn_arg, *listen_arg;
+	time_t now, last_sweep = (time_t) 0;
+	int msg_timeout;
+	/* Locks: Read config */
+	slurmctld_lock_t config_read_lock = {
+		READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	int sigarray[] = {SIGUSR1, 0};
+	char* node_addr = NULL;
+
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+	(void) pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+	debug3("_slurmctld_rpc_mgr pid = %u", getpid());
+
+	/* set node_addr to bind to (NULL means any) */
+	if (slurmctld_conf.backup_controller && slurmctld_conf.backup_addr &&
+	    (strcmp(node_name, slurmctld_conf.backup_controller) == 0) &&
+	    (strcmp(slurmctld_conf.backup_controller,
+		    slurmctld_conf.backup_addr) != 0)) {
+		node_addr = slurmctld_conf.backup_addr ;
+	}
+	else if (_valid_controller() &&
+		 strcmp(slurmctld_conf.control_machine,
+			 slurmctld_conf.control_addr)) {
+		node_addr = slurmctld_conf.control_addr ;
+	}
+
+	if ((epoll_fd = epoll_create(max_rpc_conns + 1)) < 0)
+		fatal("epoll_create: %m");
+	fd_set_close_on_exec(epoll_fd);
+	events = xmalloc(sizeof(struct epoll_event) * RPC_EPOLL_EVENTS);
+
+	/* initialize ports for RPCs */
+	lock_slurmctld(config_read_lock);
+	nports = slurmctld_conf.slurmctld_port_count;
+	sockfd = xmalloc(sizeof(slurm_fd_t) * nports);
+	listen_arg = xmalloc(sizeof(connection_arg_t) * nports);
+	for (i=0; i<nports; i++) {
+		sockfd[i] = slurm_init_msg_engine_addrname_port(
+					node_addr,
+					slurmctld_conf.slurmctld_port+i);
+		if (sockfd[i] == SLURM_SOCKET_ERROR)
+			fatal("slurm_init_msg_engine_addrname_port error %m");
+		slurm_get_stream_addr(sockfd[i], &srv_addr);
+		slurm_get_ip_str(&srv_addr, &port, ip, sizeof(ip));
+		debug2("slurmctld listening on %s:%d", ip, ntohs(port));
+		fd_set_nonblocking(sockfd[i]);
+		listen_arg[i].newsockfd = sockfd[i];
+		listen_arg[i].listen = true;
+		ev.events = EPOLLIN;
+		ev.data.ptr = &listen_arg[i];
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd[i], &ev) < 0)
+			fatal("epoll_ctl: %m");
+	}
+	unlock_slurmctld(config_read_lock);
+	msg_timeout = slurm_get_msg_timeout();
+
+	/* start the pool of threads which process complete RPCs */
+	rpc_work_list = list_create(NULL);
+	rpc_workers_fini = false;
+	worker_ids = xmalloc(sizeof(pthread_t) * rpc_worker_threads);
+	slurm_attr_init(&thread_attr_rpc_req);
+	for (i = 0; i < rpc_worker_threads; i++) {
+		if (pthread_create(&worker_ids[worker_cnt],
+				   &thread_attr_rpc_req,
+				   _rpc_worker, NULL)) {
+			error("pthread_create: %m");
+			continue;
+		}
+		worker_cnt++;
+	}
+	slurm_attr_destroy(&thread_attr_rpc_req);
+	if (worker_cnt == 0)
+		fatal("Unable to create any RPC worker threads");
+	debug2("slurmctld started %d RPC worker threads", worker_cnt);
+
+	/* Prepare to catch SIGUSR1 to interrupt epoll_wait().
+	 * This signal is generated by the slurmctld signal
+	 * handler thread upon receipt of SIGABRT, SIGINT,
+	 * or SIGTERM. That thread does all processing of
+	 * all signals. */
+	xsignal(SIGUSR1, _sig_handler);
+	xsignal_unblock(sigarray);
+
+	/*
+	 * Process incoming RPCs until told to shutdown
+	 */
+	while (slurmctld_config.shutdown_time == 0) {
+		/* Stop accepting new connections while too many are
+		 * open, the kernel's listen queue absorbs the excess */
+		if (listening &&
+		    (rpc_conn_cnt + _rpc_queue_depth() >=
+		     max_rpc_conns)) {
+			for (i = 0; i < nports; i++)
+				(void) epoll_ctl(epoll_fd, EPOLL_CTL_DEL,
+						 sockfd[i], &ev);
+			listening = false;
+			debug("RPC connection count over limit (%d), "
+			      "deferring accept", max_rpc_conns);
+		} else if (!listening &&
+			   (rpc_conn_cnt + _rpc_queue_depth() <
+			    max_rpc_conns)) {
+			for (i = 0; i < nports; i++) {
+				ev.events = EPOLLIN;
+				ev.data.ptr = &listen_arg[i];
+				(void) epoll_ctl(epoll_fd, EPOLL_CTL_ADD,
+						 sockfd[i], &ev);
+			}
+			listening = true;
+		}
+
+		ev_cnt = epoll_wait(epoll_fd, events, RPC_EPOLL_EVENTS, 1000);
+		if (ev_cnt < 0) {
+			if (errno != EINTR)
+				error("_slurmctld_rpc_mgr epoll_wait: %m");
+			continue;
+		}
+
+		for (i = 0; i < ev_cnt; i++) {
+			conn_arg = (connection_arg_t *) events[i].data.ptr;
+			if (!conn_arg->listen) {
+				_rpc_conn_read(epoll_fd, conn_arg);
+				continue;
+			}
+			/* accept every pending connection on this port */
+			while (rpc_conn_cnt + _rpc_queue_depth() <
+			       max_rpc_conns) {
+				newsockfd = slurm_accept_msg_conn(
+					conn_arg->newsockfd, &cli_addr);
+				if (newsockfd == SLURM_SOCKET_ERROR) {
+					if ((errno != EAGAIN) &&
+					    (errno != EWOULDBLOCK) &&
+					    (errno != EINTR))
+						error("slurm_accept_msg_conn: "
+						      "%m");
+					break;
+				}
+				_rpc_conn_add(epoll_fd, newsockfd);
+			}
+		}
+
+		/* Close connections which have been idle for more than
+		 * MessageTimeout. The list is kept in order of last
+		 * activity, so stop at the first active connection */
+		now = time(NULL);
+		if (difftime(now, last_sweep) < 1)
+			continue;
+		last_sweep = now;
+		while ((conn_arg = rpc_conn_head) &&
+		       (difftime(now, conn_arg->last_active) > msg_timeout)) {
+			debug("RPC connection timed out after %d bytes",
+			      conn_arg->len_read + conn_arg->msg_read);
+			_rpc_conn_unlink(conn_arg);
+			_rpc_conn_close(epoll_fd, conn_arg);
+		}
+	}
+
+	debug3("_slurmctld_rpc_mgr shutting down");
+	for (i=0; i<nports; i++)
+		(void) slurm_shutdown_msg_engine(sockfd[i]);
+	xfree(sockfd);
+	xfree(listen_arg);
+	while ((conn_arg = rpc_conn_head)) {
+		_rpc_conn_unlink(conn_arg);
+		_rpc_conn_close(epoll_fd, conn_arg);
+	}
+	(void) close(epoll_fd);
+	xfree(events);
+
+	/* Let the workers drain any queued RPCs and exit */
+	slurm_mutex_lock(&rpc_queue_lock);
+	rpc_workers_fini = true;
+	pthread_cond_broadcast(&rpc_queue_cond);
+	slurm_mutex_unlock(&rpc_queue_lock);
+	_free_server_thread();
+	for (i = 0; i < worker_cnt; i++)
+		pthread_join(worker_ids[i], NULL);
+	xfree(worker_ids);
+	list_destroy(rpc_work_list);
+	rpc_work_list = NULL;
+
+	pthread_exit((void *) 0);
+	return NULL;
+}
+
+/* Start tracking a newly accepted connection */
+static void _rpc_conn_add(int epoll_fd, slurm_fd_t newsockfd)
+{
+	connection_arg_t *conn_arg;
+	struct epoll_event ev;
+
+	conn_arg = xmalloc(sizeof(connection_arg_t));
+	conn_arg->newsockfd = newsockfd;
+	conn_arg->last_active = time(NULL);
+	fd_set_nonblocking(newsockfd);
+	fd_set_close_on_exec(newsockfd);
+	ev.events = EPOLLIN;
+	ev.data.ptr = conn_arg;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, newsockfd, &ev) < 0) {
+		error("epoll_ctl: %m");
+		slurm_close_accepted_conn(newsockfd);
+		xfree(conn_arg);
+		return;
+	}
+	_rpc_conn_link(conn_arg);
+}
+
+/* Add a connection to the tail (most recently active end) of the list */
+static void _rpc_conn_link(connection_arg_t *conn_arg)
+{
+	conn_arg->prev = rpc_conn_tail;
+	conn_arg->next = NULL;
+	if (rpc_conn_tail)
+		rpc_conn_tail->next = conn_arg;
+	else
+		rpc_conn_head = conn_arg;
+	rpc_conn_tail = conn_arg;
+	rpc_conn_cnt++;
+}
+
+/* Remove a connection from the list */
+static void _rpc_conn_unlink(connection_arg_t *conn_arg)
+{
+	if (conn_arg->prev)
+		conn_arg->prev->next = conn_arg->next;
+	else
+		rpc_conn_head = conn_arg->next;
+	if (conn_arg->next)
+		conn_arg->next->prev = conn_arg->prev;
+	else
+		rpc_conn_tail = conn_arg->prev;
+	conn_arg->prev = conn_arg->next = NULL;
+	rpc_conn_cnt--;
+}
+
+/* Stop tracking a connection and release its resources */
+static void _rpc_conn_close(int epoll_fd, connection_arg_t *conn_arg)
+{
+	(void) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn_arg->newsockfd, NULL);
+	slurm_close_accepted_conn(conn_arg->newsockfd);
+	xfree(conn_arg->msg_buf);
+	xfree(conn_arg);
+}
+
+/* Read whatever data is available on a connection. Once the message length
+ * and body have been completely received, queue it for a worker thread */
+static void _rpc_conn_read(int epoll_fd, connection_arg_t *conn_arg)
+{
+	ssize_t len;
+	uint32_t msg_len;
+
+	/* Data (or EOF) is pending, move to the most recently active end */
+	_rpc_conn_unlink(conn_arg);
+	conn_arg->last_active = time(NULL);
+	_rpc_conn_link(conn_arg);
+
+	while (conn_arg->len_read < sizeof(msg_len)) {
+		len = read(conn_arg->newsockfd,
+			   conn_arg->len_buf + conn_arg->len_read,
+			   sizeof(msg_len) - conn_arg->len_read);
+		if (len > 0) {
+			conn_arg->len_read += len;
+			continue;
+		}
+		if ((len < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+			return;
+		goto close_conn;	/* EOF or error */
+	}
+
+	if (conn_arg->msg_buf == NULL) {
+		memcpy(&msg_len, conn_arg->len_buf, sizeof(msg_len));
+		conn_arg->msg_len = ntohl(msg_len);
+		if (conn_arg->msg_len > RPC_MAX_MSG_SIZE) {
+			error("_rpc_conn_read: insane message length %u",
+			      conn_arg->msg_len);
+			goto close_conn;
+		}
+		conn_arg->msg_buf = xmalloc(conn_arg->msg_len);
+	}
+
+	while (conn_arg->msg_read < conn_arg->msg_len) {
+		len = read(conn_arg->newsockfd,
+			   conn_arg->msg_buf + conn_arg->msg_read,
+			   conn_arg->msg_len - conn_arg->msg_read);
+		if (len > 0) {
+			conn_arg->msg_read += len;
+			continue;
+		}
+		if ((len < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+			return;
+		goto close_conn;	/* EOF or error */
+	}
+
+	/* Complete message, hand off to worker with a blocking socket
+	 * for the response */
+	_rpc_conn_unlink(conn_arg);
+	(void) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn_arg->newsockfd, NULL);
+	fd_set_blocking(conn_arg->newsockfd);
+	gettimeofday(&conn_arg->queue_time, NULL);
+
+	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+	slurmctld_config.server_thread_count++;
+	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+
+	slurm_mutex_lock(&rpc_queue_lock);
+	list_enqueue(rpc_work_list, conn_arg);
+	rpc_stats.queue_depth++;
+	if (rpc_stats.queue_depth > rpc_stats.queue_max)
+		rpc_stats.queue_max = rpc_stats.queue_depth;
+	pthread_cond_signal(&rpc_queue_cond);
+	slurm_mutex_unlock(&rpc_queue_lock);
+	return;
+
+close_conn:
+	_rpc_conn_unlink(conn_arg);
+	_rpc_conn_close(epoll_fd, conn_arg);
+}
+
+/* Number of complete messages waiting for a worker thread */
+static int _rpc_queue_depth(void)
+{
+	int depth;
+
+	slurm_mutex_lock(&rpc_queue_lock);
+	depth = rpc_stats.queue_depth;
+	slurm_mutex_unlock(&rpc_queue_lock);
+
+	return depth;
+}
+
+/* _rpc_worker - Process complete RPCs queued by _slurmctld_rpc_mgr until
+ *	shutdown and an empty queue */
+static void *_rpc_worker(void *no_data)
+{
+	connection_arg_t *conn_arg;
+	struct timeval now;
+
+	while (1) {
+		slurm_mutex_lock(&rpc_queue_lock);
+		while (((conn_arg = list_dequeue(rpc_work_list)) == NULL) &&
+		       !rpc_workers_fini) {
+			pthread_cond_wait(&rpc_queue_cond, &rpc_queue_lock);
+		}
+		if (conn_arg) {
+			rpc_stats.queue_depth--;
+			gettimeofday(&now, NULL);
+			rpc_stats.wait_usec += slurm_diff_tv(
+				&conn_arg->queue_time, &now);
+		}
+		slurm_mutex_unlock(&rpc_queue_lock);
+		if (conn_arg == NULL)
+			break;
+		_service_connection((void *) conn_arg);
+	}
+
+	return NULL;
+}
+#else
 /* _slurmctld_rpc_mgr - Read incoming RPCs and create pthread for each */
 static void *_slurmctld_rpc_mgr(void *no_data)
 {
@@ -986,6 +1415,8 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	return NULL;
 }
 
+#endif	/* HAVE_SYS_EPOLL_H */
+
 /*
  * _service_connection - service the RPC
  * IN/OUT arg - really just the connection's file descriptor, freed
@@ -997,13 +1428,24 @@ static void *_service_connection(void *arg)
 	connection_arg_t *conn = (connection_arg_t *) arg;
 	void *return_code = NULL;
 	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
+	int rc;
+	long delta_t;
+	DEF_TIMERS;
 
 	slurm_msg_t_init(msg);
 	/*
 	 * slurm_receive_msg sets msg connection fd to accepted fd. This allows
 	 * possibility for slurmctld_req() to close accepted connection.
 	 */
-	if(slurm_receive_msg(conn->newsockfd, msg, 0) != 0) {
+#ifdef HAVE_SYS_EPOLL_H
+	/* Message was already read by _slurmctld_rpc_mgr */
+	rc = slurm_unpack_received_msg(msg, conn->newsockfd, conn->msg_buf,
+				       conn->msg_len);
+	conn->msg_buf = NULL;
+#else
+	rc = slurm_receive_msg(conn->newsockfd, msg, 0);
+#endif
+	if (rc != 0) {
 		error("slurm_receive_msg: %m");
 		/* close should only be called when the socket implementation
 		 * is being used the following call will be a no-op in a
@@ -1020,7 +1462,16 @@ static void *_service_connection(void *arg)
 			info("_service_connection/slurm_receive_msg %m");
 	} else {
 		/* process the request */
+		START_TIMER;
 		slurmctld_req(msg);
+		END_TIMER;
+		delta_t = DELTA_TIMER;
+		slurm_mutex_lock(&rpc_queue_lock);
+		rpc_stats.cnt++;
+		rpc_stats.svc_usec += delta_t;
+		if (delta_t > rpc_stats.svc_max_usec)
+			rpc_stats.svc_max_usec = delta_t;
+		slurm_mutex_unlock(&rpc_queue_lock);
 	}
 	if ((conn->newsockfd >= 0)
 	    && slurm_close_accepted_conn(conn->newsockfd) < 0)
@@ -1033,6 +1484,7 @@ cleanup:
 	return return_code;
 }
 
+#ifndef HAVE_SYS_EPOLL_H
 /* Increment slurmctld_config.server_thread_count and don't return
  * until its value is no larger than MAX_SERVER_THREADS,
  * RET true unless shutdown in progress */
@@ -1075,6 +1527,7 @@ static bool _wait_for_server_thread(void)
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 	return rc;
 }
+#endif
 
 static void _free_server_thread(void)
 {
@@ -1087,6 +1540,29 @@ static void _free_server_thread(void)
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 }
 
+/* Log RPC queue and service time statistics accumulated since the
+ * previous report, then reset them */
+static void _rpc_stats_report(void)
+{
+	slurm_mutex_lock(&rpc_queue_lock);
+	if (rpc_stats.cnt) {
+		debug("RPC stats: count=%u queue_depth=%u max_queue_depth=%u "
+		      "avg_wait_usec=%"PRIu64" avg_service_usec=%"PRIu64" "
+		      "max_service_usec=%"PRIu64,
+		      rpc_stats.cnt, rpc_stats.queue_depth,
+		      rpc_stats.queue_max,
+		      rpc_stats.wait_usec / rpc_stats.cnt,
+		      rpc_stats.svc_usec / rpc_stats.cnt,
+		      rpc_stats.svc_max_usec);
+	}
+	rpc_stats.queue_max = rpc_stats.queue_depth;
+	rpc_stats.cnt = 0;
+	rpc_stats.wait_usec = 0;
+	rpc_stats.svc_usec = 0;
+	rpc_stats.svc_max_usec = 0;
+	slurm_mutex_unlock(&rpc_queue_lock);
+}
+
 static int _accounting_cluster_ready()
 {
 	struct node_record *node_ptr;
@@ -1278,6 +1754,7 @@ static void *_slurmctld_background(void *no_data)
 	static time_t last_node_acct;
 	static time_t last_ctld_bu_ping;
 	static time_t last_uid_update;
+	static time_t last_stats;
 	static bool ping_msg_sent = false;
 	time_t now;
 	int no_resp_msg_interval, ping_interval, purge_job_interval;
@@ -1313,7 +1790,7 @@ static void *_slurmctld_background(void *no_data)
 	last_purge_job_time = last_trigger = last_health_check_time = now;
 	last_timelimit_time = last_assert_primary_time = now;
 	last_no_resp_msg_time = last_resv_time = last_ctld_bu_ping = now;
-	last_uid_update = now;
+	last_uid_update = last_stats = now;
 
 	if ((slurmctld_conf.min_job_age > 0) &&
 	    (slurmctld_conf.min_job_age < PURGE_JOB_INTERVAL)) {
@@ -1535,6 +2012,18 @@ static void *_slurmctld_background(void *no_data)
 			assoc_mgr_set_missing_uids();
 		}
 
+		if (difftime(now, last_stats) >= PERIODIC_STATS) {
+			now = time(NULL);
+			last_stats = now;
+			_rpc_stats_report();
+			lock_stats_report();
+			assoc_mgr_lock_stats_report();
+			info_snapshot_stats_report();
+			job_pack_stats_report();
+			conn_cache_stats_report();
+			agent_stats_report();
+		}
+
 		END_TIMER2("_slurmctld_background");
 	}
 
@@ -2102,11 +2591,22 @@ static void _test_thread_limit(void)
 	struct rlimit rlim[1];
 	if (getrlimit(RLIMIT_NOFILE, rlim) < 0)
 		error("Unable to get file count limit");
-	else if ((rlim->rlim_cur != RLIM_INFINITY) &&
-		 (max_server_threads > rlim->rlim_cur)) {
-		max_server_threads = rlim->rlim_cur;
-		info("Reducing max_server_thread to %u due to file count limit "
-		     "of %u", max_server_threads, max_server_threads);
+	else if (rlim->rlim_cur != RLIM_INFINITY) {
+		if (max_server_threads > rlim->rlim_cur) {
+			max_server_threads = rlim->rlim_cur;
+			info("Reducing max_server_thread to %u due to file "
+			     "count limit of %u",
+			     max_server_threads, max_server_threads);
+			if (rpc_worker_threads > max_server_threads)
+				rpc_worker_threads = max_server_threads;
+		}
+		/* Leave file descriptors for state files, agents, etc. */
+		if (max_rpc_conns > (rlim->rlim_cur / 2)) {
+			max_rpc_conns = MAX(rlim->rlim_cur / 2, 1);
+			info("Reducing max_rpc_conns to %d due to file "
+			     "count limit of %u",
+			     max_rpc_conns, (uint32_t) rlim->rlim_cur);
+		}
 	}
 }
 #endif
@@ -579,16 +579,16 @@ extern int dump_all_front_end_state(void)
 extern int load_all_front_end_state(bool state_only)
 {
 #ifdef HAVE_FRONT_END
-	char *node_name = NULL, *reason = NULL, *data = NULL, *state_file;
-	int data_allocated, data_read = 0, error_code = 0, node_cnt = 0;
+	char *node_name = NULL, *reason = NULL, *state_file;
+	int error_code = 0, node_cnt = 0;
 	uint16_t node_state;
-	uint32_t data_size = 0, name_len;
+	uint32_t name_len;
 	uint32_t reason_uid = NO_VAL;
 	time_t reason_time = 0;
 	front_end_record_t *front_end_ptr;
 	int state_fd;
 	time_t time_stamp;
-	Buf buffer;
+	Buf buffer = NULL;
 	char *ver_str = NULL;
 	uint16_t protocol_version = (uint16_t) NO_VAL;
 
@@ -599,30 +599,16 @@ extern int load_all_front_end_state(bool state_only)
 		info ("No node state file (%s) to recover", state_file);
 		error_code = ENOENT;
 	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size], BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error ("Read error on %s: %m",
-						state_file);
-					break;
-				}
-			} else if (data_read == 0)     /* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close (state_fd);
+		buffer = create_mmap_buf(state_fd);
+		if (buffer == NULL)
+			error("Read error on %s: %m", state_file);
+		close(state_fd);
 	}
 	xfree (state_file);
 	unlock_state_files ();
 
-	buffer = create_buf (data, data_size);
+	if (buffer == NULL)
+		buffer = create_buf(NULL, 0);
 
 	safe_unpackstr_xmalloc( &ver_str, &name_len, buffer);
 	debug3("Version string in front_end_state header is %s", ver_str);
@@ -0,0 +1,248 @@
+/*****************************************************************************\
+ *  info_snapshot.c - shared packed copies of job, node and partition
+ *	information for read-only RPCs
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#ifdef WITH_PTHREADS
+#  include <pthread.h>
+#endif
+
+#include <time.h>
+
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+
+#include "src/slurmctld/info_snapshot.h"
+#include "src/slurmctld/slurmctld.h"
+
+/* Snapshots kept for each type of information (different show_flags or
+ * protocol versions) */
+#define INFO_SNAPSHOT_SLOTS 4
+
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+static info_snapshot_t *snapshots[INFO_SNAPSHOT_TYPES][INFO_SNAPSHOT_SLOTS];
+
+/* Statistics, protected by snapshot_lock */
+static uint32_t fresh_hits = 0;	/* served from an up to date snapshot */
+static uint32_t stale_hits = 0;	/* served from an older snapshot
+				 * because the locks were busy */
+static uint32_t misses = 0;	/* no usable snapshot */
+static uint32_t publishes = 0;	/* snapshots created */
+
+static void _snapshot_free(info_snapshot_t *snapshot)
+{
+	xfree(snapshot->data);
+	xfree(snapshot);
+}
+
+extern time_t info_snapshot_update_time(info_snapshot_type_t type)
+{
+	time_t update_time = slurmctld_conf.last_update;
+
+	update_time = MAX(update_time, last_part_update);
+	if (type == INFO_SNAPSHOT_JOB)
+		update_time = MAX(update_time, last_job_update);
+	else if (type == INFO_SNAPSHOT_NODE)
+		update_time = MAX(update_time, last_node_update);
+
+	return update_time;
+}
+
+extern info_snapshot_t *info_snapshot_get(info_snapshot_type_t type,
+					  uint16_t show_flags,
+					  uint16_t protocol_version,
+					  bool locked)
+{
+	info_snapshot_t *snapshot, *found = NULL;
+	time_t now = time(NULL);
+	time_t update_time = 0;
+	int i;
+
+	/* The update times are only read under the caller's locks */
+	if (locked)
+		update_time = info_snapshot_update_time(type);
+
+	show_flags &= (~SHOW_ALL);
+	slurm_mutex_lock(&snapshot_lock);
+	for (i = 0; i < INFO_SNAPSHOT_SLOTS; i++) {
+		snapshot = snapshots[type][i];
+		if ((snapshot == NULL) ||
+		    (snapshot->show_flags != show_flags) ||
+		    (snapshot->protocol_version != protocol_version))
+			continue;
+		if (locked) {
+			/* Fresh if packed after the second of the last
+			 * update */
+			if (snapshot->pack_time > update_time) {
+				fresh_hits++;
+				found = snapshot;
+			}
+		} else if (difftime(now, snapshot->pack_time) <=
+			   INFO_SNAPSHOT_MAX_AGE) {
+			stale_hits++;
+			found = snapshot;
+		}
+		break;
+	}
+	if (found)
+		found->ref_cnt++;
+	else
+		misses++;
+	slurm_mutex_unlock(&snapshot_lock);
+
+	return found;
+}
+
+extern bool info_snapshot_public(info_snapshot_type_t type,
+				 uint16_t show_flags)
+{
+	uint16_t private_flag;
+
+	if (type == INFO_SNAPSHOT_JOB) {
+		/* Batch script is only packed for the job's owner */
+		if (show_flags & SHOW_DETAIL)
+			return false;
+		private_flag = PRIVATE_DATA_JOBS;
+	} else if (type == INFO_SNAPSHOT_NODE)
+		private_flag = PRIVATE_DATA_NODES;
+	else
+		private_flag = PRIVATE_DATA_PARTITIONS;
+
+	if (slurmctld_conf.private_data & private_flag)
+		return false;
+	if (part_access_restricted())
+		return false;
+	return true;
+}
+
+extern info_snapshot_t *info_snapshot_publish(info_snapshot_type_t type,
+					      uint16_t show_flags,
+					      uint16_t protocol_version,
+					      time_t pack_time,
+					      char *data, int data_size)
+{
+	info_snapshot_t *snapshot, *old_snapshot = NULL;
+	int i, slot = -1;
+
+	snapshot = xmalloc(sizeof(info_snapshot_t));
+	snapshot->data = data;
+	snapshot->data_size = data_size;
+	snapshot->pack_time = pack_time;
+	snapshot->update_time = info_snapshot_update_time(type);
+	snapshot->protocol_version = protocol_version;
+	snapshot->show_flags = show_flags & (~SHOW_ALL);
+	snapshot->ref_cnt = 2;	/* cache and caller */
+
+	slurm_mutex_lock(&snapshot_lock);
+	/* Replace the snapshot for the same request, an empty slot or the
+	 * oldest snapshot, in that order of preference */
+	for (i = 0; i < INFO_SNAPSHOT_SLOTS; i++) {
+		old_snapshot = snapshots[type][i];
+		if (old_snapshot == NULL) {
+			if (slot == -1)
+				slot = i;
+			continue;
+		}
+		if ((old_snapshot->show_flags == snapshot->show_flags) &&
+		    (old_snapshot->protocol_version == protocol_version)) {
+			slot = i;
+			break;
+		}
+		if ((slot == -1) ||
+		    (snapshots[type][slot] &&
+		     (old_snapshot->pack_time <
+		      snapshots[type][slot]->pack_time)))
+			slot = i;
+	}
+	old_snapshot = snapshots[type][slot];
+	snapshots[type][slot] = snapshot;
+	publishes++;
+	if (old_snapshot && (--old_snapshot->ref_cnt == 0))
+		_snapshot_free(old_snapshot);
+	slurm_mutex_unlock(&snapshot_lock);
+
+	return snapshot;
+}
+
+extern void info_snapshot_put(info_snapshot_t *snapshot)
+{
+	bool free_it;
+
+	slurm_mutex_lock(&snapshot_lock);
+	free_it = (--snapshot->ref_cnt == 0);
+	slurm_mutex_unlock(&snapshot_lock);
+
+	if (free_it)
+		_snapshot_free(snapshot);
+}
+
+extern void info_snapshot_stats_report(void)
+{
+	slurm_mutex_lock(&snapshot_lock);
+	if (fresh_hits || stale_hits || misses) {
+		debug("Info snapshot stats: fresh_hits=%u stale_hits=%u "
+		      "misses=%u published=%u",
+		      fresh_hits, stale_hits, misses, publishes);
+	}
+	fresh_hits = stale_hits = misses = publishes = 0;
+	slurm_mutex_unlock(&snapshot_lock);
+}
+
+extern void info_snapshot_purge(void)
+{
+	info_snapshot_t *snapshot;
+	int i, j;
+
+	slurm_mutex_lock(&snapshot_lock);
+	for (i = 0; i < INFO_SNAPSHOT_TYPES; i++) {
+		for (j = 0; j < INFO_SNAPSHOT_SLOTS; j++) {
+			snapshot = snapshots[i][j];
+			snapshots[i][j] = NULL;
+			if (snapshot && (--snapshot->ref_cnt == 0))
+				_snapshot_free(snapshot);
+		}
+	}
+	slurm_mutex_unlock(&snapshot_lock);
+}
+
+extern void info_snapshot_fini(void)
+{
+	info_snapshot_purge();
+}
@@ -0,0 +1,148 @@
+/*****************************************************************************\
+ *  info_snapshot.h - shared packed copies of job, node and partition
+ *	information for read-only RPCs
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _HAVE_INFO_SNAPSHOT_H
+#define _HAVE_INFO_SNAPSHOT_H
+
+#include "src/slurmctld/slurmctld.h"
+
+/*
+ * Read-only information RPCs (squeue, sinfo, etc.) must normally wait for
+ * the scheduler to release its job, node and partition write locks before
+ * they can pack a response. When the response does not depend upon the
+ * requesting user, the packed buffer is published here as a snapshot and
+ * shared by later requests, which can then be satisfied without taking
+ * any slurmctld locks. A snapshot is "fresh" while no relevant update has
+ * happened since it was packed, which can only be tested while holding
+ * the read locks used to pack it. If those locks are busy, a snapshot is
+ * used without that test until it is INFO_SNAPSHOT_MAX_AGE seconds old,
+ * so that readers never wait for a long scheduling pass. Such a response
+ * may thus be up to INFO_SNAPSHOT_MAX_AGE seconds out of date, but never
+ * older than the requester's previous response. A reconfiguration, which
+ * may change PrivateData, and a partition update or deletion, which may
+ * hide information from some users, discard all snapshots.
+ */
+
+/* Maximum age of a snapshot in seconds */
+#ifndef INFO_SNAPSHOT_MAX_AGE
+#define INFO_SNAPSHOT_MAX_AGE 5
+#endif
+
+typedef enum {
+	INFO_SNAPSHOT_JOB,
+	INFO_SNAPSHOT_NODE,
+	INFO_SNAPSHOT_PART,
+	INFO_SNAPSHOT_TYPES
+} info_snapshot_type_t;
+
+typedef struct info_snapshot {
+	char *data;		/* packed response message body */
+	int data_size;		/* size of data in bytes */
+	time_t pack_time;	/* time data was packed */
+	time_t update_time;	/* info_snapshot_update_time() when packed */
+	uint16_t protocol_version;
+	uint16_t show_flags;	/* excluding SHOW_ALL */
+	int ref_cnt;		/* references, including the cache's own */
+} info_snapshot_t;
+
+/*
+ * info_snapshot_get - find a snapshot which can be used to respond to a
+ *	request
+ * IN type - kind of information requested
+ * IN show_flags - request's show_flags
+ * IN protocol_version - request's protocol version
+ * IN locked - if set, the caller holds the locks used to pack this type of
+ *	information and only a fresh snapshot is returned, otherwise any
+ *	snapshot up to INFO_SNAPSHOT_MAX_AGE seconds old is returned
+ * RET snapshot reference to be released with info_snapshot_put() or NULL
+ */
+extern info_snapshot_t *info_snapshot_get(info_snapshot_type_t type,
+					  uint16_t show_flags,
+					  uint16_t protocol_version,
+					  bool locked);
+
+/*
+ * info_snapshot_public - determine if a response will be identical for
+ *	all users and can thus be published as a snapshot
+ * IN type - kind of information requested
+ * IN show_flags - request's show_flags
+ * NOTE: READ lock_slurmctld config and partition before entry
+ */
+extern bool info_snapshot_public(info_snapshot_type_t type,
+				 uint16_t show_flags);
+
+/*
+ * info_snapshot_publish - make a newly packed response available to other
+ *	requests, replacing any older snapshot for the same request type
+ * IN type - kind of information packed
+ * IN show_flags - show_flags used to pack the data
+ * IN protocol_version - protocol version used to pack the data
+ * IN pack_time - time at which the data was packed
+ * IN data - packed data, ownership passes to the snapshot
+ * IN data_size - size of data in bytes
+ * RET snapshot reference to be released with info_snapshot_put()
+ * NOTE: Call while still holding the locks used to pack the data
+ */
+extern info_snapshot_t *info_snapshot_publish(info_snapshot_type_t type,
+					      uint16_t show_flags,
+					      uint16_t protocol_version,
+					      time_t pack_time,
+					      char *data, int data_size);
+
+/* info_snapshot_put - release a reference to a snapshot */
+extern void info_snapshot_put(info_snapshot_t *snapshot);
+
+/* info_snapshot_update_time - return the latest update time of all
+ *	records which contribute to the given type of information
+ * NOTE: READ lock_slurmctld config, partition and the information's own
+ *	records (job or node) before entry */
+extern time_t info_snapshot_update_time(info_snapshot_type_t type);
+
+/* info_snapshot_stats_report - Log snapshot use statistics accumulated
+ *	since the last report, then clear them */
+extern void info_snapshot_stats_report(void);
+
+/* info_snapshot_purge - discard all cached snapshots, they are freed once
+ *	no longer in use
+ * NOTE: WRITE lock_slurmctld config or partition before entry */
+extern void info_snapshot_purge(void);
+
+/* info_snapshot_fini - free all cached snapshots */
+extern void info_snapshot_fini(void);
+
+#endif	/* !_HAVE_INFO_SNAPSHOT_H */
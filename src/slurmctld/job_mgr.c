@@ -1,7 +1,7 @@
 /*****************************************************************************\
  *  job_mgr.c - manage the job information of slurm
  *	Note: there is a global job list (job_list), time stamp
- *	(last_job_update), and hash table (job_hash)
+ *	(last_job_update), and hash tables (job_id_hash, job_name_hash)
  *****************************************************************************
  *  Copyright (C) 2002-2007 The Regents of the University of California.
  *  Copyright (C) 2008-2010 Lawrence Livermore National Security.
@@ -49,6 +49,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,6 +63,7 @@
 
 #include "src/common/assoc_mgr.h"
 #include "src/common/bitstring.h"
+#include "src/common/fd.h"
 #include "src/common/forward.h"
 #include "src/common/gres.h"
 #include "src/common/hostlist.h"
@@ -98,7 +100,8 @@
 #define STEP_FLAG 0xbbbb
 #define TOP_PRIORITY 0xffff0000	/* large, but leave headroom for higher */
 
-#define JOB_HASH_INX(_job_id)	(_job_id % hash_table_size)
+/* Seconds for which purged job IDs are remembered for pack_job_delta() */
+#define JOB_REMOVED_MAX_AGE	600
 
 /* Change JOB_STATE_VERSION value when changing the state save format */
 #define JOB_STATE_VERSION      "VER011"
@@ -106,6 +109,17 @@
 #define JOB_2_2_STATE_VERSION  "VER010"		/* SLURM version 2.2 */
 #define JOB_2_1_STATE_VERSION  "VER009"		/* SLURM version 2.1 */
 
+/* Job state journal record types, see dump_all_job_state() */
+#define JOB_JOURNAL_UPDATE	1	/* packed job record follows */
+#define JOB_JOURNAL_REMOVE	2	/* ID of purged job follows */
+#define JOB_JOURNAL_SEQUENCE	3	/* job_id_sequence follows */
+
+/* The job state journal is not compacted until larger than this */
+#define JOB_JOURNAL_MIN_COMPACT	(1024 * 1024)
+/* Write a new job_state file at least this often, seconds. It also saves
+ * changes made without mark_job_state_dirty() being called */
+#define JOB_SNAPSHOT_MAX_AGE	(60 * 60)
+
 #define JOB_CKPT_VERSION      "JOB_CKPT_002"
 #define JOB_2_2_CKPT_VERSION  "JOB_CKPT_002"	/* SLURM version 2.2 */
 #define JOB_2_1_CKPT_VERSION  "JOB_CKPT_001"	/* SLURM version 2.1 */
@@ -117,16 +131,123 @@ time_t last_job_update;		/* time of last update to job records */
 /* Local variables */
 static uint32_t highest_prio = 0;
 static uint32_t lowest_prio  = TOP_PRIORITY;
-static int      hash_table_size = 0;
 static int      job_count = 0;		/* job's in the system */
 static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
-static struct   job_record **job_hash = NULL;
 static bool     wiki_sched = false;
 static bool     wiki2_sched = false;
 static bool     wiki_sched_test = false;
 
+/* Open addressing hash table of job records, see _job_hash_add() */
+typedef struct job_hash_table {
+	struct job_record **slot;	/* table of size entries */
+	uint32_t size;			/* always a power of two */
+	uint32_t bits;			/* log2(size) */
+	uint32_t count;			/* records in table */
+} job_hash_table_t;
+
+static job_hash_table_t job_id_hash;	/* keyed by job_id */
+static job_hash_table_t job_name_hash;	/* keyed by user_id and name */
+
+/* Fields of a job record which are packed by pack_job(), but which may be
+ * changed without the record's last_update time being set, mostly by the
+ * schedulers and select plugins. String fields and the select plugin's
+ * job information are represented by hashes. See _job_pack_key_test(). */
+typedef struct job_pack_key {
+	time_t   begin_time;
+	bool     begun;			/* begin_time has been reached */
+	uint32_t cpu_cnt;
+	uint32_t derived_ec;
+	time_t   end_time;
+	uint32_t exit_code;
+	uint16_t job_state;
+	uint16_t nice;
+	uint32_t node_cnt;
+	int      node_cg_cnt;		/* nodes still completing */
+	struct part_record *part_ptr;
+	time_t   pre_sus_time;
+	time_t   preempt_time;
+	uint32_t priority;
+	uint32_t qos_id;
+	time_t   resize_time;
+	uint16_t restart_cnt;
+	time_t   start_time;
+	uint16_t state_reason;
+	time_t   suspend_time;
+	uint32_t time_limit;
+	uint32_t time_min;
+	uint32_t total_cpus;
+	uint32_t total_nodes;
+	uint64_t str_hash;		/* batch_host, nodes, state_desc */
+	uint64_t select_hash;		/* packed select_jobinfo */
+} job_pack_key_t;
+
+/* Packed copies of a job record as sent in response to job information
+ * requests with and without SHOW_ALL (which is part of the packed record).
+ * Records are only cached when packed for the current protocol version
+ * without SHOW_DETAIL, since the batch script depends upon the requester. */
+struct job_pack_cache {
+	job_pack_key_t key;	/* key fields when record last examined */
+	time_t   key_update;	/* time key fields last changed */
+	uint32_t select_gen;	/* select_jobinfo_gen() at key.select_hash */
+	char    *data[2];	/* packed record */
+	uint32_t data_size[2];
+	time_t   pack_time[2];	/* time record was packed */
+	uint16_t show_flags[2];	/* show_flags used to pack record */
+};
+
+/* Record of a job purged from job_list, used to report its removal to
+ * pack_job_delta() requesters */
+typedef struct job_removed {
+	uint32_t job_id;
+	time_t   remove_time;
+} job_removed_t;
+
+/* Job information requests only hold a read lock on the job records, so
+ * job_pack_mutex protects the pack_cache of every job record against
+ * concurrent requests. Other fields of the job records are not modified
+ * while it is held. */
+static pthread_mutex_t job_pack_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Buf job_pack_key_buf = NULL;	/* scratch for _job_pack_key_test() */
+
+/* job_removed_list holds records of purged jobs in order of removal.
+ * Records older than JOB_REMOVED_MAX_AGE are discarded, so the list is
+ * complete for removals at or after job_removed_horizon only. */
+static List   job_removed_list = NULL;
+static time_t job_removed_horizon = 0;
+
+/* The job_state file holds the records of all jobs when it was written and
+ * job_state.journal records of jobs changed or purged since then, see
+ * dump_all_job_state(). These are only used by the state save thread,
+ * except job_journal_removed, which _list_delete_job() adds the IDs of
+ * saved job records to under the job write lock. */
+static int      job_journal_fd = -1;	/* -1 if a job_state file is needed */
+static uint32_t job_journal_seq = 0;	/* job_id_sequence last saved */
+static uint32_t job_journal_size = 0;	/* bytes in journal */
+static List     job_journal_removed = NULL;
+static time_t   job_snapshot_time = 0;	/* time stamp of job_state file */
+static uint32_t job_snapshot_size = 0;	/* bytes in job_state file */
+
+/* The records of jobs changed since the last save, see
+ * mark_job_state_dirty(). Purged records are removed from the set by
+ * _list_delete_job(), leaving a NULL entry. job_state_dirty_lock protects
+ * the set and the state_dirty_inx of every job record, which the state
+ * save thread clears while only holding a read lock on the jobs. */
+static pthread_mutex_t     job_state_dirty_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct job_record **job_state_dirty = NULL;
+static uint32_t            job_state_dirty_cnt = 0;
+static uint32_t            job_state_dirty_size = 0;
+
+/* Counters reported by _job_pack_stats_report() */
+static uint32_t job_pack_hits = 0, job_pack_misses = 0;
+static uint32_t job_delta_cnt = 0, job_delta_full_cnt = 0;
+
 /* Local functions */
 static void _add_job_hash(struct job_record *job_ptr);
+static void _job_hash_add(job_hash_table_t *table, struct job_record *job_ptr);
+static void _job_hash_remove(job_hash_table_t *table,
+			     struct job_record *job_ptr);
+static void _job_hash_resize(job_hash_table_t *table, uint32_t min_size);
+static void _reset_name_depend(uint32_t name_hash);
 static int  _checkpoint_job_record (struct job_record *job_ptr,
 				    char *image_dir);
 static int  _copy_job_desc_to_file(job_desc_msg_t * job_desc,
@@ -148,6 +269,9 @@ static void _dump_job_details(struct job_details *detail_ptr,
 static void _dump_job_state(struct job_record *dump_job_ptr, Buf buffer);
 static int  _find_batch_dir(void *x, void *key);
 static void _get_batch_job_dir_ids(List batch_dirs);
+static void _job_pack_cache_free(struct job_record *job_ptr);
+static void _job_removed_add(struct job_record *job_ptr);
+static void _job_removed_del(void *x);
 static void _job_timed_out(struct job_record *job_ptr);
 static int  _job_create(job_desc_msg_t * job_specs, int allocate, int will_run,
 			struct job_record **job_rec_ptr, uid_t submit_uid);
@@ -226,6 +350,8 @@ struct job_record *create_job_record(int *error_code)
 
 	job_ptr->magic = JOB_MAGIC;
 	job_ptr->details = detail_ptr;
+	job_ptr->last_update = last_job_update;
+	mark_job_state_dirty(job_ptr);
 	job_ptr->prio_factors = xmalloc(sizeof(priority_factors_object_t));
 	job_ptr->step_list = list_create(NULL);
 	if (job_ptr->step_list == NULL)
@@ -370,11 +496,128 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 
 
 /*
- * dump_all_job_state - save the state of all jobs to file for checkpoint
- *	Changes here should be reflected in load_last_job_id() and
- *	load_all_job_state().
- * RET 0 or error code */
-int dump_all_job_state(void)
+ * mark_job_state_dirty - note that a job record changed, so that the next
+ *	dump_all_job_state() journals it
+ * IN job_ptr - pointer to the changed job
+ * NOTE: Call with a write lock on the job records
+ */
+extern void mark_job_state_dirty(struct job_record *job_ptr)
+{
+	slurm_mutex_lock(&job_state_dirty_lock);
+	if (job_ptr->state_dirty_inx == 0) {
+		if (job_state_dirty_cnt >= job_state_dirty_size) {
+			job_state_dirty_size = MAX(1024,
+						   job_state_dirty_size * 2);
+			xrealloc(job_state_dirty, sizeof(struct job_record *) *
+				 job_state_dirty_size);
+		}
+		job_state_dirty[job_state_dirty_cnt++] = job_ptr;
+		job_ptr->state_dirty_inx = job_state_dirty_cnt;
+	}
+	slurm_mutex_unlock(&job_state_dirty_lock);
+}
+
+/* Remove a job record from the set of changed jobs, if present */
+static void _job_state_dirty_remove(struct job_record *job_ptr)
+{
+	slurm_mutex_lock(&job_state_dirty_lock);
+	if (job_ptr->state_dirty_inx) {
+		job_state_dirty[job_ptr->state_dirty_inx - 1] = NULL;
+		job_ptr->state_dirty_inx = 0;
+	}
+	slurm_mutex_unlock(&job_state_dirty_lock);
+}
+
+/* Empty the set of changed jobs, after all have been saved
+ * NOTE: Lock job_state_dirty_lock and a read lock on jobs before entry */
+static void _job_state_dirty_clear(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < job_state_dirty_cnt; i++) {
+		if (job_state_dirty[i])
+			job_state_dirty[i]->state_dirty_inx = 0;
+	}
+	job_state_dirty_cnt = 0;
+}
+
+/* Write a buffer's contents to a state save file
+ * RET 0 or errno */
+static int _job_state_write(int fd, Buf buffer, char *file_name)
+{
+	int pos = 0, nwrite = get_buf_offset(buffer), amount;
+	char *data = (char *)get_buf_data(buffer);
+
+	while (nwrite > 0) {
+		amount = write(fd, &data[pos], nwrite);
+		if (amount < 0) {
+			if (errno == EINTR)
+				continue;
+			error("Error writing file %s, %m", file_name);
+			return errno;
+		}
+		nwrite -= amount;
+		pos    += amount;
+	}
+	return 0;
+}
+
+/*
+ * _job_journal_create - replace the job state journal with an empty one for
+ *	the job_state file just written with time stamp snapshot_time and
+ *	leave it open for appending
+ * RET 0 or error code
+ */
+static int _job_journal_create(time_t snapshot_time)
+{
+	char *reg_file, *new_file;
+	int error_code = 0, fd;
+	Buf buffer = init_buf(BUF_SIZE);
+
+	packstr(JOB_STATE_VERSION, buffer);
+	pack_time(snapshot_time, buffer);
+
+	reg_file = xstrdup(slurmctld_conf.state_save_location);
+	xstrcat(reg_file, "/job_state.journal");
+	new_file = xstrdup(reg_file);
+	xstrcat(new_file, ".new");
+
+	fd = creat(new_file, 0600);
+	if (fd < 0) {
+		error("Can't save state, create file %s error %m", new_file);
+		error_code = errno;
+	} else {
+		int rc;
+		error_code = _job_state_write(fd, buffer, new_file);
+		rc = fsync_and_close(fd, "job journal");
+		if (rc && !error_code)
+			error_code = rc;
+	}
+	if (!error_code && (rename(new_file, reg_file) < 0)) {
+		error("Can't rename %s to %s: %m", new_file, reg_file);
+		error_code = errno;
+	}
+	if (error_code)
+		(void) unlink(new_file);
+	else if ((job_journal_fd = open(reg_file, O_WRONLY | O_APPEND)) < 0) {
+		error("Can't open job journal %s: %m", reg_file);
+		error_code = errno;
+	} else {
+		fd_set_close_on_exec(job_journal_fd);
+		job_journal_size = get_buf_offset(buffer);
+	}
+	xfree(reg_file);
+	xfree(new_file);
+	free_buf(buffer);
+	return error_code;
+}
+
+/*
+ * _dump_job_snapshot - save the state of all jobs to the job_state file and
+ *	start a new job state journal for changes after it
+ * RET 0 or error code
+ */
+static int _dump_job_snapshot(void)
 {
 	/* Save high-water mark to avoid buffer growth with copies */
 	static int high_buffer_size = (1024 * 1024);
@@ -388,9 +631,18 @@ int dump_all_job_state(void)
 	struct job_record *job_ptr;
 	Buf buffer = init_buf(high_buffer_size);
 	time_t min_age = 0, now = time(NULL);
-	DEF_TIMERS;
+	uint32_t saved_job_id;
+
+	if (job_journal_fd >= 0) {
+		(void) close(job_journal_fd);
+		job_journal_fd = -1;
+	}
+
+	/* The journal is matched to its job_state file by time stamp,
+	 * so these must differ between job_state files */
+	if (now <= job_snapshot_time)
+		now = job_snapshot_time + 1;
 
-	START_TIMER;
 	/* write header: version, time */
 	packstr(JOB_STATE_VERSION, buffer);
 	pack_time(now, buffer);
@@ -398,18 +650,27 @@ int dump_all_job_state(void)
 	if (slurmctld_conf.min_job_age > 0)
 		min_age = now  - slurmctld_conf.min_job_age;
 
+	/* write individual job records */
+	lock_slurmctld(job_read_lock);
+
 	/*
 	 * write header: job id
 	 * This is needed so that the job id remains persistent even after
 	 * slurmctld is restarted.
 	 */
-	pack32( job_id_sequence, buffer);
-
+	saved_job_id = job_id_sequence;
+	pack32(saved_job_id, buffer);
 	debug3("Writing job id %u to header record of job_state file",
-	       job_id_sequence);
+	       saved_job_id);
+
+	/* Purged records are not in this file, so need not be journaled.
+	 * Nor need changed records, as all are written here. */
+	if (job_journal_removed)
+		list_flush(job_journal_removed);
+	slurm_mutex_lock(&job_state_dirty_lock);
+	_job_state_dirty_clear();
+	slurm_mutex_unlock(&job_state_dirty_lock);
 
-	/* write individual job records */
-	lock_slurmctld(job_read_lock);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
@@ -452,19 +713,10 @@ int dump_all_job_state(void)
 		      new_file);
 		error_code = errno;
 	} else {
-		int pos = 0, nwrite = get_buf_offset(buffer), amount, rc;
-		char *data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
+		int rc;
+		high_buffer_size = MAX(get_buf_offset(buffer),
+				       high_buffer_size);
+		error_code = _job_state_write(log_fd, buffer, new_file);
 
 		rc = fsync_and_close(log_fd, "job");
 		if (rc && !error_code)
@@ -482,6 +734,14 @@ int dump_all_job_state(void)
 			debug4("unable to create link for %s -> %s: %m",
 			       new_file, reg_file);
 		(void) unlink(new_file);
+
+		/* A crash before the new journal is in place leaves the
+		 * old one, which does not match this file's time stamp
+		 * and is ignored when the state is loaded */
+		job_snapshot_time = now;
+		job_snapshot_size = get_buf_offset(buffer);
+		job_journal_seq = saved_job_id;
+		error_code = _job_journal_create(now);
 	}
 	xfree(old_file);
 	xfree(reg_file);
@@ -489,6 +749,119 @@ int dump_all_job_state(void)
 	unlock_state_files();
 
 	free_buf(buffer);
+	return error_code;
+}
+
+/* Pack a job record as packmem() would, without an intermediate copy */
+static void _job_journal_pack(struct job_record *job_ptr, Buf buffer)
+{
+	uint32_t size_offset, end_offset;
+
+	size_offset = get_buf_offset(buffer);
+	pack32((uint32_t) 0, buffer);	/* record size, set below */
+	_dump_job_state(job_ptr, buffer);
+	end_offset = get_buf_offset(buffer);
+	set_buf_offset(buffer, size_offset);
+	pack32(end_offset - size_offset - sizeof(uint32_t), buffer);
+	set_buf_offset(buffer, end_offset);
+}
+
+/*
+ * _dump_job_journal - append records of the jobs changed or purged since the
+ *	last save to the job state journal, see mark_job_state_dirty()
+ * RET 0 or error code
+ */
+static int _dump_job_journal(void)
+{
+	int error_code = 0, remove_cnt = 0, update_cnt = 0;
+	char *reg_file;
+	/* Locks: Read config and job */
+	slurmctld_lock_t job_read_lock =
+		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+	struct job_record *job_ptr;
+	uint32_t *job_id_ptr, i;
+	Buf buffer = init_buf(BUF_SIZE);
+
+	lock_slurmctld(job_read_lock);
+	if (job_id_sequence != job_journal_seq) {
+		job_journal_seq = job_id_sequence;
+		pack16((uint16_t) JOB_JOURNAL_SEQUENCE, buffer);
+		pack32(job_journal_seq, buffer);
+	}
+
+	while (job_journal_removed &&
+	       (job_id_ptr = list_pop(job_journal_removed))) {
+		pack16((uint16_t) JOB_JOURNAL_REMOVE, buffer);
+		pack32(*job_id_ptr, buffer);
+		xfree(job_id_ptr);
+		remove_cnt++;
+	}
+
+	slurm_mutex_lock(&job_state_dirty_lock);
+	for (i = 0; i < job_state_dirty_cnt; i++) {
+		if ((job_ptr = job_state_dirty[i]) == NULL)
+			continue;	/* purged, see job_journal_removed */
+		xassert (job_ptr->magic == JOB_MAGIC);
+		pack16((uint16_t) JOB_JOURNAL_UPDATE, buffer);
+		_job_journal_pack(job_ptr, buffer);
+		update_cnt++;
+	}
+	_job_state_dirty_clear();
+	slurm_mutex_unlock(&job_state_dirty_lock);
+	unlock_slurmctld(job_read_lock);
+
+	if (get_buf_offset(buffer) == 0) {
+		free_buf(buffer);
+		return SLURM_SUCCESS;
+	}
+
+	reg_file = xstrdup(slurmctld_conf.state_save_location);
+	xstrcat(reg_file, "/job_state.journal");
+	lock_state_files();
+	error_code = _job_state_write(job_journal_fd, buffer, reg_file);
+	if (!error_code && (fsync(job_journal_fd) < 0)) {
+		error("fsync() error writing job journal: %m");
+		error_code = errno;
+	}
+	unlock_state_files();
+	xfree(reg_file);
+
+	if (error_code) {
+		/* Records may be partly written, write a new job_state
+		 * file next time */
+		(void) close(job_journal_fd);
+		job_journal_fd = -1;
+	} else {
+		job_journal_size += get_buf_offset(buffer);
+		debug3("Journaled %d changed and %d removed job records",
+		       update_cnt, remove_cnt);
+	}
+	free_buf(buffer);
+	return error_code;
+}
+
+/*
+ * dump_all_job_state - save the state of all jobs to file for checkpoint.
+ *	Changes are appended to the job state journal until it grows larger
+ *	than the job_state file or that is JOB_SNAPSHOT_MAX_AGE old, when the
+ *	job_state file is rewritten.
+ *	Changes here should be reflected in load_last_job_id() and
+ *	load_all_job_state().
+ * NOTE: Only called from the state save thread
+ * RET 0 or error code */
+int dump_all_job_state(void)
+{
+	int error_code;
+	DEF_TIMERS;
+
+	START_TIMER;
+	if ((job_journal_fd < 0) ||
+	    (job_journal_size > MAX(job_snapshot_size,
+				    JOB_JOURNAL_MIN_COMPACT)) ||
+	    (difftime(time(NULL), job_snapshot_time) > JOB_SNAPSHOT_MAX_AGE))
+		error_code = _dump_job_snapshot();
+	else
+		error_code = _dump_job_journal();
 	END_TIMER2("dump_all_job_state");
 	return error_code;
 }
@@ -522,19 +895,145 @@ static int _open_job_state_file(char **state_file)
 	return state_fd;
 }
 
+/* Remove the record of a job replaced or removed by a job state journal
+ * record from the job ID hash table. Unhashed records are removed from
+ * job_list once the journal has been replayed, in a single pass. */
+static bool _job_journal_unhash(uint32_t job_id)
+{
+	struct job_record *job_ptr = find_job_record(job_id);
+
+	if (job_ptr == NULL)
+		return false;
+	_job_hash_remove(&job_id_hash, job_ptr);
+	return true;
+}
+
+/* Match job records unhashed by _job_journal_unhash(), key is ignored */
+static int _list_find_job_unhashed(void *job_entry, void *key)
+{
+	struct job_record *job_ptr = (struct job_record *) job_entry;
+
+	return (find_job_record(job_ptr->job_id) != job_ptr);
+}
+
+/*
+ * _load_job_journal - replay the job state journal written after the
+ *	job_state file with time stamp snapshot_time was saved
+ * IN snapshot_time - time stamp of the job_state file loaded
+ * IN seq_only - only recover job_id_sequence, ignore job records
+ * RET count of job records replayed
+ */
+static int _load_job_journal(time_t snapshot_time, bool seq_only)
+{
+	int state_fd, rec_cnt = 0;
+	uint32_t record_size, record_start, job_id;
+	uint32_t saved_job_id, ver_str_len;
+	uint16_t record_type;
+	char *state_file, *ver_str = NULL;
+	time_t journal_time;
+	Buf buffer = NULL;
+	bool unhashed = false;
+
+	/* read the file */
+	state_file = slurm_get_state_save_location();
+	xstrcat(state_file, "/job_state.journal");
+	lock_state_files();
+	state_fd = open(state_file, O_RDONLY);
+	if (state_fd < 0) {
+		debug("No job state journal (%s) to recover", state_file);
+		xfree(state_file);
+		unlock_state_files();
+		return 0;
+	}
+	buffer = create_mmap_buf(state_fd);
+	if (buffer == NULL)
+		error("Read error on %s: %m", state_file);
+	close(state_fd);
+	xfree(state_file);
+	unlock_state_files();
+
+	if (buffer == NULL)
+		buffer = create_buf(NULL, 0);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	if ((!ver_str) || strcmp(ver_str, JOB_STATE_VERSION)) {
+		error("Can not replay job state journal, incompatible version");
+		goto fini;
+	}
+	safe_unpack_time(&journal_time, buffer);
+	if (journal_time != snapshot_time) {
+		/* Written for an older job_state file, all of its
+		 * changes are in the one loaded */
+		debug("Job state journal is older than job_state file, "
+		      "ignored");
+		goto fini;
+	}
+
+	while (remaining_buf(buffer) > 0) {
+		safe_unpack16(&record_type, buffer);
+		if (record_type == JOB_JOURNAL_SEQUENCE) {
+			safe_unpack32(&saved_job_id, buffer);
+			job_id_sequence = MAX(saved_job_id, job_id_sequence);
+		} else if (record_type == JOB_JOURNAL_REMOVE) {
+			safe_unpack32(&job_id, buffer);
+			if (!seq_only && _job_journal_unhash(job_id))
+				unhashed = true;
+			rec_cnt++;
+		} else if (record_type == JOB_JOURNAL_UPDATE) {
+			safe_unpack32(&record_size, buffer);
+			if (record_size > remaining_buf(buffer))
+				goto unpack_error;
+			record_start = get_buf_offset(buffer);
+			if (seq_only) {
+				set_buf_offset(buffer,
+					       record_start + record_size);
+				rec_cnt++;
+				continue;
+			}
+			/* A job record starts with assoc_id and job_id.
+			 * Replace any earlier copy of the record. */
+			safe_unpack32(&job_id, buffer);
+			safe_unpack32(&job_id, buffer);
+			set_buf_offset(buffer, record_start);
+			if (_job_journal_unhash(job_id))
+				unhashed = true;
+			if ((_load_job_state(buffer, SLURM_PROTOCOL_VERSION) !=
+			     SLURM_SUCCESS) ||
+			    (get_buf_offset(buffer) !=
+			     (record_start + record_size)))
+				goto unpack_error;
+			rec_cnt++;
+		} else
+			goto unpack_error;
+	}
+	goto fini;
+
+unpack_error:
+	/* Expected if slurmctld stopped while appending to the journal */
+	info("Incomplete job state journal, replayed %d records", rec_cnt);
+fini:
+	if (unhashed)
+		(void) list_delete_all(job_list, &_list_find_job_unhashed, NULL);
+	xfree(ver_str);
+	free_buf(buffer);
+	return rec_cnt;
+}
+
 /*
  * load_all_job_state - load the job state from file, recover from last
  *	checkpoint. Execute this after loading the configuration file data.
  *	Changes here should be reflected in load_last_job_id().
+ *	Records are parsed serially: _load_job_state() creates and hashes the
+ *	job record before its fields are unpacked and calls into accounting,
+ *	assoc_mgr, partition and plugin code that is not thread safe, so the
+ *	file is neither indexed by record nor split across threads.
  * RET 0 or error code
  */
 extern int load_all_job_state(void)
 {
-	int data_allocated, data_read = 0, error_code = SLURM_SUCCESS;
-	uint32_t data_size = 0;
-	int state_fd, job_cnt = 0;
-	char *data = NULL, *state_file;
-	Buf buffer;
+	int error_code = SLURM_SUCCESS;
+	int state_fd, job_cnt = 0, journal_cnt = 0;
+	char *state_file;
+	Buf buffer = NULL;
 	time_t buf_time;
 	uint32_t saved_job_id;
 	char *ver_str = NULL;
@@ -548,25 +1047,9 @@ extern int load_all_job_state(void)
 		info("No job state file (%s) to recover", state_file);
 		error_code = ENOENT;
 	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-					      state_file);
-					break;
-				}
-			} else if (data_read == 0)	/* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
+		buffer = create_mmap_buf(state_fd);
+		if (buffer == NULL)
+			error("Read error on %s: %m", state_file);
 		close(state_fd);
 	}
 	xfree(state_file);
@@ -576,7 +1059,8 @@ extern int load_all_job_state(void)
 	if (error_code)
 		return error_code;
 
-	buffer = create_buf(data, data_size);
+	if (buffer == NULL)
+		buffer = create_buf(NULL, 0);
 	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
 	debug3("Version string in job_state header is %s", ver_str);
 	if (ver_str) {
@@ -610,10 +1094,18 @@ extern int load_all_job_state(void)
 			goto unpack_error;
 		job_cnt++;
 	}
+	free_buf(buffer);
+
+	job_snapshot_time = MAX(job_snapshot_time, buf_time);
+	if (protocol_version == SLURM_PROTOCOL_VERSION) {
+		journal_cnt = _load_job_journal(buf_time, false);
+		job_cnt = list_count(job_list);
+	}
 	debug3("Set job_id_sequence to %u", job_id_sequence);
 
-	free_buf(buffer);
 	info("Recovered information about %d jobs", job_cnt);
+	if (journal_cnt)
+		info("Replayed %d job state journal records", journal_cnt);
 	return error_code;
 
 unpack_error:
@@ -630,11 +1122,10 @@ unpack_error:
  */
 extern int load_last_job_id( void )
 {
-	int data_allocated, data_read = 0, error_code = SLURM_SUCCESS;
-	uint32_t data_size = 0;
+	int error_code = SLURM_SUCCESS;
 	int state_fd;
-	char *data = NULL, *state_file;
-	Buf buffer;
+	char *state_file;
+	Buf buffer = NULL;
 	time_t buf_time;
 	char *ver_str = NULL;
 	uint32_t ver_str_len;
@@ -648,25 +1139,9 @@ extern int load_last_job_id( void )
 		debug("No job state file (%s) to recover", state_file);
 		error_code = ENOENT;
 	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-					      state_file);
-					break;
-				}
-			} else if (data_read == 0)	/* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
+		buffer = create_mmap_buf(state_fd);
+		if (buffer == NULL)
+			error("Read error on %s: %m", state_file);
 		close(state_fd);
 	}
 	xfree(state_file);
@@ -675,7 +1150,8 @@ extern int load_last_job_id( void )
 	if (error_code)
 		return error_code;
 
-	buffer = create_buf(data, data_size);
+	if (buffer == NULL)
+		buffer = create_buf(NULL, 0);
 	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
 	debug3("Version string in job_state header is %s", ver_str);
 	if ((!ver_str) || (strcmp(ver_str, JOB_STATE_VERSION) != 0)) {
@@ -696,6 +1172,10 @@ extern int load_last_job_id( void )
 	/* Ignore the state for individual jobs stored here */
 
 	free_buf(buffer);
+
+	/* Jobs submitted since the job_state file was written */
+	job_snapshot_time = MAX(job_snapshot_time, buf_time);
+	(void) _load_job_journal(buf_time, true);
 	return error_code;
 
 unpack_error:
@@ -1419,6 +1899,7 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 	job_ptr->limit_set_min_cpus  = limit_set_max_cpus;
 	job_ptr->limit_set_min_nodes = limit_set_min_nodes;
 	job_ptr->limit_set_time      = limit_set_time;
+	rehash_job_name(job_ptr);
 
 	memset(&assoc_rec, 0, sizeof(slurmdb_association_rec_t));
 
@@ -1860,18 +2341,169 @@ unpack_error:
 	return SLURM_FAILURE;
 }
 
+/*
+ * Job records are indexed by job ID and by user ID plus job name (for
+ * singleton dependencies) in open addressing hash tables with linear
+ * probing. A table's size is a power of two and it is doubled whenever it
+ * would become more than half full, so MaxJobCount can be raised without
+ * restarting slurmctld.
+ */
+/* Fibonacci hash of a job ID to a slot in a table of 2^bits entries. The
+ * high bits of the product depend upon every bit of job_id, the low bits
+ * do not. */
+static uint32_t _hash_job_id(uint32_t job_id, uint32_t bits)
+{
+	return (job_id * 2654435761U) >> (32 - bits);
+}
+
+/* FNV-1a hash of a user ID and job name */
+static uint32_t _hash_user_name(uint32_t user_id, char *name)
+{
+	uint32_t hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		hash ^= (user_id >> (i * 8)) & 0xff;
+		hash *= 16777619U;
+	}
+	while (name && *name) {
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/* Return the home slot of a job record's key in the given table */
+static uint32_t _job_hash_key(job_hash_table_t *table,
+			      struct job_record *job_ptr)
+{
+	if (table == &job_id_hash)
+		return _hash_job_id(job_ptr->job_id, table->bits);
+	return job_ptr->name_hash & (table->size - 1);
+}
+
+static void _job_hash_add(job_hash_table_t *table, struct job_record *job_ptr)
+{
+	uint32_t inx, mask;
+
+	if ((table->count + 1) * 2 > table->size)
+		_job_hash_resize(table, (table->count + 1) * 2);
+
+	mask = table->size - 1;
+	inx = _job_hash_key(table, job_ptr);
+	while (table->slot[inx])
+		inx = (inx + 1) & mask;
+	table->slot[inx] = job_ptr;
+	table->count++;
+}
+
+/* Remove a job record from a hash table, if present. The record's key must
+ * be unchanged since it was added. */
+static void _job_hash_remove(job_hash_table_t *table,
+			     struct job_record *job_ptr)
+{
+	uint32_t inx, next_inx, home_inx, mask;
+
+	if (table->size == 0)
+		return;
+
+	mask = table->size - 1;
+	inx = _job_hash_key(table, job_ptr);
+	while (table->slot[inx] != job_ptr) {
+		if (table->slot[inx] == NULL)
+			return;		/* not in table */
+		inx = (inx + 1) & mask;
+	}
+	table->slot[inx] = NULL;
+	table->count--;
+
+	/* Move any following records of the probe sequence which can not be
+	 * found past the newly empty slot back into it */
+	next_inx = inx;
+	while (1) {
+		next_inx = (next_inx + 1) & mask;
+		if (table->slot[next_inx] == NULL)
+			break;
+		home_inx = _job_hash_key(table, table->slot[next_inx]);
+		if ((next_inx > inx) ?
+		    ((home_inx > inx) && (home_inx <= next_inx)) :
+		    ((home_inx > inx) || (home_inx <= next_inx)))
+			continue;	/* still reachable from home_inx */
+		table->slot[inx] = table->slot[next_inx];
+		table->slot[next_inx] = NULL;
+		inx = next_inx;
+	}
+}
+
+/* Grow a hash table to hold at least min_size slots */
+static void _job_hash_resize(job_hash_table_t *table, uint32_t min_size)
+{
+	struct job_record **old_slot = table->slot;
+	uint32_t i, old_size = table->size, size = 1024, bits = 10;
+
+	while (size < min_size) {
+		size *= 2;
+		bits++;
+	}
+	if (size <= old_size)
+		return;
+
+	table->slot = xmalloc(sizeof(struct job_record *) * size);
+	table->size = size;
+	table->bits = bits;
+	table->count = 0;
+	for (i = 0; i < old_size; i++) {
+		if (old_slot[i])
+			_job_hash_add(table, old_slot[i]);
+	}
+	xfree(old_slot);
+	if (old_size)
+		debug("job hash table grown to %u entries", size);
+}
+
+/* Discard the cached dependency test results of all jobs with the given
+ * hash of user ID and name, see rehash_job_name() */
+static void _reset_name_depend(uint32_t name_hash)
+{
+	struct job_record *job_ptr;
+	uint32_t inx, mask;
+
+	if (job_name_hash.size == 0)
+		return;
+
+	mask = job_name_hash.size - 1;
+	inx = name_hash & mask;
+	while ((job_ptr = job_name_hash.slot[inx])) {
+		if ((job_ptr->name_hash == name_hash) && job_ptr->details)
+			job_ptr->details->depend_valid = false;
+		inx = (inx + 1) & mask;
+	}
+}
+
 /* _add_job_hash - add a job hash entry for given job record, job_id must
  *	already be set
  * IN job_ptr - pointer to job record
  * Globals: hash table updated
  */
-void _add_job_hash(struct job_record *job_ptr)
+static void _add_job_hash(struct job_record *job_ptr)
 {
-	int inx;
+	_job_hash_add(&job_id_hash, job_ptr);
+}
 
-	inx = JOB_HASH_INX(job_ptr->job_id);
-	job_ptr->job_next = job_hash[inx];
-	job_hash[inx] = job_ptr;
+/*
+ * rehash_job_name - update the index of jobs by user and name after a
+ *	change to a job's user_id or name
+ * IN job_ptr - pointer to job record
+ */
+extern void rehash_job_name(struct job_record *job_ptr)
+{
+	/* Singleton dependencies of jobs with both the old and new name
+	 * may be affected */
+	_reset_name_depend(job_ptr->name_hash);
+	_job_hash_remove(&job_name_hash, job_ptr);
+	job_ptr->name_hash = _hash_user_name(job_ptr->user_id, job_ptr->name);
+	_job_hash_add(&job_name_hash, job_ptr);
+	_reset_name_depend(job_ptr->name_hash);
 }
 
 /*
@@ -1879,22 +2511,69 @@ void _add_job_hash(struct job_record *job_ptr)
  * IN job_id - requested job's id
  * RET pointer to the job's record, NULL on error
  * global: job_list - global job list pointer
- *	job_hash - hash table into job records
+ *	job_id_hash - hash table into job records
  */
 struct job_record *find_job_record(uint32_t job_id)
 {
 	struct job_record *job_ptr;
+	uint32_t inx, mask;
+
+	if (job_id_hash.size == 0)
+		return NULL;
 
-	job_ptr = job_hash[JOB_HASH_INX(job_id)];
-	while (job_ptr) {
+	mask = job_id_hash.size - 1;
+	inx = _hash_job_id(job_id, job_id_hash.bits);
+	while ((job_ptr = job_id_hash.slot[inx])) {
 		if (job_ptr->job_id == job_id)
 			return job_ptr;
-		job_ptr = job_ptr->job_next;
+		inx = (inx + 1) & mask;
 	}
 
 	return NULL;
 }
 
+/*
+ * find_job_name_records - build a list of a user's jobs with a given name
+ * IN user_id - user ID
+ * IN job_name - job name, jobs with no name match any name
+ * RET list of pointers to job records
+ * NOTE: the caller must call list_destroy() on RET value to free memory
+ */
+extern List find_job_name_records(uint32_t user_id, char *job_name)
+{
+	List job_queue;
+	struct job_record *job_ptr;
+	uint32_t hash, inx, mask;
+	int pass;
+
+	job_queue = list_create(NULL);
+	if (job_queue == NULL)
+		fatal("list_create memory allocation failure");
+	if (job_name_hash.size == 0)
+		return job_queue;
+
+	/* Pass 0 finds jobs with the given name, pass 1 jobs with no name */
+	mask = job_name_hash.size - 1;
+	for (pass = 0; pass < 2; pass++) {
+		if ((pass == 0) && (job_name == NULL))
+			continue;
+		hash = _hash_user_name(user_id, pass ? NULL : job_name);
+		inx = hash & mask;
+		while ((job_ptr = job_name_hash.slot[inx])) {
+			inx = (inx + 1) & mask;
+			if ((job_ptr->name_hash != hash) ||
+			    (job_ptr->user_id != user_id))
+				continue;
+			if (pass ? (job_ptr->name != NULL) :
+			    (!job_ptr->name || strcmp(job_name, job_ptr->name)))
+				continue;
+			list_append(job_queue, job_ptr);
+		}
+	}
+
+	return job_queue;
+}
+
 /* rebuild a job's partition name list based upon the contents of its
  *	part_ptr_list */
 static void _rebuild_part_name_list(struct job_record  *job_ptr)
@@ -1927,7 +2606,8 @@ static void _rebuild_part_name_list(struct job_record  *job_ptr)
 		xstrcat(job_ptr->partition, part_ptr->name);
 	}
 	list_iterator_destroy(part_iterator);
-	last_job_update = time(NULL);
+	last_job_update = job_ptr->last_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 }
 
 /*
@@ -2665,29 +3345,29 @@ int init_job_conf(void)
 		if (job_list == NULL)
 			fatal ("Memory allocation failure");
 	}
+	if (job_removed_list == NULL) {
+		job_removed_list = list_create(_job_removed_del);
+		job_removed_horizon = time(NULL);
+	}
+	if (job_journal_removed == NULL)
+		job_journal_removed = list_create(slurm_destroy_char);
 
 	last_job_update = time(NULL);
 	return SLURM_SUCCESS;
 }
 
 /*
- * rehash_jobs - Create or rebuild the job hash table.
+ * rehash_jobs - Create or grow the job hash tables to hold MaxJobCount jobs
+ *	without further resizing. The tables also grow as needed when jobs
+ *	are added, so MaxJobCount may be increased by reconfiguration.
  * NOTE: run lock_slurmctld before entry: Read config, write job
  */
 extern void rehash_jobs(void)
 {
-	if (job_hash == NULL) {
-		hash_table_size = slurmctld_conf.max_job_cnt;
-		job_hash = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-	} else if (hash_table_size < (slurmctld_conf.max_job_cnt / 2)) {
-		/* If the MaxJobCount grows by too much, the hash table will
-		 * be ineffective without rebuilding. We don't presently bother
-		 * to rebuild the hash table, but cut MaxJobCount back as
-		 * needed. */
-		error ("MaxJobCount reset too high, restart slurmctld");
-		slurmctld_conf.max_job_cnt = hash_table_size;
-	}
+	uint32_t min_size = slurmctld_conf.max_job_cnt * 2;
+
+	_job_hash_resize(&job_id_hash, min_size);
+	_job_hash_resize(&job_name_hash, min_size);
 }
 
 /*
@@ -2817,7 +3497,8 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 		error_code = select_nodes(job_ptr, no_alloc, NULL);
 
 	if (!test_only) {
-		last_job_update = now;
+		last_job_update = job_ptr->last_update = now;
+		mark_job_state_dirty(job_ptr);
 		slurm_sched_schedule();	/* work for external scheduler */
 	}
 
@@ -2914,6 +3595,8 @@ extern int job_fail(uint32_t job_id)
 		} else
 			job_ptr->end_time       = now;
 		last_job_update                 = now;
+		job_ptr->last_update            = now;
+		mark_job_state_dirty(job_ptr);
 		job_ptr->job_state = JOB_FAILED | JOB_COMPLETING;
 		build_cg_bitmap(job_ptr);
 		job_ptr->exit_code = 1;
@@ -3003,6 +3686,8 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t batch_flag,
 
 	if (IS_JOB_PENDING(job_ptr) && (signal == SIGKILL)) {
 		last_job_update		= now;
+		job_ptr->last_update	= now;
+		mark_job_state_dirty(job_ptr);
 		job_ptr->job_state	= JOB_CANCELLED;
 		job_ptr->start_time	= now;
 		job_ptr->end_time	= now;
@@ -3018,6 +3703,8 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t batch_flag,
 		job_term_state = JOB_CANCELLED;
 	if (IS_JOB_SUSPENDED(job_ptr) &&  (signal == SIGKILL)) {
 		last_job_update         = now;
+		job_ptr->last_update    = now;
+		mark_job_state_dirty(job_ptr);
 		job_ptr->end_time       = job_ptr->suspend_time;
 		job_ptr->tot_sus_time  += difftime(now, job_ptr->suspend_time);
 		job_ptr->job_state      = job_term_state | JOB_COMPLETING;
@@ -3036,6 +3723,8 @@ extern int job_signal(uint32_t job_id, uint16_t signal, uint16_t batch_flag,
 			job_ptr->time_last_active	= now;
 			job_ptr->end_time		= now;
 			last_job_update			= now;
+			job_ptr->last_update		= now;
+			mark_job_state_dirty(job_ptr);
 			job_ptr->job_state = job_term_state | JOB_COMPLETING;
 			build_cg_bitmap(job_ptr);
 			deallocate_nodes(job_ptr, false, false, preempt);
@@ -3221,7 +3910,8 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 		job_completion_logger(job_ptr, false);
 	}
 
-	last_job_update = now;
+	last_job_update = job_ptr->last_update = now;
+	mark_job_state_dirty(job_ptr);
 	if (job_comp_flag) {	/* job was running */
 		build_cg_bitmap(job_ptr);
 		deallocate_nodes(job_ptr, false, suspended, false);
@@ -4482,6 +5172,7 @@ _copy_job_desc_to_job_record(job_desc_msg_t * job_desc,
 
 	job_ptr->user_id    = (uid_t) job_desc->user_id;
 	job_ptr->group_id   = (gid_t) job_desc->group_id;
+	rehash_job_name(job_ptr);
 	job_ptr->job_state  = JOB_PENDING;
 	job_ptr->time_limit = job_desc->time_limit;
 	if (job_desc->time_min != NO_VAL)
@@ -4791,7 +5482,8 @@ void job_time_limit(void)
 		}
 		if (job_ptr->time_limit != INFINITE) {
 			if (job_ptr->end_time <= over_run) {
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
+				mark_job_state_dirty(job_ptr);
 				info("Time limit exhausted for JobId=%u",
 				     job_ptr->job_id);
 				_job_timed_out(job_ptr);
@@ -4812,7 +5504,8 @@ void job_time_limit(void)
 		}
 
 		if (resv_status != SLURM_SUCCESS) {
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
+			mark_job_state_dirty(job_ptr);
 			info("Reservation ended for JobId=%u",
 			     job_ptr->job_id);
 			_job_timed_out(job_ptr);
@@ -4843,7 +5536,8 @@ void job_time_limit(void)
 
 			if ((qos->grp_cpu_mins != (uint64_t)INFINITE)
 			    && (usage_mins >= qos->grp_cpu_mins)) {
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
+				mark_job_state_dirty(job_ptr);
 				info("Job %u timed out, "
 				     "the job is at or exceeds QOS %s's "
 				     "group max cpu minutes of %"PRIu64" "
@@ -4858,7 +5552,8 @@ void job_time_limit(void)
 
 			if ((qos->grp_wall != INFINITE)
 			    && (wall_mins >= qos->grp_wall)) {
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
+				mark_job_state_dirty(job_ptr);
 				info("Job %u timed out, "
 				     "the job is at or exceeds QOS %s's "
 				     "group wall limit of %u with %u",
@@ -4871,7 +5566,8 @@ void job_time_limit(void)
 
 			if ((qos->max_cpu_mins_pj != (uint64_t)INFINITE)
 			    && (job_cpu_usage_mins >= qos->max_cpu_mins_pj)) {
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
+				mark_job_state_dirty(job_ptr);
 				info("Job %u timed out, "
 				     "the job is at or exceeds QOS %s's "
 				     "max cpu minutes of %"PRIu64" "
@@ -4943,7 +5639,8 @@ void job_time_limit(void)
 		assoc_mgr_unlock(&locks);
 
 		if(job_ptr->state_reason == FAIL_TIMEOUT) {
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
+			mark_job_state_dirty(job_ptr);
 			_job_timed_out(job_ptr);
 			xfree(job_ptr->state_desc);
 			continue;
@@ -5112,28 +5809,30 @@ static int _validate_job_desc(job_desc_msg_t * job_desc_msg, int allocate,
  * IN job_entry - pointer to job_record to delete
  * global: job_list - pointer to global job list
  *	job_count - count of job list entries
- *	job_hash - hash table into job records
+ *	job_id_hash, job_name_hash - hash tables into job records
  */
 static void _list_delete_job(void *job_entry)
 {
 	struct job_record *job_ptr = (struct job_record *) job_entry;
-	struct job_record **job_pptr;
 	int i;
 
 	xassert(job_entry);
 	xassert (job_ptr->magic == JOB_MAGIC);
 	job_ptr->magic = 0;	/* make sure we don't delete record twice */
 
-	/* Remove the record from the hash table */
-	job_pptr = &job_hash[JOB_HASH_INX(job_ptr->job_id)];
-	while ((job_pptr != NULL) &&
-	       ((job_ptr = *job_pptr) != (struct job_record *) job_entry)) {
-		job_pptr = &job_ptr->job_next;
-	}
-	if (job_pptr == NULL)
-		fatal("job hash error");
-	*job_pptr = job_ptr->job_next;
+	/* Remove the record from the hash tables */
+	notify_job_dependents(job_ptr);
+	_job_hash_remove(&job_id_hash, job_ptr);
+	_job_hash_remove(&job_name_hash, job_ptr);
+	xfree(job_ptr->depend_child_id);
 
+	_job_removed_add(job_ptr);
+	_job_pack_cache_free(job_ptr);
+	if (job_journal_removed) {
+		uint32_t *job_id_ptr = xmalloc(sizeof(uint32_t));
+		*job_id_ptr = job_ptr->job_id;
+		list_append(job_journal_removed, job_id_ptr);
+	}
 	delete_job_details(job_ptr);
 	xfree(job_ptr->account);
 	xfree(job_ptr->alloc_node);
@@ -5169,6 +5868,8 @@ static void _list_delete_job(void *job_entry)
 		list_destroy(job_ptr->step_list);
 	}
 	xfree(job_ptr->wckey);
+	/* Last, delete_step_records() marks the job as changed */
+	_job_state_dirty_remove(job_ptr);
 	job_count--;
 	xfree(job_ptr);
 }
@@ -5230,6 +5931,246 @@ static int _list_find_job_old(void *job_entry, void *key)
 }
 
 
+/* Remember that a job record has been purged */
+static void _job_removed_add(struct job_record *job_ptr)
+{
+	job_removed_t *removed_ptr;
+	time_t now = time(NULL);
+
+	if (job_removed_list == NULL)
+		return;		/* shutting down */
+
+	while ((removed_ptr = list_peek(job_removed_list)) &&
+	       (removed_ptr->remove_time < (now - JOB_REMOVED_MAX_AGE))) {
+		removed_ptr = list_pop(job_removed_list);
+		job_removed_horizon = MAX(job_removed_horizon,
+					  removed_ptr->remove_time);
+		_job_removed_del(removed_ptr);
+	}
+
+	removed_ptr = xmalloc(sizeof(job_removed_t));
+	removed_ptr->job_id = job_ptr->job_id;
+	removed_ptr->remove_time = now;
+	if (list_append(job_removed_list, removed_ptr) == NULL)
+		fatal("list_append memory allocation failure");
+}
+
+static void _job_removed_del(void *x)
+{
+	job_removed_t *removed_ptr = (job_removed_t *) x;
+
+	xfree(removed_ptr);
+}
+
+static void _job_pack_cache_free(struct job_record *job_ptr)
+{
+	struct job_pack_cache *cache_ptr = job_ptr->pack_cache;
+	int i;
+
+	if (cache_ptr == NULL)
+		return;
+	for (i = 0; i < 2; i++)
+		xfree(cache_ptr->data[i]);
+	xfree(job_ptr->pack_cache);
+}
+
+/* Add a string, including its terminator, to a 64-bit FNV-1a hash */
+static uint64_t _job_pack_hash(uint64_t hash, const char *data, int len)
+{
+	int i;
+
+	if (data == NULL) {
+		data = "";
+		len = 1;
+	}
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#define _JOB_PACK_HASH_STR(hash, str) \
+	_job_pack_hash(hash, str, (str) ? (strlen(str) + 1) : 0)
+
+/*
+ * _job_pack_key_test - Compare the fields of a job record which may change
+ *	without its last_update time being set against their values when the
+ *	record was last examined and note the time if any differ, see
+ *	_job_pack_update_time(). This keeps pack_job_delta() accurate and
+ *	invalidates the record's packed copies. The job record itself is not
+ *	modified, as only a read lock on it is held. select_jobinfo is only
+ *	packed and hashed again after select_jobinfo_changed() was called.
+ * NOTE: Lock job_pack_mutex before entry
+ */
+static void _job_pack_key_test(struct job_record *job_ptr, time_t now)
+{
+	struct job_pack_cache *cache_ptr = job_ptr->pack_cache;
+	job_pack_key_t key;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	uint32_t select_gen = select_jobinfo_gen();
+
+	memset(&key, 0, sizeof(job_pack_key_t));
+	if (job_ptr->details) {
+		key.begin_time   = job_ptr->details->begin_time;
+		key.nice         = job_ptr->details->nice;
+	}
+	key.begun        = (key.begin_time <= now);
+	key.cpu_cnt      = job_ptr->cpu_cnt;
+	key.derived_ec   = job_ptr->derived_ec;
+	key.end_time     = job_ptr->end_time;
+	key.exit_code    = job_ptr->exit_code;
+	key.job_state    = job_ptr->job_state;
+	key.node_cnt     = job_ptr->node_cnt;
+	key.part_ptr     = job_ptr->part_ptr;
+	key.pre_sus_time = job_ptr->pre_sus_time;
+	key.preempt_time = job_ptr->preempt_time;
+	key.priority     = job_ptr->priority;
+	key.qos_id       = job_ptr->qos_id;
+	key.resize_time  = job_ptr->resize_time;
+	key.restart_cnt  = job_ptr->restart_cnt;
+	key.start_time   = job_ptr->start_time;
+	key.state_reason = job_ptr->state_reason;
+	key.suspend_time = job_ptr->suspend_time;
+	key.time_limit   = job_ptr->time_limit;
+	key.time_min     = job_ptr->time_min;
+	key.total_cpus   = job_ptr->total_cpus;
+	key.total_nodes  = job_ptr->total_nodes;
+	if (IS_JOB_COMPLETING(job_ptr) && job_ptr->node_bitmap_cg)
+		key.node_cg_cnt = bit_set_count(job_ptr->node_bitmap_cg);
+
+	hash = _JOB_PACK_HASH_STR(hash, job_ptr->batch_host);
+	hash = _JOB_PACK_HASH_STR(hash, job_ptr->nodes);
+	hash = _JOB_PACK_HASH_STR(hash, job_ptr->state_desc);
+	key.str_hash = hash;
+
+	if (cache_ptr && (cache_ptr->select_gen == select_gen)) {
+		key.select_hash = cache_ptr->key.select_hash;
+	} else {
+		if (job_pack_key_buf == NULL)
+			job_pack_key_buf = init_buf(BUF_SIZE);
+		set_buf_offset(job_pack_key_buf, 0);
+		select_g_select_jobinfo_pack(job_ptr->select_jobinfo,
+					     job_pack_key_buf,
+					     SLURM_PROTOCOL_VERSION);
+		key.select_hash = _job_pack_hash(0xcbf29ce484222325ULL,
+					get_buf_data(job_pack_key_buf),
+					get_buf_offset(job_pack_key_buf));
+	}
+
+	if (cache_ptr == NULL) {
+		cache_ptr = xmalloc(sizeof(struct job_pack_cache));
+		job_ptr->pack_cache = cache_ptr;
+	} else if (memcmp(&cache_ptr->key, &key, sizeof(job_pack_key_t)))
+		cache_ptr->key_update = now;
+	cache_ptr->select_gen = select_gen;
+	memcpy(&cache_ptr->key, &key, sizeof(job_pack_key_t));
+}
+
+/*
+ * _job_pack_update_time - Return the time a job record last changed in a
+ *	way visible to job information requests: the later of its last_update
+ *	time and the last change found by _job_pack_key_test()
+ * NOTE: Lock job_pack_mutex and call _job_pack_key_test() before entry
+ */
+static time_t _job_pack_update_time(struct job_record *job_ptr)
+{
+	return MAX(job_ptr->last_update, job_ptr->pack_cache->key_update);
+}
+
+/*
+ * _pack_job_cached - pack a job record, using a copy cached in the job
+ *	record if still valid, otherwise pack the record and cache the result
+ *	if it is independent of the requester
+ * NOTE: Lock job_pack_mutex and call _job_pack_key_test() before entry
+ */
+static void _pack_job_cached(struct job_record *job_ptr, uint16_t show_flags,
+			     Buf buffer, uint16_t protocol_version, uid_t uid,
+			     time_t now)
+{
+	struct job_pack_cache *cache_ptr = job_ptr->pack_cache;
+	int inx = (show_flags & SHOW_ALL) ? 1 : 0;
+	uint32_t offset;
+
+	if ((show_flags & SHOW_DETAIL) ||
+	    (protocol_version != SLURM_PROTOCOL_VERSION)) {
+		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		return;
+	}
+
+	/* The packed record includes the partition's name and maximum time
+	 * limit. Records packed in the second of an update may be stale. */
+	if (cache_ptr->data[inx] &&
+	    (cache_ptr->show_flags[inx] == show_flags) &&
+	    (cache_ptr->pack_time[inx] > _job_pack_update_time(job_ptr)) &&
+	    (cache_ptr->pack_time[inx] > last_part_update)) {
+		packmem_array(cache_ptr->data[inx], cache_ptr->data_size[inx],
+			      buffer);
+		job_pack_hits++;
+		return;
+	}
+
+	offset = get_buf_offset(buffer);
+	pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+	xfree(cache_ptr->data[inx]);
+	cache_ptr->data_size[inx] = get_buf_offset(buffer) - offset;
+	cache_ptr->data[inx] = xmalloc(cache_ptr->data_size[inx]);
+	memcpy(cache_ptr->data[inx], get_buf_data(buffer) + offset,
+	       cache_ptr->data_size[inx]);
+	cache_ptr->pack_time[inx] = now;
+	cache_ptr->show_flags[inx] = show_flags;
+	job_pack_misses++;
+}
+
+/* Return true if the job should be reported to the given user */
+static bool _job_visible(struct job_record *job_ptr, uint16_t show_flags,
+			 uid_t uid)
+{
+	if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
+	    (job_ptr->part_ptr) &&
+	    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
+		return false;
+
+	if ((slurmctld_conf.private_data & PRIVATE_DATA_JOBS) &&
+	    (job_ptr->user_id != uid) && !validate_operator(uid) &&
+	    !assoc_mgr_is_user_acct_coord(acct_db_conn, uid,
+					  job_ptr->account))
+		return false;
+
+	return true;
+}
+
+/* Return true if the job is ready for purging and should not be reported.
+ * If purge_time is set, it is set to the time the job became ready. */
+static bool _job_purgeable(struct job_record *job_ptr, time_t min_age,
+			   time_t *purge_time)
+{
+	if ((min_age > 0) && (job_ptr->end_time < min_age) &&
+	    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr)) {
+		if (purge_time) {
+			*purge_time = job_ptr->end_time +
+				      slurmctld_conf.min_job_age;
+		}
+		return true;
+	}
+	return false;
+}
+
+/* Log job information packing statistics accumulated since the last
+ * report, then clear them */
+extern void job_pack_stats_report(void)
+{
+	slurm_mutex_lock(&job_pack_mutex);
+	debug("Job pack stats: cached=%u packed=%u delta=%u delta_full=%u "
+	      "removed_records=%d", job_pack_hits, job_pack_misses,
+	      job_delta_cnt, job_delta_full_cnt,
+	      job_removed_list ? list_count(job_removed_list) : 0);
+	job_pack_hits = job_pack_misses = 0;
+	job_delta_cnt = job_delta_full_cnt = 0;
+	slurm_mutex_unlock(&job_pack_mutex);
+}
+
+
 /*
  * pack_all_jobs - dump all job information for all jobs in
  *	machine independent form (for network transmission)
@@ -5267,30 +6208,24 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 
 	/* write individual job records */
 	part_filter_set(uid);
+	slurm_mutex_lock(&job_pack_mutex);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
 
-		if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
-		    (job_ptr->part_ptr) &&
-		    (job_ptr->part_ptr->flags & PART_FLAG_HIDDEN))
-			continue;
-
-		if ((slurmctld_conf.private_data & PRIVATE_DATA_JOBS) &&
-		    (job_ptr->user_id != uid) && !validate_operator(uid) &&
-		    !assoc_mgr_is_user_acct_coord(acct_db_conn, uid,
-						  job_ptr->account))
+		_job_pack_key_test(job_ptr, now);
+		if (!_job_visible(job_ptr, show_flags, uid))
 			continue;
-
-		if ((min_age > 0) && (job_ptr->end_time < min_age) &&
-		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
+		if (_job_purgeable(job_ptr, min_age, NULL))
 			continue;	/* job ready for purging, don't dump */
 
-		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		_pack_job_cached(job_ptr, show_flags, buffer,
+				 protocol_version, uid, now);
 		jobs_packed++;
 	}
-	part_filter_clear();
 	list_iterator_destroy(job_iterator);
+	slurm_mutex_unlock(&job_pack_mutex);
+	part_filter_clear();
 
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
@@ -5302,6 +6237,118 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
 
+/*
+ * pack_job_delta - dump job information for jobs which have changed or
+ *	been removed since a given time in machine independent form (for
+ *	network transmission)
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN since - time of the requester's previous job information
+ * IN show_flags - job filtering options
+ * IN uid - uid of user making request (for partition filtering)
+ * global: job_list - global list of job records
+ * NOTE: If the changes since the given time can not be determined, all
+ *	job information is packed and flagged as such
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: change _unpack_job_info_delta_msg() in common/slurm_protocol_pack.c
+ *	whenever the data format changes
+ */
+extern void pack_job_delta(char **buffer_ptr, int *buffer_size, time_t since,
+			   uint16_t show_flags, uid_t uid,
+			   uint16_t protocol_version)
+{
+	ListIterator iterator;
+	struct job_record *job_ptr;
+	job_removed_t *removed_ptr;
+	uint32_t jobs_packed = 0, tmp_offset;
+	uint32_t removed_cnt = 0, removed_size = 0, *removed_ids = NULL;
+	uint16_t full;
+	Buf buffer;
+	time_t min_age = 0, purge_time, update_time, now = time(NULL);
+
+	buffer_ptr[0] = NULL;
+	*buffer_size = 0;
+
+	/* Job visibility may have changed with the partition or configuration
+	 * (PrivateData), and removed jobs are only remembered for a while */
+	full = ((since <= job_removed_horizon) ||
+		(since <= last_part_update) ||
+		(since <= slurmctld_conf.last_update));
+
+	buffer = init_buf(BUF_SIZE);
+	pack16(full, buffer);
+	pack32(jobs_packed, buffer);
+	pack_time(now, buffer);
+
+	if (slurmctld_conf.min_job_age > 0)
+		min_age = now  - slurmctld_conf.min_job_age;
+
+	part_filter_set(uid);
+	slurm_mutex_lock(&job_pack_mutex);
+	job_delta_cnt++;
+	if (full)
+		job_delta_full_cnt++;
+	iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(iterator))) {
+		xassert (job_ptr->magic == JOB_MAGIC);
+
+		_job_pack_key_test(job_ptr, now);
+		update_time = _job_pack_update_time(job_ptr);
+		purge_time = 0;
+		if (!_job_visible(job_ptr, show_flags, uid) ||
+		    _job_purgeable(job_ptr, min_age, &purge_time)) {
+			/* The requester may still have a copy of this job */
+			if (!full && ((update_time >= since) ||
+				      (purge_time >= since))) {
+				if (removed_cnt >= removed_size) {
+					removed_size += 64;
+					xrealloc(removed_ids, sizeof(uint32_t) *
+						 removed_size);
+				}
+				removed_ids[removed_cnt++] = job_ptr->job_id;
+			}
+			continue;
+		}
+		/* A job updated in the same second as the requester's previous
+		 * job information may or may not be included in it */
+		if (!full && (update_time < since))
+			continue;	/* requester has current record */
+
+		_pack_job_cached(job_ptr, show_flags, buffer,
+				 protocol_version, uid, now);
+		jobs_packed++;
+	}
+	list_iterator_destroy(iterator);
+	slurm_mutex_unlock(&job_pack_mutex);
+	part_filter_clear();
+
+	if (!full) {
+		iterator = list_iterator_create(job_removed_list);
+		while ((removed_ptr = (job_removed_t *) list_next(iterator))) {
+			if (removed_ptr->remove_time < since)
+				continue;
+			if (removed_cnt >= removed_size) {
+				removed_size += 64;
+				xrealloc(removed_ids,
+					 sizeof(uint32_t) * removed_size);
+			}
+			removed_ids[removed_cnt++] = removed_ptr->job_id;
+		}
+		list_iterator_destroy(iterator);
+	}
+	pack32_array(removed_ids, removed_cnt, buffer);
+	xfree(removed_ids);
+
+	/* put the real record count in the message body header */
+	tmp_offset = get_buf_offset(buffer);
+	set_buf_offset(buffer, sizeof(uint16_t));
+	pack32(jobs_packed, buffer);
+	set_buf_offset(buffer, tmp_offset);
+
+	*buffer_size = get_buf_offset(buffer);
+	buffer_ptr[0] = xfer_buf_data(buffer);
+}
+
 /*
  * pack_one_job - dump information for one jobs in
  *	machine independent form (for network transmission)
@@ -5884,6 +6931,10 @@ void purge_old_job(void)
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		if (!IS_JOB_PENDING(job_ptr))
 			continue;
+		/* Fully test dependencies periodically in case some change
+		 * of job state did not call notify_job_dependents() */
+		if (job_ptr->details)
+			job_ptr->details->depend_valid = false;
 		if (test_job_dependency(job_ptr) == 2) {
 			info("Job dependency can't be satisfied, cancelling "
 			     "job %u", job_ptr->job_id);
@@ -5893,6 +6944,8 @@ void purge_old_job(void)
 			job_ptr->end_time	= now;
 			job_completion_logger(job_ptr, false);
 			last_job_update		= now;
+			job_ptr->last_update	= now;
+			mark_job_state_dirty(job_ptr);
 			srun_allocate_abort(job_ptr);
 		}
 	}
@@ -5902,6 +6955,9 @@ void purge_old_job(void)
 	if (i) {
 		debug2("purge_old_job: purged %d old job records", i);
 /*		last_job_update = now;		don't worry about state save */
+		/* Cheap to journal, keeps purged jobs out of saved state */
+		if (job_journal_removed && list_count(job_journal_removed))
+			schedule_job_save();
 	}
 }
 
@@ -6442,7 +7498,8 @@ int update_job(job_desc_msg_t * job_specs, uid_t uid)
 	detail_ptr = job_ptr->details;
 	if (detail_ptr)
 		mc_ptr = detail_ptr->mc_ptr;
-	last_job_update = now;
+	last_job_update = job_ptr->last_update = now;
+	mark_job_state_dirty(job_ptr);
 
 	if (job_specs->account) {
 		if (!IS_JOB_PENDING(job_ptr))
@@ -7350,6 +8407,7 @@ int update_job(job_desc_msg_t * job_specs, uid_t uid)
 		} else {
 			job_ptr->name = job_specs->name;
 			job_specs->name = NULL;
+			rehash_job_name(job_ptr);
 
 			info("sched: update_job: setting name to %s for "
 			     "job_id %u", job_ptr->name, job_specs->job_id);
@@ -8417,6 +9475,7 @@ extern bool job_epilog_complete(uint32_t job_id, char *node_name,
 
 	if (job_ptr == NULL)
 		return true;
+	mark_job_state_dirty(job_ptr);
 
 	/* There is a potential race condition this handles.
 	 * If slurmctld cold-starts while slurmd keeps running,
@@ -8540,11 +9599,26 @@ extern bool job_epilog_complete(uint32_t job_id, char *node_name,
 /* job_fini - free all memory associated with job records */
 void job_fini (void)
 {
+	FREE_NULL_LIST(job_removed_list);
+	FREE_NULL_LIST(job_journal_removed);
+	if (job_pack_key_buf) {
+		free_buf(job_pack_key_buf);
+		job_pack_key_buf = NULL;
+	}
+	if (job_journal_fd >= 0) {
+		(void) close(job_journal_fd);
+		job_journal_fd = -1;
+	}
 	if (job_list) {
 		list_destroy(job_list);
 		job_list = NULL;
 	}
-	xfree(job_hash);
+	xfree(job_state_dirty);
+	job_state_dirty_cnt = job_state_dirty_size = 0;
+	xfree(job_id_hash.slot);
+	memset(&job_id_hash, 0, sizeof(job_hash_table_t));
+	xfree(job_name_hash.slot);
+	memset(&job_name_hash, 0, sizeof(job_hash_table_t));
 }
 
 /* log the completion of the specified job */
@@ -8555,7 +9629,9 @@ extern void job_completion_logger(struct job_record  *job_ptr, bool requeue)
 
 	xassert(job_ptr);
 
+	mark_job_state_dirty(job_ptr);
 	acct_policy_remove_job_submit(job_ptr);
+	notify_job_dependents(job_ptr);
 
 	if (!IS_JOB_RESIZING(job_ptr)) {
 		/* Remove configuring state just to make sure it isn't there
@@ -8852,7 +9928,8 @@ static int _suspend_job_nodes(struct job_record *job_ptr, bool clear_prio)
 			node_ptr->last_idle  = now;
 		}
 	}
-	last_job_update = last_node_update = now;
+	last_job_update = last_node_update = job_ptr->last_update = now;
+	mark_job_state_dirty(job_ptr);
 	return rc;
 }
 
@@ -8896,7 +9973,8 @@ static int _resume_job_nodes(struct job_record *job_ptr, bool clear_prio)
 		node_flags = node_ptr->node_state & NODE_STATE_FLAGS;
 		node_ptr->node_state = NODE_STATE_ALLOCATED | node_flags;
 	}
-	last_job_update = last_node_update = time(NULL);
+	last_job_update = last_node_update = job_ptr->last_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 	return rc;
 }
 
@@ -9099,7 +10177,8 @@ extern int job_requeue (uid_t uid, uint32_t job_id, slurm_fd_t conn_fd,
 	}
 
 	slurm_sched_requeue(job_ptr, "Job requeued by user/admin");
-	last_job_update = now;
+	last_job_update = job_ptr->last_update = now;
+	mark_job_state_dirty(job_ptr);
 
 	if (IS_JOB_SUSPENDED(job_ptr)) {
 		enum job_states suspend_job_state = job_ptr->job_state;
@@ -9378,7 +10457,8 @@ extern int update_job_account(char *module, struct job_record *job_ptr,
 	}
 	job_ptr->assoc_id = assoc_rec.id;
 
-	last_job_update = time(NULL);
+	last_job_update = job_ptr->last_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 
 	return SLURM_SUCCESS;
 }
@@ -9442,7 +10522,8 @@ extern int update_job_wckey(char *module, struct job_record *job_ptr,
 		     module, job_ptr->job_id);
 	}
 
-	last_job_update = time(NULL);
+	last_job_update = job_ptr->last_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 
 	return SLURM_SUCCESS;
 }
@@ -10019,7 +11100,8 @@ extern int job_restart(checkpoint_msg_t *ckpt_ptr, uid_t uid, slurm_fd_t conn_fd
 		job_ptr->details->restart_dir = image_dir;
 		image_dir = NULL;	/* Nothing left to xfree */
 
-		last_job_update = time(NULL);
+		last_job_update = job_ptr->last_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
 	}
 
  unpack_error:
@@ -77,11 +77,21 @@
 #define MAX_RETRIES 10
 
 static char **	_build_env(struct job_record *job_ptr);
+static void	_depend_child_add(struct job_record *job_ptr,
+				  uint32_t child_id);
+static int	_depend_child_cmp(const void *a, const void *b);
+static bool	_depend_child_test(struct job_record *child_ptr,
+				   struct job_record *job_ptr);
 static void	_depend_list_del(void *dep_ptr);
 static void	_feature_list_delete(void *x);
-static void	_job_queue_append(List job_queue, struct job_record *job_ptr,
-				  struct part_record *part_ptr);
 static void	_job_queue_rec_del(void *x);
+static void	_job_queue_view_append(job_queue_view_t *view,
+				       struct job_record *job_ptr,
+				       struct part_record *part_ptr);
+static int	_job_queue_view_cmp(job_queue_view_t *view,
+				    uint32_t inx1, uint32_t inx2);
+static void	_job_queue_view_sift(job_queue_view_t *view, uint32_t pos);
+static bool	_preempt_check_needed(void);
 static void *	_run_epilog(void *arg);
 static void *	_run_prolog(void *arg);
 static bool	_scan_depend(List dependency_list, uint32_t job_id);
@@ -89,54 +99,124 @@ static int	_valid_feature_list(uint32_t job_id, List feature_list);
 static int	_valid_node_feature(char *feature);
 
 
-/*
- * _build_user_job_list - build list of jobs for a given user
- *			  and an optional job name
- * IN  user_id - user id
- * IN  job_name - job name constraint
- * RET the job queue
- * NOTE: the caller must call list_destroy() on RET value to free memory
- */
-static List _build_user_job_list(uint32_t user_id, char* job_name)
+static void _job_queue_rec_del(void *x)
 {
-	List job_queue;
-	ListIterator job_iterator;
-	struct job_record *job_ptr = NULL;
+	xfree(x);
+}
 
-	job_queue = list_create(NULL);
-	if (job_queue == NULL)
-		fatal("list_create memory allocation failure");
-	job_iterator = list_iterator_create(job_list);
-	if (job_iterator == NULL)
-		fatal("list_iterator_create malloc failure");
-	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
-		xassert (job_ptr->magic == JOB_MAGIC);
-		if (job_ptr->user_id != user_id)
-			continue;
-		if (job_name && job_ptr->name &&
-		    strcmp(job_name, job_ptr->name))
-			continue;
-		list_append(job_queue, job_ptr);
+/* Add an entry for a job in the given partition to a job queue view */
+static void _job_queue_view_append(job_queue_view_t *view,
+				   struct job_record *job_ptr,
+				   struct part_record *part_ptr)
+{
+	uint32_t i, inx;
+
+	if (view->count >= view->size) {
+		view->size = MAX(view->size * 2, 1024);
+		xrealloc(view->job_ptr,  sizeof(struct job_record *) *
+					 view->size);
+		xrealloc(view->part_ptr, sizeof(struct part_record *) *
+					 view->size);
+		xrealloc(view->part_inx, sizeof(uint32_t) * view->size);
+		xrealloc(view->job_id,   sizeof(uint32_t) * view->size);
+		xrealloc(view->priority, sizeof(uint32_t) * view->size);
+		xrealloc(view->flags,    sizeof(uint16_t) * view->size);
 	}
-	list_iterator_destroy(job_iterator);
 
-	return job_queue;
+	for (i = 0; i < view->part_cnt; i++) {
+		if (view->part_table[i] == part_ptr)
+			break;
+	}
+	if (i == view->part_cnt) {	/* not in part_list */
+		xrealloc(view->part_table, sizeof(struct part_record *) *
+					   (view->part_cnt + 1));
+		view->part_table[view->part_cnt++] = part_ptr;
+	}
+
+	inx = view->count++;
+	view->job_ptr[inx]  = job_ptr;
+	view->part_ptr[inx] = part_ptr;
+	view->part_inx[inx] = i;
+	view->job_id[inx]   = job_ptr->job_id;
+	view->priority[inx] = job_ptr->priority;
+	view->flags[inx]    = 0;
+	if (job_ptr->resv_id)
+		view->flags[inx] |= JOB_VIEW_RESV;
 }
 
-static void _job_queue_append(List job_queue, struct job_record *job_ptr,
-			      struct part_record *part_ptr)
+/* Compare two entries of a job queue view as sort_job_queue2() does, with
+ * the lower job ID first if they are otherwise equal */
+static int _job_queue_view_cmp(job_queue_view_t *view,
+			       uint32_t inx1, uint32_t inx2)
 {
-	job_queue_rec_t *job_queue_rec;
+	job_queue_rec_t job_rec1, job_rec2;
+	uint16_t has_resv1, has_resv2;
+
+	if (view->preempt_check) {
+		job_rec1.job_ptr  = view->job_ptr[inx1];
+		job_rec1.part_ptr = view->part_ptr[inx1];
+		job_rec2.job_ptr  = view->job_ptr[inx2];
+		job_rec2.part_ptr = view->part_ptr[inx2];
+		if (slurm_job_preempt_check(&job_rec1, &job_rec2))
+			return -1;
+		if (slurm_job_preempt_check(&job_rec2, &job_rec1))
+			return 1;
+	}
+
+	has_resv1 = view->flags[inx1] & JOB_VIEW_RESV;
+	has_resv2 = view->flags[inx2] & JOB_VIEW_RESV;
+	if (has_resv1 && !has_resv2)
+		return -1;
+	if (!has_resv1 && has_resv2)
+		return 1;
+
+	if (view->priority[inx1] < view->priority[inx2])
+		return 1;
+	if (view->priority[inx1] > view->priority[inx2])
+		return -1;
+	if (view->job_id[inx1] < view->job_id[inx2])
+		return -1;
+	if (view->job_id[inx1] > view->job_id[inx2])
+		return 1;
+	return 0;
+}
 
-	job_queue_rec = xmalloc(sizeof(job_queue_rec_t));
-	job_queue_rec->job_ptr  = job_ptr;
-	job_queue_rec->part_ptr = part_ptr;
-	list_append(job_queue, job_queue_rec);
+/* Move the entry at position pos of a job queue view's heap down until
+ * neither of its children should run before it */
+static void _job_queue_view_sift(job_queue_view_t *view, uint32_t pos)
+{
+	uint32_t child, inx = view->heap[pos];
+
+	while ((child = (pos * 2) + 1) < view->heap_cnt) {
+		if (((child + 1) < view->heap_cnt) &&
+		    (_job_queue_view_cmp(view, view->heap[child + 1],
+					 view->heap[child]) < 0))
+			child++;
+		if (_job_queue_view_cmp(view, view->heap[child], inx) >= 0)
+			break;
+		view->heap[pos] = view->heap[child];
+		pos = child;
+	}
+	view->heap[pos] = inx;
 }
 
-static void _job_queue_rec_del(void *x)
+/* Return true if the preempt plugin must be consulted to order jobs */
+static bool _preempt_check_needed(void)
 {
-	xfree(x);
+	static time_t config_update = (time_t) 0;
+	static bool preempt_check = true;
+	char *preempt_type;
+
+	if (config_update != slurmctld_conf.last_update) {
+		preempt_type = slurm_get_preempt_type();
+		if (preempt_type && (strcmp(preempt_type, "preempt/none") == 0))
+			preempt_check = false;
+		else
+			preempt_check = true;
+		xfree(preempt_type);
+		config_update = slurmctld_conf.last_update;
+	}
+	return preempt_check;
 }
 
 /*
@@ -148,15 +228,57 @@ static void _job_queue_rec_del(void *x)
 extern List build_job_queue(bool clear_start)
 {
 	List job_queue;
+	job_queue_view_t *view;
+	job_queue_rec_t *job_queue_rec;
+	uint32_t i;
+
+	job_queue = list_create(_job_queue_rec_del);
+	if (job_queue == NULL)
+		fatal("list_create memory allocation failure");
+	view = build_job_queue_view(clear_start);
+	for (i = 0; i < view->count; i++) {
+		job_queue_rec = xmalloc(sizeof(job_queue_rec_t));
+		job_queue_rec->job_ptr  = view->job_ptr[i];
+		job_queue_rec->part_ptr = view->part_ptr[i];
+		list_append(job_queue, job_queue_rec);
+	}
+	free_job_queue_view(view);
+
+	return job_queue;
+}
+
+/*
+ * build_job_queue_view - build a view of the pending jobs which are eligible
+ *	to be scheduled, with the same tests and side effects as
+ *	build_job_queue()
+ * IN clear_start - if set then clear the start_time for pending jobs
+ * RET the view, use job_queue_view_next() to get its entries in priority
+ *	order
+ * NOTE: the caller must call free_job_queue_view() on RET value to free
+ *	memory
+ */
+extern job_queue_view_t *build_job_queue_view(bool clear_start)
+{
+	job_queue_view_t *view;
 	ListIterator job_iterator, part_iterator;
 	struct job_record *job_ptr = NULL;
 	struct part_record *part_ptr;
 	bool job_is_pending;
 	bool job_indepen = false;
 
-	job_queue = list_create(_job_queue_rec_del);
-	if (job_queue == NULL)
-		fatal("list_create memory allocation failure");
+	view = xmalloc(sizeof(job_queue_view_t));
+	view->preempt_check = _preempt_check_needed();
+	view->part_cnt = list_count(part_list);
+	view->part_table = xmalloc(sizeof(struct part_record *) *
+				   MAX(view->part_cnt, 1));
+	view->part_cnt = 0;
+	part_iterator = list_iterator_create(part_list);
+	if (part_iterator == NULL)
+		fatal("list_iterator_create memory allocation failure");
+	while ((part_ptr = (struct part_record *) list_next(part_iterator)))
+		view->part_table[view->part_cnt++] = part_ptr;
+	list_iterator_destroy(part_iterator);
+
 	job_iterator = list_iterator_create(job_list);
 	if (job_iterator == NULL)
 		fatal("list_iterator_create memory allocation failure");
@@ -199,7 +321,8 @@ extern List build_job_queue(bool clear_start)
 				fatal("list_iterator_create malloc failure");
 			while ((part_ptr = (struct part_record *)
 					list_next(part_iterator))) {
-				_job_queue_append(job_queue, job_ptr, part_ptr);
+				_job_queue_view_append(view, job_ptr,
+						       part_ptr);
 			}
 			list_iterator_destroy(part_iterator);
 		} else {
@@ -216,13 +339,61 @@ extern List build_job_queue(bool clear_start)
 				      "part %s", job_ptr->job_id,
 				      job_ptr->partition);
 			}
-			_job_queue_append(job_queue, job_ptr,
-					  job_ptr->part_ptr);
+			_job_queue_view_append(view, job_ptr,
+					       job_ptr->part_ptr);
 		}
 	}
 	list_iterator_destroy(job_iterator);
 
-	return job_queue;
+	return view;
+}
+
+/* Free a job queue view made by build_job_queue_view() */
+extern void free_job_queue_view(job_queue_view_t *view)
+{
+	if (view == NULL)
+		return;
+	xfree(view->job_ptr);
+	xfree(view->part_ptr);
+	xfree(view->part_inx);
+	xfree(view->job_id);
+	xfree(view->priority);
+	xfree(view->flags);
+	xfree(view->part_table);
+	xfree(view->heap);
+	xfree(view);
+}
+
+/*
+ * job_queue_view_next - return the entries of a job queue view in order of
+ *	decreasing priority, the order of sort_job_queue2() with job ID
+ *	breaking ties
+ * IN/OUT view - view made by build_job_queue_view()
+ * RET index of the next entry in view's arrays or -1 if none remain
+ */
+extern int job_queue_view_next(job_queue_view_t *view)
+{
+	uint32_t i, inx;
+
+	if (!view->heap_built) {
+		/* Building the heap takes linear time, after which each
+		 * entry costs a logarithmic number of comparisons */
+		view->heap = xmalloc(sizeof(uint32_t) * MAX(view->count, 1));
+		for (i = 0; i < view->count; i++)
+			view->heap[i] = i;
+		view->heap_cnt = view->count;
+		for (i = view->heap_cnt / 2; i > 0; i--)
+			_job_queue_view_sift(view, i - 1);
+		view->heap_built = true;
+	}
+	if (view->heap_cnt == 0)
+		return -1;
+
+	inx = view->heap[0];
+	view->heap[0] = view->heap[--view->heap_cnt];
+	if (view->heap_cnt)
+		_job_queue_view_sift(view, 0);
+	return (int) inx;
 }
 
 /*
@@ -296,22 +467,6 @@ extern void set_job_elig_time(void)
 	unlock_slurmctld(job_write_lock);
 }
 
-/* Test of part_ptr can still run jobs or if its nodes have
- * already been reserved by higher priority jobs (those in
- * the failed_parts array) */
-static bool _failed_partition(struct part_record *part_ptr,
-			      struct part_record **failed_parts,
-			      int failed_part_cnt)
-{
-	int i;
-
-	for (i = 0; i < failed_part_cnt; i++) {
-		if (failed_parts[i] == part_ptr)
-			return true;
-	}
-	return false;
-}
-
 /*
  * schedule - attempt to schedule all pending jobs
  *	pending jobs for each partition will be scheduled in priority
@@ -327,12 +482,12 @@ static bool _failed_partition(struct part_record *part_ptr,
  */
 extern int schedule(uint32_t job_limit)
 {
-	List job_queue = NULL;
-	int error_code, failed_part_cnt = 0, job_cnt = 0, i;
-	uint32_t job_depth = 0;
-	job_queue_rec_t *job_queue_rec;
+	job_queue_view_t *job_queue;
+	int error_code, job_cnt = 0, i, inx;
+	uint32_t job_depth = 0, part_inx, queue_cnt;
 	struct job_record *job_ptr;
-	struct part_record *part_ptr, **failed_parts = NULL;
+	struct part_record *part_ptr;
+	bool *failed_parts;
 	bitstr_t *save_avail_node_bitmap;
 	/* Locks: Read config, write job, write node, read partition */
 	slurmctld_lock_t job_write_lock =
@@ -417,16 +572,18 @@ extern int schedule(uint32_t job_limit)
 	}
 #endif
 
-	failed_parts = xmalloc(sizeof(struct part_record *) *
-			       list_count(part_list));
 	save_avail_node_bitmap = bit_copy(avail_node_bitmap);
 
 	debug("sched: Running job scheduler");
-	job_queue = build_job_queue(false);
-	while ((job_queue_rec = list_pop_bottom(job_queue, sort_job_queue2))) {
-		job_ptr  = job_queue_rec->job_ptr;
-		part_ptr = job_queue_rec->part_ptr;
-		xfree(job_queue_rec);
+	job_queue = build_job_queue_view(false);
+	queue_cnt = job_queue->count;
+	/* Partitions whose nodes are reserved for higher priority jobs,
+	 * indexed like job_queue->part_table */
+	failed_parts = xmalloc(sizeof(bool) * MAX(job_queue->part_cnt, 1));
+	while ((inx = job_queue_view_next(job_queue)) >= 0) {
+		job_ptr  = job_queue->job_ptr[inx];
+		part_ptr = job_queue->part_ptr[inx];
+		part_inx = job_queue->part_inx[inx];
 		if ((time(NULL) - sched_start) >= sched_timeout) {
 			debug("sched: loop taking too long, breaking out");
 			break;
@@ -451,9 +608,7 @@ extern int schedule(uint32_t job_limit)
 			/* Cycle through partitions usable for this job */
 			job_ptr->part_ptr = part_ptr;
 		}
-		if ((job_ptr->resv_name == NULL) &&
-		    _failed_partition(job_ptr->part_ptr, failed_parts,
-				      failed_part_cnt)) {
+		if ((job_ptr->resv_name == NULL) && failed_parts[part_inx]) {
 			if (job_ptr->priority != 1) {	/* not system hold */
 				job_ptr->state_reason = WAIT_PRIORITY;
 				xfree(job_ptr->state_desc);
@@ -467,8 +622,8 @@ extern int schedule(uint32_t job_limit)
 			       job_ptr->partition);
 			continue;
 		}
-		if (bit_overlap(avail_node_bitmap,
-				job_ptr->part_ptr->node_bitmap) == 0) {
+		if (!bit_overlap_any(avail_node_bitmap,
+				     job_ptr->part_ptr->node_bitmap)) {
 			/* All nodes DRAIN, DOWN, or
 			 * reserved for jobs in higher priority partition */
 			job_ptr->state_reason = WAIT_RESOURCES;
@@ -502,7 +657,8 @@ extern int schedule(uint32_t job_limit)
 			 * very rare. */
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
-			last_job_update = time(NULL);
+			last_job_update = job_ptr->last_update = time(NULL);
+			mark_job_state_dirty(job_ptr);
 			job_ptr->job_state = JOB_FAILED;
 			job_ptr->exit_code = 1;
 			job_ptr->state_reason = FAIL_ACCOUNT;
@@ -535,8 +691,7 @@ extern int schedule(uint32_t job_limit)
 			if (fail_by_part) {
 		 		/* do not schedule more jobs in this partition
 				 * or on nodes in this partition */
-				failed_parts[failed_part_cnt++] =
-						job_ptr->part_ptr;
+				failed_parts[part_inx] = true;
 				bit_not(job_ptr->part_ptr->node_bitmap);
 				bit_and(avail_node_bitmap,
 					job_ptr->part_ptr->node_bitmap);
@@ -570,7 +725,8 @@ extern int schedule(uint32_t job_limit)
 		} else if (error_code == SLURM_SUCCESS) {
 			/* job initiated */
 			debug3("sched: JobId=%u initiated", job_ptr->job_id);
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
+			mark_job_state_dirty(job_ptr);
 #ifdef HAVE_BG
 			select_g_select_jobinfo_get(job_ptr->select_jobinfo,
 						    SELECT_JOBDATA_IONODES,
@@ -602,7 +758,8 @@ extern int schedule(uint32_t job_limit)
 			info("sched: schedule: JobId=%u non-runnable: %s",
 			     job_ptr->job_id, slurm_strerror(error_code));
 			if (!wiki_sched) {
-				last_job_update = now;
+				last_job_update = job_ptr->last_update = now;
+				mark_job_state_dirty(job_ptr);
 				job_ptr->job_state = JOB_FAILED;
 				job_ptr->exit_code = 1;
 				job_ptr->state_reason = FAIL_BAD_CONSTRAINTS;
@@ -617,9 +774,11 @@ extern int schedule(uint32_t job_limit)
 	FREE_NULL_BITMAP(avail_node_bitmap);
 	avail_node_bitmap = save_avail_node_bitmap;
 	xfree(failed_parts);
-	list_destroy(job_queue);
+	free_job_queue_view(job_queue);
 	unlock_slurmctld(job_write_lock);
 	END_TIMER2("schedule");
+	debug2("sched: tested %u of %u queued jobs %s",
+	       MIN(job_depth, queue_cnt), queue_cnt, TIME_STR);
 	return job_cnt;
 }
 
@@ -794,6 +953,101 @@ static void _depend_list_del(void *dep_ptr)
 	xfree(dep_ptr);
 }
 
+/* Record that the job child_id depends upon job_ptr, so that its dependency
+ * test result can be discarded when job_ptr's state changes. Duplicate and
+ * stale entries are dropped by notify_job_dependents(). */
+static void _depend_child_add(struct job_record *job_ptr, uint32_t child_id)
+{
+	if (job_ptr->depend_child_cnt >= job_ptr->depend_child_size) {
+		job_ptr->depend_child_size *= 2;
+		if (job_ptr->depend_child_size < 8)
+			job_ptr->depend_child_size = 8;
+		xrealloc(job_ptr->depend_child_id, sizeof(uint32_t) *
+			 job_ptr->depend_child_size);
+	}
+	job_ptr->depend_child_id[job_ptr->depend_child_cnt++] = child_id;
+}
+
+static int _depend_child_cmp(const void *a, const void *b)
+{
+	uint32_t id_a = *(uint32_t *) a, id_b = *(uint32_t *) b;
+
+	if (id_a < id_b)
+		return -1;
+	return (id_a > id_b);
+}
+
+/* Return true if the job child_ptr still depends upon job_ptr */
+static bool _depend_child_test(struct job_record *child_ptr,
+			       struct job_record *job_ptr)
+{
+	ListIterator depend_iter;
+	struct depend_spec *dep_ptr;
+	bool rc = false;
+
+	if ((child_ptr->details == NULL) ||
+	    (child_ptr->details->depend_list == NULL))
+		return false;
+	depend_iter = list_iterator_create(child_ptr->details->depend_list);
+	if (depend_iter == NULL)
+		fatal("list_iterator_create malloc failure");
+	while ((dep_ptr = list_next(depend_iter))) {
+		if (dep_ptr->job_ptr == job_ptr) {
+			rc = true;
+			break;
+		}
+	}
+	list_iterator_destroy(depend_iter);
+	return rc;
+}
+
+/*
+ * notify_job_dependents - note that a job has started, ended, been requeued
+ *	or purged, so that the dependencies of jobs which depend upon it,
+ *	including singleton dependencies of jobs with the same user and name,
+ *	must be tested again
+ * IN job_ptr - pointer to job which has changed
+ */
+extern void notify_job_dependents(struct job_record *job_ptr)
+{
+	struct job_record *child_ptr;
+	List job_queue;
+	ListIterator job_iterator;
+	uint32_t i, j;
+
+	/* Duplicate entries and jobs which no longer exist or no longer
+	 * depend upon this job are dropped from the list */
+	if (job_ptr->depend_child_cnt > 1) {
+		qsort(job_ptr->depend_child_id, job_ptr->depend_child_cnt,
+		      sizeof(uint32_t), _depend_child_cmp);
+	}
+	for (i = 0, j = 0; i < job_ptr->depend_child_cnt; i++) {
+		if ((j > 0) && (job_ptr->depend_child_id[j - 1] ==
+				job_ptr->depend_child_id[i]))
+			continue;
+		child_ptr = find_job_record(job_ptr->depend_child_id[i]);
+		if ((child_ptr == NULL) ||
+		    !_depend_child_test(child_ptr, job_ptr))
+			continue;
+		child_ptr->details->depend_valid = false;
+		job_ptr->depend_child_id[j++] = job_ptr->depend_child_id[i];
+	}
+	job_ptr->depend_child_cnt = j;
+
+	if (job_ptr->name == NULL)
+		return;
+	job_queue = find_job_name_records(job_ptr->user_id, job_ptr->name);
+	job_iterator = list_iterator_create(job_queue);
+	if (job_iterator == NULL)
+		fatal("list_iterator_create malloc failure");
+	while ((child_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (child_ptr->details)
+			child_ptr->details->depend_valid = false;
+	}
+	list_iterator_destroy(job_iterator);
+	list_destroy(job_queue);
+}
+
 /* Print a job's dependency information based upon job_ptr->depend_list */
 extern void print_job_dependency(struct job_record *job_ptr)
 {
@@ -832,7 +1086,9 @@ extern void print_job_dependency(struct job_record *job_ptr)
 }
 
 /*
- * Determine if a job's dependencies are met
+ * Determine if a job's dependencies are met. The result is cached until
+ *	notify_job_dependents() is called for a job upon which this job
+ *	depends or the job's dependencies are updated.
  * RET: 0 = no dependencies
  *      1 = dependencies remain
  *      2 = failure (job completion code not per dependency), delete the job
@@ -846,10 +1102,13 @@ extern int test_job_dependency(struct job_record *job_ptr)
  	bool run_now;
 	int count = 0;
  	struct job_record *qjob_ptr;
+	int rc = 0;
 
 	if ((job_ptr->details == NULL) ||
 	    (job_ptr->details->depend_list == NULL))
 		return 0;
+	if (job_ptr->details->depend_valid)
+		return job_ptr->details->depend_state;
 
 	count = list_count(job_ptr->details->depend_list);
 	depend_iter = list_iterator_create(job_ptr->details->depend_list);
@@ -861,8 +1120,8 @@ extern int test_job_dependency(struct job_record *job_ptr)
  		if ((dep_ptr->depend_type == SLURM_DEPEND_SINGLETON) &&
  		    job_ptr->name) {
  			/* get user jobs with the same user and name */
- 			job_queue = _build_user_job_list(job_ptr->user_id,
-							 job_ptr->name);
+ 			job_queue = find_job_name_records(job_ptr->user_id,
+							  job_ptr->name);
  			run_now = true;
 			job_iterator = list_iterator_create(job_queue);
 			if (job_iterator == NULL)
@@ -950,17 +1209,28 @@ extern int test_job_dependency(struct job_record *job_ptr)
 			xstrsubstitute(job_ptr->details->dependency, 
 				       rmv_dep, "");
 			xfree(rmv_dep);
+			job_ptr->last_update = time(NULL);
+			mark_job_state_dirty(job_ptr);
 		}
 	}
 	list_iterator_destroy(depend_iter);
-	if (!depends && !expands && (count == 0))
+	if (!depends && !expands && (count == 0) &&
+	    job_ptr->details->dependency) {
 		xfree(job_ptr->details->dependency);
+		job_ptr->last_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
+	}
 
 	if (failure)
-		return 2;
-	if (depends)
-		return 1;
-	return 0;
+		rc = 2;
+	else if (depends)
+		rc = 1;
+	/* The expanded job's end time may change at any time */
+	if (!expands) {
+		job_ptr->details->depend_state = rc;
+		job_ptr->details->depend_valid = true;
+	}
+	return rc;
 }
 
 /*
@@ -980,6 +1250,7 @@ extern int update_job_dependency(struct job_record *job_ptr, char *new_depend)
 	List new_depend_list = NULL;
 	struct depend_spec *dep_ptr;
 	struct job_record *dep_job_ptr;
+	ListIterator depend_iter;
 	char dep_buf[32];
 	bool expand_cnt = 0;
 
@@ -987,6 +1258,7 @@ extern int update_job_dependency(struct job_record *job_ptr, char *new_depend)
 		return EINVAL;
 
 	/* Clear dependencies on NULL, "0", or empty dependency input */
+	job_ptr->details->depend_valid = false;
 	job_ptr->details->expanding_jobid = 0;
 	if ((new_depend == NULL) || (new_depend[0] == '\0') ||
 	    ((new_depend[0] == '0') && (new_depend[1] == '\0'))) {
@@ -1136,6 +1408,15 @@ extern int update_job_dependency(struct job_record *job_ptr, char *new_depend)
 		if (job_ptr->details->depend_list)
 			list_destroy(job_ptr->details->depend_list);
 		job_ptr->details->depend_list = new_depend_list;
+		depend_iter = list_iterator_create(new_depend_list);
+		if (!depend_iter)
+			fatal("list_iterator_create memory allocation failure");
+		while ((dep_ptr = list_next(depend_iter))) {
+			if (dep_ptr->job_ptr)
+				_depend_child_add(dep_ptr->job_ptr,
+						  job_ptr->job_id);
+		}
+		list_iterator_destroy(depend_iter);
 #if _DEBUG
 		print_job_dependency(job_ptr);
 #endif
@@ -49,6 +49,33 @@ typedef struct job_queue_rec {
 	struct part_record *part_ptr;
 } job_queue_rec_t;
 
+/* A job queue view holds pending jobs in arrays indexed by entry, with the
+ * fields used to order and filter the queue copied out of the job and
+ * partition records, so a scheduling pass scans contiguous memory rather
+ * than job_list's nodes and the records they point to. A job which may run
+ * in several partitions has one entry per partition. */
+typedef struct job_queue_view {
+	uint32_t count;			/* entries in use */
+	uint32_t size;			/* entries allocated */
+	struct job_record **job_ptr;
+	struct part_record **part_ptr;
+	uint32_t *part_inx;		/* index of part_ptr in part_table */
+	uint32_t *job_id;
+	uint32_t *priority;
+	uint16_t *flags;		/* JOB_VIEW_* */
+
+	struct part_record **part_table;/* partitions of the entries */
+	uint32_t part_cnt;		/* entries in part_table */
+
+	uint32_t *heap;			/* binary heap of entries not yet
+					 * returned by job_queue_view_next() */
+	uint32_t heap_cnt;
+	bool heap_built;
+	bool preempt_check;		/* order using the preempt plugin */
+} job_queue_view_t;
+
+#define JOB_VIEW_RESV	0x0001		/* job has a reservation */
+
 /*
  * build_feature_list - Translate a job's feature string into a feature_list
  * IN  details->features
@@ -65,6 +92,18 @@ extern int build_feature_list(struct job_record *job_ptr);
  */
 extern List build_job_queue(bool clear_start);
 
+/*
+ * build_job_queue_view - build a view of the pending jobs which are eligible
+ *	to be scheduled, with the same tests and side effects as
+ *	build_job_queue()
+ * IN clear_start - if set then clear the start_time for pending jobs
+ * RET the view, use job_queue_view_next() to get its entries in priority
+ *	order
+ * NOTE: the caller must call free_job_queue_view() on RET value to free
+ *	memory
+ */
+extern job_queue_view_t *build_job_queue_view(bool clear_start);
+
 /*
  * epilog_slurmctld - execute the prolog_slurmctld for a job that has just
  *	terminated.
@@ -73,6 +112,9 @@ extern List build_job_queue(bool clear_start);
  */
 extern int epilog_slurmctld(struct job_record *job_ptr);
 
+/* Free a job queue view made by build_job_queue_view() */
+extern void free_job_queue_view(job_queue_view_t *view);
+
 /*
  * job_is_completing - Determine if jobs are in the process of completing.
  * RET - True of any job is in the process of completing AND
@@ -82,6 +124,17 @@ extern int epilog_slurmctld(struct job_record *job_ptr);
  */
 extern bool job_is_completing(void);
 
+/*
+ * job_queue_view_next - return the entries of a job queue view in order of
+ *	decreasing priority, the order of sort_job_queue2() with job ID
+ *	breaking ties. Only the entries actually returned are fully ordered,
+ *	so a pass which tests just the first few jobs costs little more than
+ *	building the view.
+ * IN/OUT view - view made by build_job_queue_view()
+ * RET index of the next entry in view's arrays or -1 if none remain
+ */
+extern int job_queue_view_next(job_queue_view_t *view);
+
 /* Determine if a pending job will run using only the specified nodes
  * (in job_desc_msg->req_nodes), build response message and return
  * SLURM_SUCCESS on success. Otherwise return an error code. Caller
@@ -105,6 +158,15 @@ extern void launch_job(struct job_record *job_ptr);
 extern int make_batch_job_cred(batch_job_launch_msg_t *launch_msg_ptr,
 			       struct job_record *job_ptr);
 
+/*
+ * notify_job_dependents - note that a job has started, ended, been requeued
+ *	or purged, so that the dependencies of jobs which depend upon it,
+ *	including singleton dependencies of jobs with the same user and name,
+ *	must be tested again
+ * IN job_ptr - pointer to job which has changed
+ */
+extern void notify_job_dependents(struct job_record *job_ptr);
+
 /* Print a job's dependency information based upon job_ptr->depend_list */
 extern void print_job_dependency(struct job_record *job_ptr);
 
@@ -152,7 +214,9 @@ extern void sort_job_queue(List job_queue);
 extern int sort_job_queue2(void *x, void *y);
 
 /*
- * Determine if a job's dependencies are met
+ * Determine if a job's dependencies are met. The result is cached until
+ *	notify_job_dependents() is called for a job upon which this job
+ *	depends or the job's dependencies are updated.
  * RET: 0 = no dependencies
  *      1 = dependencies remain
  *      2 = failure (job completion code not per dependency), delete the job
@@ -46,12 +46,28 @@
 #endif
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
+#include "src/common/timers.h"
+#include "src/common/xstring.h"
+
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/slurmctld.h"
 
+/* Lock wait and hold time histograms. Bucket i counts times below
+ * 10^(i+1) microseconds, the last bucket counts all longer times */
+#define LOCK_HIST_BUCKETS 7
+
+typedef struct lock_time_stats {
+	uint32_t cnt;
+	uint64_t total_usec;
+	uint64_t max_usec;
+	uint32_t hist[LOCK_HIST_BUCKETS];
+} lock_time_stats_t;
+
 static pthread_mutex_t locks_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t locks_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -59,6 +75,20 @@ static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
 static slurmctld_lock_flags_t slurmctld_locks;
 static int kill_thread = 0;
 
+/* Statistics indexed by [datatype][0=read, 1=write],
+ * protected by locks_mutex */
+static lock_time_stats_t lock_wait_stats[ENTITY_COUNT][2];
+static lock_time_stats_t lock_hold_stats[ENTITY_COUNT][2];
+
+/* Time at which each lock was acquired. There is only one writer, but
+ * readers record their acquire time in thread specific data */
+static struct timeval write_lock_time[ENTITY_COUNT];
+static pthread_key_t read_lock_time_key;
+static pthread_once_t read_lock_time_once = PTHREAD_ONCE_INIT;
+
+static void _lock_stats_add(lock_time_stats_t *stats, long usec);
+static struct timeval *_read_lock_time(void);
+static void _read_lock_time_init(void);
 static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock);
 static void _wr_rdunlock(lock_datatype_t datatype);
 static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock);
@@ -185,16 +215,70 @@ extern void unlock_slurmctld(slurmctld_lock_t lock_levels)
 		_wr_wrunlock(CONFIG_LOCK);
 }
 
+/* Record one event of the given duration */
+static void _lock_stats_add(lock_time_stats_t *stats, long usec)
+{
+	int i;
+	long limit = 10;
+
+	if (usec < 0)
+		usec = 0;
+	for (i = 0; i < (LOCK_HIST_BUCKETS - 1); i++, limit *= 10) {
+		if (usec < limit)
+			break;
+	}
+	stats->hist[i]++;
+	stats->cnt++;
+	stats->total_usec += usec;
+	if (usec > stats->max_usec)
+		stats->max_usec = usec;
+}
+
+static void _read_lock_time_destroy(void *arg)
+{
+	free(arg);
+}
+
+static void _read_lock_time_init(void)
+{
+	if (pthread_key_create(&read_lock_time_key, _read_lock_time_destroy))
+		fatal("pthread_key_create: %m");
+}
+
+/* Return this thread's array of read lock acquire times */
+static struct timeval *_read_lock_time(void)
+{
+	struct timeval *tv;
+
+	(void) pthread_once(&read_lock_time_once, _read_lock_time_init);
+	tv = pthread_getspecific(read_lock_time_key);
+	if (tv == NULL) {
+		/* malloc rather than xmalloc, freed by pthread destructor */
+		tv = calloc(ENTITY_COUNT, sizeof(struct timeval));
+		if (tv == NULL)
+			fatal("calloc: %m");
+		(void) pthread_setspecific(read_lock_time_key, tv);
+	}
+	return tv;
+}
+
 /* _wr_rdlock - Issue a read lock on the specified data type */
 static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 {
 	bool success = true;
+	struct timeval *lock_tv = _read_lock_time();
+	struct timeval start_tv;
 
+	gettimeofday(&start_tv, NULL);
 	slurm_mutex_lock(&locks_mutex);
 	while (1) {
 		if ((slurmctld_locks.entity[write_wait_lock(datatype)] == 0) &&
 		    (slurmctld_locks.entity[write_lock(datatype)] == 0)) {
 			slurmctld_locks.entity[read_lock(datatype)]++;
+			gettimeofday(&lock_tv[datatype], NULL);
+			_lock_stats_add(&lock_wait_stats[datatype][0],
+					slurm_diff_tv(&start_tv,
+						      &lock_tv[datatype]));
 			break;
 		} else if (!wait_lock) {
 			success = false;
@@ -212,7 +296,13 @@ static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 /* _wr_rdunlock - Issue a read unlock on the specified data type */
 static void _wr_rdunlock(lock_datatype_t datatype)
 {
+	struct timeval *lock_tv = _read_lock_time();
+	struct timeval now_tv;
+
+	gettimeofday(&now_tv, NULL);
 	slurm_mutex_lock(&locks_mutex);
+	_lock_stats_add(&lock_hold_stats[datatype][0],
+			slurm_diff_tv(&lock_tv[datatype], &now_tv));
 	slurmctld_locks.entity[read_lock(datatype)]--;
 	pthread_cond_broadcast(&locks_cond);
 	slurm_mutex_unlock(&locks_mutex);
@@ -222,7 +312,9 @@ static void _wr_rdunlock(lock_datatype_t datatype)
 static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 {
 	bool success = true;
+	struct timeval start_tv;
 
+	gettimeofday(&start_tv, NULL);
 	slurm_mutex_lock(&locks_mutex);
 	slurmctld_locks.entity[write_wait_lock(datatype)]++;
 
@@ -231,6 +323,10 @@ static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 		    (slurmctld_locks.entity[write_lock(datatype)] == 0)) {
 			slurmctld_locks.entity[write_lock(datatype)]++;
 			slurmctld_locks.entity[write_wait_lock(datatype)]--;
+			gettimeofday(&write_lock_time[datatype], NULL);
+			_lock_stats_add(&lock_wait_stats[datatype][1],
+					slurm_diff_tv(&start_tv,
+						&write_lock_time[datatype]));
 			break;
 		} else if (!wait_lock) {
 			slurmctld_locks.entity[write_wait_lock(datatype)]--;
@@ -249,7 +345,12 @@ static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 /* _wr_wrunlock - Issue a write unlock on the specified data type */
 static void _wr_wrunlock(lock_datatype_t datatype)
 {
+	struct timeval now_tv;
+
+	gettimeofday(&now_tv, NULL);
 	slurm_mutex_lock(&locks_mutex);
+	_lock_stats_add(&lock_hold_stats[datatype][1],
+			slurm_diff_tv(&write_lock_time[datatype], &now_tv));
 	slurmctld_locks.entity[write_lock(datatype)]--;
 	pthread_cond_broadcast(&locks_cond);
 	slurm_mutex_unlock(&locks_mutex);
@@ -264,6 +365,55 @@ void get_lock_values(slurmctld_lock_flags_t * lock_flags)
 	       sizeof(slurmctld_locks));
 }
 
+/* Log one line of lock time statistics */
+static void _lock_stats_log(char *name, char *mode,
+			    lock_time_stats_t *wait, lock_time_stats_t *hold)
+{
+	char *wait_hist = NULL, *hold_hist = NULL;
+	int i;
+
+	if ((wait->cnt == 0) && (hold->cnt == 0))
+		return;
+	for (i = 0; i < LOCK_HIST_BUCKETS; i++) {
+		xstrfmtcat(wait_hist, "%s%u", (i ? "/" : ""), wait->hist[i]);
+		xstrfmtcat(hold_hist, "%s%u", (i ? "/" : ""), hold->hist[i]);
+	}
+	debug("Lock stats: %s %s cnt=%u wait_avg=%"PRIu64" "
+	      "wait_max=%"PRIu64" wait_hist=%s hold_avg=%"PRIu64" "
+	      "hold_max=%"PRIu64" hold_hist=%s",
+	      name, mode, wait->cnt, wait->total_usec / MAX(wait->cnt, 1),
+	      wait->max_usec, wait_hist, hold->total_usec / MAX(hold->cnt, 1),
+	      hold->max_usec, hold_hist);
+	xfree(wait_hist);
+	xfree(hold_hist);
+}
+
+/* lock_stats_report - Log lock wait and hold time statistics accumulated
+ *	since the last report, then clear them. Times are in microseconds,
+ *	histogram buckets are by decade from <10us to >=1sec */
+extern void lock_stats_report(void)
+{
+	static char *lock_names[ENTITY_COUNT] = {
+		"config", "job", "node", "partition" };
+	lock_time_stats_t wait_stats[ENTITY_COUNT][2];
+	lock_time_stats_t hold_stats[ENTITY_COUNT][2];
+	int i;
+
+	slurm_mutex_lock(&locks_mutex);
+	memcpy(wait_stats, lock_wait_stats, sizeof(wait_stats));
+	memcpy(hold_stats, lock_hold_stats, sizeof(hold_stats));
+	memset(lock_wait_stats, 0, sizeof(lock_wait_stats));
+	memset(lock_hold_stats, 0, sizeof(lock_hold_stats));
+	slurm_mutex_unlock(&locks_mutex);
+
+	for (i = 0; i < ENTITY_COUNT; i++) {
+		_lock_stats_log(lock_names[i], "read",
+				&wait_stats[i][0], &hold_stats[i][0]);
+		_lock_stats_log(lock_names[i], "write",
+				&wait_stats[i][1], &hold_stats[i][1]);
+	}
+}
+
 /* kill_locked_threads - Kill all threads waiting on semaphores */
 extern void kill_locked_threads(void)
 {
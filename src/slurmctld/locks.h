@@ -136,6 +136,10 @@ extern void init_locks ( void );
 /* kill_locked_threads - Kill all threads waiting on semaphores */
 extern void kill_locked_threads ( void );
 
+/* lock_stats_report - Log lock wait and hold time statistics accumulated
+ *	since the last report, then clear them */
+extern void lock_stats_report ( void );
+
 /* lock_slurmctld - Issue the required lock requests in a well defined order */
 extern void lock_slurmctld (slurmctld_lock_t lock_levels);
 
@@ -262,19 +262,19 @@ static int _open_node_state_file(char **state_file)
  */
 extern int load_all_node_state ( bool state_only )
 {
-	char *node_name = NULL, *reason = NULL, *data = NULL, *state_file;
+	char *node_name = NULL, *reason = NULL, *state_file;
 	char *features = NULL, *gres = NULL;
-	int data_allocated, data_read = 0, error_code = 0, node_cnt = 0;
+	int error_code = 0, node_cnt = 0;
 	uint16_t node_state;
 	uint16_t cpus = 1, sockets = 1, cores = 1, threads = 1;
-	uint32_t real_memory, tmp_disk, data_size = 0, name_len;
+	uint32_t real_memory, tmp_disk, name_len;
 	uint32_t reason_uid = NO_VAL;
 	time_t reason_time = 0;
 	List gres_list = NULL;
 	struct node_record *node_ptr;
 	int state_fd;
 	time_t time_stamp, now = time(NULL);
-	Buf buffer;
+	Buf buffer = NULL;
 	char *ver_str = NULL;
 	hostset_t hs = NULL;
 	bool power_save_mode = false;
@@ -291,30 +291,16 @@ extern int load_all_node_state ( bool state_only )
 		error_code = ENOENT;
 	}
 	else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size], BUF_SIZE);
-			if (data_read < 0) {
-				if (errno == EINTR)
-					continue;
-				else {
-					error ("Read error on %s: %m",
-						state_file);
-					break;
-				}
-			} else if (data_read == 0)     /* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
-		close (state_fd);
+		buffer = create_mmap_buf(state_fd);
+		if (buffer == NULL)
+			error("Read error on %s: %m", state_file);
+		close(state_fd);
 	}
 	xfree (state_file);
 	unlock_state_files ();
 
-	buffer = create_buf (data, data_size);
+	if (buffer == NULL)
+		buffer = create_buf(NULL, 0);
 
 	safe_unpackstr_xmalloc( &ver_str, &name_len, buffer);
 	debug3("Version string in node_state header is %s", ver_str);
@@ -2590,7 +2576,8 @@ void make_node_idle(struct node_record *node_ptr,
 	xassert(node_ptr);
 	if (node_bitmap && (bit_test(node_bitmap, inx))) {
 		/* Not a replay */
-		last_job_update = now;
+		last_job_update = job_ptr->last_update = now;
+		mark_job_state_dirty(job_ptr);
 		bit_clear(node_bitmap, inx);
 
 		job_update_cpu_cnt(job_ptr, inx);
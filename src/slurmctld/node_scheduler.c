@@ -1193,7 +1193,8 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	}
 
 	if (fail_reason != WAIT_NO_REASON) {
-		last_job_update = now;
+		last_job_update = job_ptr->last_update = now;
+		mark_job_state_dirty(job_ptr);
 		xfree(job_ptr->state_desc);
 		if (job_ptr->priority == 0) {	/* user/admin hold */
 			if ((job_ptr->state_reason != WAIT_HELD) &&
@@ -1273,7 +1274,8 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			xfree(job_ptr->state_desc);
 			if (job_ptr->priority != 0)  /* Move to end of queue */
 				job_ptr->priority = 1;
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
+			mark_job_state_dirty(job_ptr);
 		} else if (error_code == ESLURM_NODE_NOT_AVAIL) {
 			/* Required nodes are down or drained */
 			debug3("JobId=%u required nodes not avail",
@@ -1282,7 +1284,8 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			xfree(job_ptr->state_desc);
 			if (job_ptr->priority != 0)  /* Move to end of queue */
 				job_ptr->priority = 1;
-			last_job_update = now;
+			last_job_update = job_ptr->last_update = now;
+			mark_job_state_dirty(job_ptr);
 		} else if (error_code == ESLURM_RESERVATION_NOT_USABLE) {
 			job_ptr->state_reason = WAIT_RESERVATION;
 			xfree(job_ptr->state_desc);
@@ -1356,9 +1359,11 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	configuring = IS_JOB_CONFIGURING(job_ptr);
 
 	job_ptr->job_state = JOB_RUNNING;
+	mark_job_state_dirty(job_ptr);
 	if (configuring
-	    || bit_overlap(job_ptr->node_bitmap, power_node_bitmap))
+	    || bit_overlap_any(job_ptr->node_bitmap, power_node_bitmap))
 		job_ptr->job_state |= JOB_CONFIGURING;
+	notify_job_dependents(job_ptr);
 	if (select_g_select_nodeinfo_set(job_ptr) != SLURM_SUCCESS) {
 		error("select_g_select_nodeinfo_set(%u): %m", job_ptr->job_id);
 		/* not critical ... by now */
@@ -1650,9 +1655,8 @@ static int _build_node_list(struct job_record *job_ptr,
 	node_set_ptr[node_set_inx+1].my_bitmap = NULL;
 	if (detail_ptr->exc_node_bitmap) {
 		if (usable_node_mask) {
-			bit_not(detail_ptr->exc_node_bitmap);
-			bit_and(usable_node_mask, detail_ptr->exc_node_bitmap);
-			bit_not(detail_ptr->exc_node_bitmap);
+			bit_and_not(usable_node_mask,
+				    detail_ptr->exc_node_bitmap);
 		} else {
 			usable_node_mask =
 				bit_copy(detail_ptr->exc_node_bitmap);
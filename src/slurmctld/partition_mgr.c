@@ -63,6 +63,7 @@
 #include "src/common/xstring.h"
 
 #include "src/slurmctld/groups.h"
+#include "src/slurmctld/info_snapshot.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/sched_plugin.h"
@@ -453,17 +454,17 @@ static int _open_part_state_file(char **state_file)
 int load_all_part_state(void)
 {
 	char *part_name = NULL, *allow_groups = NULL, *nodes = NULL;
-	char *state_file, *data = NULL;
+	char *state_file;
 	uint32_t max_time, default_time, max_nodes, min_nodes;
 	uint32_t grace_time = 0;
 	time_t time;
 	uint16_t def_part_flag, flags, hidden, root_only;
 	uint16_t max_share, preempt_mode, priority, state_up;
 	struct part_record *part_ptr;
-	uint32_t data_size = 0, name_len;
-	int data_allocated, data_read = 0, error_code = 0, part_cnt = 0;
+	uint32_t name_len;
+	int error_code = 0, part_cnt = 0;
 	int state_fd;
-	Buf buffer;
+	Buf buffer = NULL;
 	char *ver_str = NULL;
 	char* allow_alloc_nodes = NULL;
 	uint16_t protocol_version = (uint16_t)NO_VAL;
@@ -477,31 +478,16 @@ int load_all_part_state(void)
 		     state_file);
 		error_code = ENOENT;
 	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					 BUF_SIZE);
-			if (data_read < 0) {
-				if  (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-						state_file);
-					break;
-				}
-			} else if (data_read == 0)     /* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
+		buffer = create_mmap_buf(state_fd);
+		if (buffer == NULL)
+			error("Read error on %s: %m", state_file);
 		close(state_fd);
 	}
 	xfree(state_file);
 	unlock_state_files();
 
-	buffer = create_buf(data, data_size);
+	if (buffer == NULL)
+		buffer = create_buf(NULL, 0);
 
 	safe_unpackstr_xmalloc( &ver_str, &name_len, buffer);
 	debug3("Version string in part_state header is %s", ver_str);
@@ -856,6 +842,29 @@ int list_find_part(void *part_entry, void *key)
 	return 0;
 }
 
+/* part_access_restricted - Determine if any partition is hidden or limited
+ *	to specific groups, in which case the job, node and partition
+ *	information reported depends upon the requesting user
+ * NOTE: READ lock_slurmctld partition before entry */
+extern bool part_access_restricted(void)
+{
+	struct part_record *part_ptr;
+	ListIterator part_iterator;
+	bool restricted = false;
+
+	part_iterator = list_iterator_create(part_list);
+	while ((part_ptr = (struct part_record *) list_next(part_iterator))) {
+		if ((part_ptr->flags & PART_FLAG_HIDDEN) ||
+		    part_ptr->allow_groups) {
+			restricted = true;
+			break;
+		}
+	}
+	list_iterator_destroy(part_iterator);
+
+	return restricted;
+}
+
 /* part_filter_set - Set the partition's hidden flag based upon a user's
  * group access. This must be followed by a call to part_filter_clear() */
 extern void part_filter_set(uid_t uid)
@@ -1106,6 +1115,9 @@ extern int update_part (update_part_msg_t * part_desc, bool create_flag)
 	}
 
 	last_part_update = time(NULL);
+	/* Hidden and AllowGroups change what every user may see, so shared
+	 * snapshots are not used even while the locks are busy */
+	info_snapshot_purge();
 
 	if (part_desc->max_time != NO_VAL) {
 		info("update_part: setting max_time to %u for partition %s",
@@ -1544,6 +1556,7 @@ extern int delete_partition(delete_part_msg_t *part_desc_ptr)
 	(void) kill_job_by_part_name(part_desc_ptr->name);
 	list_delete_all(part_list, list_find_part, part_desc_ptr->name);
 	last_part_update = time(NULL);
+	info_snapshot_purge();
 
 	slurm_sched_partition_change();	/* notify sched plugin */
 	select_g_reconfigure();		/* notify select plugin too */
@@ -76,6 +76,7 @@
 #include "src/slurmctld/agent.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/gang.h"
+#include "src/slurmctld/info_snapshot.h"
 #include "src/slurmctld/job_scheduler.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/proc_req.h"
@@ -108,7 +109,15 @@ inline static void  _slurm_rpc_complete_job_allocation(slurm_msg_t * msg);
 inline static void  _slurm_rpc_complete_batch_script(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_conf(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_front_end(slurm_msg_t * msg);
+static info_snapshot_t *_get_info_snapshot(info_snapshot_type_t type,
+					   uint16_t show_flags,
+					   uint16_t protocol_version,
+					   slurmctld_lock_t lock_levels);
+static void         _send_info_snapshot(slurm_msg_t *msg,
+					uint16_t msg_type, time_t last_update,
+					info_snapshot_t *snapshot);
 inline static void  _slurm_rpc_dump_jobs(slurm_msg_t * msg);
+inline static void  _slurm_rpc_dump_jobs_delta(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_job_single(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_nodes(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_partitions(slurm_msg_t * msg);
@@ -188,6 +197,10 @@ void slurmctld_req (slurm_msg_t * msg)
 		_slurm_rpc_dump_jobs(msg);
 		slurm_free_job_info_request_msg(msg->data);
 		break;
+	case REQUEST_JOB_INFO_DELTA:
+		_slurm_rpc_dump_jobs_delta(msg);
+		slurm_free_job_info_request_msg(msg->data);
+		break;
 	case REQUEST_JOB_INFO_SINGLE:
 		_slurm_rpc_dump_job_single(msg);
 		slurm_free_job_id_msg(msg->data);
@@ -468,6 +481,7 @@ void _fill_ctld_conf(slurm_ctl_conf_t * conf_ptr)
 	conf_ptr->checkpoint_type     = xstrdup(conf->checkpoint_type);
 	conf_ptr->cluster_name        = xstrdup(conf->cluster_name);
 	conf_ptr->complete_wait       = conf->complete_wait;
+	conf_ptr->conn_cache_size     = conf->conn_cache_size;
 	conf_ptr->control_addr        = xstrdup(conf->control_addr);
 	conf_ptr->control_machine     = xstrdup(conf->control_machine);
 	conf_ptr->crypto_type         = xstrdup(conf->crypto_type);
@@ -915,13 +929,66 @@ static void _slurm_rpc_dump_conf(slurm_msg_t * msg)
 	}
 }
 
+/* _get_info_snapshot - Return a shared snapshot which can be used to
+ *	respond to an information request. If there is no up to date
+ *	snapshot, acquire the specified locks and return NULL. Whether a
+ *	snapshot is up to date is tested under the locks. If they are not
+ *	immediately available, a snapshot up to INFO_SNAPSHOT_MAX_AGE seconds
+ *	old is used instead of waiting. */
+static info_snapshot_t *_get_info_snapshot(info_snapshot_type_t type,
+					   uint16_t show_flags,
+					   uint16_t protocol_version,
+					   slurmctld_lock_t lock_levels)
+{
+	info_snapshot_t *snapshot;
+
+	if (try_lock_slurmctld(lock_levels) == 0) {
+		snapshot = info_snapshot_get(type, show_flags,
+					     protocol_version, true);
+		if (snapshot)
+			unlock_slurmctld(lock_levels);
+		return snapshot;
+	}
+	snapshot = info_snapshot_get(type, show_flags, protocol_version,
+				     false);
+	if (snapshot)
+		return snapshot;
+	lock_slurmctld(lock_levels);
+	return NULL;
+}
+
+/* _send_info_snapshot - Respond to an information request using a shared
+ *	snapshot, then release the snapshot */
+static void _send_info_snapshot(slurm_msg_t *msg, uint16_t msg_type,
+				time_t last_update, info_snapshot_t *snapshot)
+{
+	slurm_msg_t response_msg;
+
+	if (((last_update - 1) >= snapshot->update_time) ||
+	    (last_update > snapshot->pack_time)) {
+		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+	} else {
+		slurm_msg_t_init(&response_msg);
+		response_msg.flags = msg->flags;
+		response_msg.protocol_version = msg->protocol_version;
+		response_msg.address = msg->address;
+		response_msg.msg_type = msg_type;
+		response_msg.data = snapshot->data;
+		response_msg.data_size = snapshot->data_size;
+		slurm_send_node_msg(msg->conn_fd, &response_msg);
+	}
+	info_snapshot_put(snapshot);
+}
+
 /* _slurm_rpc_dump_jobs - process RPC for job state information */
 static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 {
 	DEF_TIMERS;
 	char *dump;
 	int dump_size;
+	time_t pack_time;
 	slurm_msg_t response_msg;
+	info_snapshot_t *snapshot;
 	job_info_request_msg_t *job_info_request_msg =
 		(job_info_request_msg_t *) msg->data;
 	/* Locks: Read config job, write node (for hiding) */
@@ -931,17 +998,36 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_JOB_INFO from uid=%d", uid);
-	lock_slurmctld(job_read_lock);
+	snapshot = _get_info_snapshot(INFO_SNAPSHOT_JOB,
+				      job_info_request_msg->show_flags,
+				      msg->protocol_version, job_read_lock);
+	if (snapshot) {
+		_send_info_snapshot(msg, RESPONSE_JOB_INFO,
+				    job_info_request_msg->last_update,
+				    snapshot);
+		END_TIMER2("_slurm_rpc_dump_jobs");
+		debug3("_slurm_rpc_dump_jobs, from snapshot %s", TIME_STR);
+		return;
+	}
 
 	if ((job_info_request_msg->last_update - 1) >= last_job_update) {
 		unlock_slurmctld(job_read_lock);
 		debug3("_slurm_rpc_dump_jobs, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
+		pack_time = time(NULL);
 		pack_all_jobs(&dump, &dump_size,
 			      job_info_request_msg->show_flags,
 			      g_slurm_auth_get_uid(msg->auth_cred, NULL),
 			      msg->protocol_version);
+		if (info_snapshot_public(INFO_SNAPSHOT_JOB,
+					 job_info_request_msg->show_flags)) {
+			snapshot = info_snapshot_publish(
+				INFO_SNAPSHOT_JOB,
+				job_info_request_msg->show_flags,
+				msg->protocol_version, pack_time,
+				dump, dump_size);
+		}
 		unlock_slurmctld(job_read_lock);
 		END_TIMER2("_slurm_rpc_dump_jobs");
 /* 		info("_slurm_rpc_dump_jobs, size=%d %s", */
@@ -956,6 +1042,57 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 		response_msg.data = dump;
 		response_msg.data_size = dump_size;
 
+		/* send message */
+		slurm_send_node_msg(msg->conn_fd, &response_msg);
+		if (snapshot)
+			info_snapshot_put(snapshot);
+		else
+			xfree(dump);
+	}
+}
+
+/* _slurm_rpc_dump_jobs_delta - process RPC for job state information
+ *	changed since the requester's previous job information */
+static void _slurm_rpc_dump_jobs_delta(slurm_msg_t * msg)
+{
+	DEF_TIMERS;
+	char *dump;
+	int dump_size;
+	slurm_msg_t response_msg;
+	job_info_request_msg_t *job_info_request_msg =
+		(job_info_request_msg_t *) msg->data;
+	/* Locks: Read config job, write node (for hiding) */
+	slurmctld_lock_t job_read_lock = {
+		READ_LOCK, READ_LOCK, NO_LOCK, WRITE_LOCK };
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+
+	START_TIMER;
+	debug3("Processing RPC: REQUEST_JOB_INFO_DELTA from uid=%d", uid);
+	lock_slurmctld(job_read_lock);
+
+	if ((job_info_request_msg->last_update - 1) >= last_job_update) {
+		unlock_slurmctld(job_read_lock);
+		debug3("_slurm_rpc_dump_jobs_delta, no change");
+		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+	} else {
+		pack_job_delta(&dump, &dump_size,
+			       job_info_request_msg->last_update,
+			       job_info_request_msg->show_flags, uid,
+			       msg->protocol_version);
+		unlock_slurmctld(job_read_lock);
+		END_TIMER2("_slurm_rpc_dump_jobs_delta");
+		debug3("_slurm_rpc_dump_jobs_delta, size=%d %s",
+		       dump_size, TIME_STR);
+
+		/* init response_msg structure */
+		slurm_msg_t_init(&response_msg);
+		response_msg.flags = msg->flags;
+		response_msg.protocol_version = msg->protocol_version;
+		response_msg.address = msg->address;
+		response_msg.msg_type = RESPONSE_JOB_INFO_DELTA;
+		response_msg.data = dump;
+		response_msg.data_size = dump_size;
+
 		/* send message */
 		slurm_send_node_msg(msg->conn_fd, &response_msg);
 		xfree(dump);
@@ -1145,18 +1282,29 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 	DEF_TIMERS;
 	char *dump;
 	int dump_size;
+	time_t pack_time;
 	slurm_msg_t response_msg;
+	info_snapshot_t *snapshot;
 	node_info_request_msg_t *node_req_msg =
 		(node_info_request_msg_t *) msg->data;
 	/* Locks: Read config, write node (reset allocated CPU count in some
-	 * select plugins) */
+	 * select plugins), read partition (for hiding) */
 	slurmctld_lock_t node_write_lock = {
-		READ_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK };
+		READ_LOCK, NO_LOCK, WRITE_LOCK, READ_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_NODE_INFO from uid=%d", uid);
-	lock_slurmctld(node_write_lock);
+	snapshot = _get_info_snapshot(INFO_SNAPSHOT_NODE,
+				      node_req_msg->show_flags,
+				      msg->protocol_version, node_write_lock);
+	if (snapshot) {
+		_send_info_snapshot(msg, RESPONSE_NODE_INFO,
+				    node_req_msg->last_update, snapshot);
+		END_TIMER2("_slurm_rpc_dump_nodes");
+		debug3("_slurm_rpc_dump_nodes, from snapshot %s", TIME_STR);
+		return;
+	}
 
 	if ((slurmctld_conf.private_data & PRIVATE_DATA_NODES) &&
 	    (!validate_operator(uid))) {
@@ -1175,8 +1323,16 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
 
+		pack_time = time(NULL);
 		pack_all_node(&dump, &dump_size, node_req_msg->show_flags,
 			      uid, msg->protocol_version);
+		if (info_snapshot_public(INFO_SNAPSHOT_NODE,
+					 node_req_msg->show_flags)) {
+			snapshot = info_snapshot_publish(
+				INFO_SNAPSHOT_NODE, node_req_msg->show_flags,
+				msg->protocol_version, pack_time,
+				dump, dump_size);
+		}
 		unlock_slurmctld(node_write_lock);
 		END_TIMER2("_slurm_rpc_dump_nodes");
 		debug3("_slurm_rpc_dump_nodes, size=%d %s",
@@ -1193,7 +1349,10 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 
 		/* send message */
 		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
+		if (snapshot)
+			info_snapshot_put(snapshot);
+		else
+			xfree(dump);
 	}
 }
 
@@ -1203,7 +1362,9 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 	DEF_TIMERS;
 	char *dump;
 	int dump_size;
+	time_t pack_time;
 	slurm_msg_t response_msg;
+	info_snapshot_t *snapshot;
 	part_info_request_msg_t  *part_req_msg;
 
 	/* Locks: Read configuration and partition */
@@ -1214,7 +1375,17 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 	START_TIMER;
 	debug2("Processing RPC: REQUEST_PARTITION_INFO uid=%d", uid);
 	part_req_msg = (part_info_request_msg_t  *) msg->data;
-	lock_slurmctld(part_read_lock);
+	snapshot = _get_info_snapshot(INFO_SNAPSHOT_PART,
+				      part_req_msg->show_flags,
+				      msg->protocol_version, part_read_lock);
+	if (snapshot) {
+		_send_info_snapshot(msg, RESPONSE_PARTITION_INFO,
+				    part_req_msg->last_update, snapshot);
+		END_TIMER2("_slurm_rpc_dump_partitions");
+		debug2("_slurm_rpc_dump_partitions, from snapshot %s",
+		       TIME_STR);
+		return;
+	}
 
 	if ((slurmctld_conf.private_data & PRIVATE_DATA_PARTITIONS) &&
 	    !validate_operator(uid)) {
@@ -1227,8 +1398,16 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 		debug2("_slurm_rpc_dump_partitions, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
+		pack_time = time(NULL);
 		pack_all_part(&dump, &dump_size, part_req_msg->show_flags,
 			      uid, msg->protocol_version);
+		if (info_snapshot_public(INFO_SNAPSHOT_PART,
+					 part_req_msg->show_flags)) {
+			snapshot = info_snapshot_publish(
+				INFO_SNAPSHOT_PART, part_req_msg->show_flags,
+				msg->protocol_version, pack_time,
+				dump, dump_size);
+		}
 		unlock_slurmctld(part_read_lock);
 		END_TIMER2("_slurm_rpc_dump_partitions");
 		debug2("_slurm_rpc_dump_partitions, size=%d %s",
@@ -1245,7 +1424,10 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 
 		/* send message */
 		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
+		if (snapshot)
+			info_snapshot_put(snapshot);
+		else
+			xfree(dump);
 	}
 }
 
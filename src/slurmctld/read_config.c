@@ -59,6 +59,7 @@
 #include <unistd.h>
 
 #include "src/common/assoc_mgr.h"
+#include "src/common/conn_cache.h"
 #include "src/common/gres.h"
 #include "src/common/hostlist.h"
 #include "src/common/list.h"
@@ -75,6 +76,7 @@
 #include "src/slurmctld/acct_policy.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/gang.h"
+#include "src/slurmctld/info_snapshot.h"
 #include "src/slurmctld/job_scheduler.h"
 #include "src/slurmctld/job_submit.h"
 #include "src/slurmctld/licenses.h"
@@ -88,6 +90,7 @@
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/srun_comm.h"
+#include "src/slurmctld/state_save.h"
 #include "src/slurmctld/trigger_mgr.h"
 
 static void _acct_restore_active_jobs(void);
@@ -109,6 +112,7 @@ static int  _restore_node_state(int recover,
 				struct node_record *old_node_table_ptr,
 				int old_node_record_count);
 static int  _restore_part_state(List old_part_list, char *old_def_part_name);
+static void _state_load_time(char *state_file, struct timeval *tv);
 static int  _strcmp(const char *s1, const char *s2);
 static int  _sync_nodes_to_comp_job(void);
 static int  _sync_nodes_to_jobs(void);
@@ -638,6 +642,29 @@ static int _build_all_partitionline_info(void)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * _state_load_time - log the time taken to recover a state save file
+ * IN state_file - name of the file within StateSaveLocation
+ * IN/OUT tv - start of the recovery, reset to now for the next file
+ */
+static void _state_load_time(char *state_file, struct timeval *tv)
+{
+	struct timeval now;
+	struct stat stat_buf;
+	char *file_name;
+	long size = 0;
+
+	gettimeofday(&now, NULL);
+	file_name = xstrdup_printf("%s/%s", slurmctld_conf.state_save_location,
+				   state_file);
+	if (stat(file_name, &stat_buf) == 0)
+		size = stat_buf.st_size;
+	xfree(file_name);
+	info("Recovered %s (%ld bytes) in %ld usec",
+	     state_file, size, slurm_diff_tv(tv, &now));
+	*tv = now;
+}
+
 /* _sync_part_prio - Set normalized partition priorities */
 static void _sync_part_prio(void)
 {
@@ -684,6 +711,7 @@ static void _sync_part_prio(void)
 int read_slurm_conf(int recover, bool reconfig)
 {
 	DEF_TIMERS;
+	struct timeval tv_load;
 	int error_code, i, rc, load_job_ret = SLURM_SUCCESS;
 	int old_node_record_count = 0;
 	struct node_record *old_node_table_ptr = NULL, *node_ptr;
@@ -802,15 +830,26 @@ int read_slurm_conf(int recover, bool reconfig)
 		reset_first_job_id();
 		(void) slurm_sched_reconfig();
 	} else if (recover == 1) {	/* Load job & node state files */
+		state_files_prefetch();
+		gettimeofday(&tv_load, NULL);
 		(void) load_all_node_state(true);
+		_state_load_time("node_state", &tv_load);
 		(void) load_all_front_end_state(true);
+		_state_load_time("front_end_state", &tv_load);
 		load_job_ret = load_all_job_state();
+		_state_load_time("job_state", &tv_load);
 		sync_job_priorities();
 	} else if (recover > 1) {	/* Load node, part & job state files */
+		state_files_prefetch();
+		gettimeofday(&tv_load, NULL);
 		(void) load_all_node_state(false);
+		_state_load_time("node_state", &tv_load);
 		(void) load_all_front_end_state(false);
+		_state_load_time("front_end_state", &tv_load);
 		(void) load_all_part_state();
+		_state_load_time("part_state", &tv_load);
 		load_job_ret = load_all_job_state();
+		_state_load_time("job_state", &tv_load);
 		sync_job_priorities();
 	}
 
@@ -856,9 +895,12 @@ int read_slurm_conf(int recover, bool reconfig)
 	if (reconfig) {
 		load_all_resv_state(0);
 	} else {
+		gettimeofday(&tv_load, NULL);
 		load_all_resv_state(recover);
 		if (recover >= 1) {
+			_state_load_time("resv_state", &tv_load);
 			(void) trigger_state_restore();
+			_state_load_time("trigger_state", &tv_load);
 			(void) slurm_sched_reconfig();
 		}
 	}
@@ -898,6 +940,10 @@ int read_slurm_conf(int recover, bool reconfig)
 	/* Sync select plugin with synchronized job/node/part data */
 	select_g_reconfigure();
 
+	conn_cache_init(slurmctld_conf.conn_cache_size);
+
+	/* Cached information responses may no longer be public */
+	info_snapshot_purge();
 	slurmctld_conf.last_update = time(NULL);
 	END_TIMER2("read_slurm_conf");
 	return error_code;
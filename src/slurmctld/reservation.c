@@ -2144,11 +2144,11 @@ static int _open_resv_state_file(char **state_file)
  */
 extern int load_all_resv_state(int recover)
 {
-	char *state_file, *data = NULL, *ver_str = NULL;
+	char *state_file, *ver_str = NULL;
 	time_t now;
-	uint32_t data_size = 0, uint32_tmp;
-	int data_allocated, data_read = 0, error_code = 0, state_fd;
-	Buf buffer;
+	uint32_t uint32_tmp;
+	int error_code = 0, state_fd;
+	Buf buffer = NULL;
 	slurmctld_resv_t *resv_ptr = NULL;
 
 	last_resv_update = time(NULL);
@@ -2171,31 +2171,16 @@ extern int load_all_resv_state(int recover)
 		     state_file);
 		error_code = ENOENT;
 	} else {
-		data_allocated = BUF_SIZE;
-		data = xmalloc(data_allocated);
-		while (1) {
-			data_read = read(state_fd, &data[data_size],
-					BUF_SIZE);
-			if (data_read < 0) {
-				if  (errno == EINTR)
-					continue;
-				else {
-					error("Read error on %s: %m",
-						state_file);
-					break;
-				}
-			} else if (data_read == 0)     /* eof */
-				break;
-			data_size      += data_read;
-			data_allocated += data_read;
-			xrealloc(data, data_allocated);
-		}
+		buffer = create_mmap_buf(state_fd);
+		if (buffer == NULL)
+			error("Read error on %s: %m", state_file);
 		close(state_fd);
 	}
 	xfree(state_file);
 	unlock_state_files();
 
-	buffer = create_buf(data, data_size);
+	if (buffer == NULL)
+		buffer = create_buf(NULL, 0);
 
 	safe_unpackstr_xmalloc( &ver_str, &uint32_tmp, buffer);
 	debug3("Version string in resv_state header is %s", ver_str);
@@ -2406,9 +2391,7 @@ static int  _select_nodes(resv_desc_msg_t *resv_desc_ptr,
 			    (resv_ptr->start_time >= resv_desc_ptr->end_time) ||
 			    (resv_ptr->end_time   <= resv_desc_ptr->start_time))
 				continue;
-			bit_not(resv_ptr->node_bitmap);
-			bit_and(node_bitmap, resv_ptr->node_bitmap);
-			bit_not(resv_ptr->node_bitmap);
+			bit_and_not(node_bitmap, resv_ptr->node_bitmap);
 		}
 		list_iterator_destroy(iter);
 	}
@@ -2534,9 +2517,7 @@ static bitstr_t *_pick_idle_nodes(bitstr_t *avail_bitmap,
 			continue;
 		if (job_ptr->end_time < resv_desc_ptr->start_time)
 			continue;
-		bit_not(job_ptr->node_bitmap);
-		bit_and(avail_bitmap, job_ptr->node_bitmap);
-		bit_not(job_ptr->node_bitmap);
+		bit_and_not(avail_bitmap, job_ptr->node_bitmap);
 	}
 	list_iterator_destroy(job_iterator);
 	ret_bitmap = select_g_resv_test(avail_bitmap, resv_desc_ptr->node_cnt);
@@ -2889,9 +2870,7 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
 			    (res2_ptr->start_time >= job_end_time) ||
 			    (res2_ptr->end_time   <= job_start_time))
 				continue;
-			bit_not(res2_ptr->node_bitmap);
-			bit_and(*node_bitmap, res2_ptr->node_bitmap);
-			bit_not(res2_ptr->node_bitmap);
+			bit_and_not(*node_bitmap, res2_ptr->node_bitmap);
 			overlap_resv = true;
 		}
 		list_iterator_destroy(iter);
@@ -2944,9 +2923,7 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
 				    (lic_resv_time > resv_ptr->end_time))
 					lic_resv_time = resv_ptr->end_time;
 			}
-			bit_not(resv_ptr->node_bitmap);
-			bit_and(*node_bitmap, resv_ptr->node_bitmap);
-			bit_not(resv_ptr->node_bitmap);
+			bit_and_not(*node_bitmap, resv_ptr->node_bitmap);
 		}
 		list_iterator_destroy(iter);
 
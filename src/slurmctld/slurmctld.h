@@ -92,6 +92,28 @@
 #define MAX_SERVER_THREADS 256
 #endif
 
+/* Number of pooled threads processing fully received RPCs. Messages are
+ * read without blocking by a single thread and queued for this pool. */
+#ifndef RPC_WORKER_THREADS
+#define RPC_WORKER_THREADS 64
+#endif
+#if (RPC_WORKER_THREADS > MAX_SERVER_THREADS)
+#error RPC_WORKER_THREADS must not exceed MAX_SERVER_THREADS
+#endif
+
+/* Maximum count of RPC connections being read or queued for a worker.
+ * Beyond this, new connections wait in the kernel's listen queue. */
+#ifndef MAX_RPC_CONNECTIONS
+#define MAX_RPC_CONNECTIONS 4096
+#endif
+
+/* Log RPC queue depth and service time, lock wait and hold time,
+ * information snapshot, job pack cache and slurmd connection cache use, and
+ * agent thread pool statistics every PERIODIC_STATS seconds */
+#ifndef PERIODIC_STATS
+#define PERIODIC_STATS 300
+#endif
+
 /* Perform full slurmctld's state every PERIODIC_CHECKPOINT seconds */
 #ifndef PERIODIC_CHECKPOINT
 #define	PERIODIC_CHECKPOINT	300
@@ -357,6 +379,9 @@ struct job_details {
 	uint16_t cpus_per_task;		/* number of processors required for
 					 * each task */
 	List depend_list;		/* list of job_ptr:state pairs */
+	uint16_t depend_state;		/* cached test_job_dependency() result,
+					 * if depend_valid is set */
+	bool depend_valid;		/* depend_state is current */
 	char *dependency;		/* wait for other jobs */
 	char *orig_dependency;		/* original value (for archiving) */
 	uint16_t env_cnt;		/* size of env_sup (see below) */
@@ -446,6 +471,12 @@ struct job_record {
                                          * 1 if cr is enabled */
 	uint32_t db_index;              /* used only for database
 					 * plugins */
+	uint32_t *depend_child_id;	/* IDs of jobs which may depend upon
+					 * this one, see notify_job_dependents()
+					 */
+	uint32_t depend_child_cnt;	/* elements used in depend_child_id */
+	uint32_t depend_child_size;	/* elements allocated in
+					 * depend_child_id */
 	uint32_t derived_ec;		/* highest exit code of all job steps */
 	struct job_details *details;	/* job details */
 	uint16_t direct_set_prio;	/* Priority set directly if
@@ -461,11 +492,12 @@ struct job_record {
 	List gres_list;			/* generic resource allocation detail */
 	uint32_t group_id;		/* group submitted under */
 	uint32_t job_id;		/* job ID */
-	struct job_record *job_next;	/* next entry with same hash index */
 	job_resources_t *job_resrcs;	/* details of allocated cores */
 	uint16_t job_state;	        /* state of the job */
 	uint16_t kill_on_node_fail;	/* 1 if job should be killed on
 					 * node failure */
+	time_t last_update;		/* time of last change to this record,
+					 * see pack_job_delta() */
 	char *licenses;			/* licenses required by the job */
 	List license_list;		/* structure with license info */
 	uint16_t limit_set_max_cpus;	/* if max_cpus was set from
@@ -482,6 +514,8 @@ struct job_record {
 	char *mail_user;		/* user to get e-mail notification */
 	uint32_t magic;			/* magic cookie for data integrity */
 	char *name;			/* name of the job */
+	uint32_t name_hash;		/* hash of user_id and name, see
+					 * rehash_job_name() */
 	char *network;			/* network/switch requirement spec */
 	uint32_t next_step_id;		/* next step id to be used */
 	char *nodes;			/* list of nodes allocated to job */
@@ -495,6 +529,8 @@ struct job_record {
 					 * for this job, used to insure
 					 * epilog is not re-run for job */
 	uint16_t other_port;		/* port for client communications */
+	struct job_pack_cache *pack_cache; /* packed copies of this record,
+					 * see pack_all_jobs() */
 	char *partition;		/* name of job partition(s) */
 	List part_ptr_list;		/* list of pointers to partition recs */
 	bool part_nodes_missing;	/* set if job's nodes removed from this
@@ -529,6 +565,10 @@ struct job_record {
 	time_t start_time;		/* time execution begins,
 					 * actual or expected */
 	char *state_desc;		/* optional details for state_reason */
+	uint32_t state_dirty_inx;	/* 1 + index in the set of jobs
+					 * changed since the last save, 0 if
+					 * not in it, see
+					 * mark_job_state_dirty() */
 	uint16_t state_reason;		/* reason job still pending or failed
 					 * see slurm.h:enum job_wait_reason */
 	List step_list;			/* list of job's steps */
@@ -729,7 +769,10 @@ extern void delete_step_records (struct job_record *job_ptr);
  */
 extern int drain_nodes ( char *nodes, char *reason, uint32_t reason_uid );
 
-/* dump_all_job_state - save the state of all jobs to file
+/* dump_all_job_state - save the state of all jobs to file. Records of jobs
+ *	changed or purged since the last call are appended to a journal,
+ *	which is compacted into a full job_state file once it grows larger
+ *	than that file.
  * RET 0 or error code */
 extern int dump_all_job_state ( void );
 
@@ -770,10 +813,19 @@ extern void excise_node_from_job(struct job_record *job_ptr,
  * IN job_id - requested job's id
  * RET pointer to the job's record, NULL on error
  * global: job_list - global job list pointer
- *	job_hash - hash table into job records
+ *	job_id_hash - hash table into job records
  */
 extern struct job_record *find_job_record (uint32_t job_id);
 
+/*
+ * find_job_name_records - build a list of a user's jobs with a given name
+ * IN user_id - user ID
+ * IN job_name - job name, jobs with no name match any name
+ * RET list of pointers to job records
+ * NOTE: the caller must call list_destroy() on RET value to free memory
+ */
+extern List find_job_name_records(uint32_t user_id, char *job_name);
+
 /*
  * find_first_node_record - find a record for first node in the bitmap
  * IN node_bitmap
@@ -976,6 +1028,10 @@ extern int job_fail(uint32_t job_id);
  */
 extern int job_node_ready(uint32_t job_id, int *ready);
 
+/* job_pack_stats_report - Log job information packing statistics accumulated
+ *	since the last report, then clear them */
+extern void job_pack_stats_report(void);
+
 /* Record accounting information for a job immediately before changing size */
 extern void job_pre_resize_acctg(struct job_record *job_ptr);
 
@@ -1228,7 +1284,8 @@ extern int list_find_part (void *part_entry, void *key);
 
 /*
  * load_all_job_state - load the job state from file, recover from last
- *	checkpoint. Execute this after loading the configuration file data.
+ *	checkpoint and replay the job state journal written since then.
+ *	Execute this after loading the configuration file data.
  * RET 0 or error code
  */
 extern int load_all_job_state ( void );
@@ -1295,6 +1352,15 @@ extern void make_node_comp(struct node_record *node_ptr,
 extern void make_node_idle(struct node_record *node_ptr,
 			   struct job_record *job_ptr);
 
+/*
+ * mark_job_state_dirty - note that a job record changed, so that the next
+ *	dump_all_job_state() journals it
+ * IN job_ptr - pointer to the changed job, normally where its last_update
+ *	time is set
+ * NOTE: Call with a write lock on the job records
+ */
+extern void mark_job_state_dirty(struct job_record *job_ptr);
+
 /* msg_to_slurmd - send given msg_type every slurmd, no args */
 extern void msg_to_slurmd (slurm_msg_type_t msg_type);
 
@@ -1333,6 +1399,27 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 			  uint16_t show_flags, uid_t uid,
 			  uint16_t protocol_version);
 
+/*
+ * pack_job_delta - dump job information for jobs which have changed or
+ *	been removed since a given time in machine independent form (for
+ *	network transmission)
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN since - time of the requester's previous job information
+ * IN show_flags - job filtering options
+ * IN uid - uid of user making request (for partition filtering)
+ * IN protocol_version - slurm protocol version of client
+ * global: job_list - global list of job records
+ * NOTE: If the changes since the given time can not be determined, all
+ *	job information is packed and flagged as such
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: change _unpack_job_info_delta_msg() in common/slurm_protocol_pack.c
+ *	whenever the data format changes
+ */
+extern void pack_job_delta(char **buffer_ptr, int *buffer_size, time_t since,
+			   uint16_t show_flags, uid_t uid,
+			   uint16_t protocol_version);
+
 /*
  * pack_all_node - dump all configuration and node information for all nodes
  *	in machine independent form (for network transmission)
@@ -1424,6 +1511,12 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 			uint32_t job_id, uint16_t show_flags, uid_t uid,
 			uint16_t protocol_version);
 
+/* part_access_restricted - Determine if any partition is hidden or limited
+ *	to specific groups, in which case the job, node and partition
+ *	information reported depends upon the requesting user
+ * NOTE: READ lock_slurmctld partition before entry */
+extern bool part_access_restricted(void);
+
 /* part_filter_clear - Clear the partition's hidden flag based upon a user's
  * group access. This must follow a call to part_filter_set() */
 extern void part_filter_clear(void);
@@ -1453,7 +1546,14 @@ extern bool partition_in_use(char *part_name);
 void purge_old_job(void);
 
 /*
- * rehash_jobs - Create or rebuild the job hash table.
+ * rehash_job_name - update the index of jobs by user and name after a
+ *	change to a job's user_id or name
+ * IN job_ptr - pointer to job record
+ */
+extern void rehash_job_name(struct job_record *job_ptr);
+
+/*
+ * rehash_jobs - Create or grow the job hash tables to hold MaxJobCount jobs
  * NOTE: run lock_slurmctld before entry: Read config, write job
  */
 extern void rehash_jobs(void);
@@ -45,7 +45,11 @@
 #  include <pthread.h>
 #endif                          /* WITH_PTHREADS */
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "src/common/macros.h"
+#include "src/common/xstring.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/slurmctld.h"
@@ -91,6 +95,32 @@ extern int fsync_and_close(int fd, char *file_type)
 	return rc;
 }
 
+/* Start reading slurmctld's state save files into memory, so that their
+ * I/O proceeds in parallel rather than as each file is recovered */
+extern void state_files_prefetch(void)
+{
+	static char *state_files[] = {
+		"node_state", "front_end_state", "part_state", "job_state",
+		"job_state.journal", "resv_state", "trigger_state", NULL };
+	char *file_name;
+	int i, fd;
+
+	for (i = 0; state_files[i]; i++) {
+		file_name = xstrdup_printf("%s/%s",
+					   slurmctld_conf.state_save_location,
+					   state_files[i]);
+		fd = open(file_name, O_RDONLY);
+		xfree(file_name);
+		if (fd < 0)
+			continue;
+#ifdef POSIX_FADV_WILLNEED
+		/* Starts asynchronous read ahead of the whole file */
+		(void) posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+		(void) close(fd);
+	}
+}
+
 /* Queue saving of front_end state information */
 extern void schedule_front_end_save(void)
 {
@@ -45,6 +45,10 @@
  * RET 0 on success or -1 on error */
 extern int fsync_and_close(int fd, char *file_type);
 
+/* Start reading slurmctld's state save files into memory, so that their
+ * I/O proceeds in parallel rather than as each file is recovered */
+extern void state_files_prefetch(void);
+
 /* Queue saving of front_end state information */
 extern void schedule_front_end_save(void);
 
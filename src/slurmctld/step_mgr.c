@@ -170,6 +170,7 @@ static struct step_record * _create_step_record(struct job_record *job_ptr)
 	step_ptr = (struct step_record *) xmalloc(sizeof(struct step_record));
 
 	last_job_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 	step_ptr->job_ptr = job_ptr;
 	step_ptr->start_time = time(NULL);
 	step_ptr->time_limit = INFINITE;
@@ -195,6 +196,7 @@ extern void delete_step_records (struct job_record *job_ptr)
 	step_iterator = list_iterator_create (job_ptr->step_list);
 
 	last_job_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		list_remove (step_iterator);
 		_free_step_rec(step_ptr);
@@ -254,6 +256,7 @@ delete_step_record (struct job_record *job_ptr, uint32_t step_id)
 	error_code = ENOENT;
 	step_iterator = list_iterator_create (job_ptr->step_list);
 	last_job_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		if (step_ptr->step_id == step_id) {
 			list_remove (step_iterator);
@@ -512,6 +515,7 @@ int job_step_complete(uint32_t job_id, uint32_t step_id, uid_t uid,
 				 job_id, step_id);
 
 	last_job_update = time(NULL);
+	mark_job_state_dirty(job_ptr);
 	error_code = delete_step_record(job_ptr, step_id);
 	if (error_code == ENOENT) {
 		info("job_step_complete step %u.%u not found", job_id,
@@ -2448,6 +2452,7 @@ extern int job_step_checkpoint(checkpoint_msg_t *ckpt_ptr,
 				   &resp_data.error_code,
 				   &resp_data.error_msg);
 		last_job_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
 	}
 
     reply:
@@ -2514,6 +2519,7 @@ extern int job_step_checkpoint_comp(checkpoint_comp_msg_t *ckpt_ptr,
 		rc = checkpoint_comp((void *)step_ptr, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
 		last_job_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
 	}
 
     reply:
@@ -2573,6 +2579,7 @@ extern int job_step_checkpoint_task_comp(checkpoint_task_comp_msg_t *ckpt_ptr,
 			ckpt_ptr->task_id, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
 		last_job_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
 	}
 
     reply:
@@ -3299,6 +3306,7 @@ extern void step_checkpoint(void)
 				       (uint16_t)NO_VAL);
 			job_ptr->ckpt_time = now;
 			last_job_update = now;
+			mark_job_state_dirty(job_ptr);
 			continue; /* ignore periodic step ckpt */
 		}
 		step_iterator = list_iterator_create (job_ptr->step_list);
@@ -3323,6 +3331,7 @@ extern void step_checkpoint(void)
 
 			step_ptr->ckpt_time = now;
 			last_job_update = now;
+			mark_job_state_dirty(job_ptr);
 			image_dir = xstrdup(step_ptr->ckpt_dir);
 			xstrfmtcat(image_dir, "/%u.%u", job_ptr->job_id,
 				   step_ptr->step_id);
@@ -3490,8 +3499,10 @@ extern int update_step(step_update_request_msg_t *req, uid_t uid)
 		} else
 			return ESLURM_INVALID_JOB_ID;
 	}
-	if (mod_cnt)
+	if (mod_cnt) {
 		last_job_update = time(NULL);
+		mark_job_state_dirty(job_ptr);
+	}
 
 	return SLURM_SUCCESS;
 }
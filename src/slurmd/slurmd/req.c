@@ -55,6 +55,9 @@
 #include <sys/wait.h>
 #include <utime.h>
 #include <grp.h>
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#  include <zlib.h>
+#endif
 
 #include "src/common/env.h"
 #include "src/common/fd.h"
@@ -81,6 +84,7 @@
 
 #include "src/slurmd/slurmd/slurmd.h"
 #include "src/slurmd/slurmd/reverse_tree_math.h"
+#include "src/slurmd/slurmd/step_registry.h"
 #include "src/slurmd/slurmd/xcpu.h"
 
 #include "src/slurmd/common/proctrack.h"
@@ -111,6 +115,32 @@ typedef struct {
 	uint32_t step_id;
 } starting_step_t;
 
+/* A file being transferred by sbcast. A helper process running as the
+ * file's owner writes the blocks it is sent over a pipe, so a process is
+ * forked once per file rather than once per block. */
+typedef struct {
+	char *fname;
+	uid_t uid;
+	uint32_t job_id;
+	pid_t pid;		/* helper process */
+	int to_fd;		/* pipe to helper */
+	int from_fd;		/* pipe from helper */
+	pthread_mutex_t mutex;	/* held while a block is sent to helper */
+	int ref_cnt;		/* RPCs using this record */
+	bool ended;		/* free once ref_cnt is zero */
+	time_t last_update;
+} file_bcast_info_t;
+
+/* Header of a block sent to a file_bcast helper, followed by the data */
+typedef struct {
+	uint64_t offset;	/* or FILE_BCAST_APPEND */
+	uint32_t len;
+	uint16_t last_block;
+} file_bcast_block_t;
+
+/* A file_bcast helper exits if not sent a block for this many seconds */
+#define FILE_BCAST_TIMEOUT	300
+
 typedef struct {
 	uint32_t job_id;
 	uint16_t msg_timeout;
@@ -169,9 +199,8 @@ static int  _waiter_complete (uint32_t jobid);
 
 static bool _steps_completed_now(uint32_t jobid);
 static int  _valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid,
-			       uint16_t block_no);
+			       uint16_t block_no, uint32_t *job_id);
 static void _wait_state_completed(uint32_t jobid, int max_delay);
-static long _get_job_uid(uint32_t jobid);
 
 static gids_t *_gids_cache_lookup(char *user, gid_t gid);
 
@@ -199,6 +228,9 @@ static pthread_mutex_t job_limits_mutex = PTHREAD_MUTEX_INITIALIZER;
 static List job_limits_list = NULL;
 static bool job_limits_loaded = false;
 
+static pthread_mutex_t file_bcast_mutex = PTHREAD_MUTEX_INITIALIZER;
+static List file_bcast_list = NULL;	/* file_bcast_info_t records */
+
 /* NUM_PARALLEL_SUSPEND controls the number of jobs suspended/resumed
  * at one time as well as the number of jobsteps per job that can be
  * suspended at one time */
@@ -544,6 +576,54 @@ rwfail:
 }
 
 
+/* Get the job and step ids of a launch request */
+static int
+_launch_step_ids(slurmd_step_type_t type, void *req,
+		 uint32_t *jobid, uint32_t *stepid, uid_t *uid)
+{
+	switch(type) {
+	case LAUNCH_BATCH_JOB:
+		*jobid  = ((batch_job_launch_msg_t *)req)->job_id;
+		*stepid = ((batch_job_launch_msg_t *)req)->step_id;
+		*uid    = ((batch_job_launch_msg_t *)req)->uid;
+		return SLURM_SUCCESS;
+	case LAUNCH_TASKS:
+		*jobid  = ((launch_tasks_request_msg_t *)req)->job_id;
+		*stepid = ((launch_tasks_request_msg_t *)req)->job_step_id;
+		*uid    = ((launch_tasks_request_msg_t *)req)->uid;
+		return SLURM_SUCCESS;
+	default:
+		error("_launch_step_ids called with an invalid type");
+		return SLURM_ERROR;
+	}
+}
+
+/* Add a slurmstepd which has just started to the step registry */
+static void
+_register_step(slurmd_step_type_t type, void *req, pid_t stepd_pid)
+{
+	uint32_t jobid, stepid;
+	uid_t uid;
+
+	if (_launch_step_ids(type, req, &jobid, &stepid, &uid) ==
+	    SLURM_SUCCESS)
+		step_registry_add(jobid, stepid, uid, stepd_pid);
+}
+
+/* Remove a slurmstepd which failed to start from the step registry once
+ * it has exited. One still running is left to be dropped when it is
+ * found to have exited later. */
+static void
+_unregister_failed_step(slurmd_step_type_t type, void *req)
+{
+	uint32_t jobid, stepid;
+	uid_t uid;
+
+	if (_launch_step_ids(type, req, &jobid, &stepid, &uid) ==
+	    SLURM_SUCCESS)
+		step_registry_remove_exited(jobid, stepid);
+}
+
 /*
  * Fork and exec the slurmstepd, then send the slurmstepd its
  * initialization data.  Then wait for slurmstepd to send an "ok"
@@ -553,7 +633,9 @@ rwfail:
  *
  * Note that this code forks twice and it is the grandchild that
  * becomes the slurmstepd process, so the slurmstepd's parent process
- * will be init, not slurmd.
+ * will be init, not slurmd. The child reports the grandchild's pid
+ * over the to_slurmd pipe and the step is added to the step registry as
+ * soon as it arrives.
  */
 static int
 _forkexec_slurmstepd(slurmd_step_type_t type, void *req,
@@ -584,17 +666,30 @@ _forkexec_slurmstepd(slurmd_step_type_t type, void *req,
 		return SLURM_FAILURE;
 	} else if (pid > 0) {
 		int rc = 0;
+		pid_t stepd_pid;
 		time_t start_time = time(NULL);
 		/*
-		 * Parent sends initialization data to the slurmstepd
-		 * over the to_stepd pipe, and waits for the return code
-		 * reply on the to_slurmd pipe.
+		 * Parent reads the slurmstepd pid from the child, then
+		 * sends initialization data to the slurmstepd over the
+		 * to_stepd pipe, and waits for the return code reply on
+		 * the to_slurmd pipe. The slurmstepd writes nothing
+		 * until it has read its initialization data, so the pid
+		 * always arrives first.
 		 */
 		if (close(to_stepd[0]) < 0)
 			error("Unable to close read to_stepd in parent: %m");
 		if (close(to_slurmd[1]) < 0)
 			error("Unable to close write to_slurmd in parent: %m");
 
+		if (read(to_slurmd[0], &stepd_pid, sizeof(pid_t)) !=
+		    sizeof(pid_t)) {
+			error("Error reading slurmstepd pid: %m");
+			rc = SLURM_FAILURE;
+			goto done;
+		}
+		/* Register the step now, the slurmstepd may run (and must
+		 * be found to be signaled) even if its startup fails */
+		_register_step(type, req, stepd_pid);
 		if ((rc = _send_slurmstepd_init(to_stepd[1], type,
 						req, cli, self,
 						step_hset)) != 0) {
@@ -621,6 +716,8 @@ _forkexec_slurmstepd(slurmd_step_type_t type, void *req,
 		/* Reap child */
 		if (waitpid(pid, NULL, 0) < 0)
 			error("Unable to reap slurmd child process");
+		if (rc != SLURM_SUCCESS)
+			_unregister_failed_step(type, req);
 		if (close(to_stepd[1]) < 0)
 			error("close write to_stepd in parent: %m");
 		if (close(to_slurmd[0]) < 0)
@@ -652,6 +749,9 @@ _forkexec_slurmstepd(slurmd_step_type_t type, void *req,
 			      "Unable to fork grandchild: %m");
 			failed = 2;
 		} else if (pid > 0) { /* child */
+			if (write(to_slurmd[1], &pid, sizeof(pid_t)) !=
+			    sizeof(pid_t))
+				error("Unable to send slurmstepd pid: %m");
 			exit(0);
 		}
 
@@ -1374,7 +1474,7 @@ _rpc_job_notify(slurm_msg_t *msg)
 	int fd;
 
 	debug("_rpc_job_notify, uid = %d, jobid = %u", req_uid, req->job_id);
-	job_uid = _get_job_uid(req->job_id);
+	job_uid = step_registry_job_uid(req->job_id);
 	if (job_uid < 0)
 		goto no_job;
 
@@ -1387,7 +1487,7 @@ _rpc_job_notify(slurm_msg_t *msg)
 		return;
 	}
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(req->job_id);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if ((stepd->jobid  != req->job_id) ||
@@ -1397,8 +1497,8 @@ _rpc_job_notify(slurm_msg_t *msg)
 
 		step_cnt++;
 
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1) {
 			debug3("Unable to connect to step %u.%u",
 			       stepd->jobid, stepd->stepid);
@@ -1533,15 +1633,15 @@ _load_job_limits(void)
 		job_limits_list = list_create(_job_limits_free);
 	job_limits_loaded = true;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(NO_VAL);
 	step_iter = list_iterator_create(steps);
 	while ((stepd = list_next(step_iter))) {
 		job_limits_ptr = list_find_first(job_limits_list,
 						 _step_limits_match, stepd);
 		if (job_limits_ptr)	/* already processed */
 			continue;
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1)
 			continue;	/* step completed */
 		stepd_info_ptr = stepd_get_info(fd);
@@ -1660,7 +1760,7 @@ _enforce_job_mem_limit(void)
 		job_mem_info_ptr[i].vsize_limit *= (vsize_factor / 100.0);
 	}
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(NO_VAL);
 	step_iter = list_iterator_create(steps);
 	while ((stepd = list_next(step_iter))) {
 		for (job_inx=0; job_inx<job_cnt; job_inx++) {
@@ -1670,8 +1770,8 @@ _enforce_job_mem_limit(void)
 		if (job_inx >= job_cnt)
 			continue;	/* job/step not being tracked */
 
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1)
 			continue;	/* step completed */
 		acct_req.job_id  = stepd->jobid;
@@ -1818,7 +1918,8 @@ _signal_jobstep(uint32_t jobid, uint32_t stepid, uid_t req_uid,
 	int               fd, rc = SLURM_SUCCESS;
 	slurmstepd_info_t *step;
 
-	fd = stepd_connect(conf->spooldir, conf->node_name, jobid, stepid);
+	fd = step_registry_connect(conf->spooldir, conf->node_name,
+				   jobid, stepid);
 	if (fd == -1) {
 		debug("signal for nonexistant %u.%u stepd_connect failed: %m",
 		      jobid, stepid);
@@ -1895,8 +1996,8 @@ _rpc_checkpoint_tasks(slurm_msg_t *msg)
 	checkpoint_tasks_msg_t *req = (checkpoint_tasks_msg_t *) msg->data;
 	slurmstepd_info_t *step;
 
-	fd = stepd_connect(conf->spooldir, conf->node_name,
-			   req->job_id, req->job_step_id);
+	fd = step_registry_connect(conf->spooldir, conf->node_name,
+				   req->job_id, req->job_step_id);
 	if (fd == -1) {
 		debug("checkpoint for nonexistant %u.%u stepd_connect "
 		      "failed: %m", req->job_id, req->job_step_id);
@@ -1940,8 +2041,8 @@ _rpc_terminate_tasks(slurm_msg_t *msg)
 	slurmstepd_info_t *step;
 
 	debug3("Entering _rpc_terminate_tasks");
-	fd = stepd_connect(conf->spooldir, conf->node_name,
-			   req->job_id, req->job_step_id);
+	fd = step_registry_connect(conf->spooldir, conf->node_name,
+				   req->job_id, req->job_step_id);
 	if (fd == -1) {
 		debug("kill for nonexistant job %u.%u stepd_connect "
 		      "failed: %m", req->job_id, req->job_step_id);
@@ -1985,8 +2086,8 @@ _rpc_step_complete(slurm_msg_t *msg)
 	uid_t             req_uid;
 
 	debug3("Entering _rpc_step_complete");
-	fd = stepd_connect(conf->spooldir, conf->node_name,
-			   req->job_id, req->job_step_id);
+	fd = step_registry_connect(conf->spooldir, conf->node_name,
+				   req->job_id, req->job_step_id);
 	if (fd == -1) {
 		error("stepd_connect to %u.%u failed: %m",
 		      req->job_id, req->job_step_id);
@@ -2026,12 +2127,12 @@ _get_step_list(void)
 	ListIterator i;
 	step_loc_t *stepd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(NO_VAL);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		int fd;
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1)
 			continue;
 		if (stepd_state(fd) == SLURMSTEPD_NOT_RUNNING) {
@@ -2083,6 +2184,7 @@ _rpc_daemon_status(slurm_msg_t *msg)
 	resp->slurmd_debug       = conf->debug_level;
 	resp->slurmd_logfile     = xstrdup(conf->logfile);
 	resp->version            = xstrdup(SLURM_VERSION_STRING);
+	resp->rpc_stats          = slurmd_rpc_stats();
 
 	slurm_msg_t_copy(&resp_msg, msg);
 	resp_msg.msg_type = RESPONSE_SLURMD_STATUS;
@@ -2107,7 +2209,7 @@ _rpc_stat_jobacct(slurm_msg_t *msg)
 	   so only root or SlurmUser is allowed here */
 	req_uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
 
-	job_uid = _get_job_uid(req->job_id);
+	job_uid = step_registry_job_uid(req->job_id);
 	if (job_uid < 0) {
 		error("stat_jobacct for invalid job_id: %u",
 		      req->job_id);
@@ -2135,8 +2237,8 @@ _rpc_stat_jobacct(slurm_msg_t *msg)
 	resp->step_pids->node_name = xstrdup(conf->node_name);
 	slurm_msg_t_copy(&resp_msg, msg);
 	resp->return_code = SLURM_SUCCESS;
-	fd = stepd_connect(conf->spooldir, conf->node_name,
-			   req->job_id, req->step_id);
+	fd = step_registry_connect(conf->spooldir, conf->node_name,
+				   req->job_id, req->step_id);
 	if (fd == -1) {
 		error("stepd_connect to %u.%u failed: %m",
 		      req->job_id, req->step_id);
@@ -2185,7 +2287,7 @@ _rpc_list_pids(slurm_msg_t *msg)
            so only root or SlurmUser is allowed here */
         req_uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
 
-        job_uid = _get_job_uid(req->job_id);
+        job_uid = step_registry_job_uid(req->job_id);
         if (job_uid < 0) {
                 error("stat_pid for invalid job_id: %u",
 		      req->job_id);
@@ -2213,8 +2315,8 @@ _rpc_list_pids(slurm_msg_t *msg)
  	resp->node_name = xstrdup(conf->node_name);
 	resp->pid_cnt = 0;
 	resp->pid = NULL;
-        fd = stepd_connect(conf->spooldir, conf->node_name,
-                           req->job_id, req->step_id);
+        fd = step_registry_connect(conf->spooldir, conf->node_name,
+                                   req->job_id, req->step_id);
         if (fd == -1) {
                 error("stepd_connect to %u.%u failed: %m",
                       req->job_id, req->step_id);
@@ -2321,12 +2423,12 @@ static void  _rpc_pid2jid(slurm_msg_t *msg)
 	ListIterator i;
 	step_loc_t *stepd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(NO_VAL);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		int fd;
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1)
 			continue;
 		if (stepd_pid_in_container(fd, req->job_pid)
@@ -2384,15 +2486,15 @@ _init_groups(uid_t my_uid, gid_t my_gid)
  * Munge without generating a credential replay error
  * RET SLURM_SUCCESS or an error code */
 static int
-_valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid, uint16_t block_no)
+_valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid, uint16_t block_no,
+		   uint32_t *job_id)
 {
 	int rc = SLURM_SUCCESS;
-	uint32_t job_id;
 	char *nodes = NULL;
 	hostset_t hset = NULL;
 
 	rc = extract_sbcast_cred(conf->vctx, req->cred, block_no,
-				 &job_id, &nodes);
+				 job_id, &nodes);
 	if (rc != 0) {
 		error("Security violation: Invalid sbcast_cred from uid %d",
 		      req_uid);
@@ -2416,110 +2518,432 @@ _valid_sbcast_cred(file_bcast_msg_t *req, uid_t req_uid, uint16_t block_no)
 	return rc;
 }
 
-static int
-_rpc_file_bcast(slurm_msg_t *msg)
+/* Read or write all of a buffer, RET 0 or -1 on error or end of file */
+static int _file_bcast_io(int fd, char *buf, size_t len, bool write_io)
 {
-	file_bcast_msg_t *req = msg->data;
-	int fd, flags, offset, inx, rc;
-	uid_t req_uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
-	gid_t req_gid = g_slurm_auth_get_gid(msg->auth_cred, NULL);
-	pid_t child;
+	ssize_t inx;
 
-#if 0
-	info("last_block=%u force=%u modes=%o",
-	     req->last_block, req->force, req->modes);
-	info("uid=%u gid=%u atime=%lu mtime=%lu block_len[0]=%u",
-	     req->uid, req->gid, req->atime, req->mtime, req->block_len);
-#if 0
-	/* when the file being transferred is binary, the following line
-	 * can break the terminal output for slurmd */
-	info("req->block[0]=%s, @ %lu", \
-	     req->block[0], (unsigned long) &req->block);
-#endif
-#endif
+	while (len) {
+		if (write_io)
+			inx = write(fd, buf, len);
+		else
+			inx = read(fd, buf, len);
+		if (inx == -1) {
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			return -1;
+		} else if (inx == 0)
+			return -1;
+		buf += inx;
+		len -= inx;
+	}
+	return 0;
+}
 
-	if ((rc = _valid_sbcast_cred(req, req_uid, req->block_no)) !=
-	    SLURM_SUCCESS)
-		return rc;
+/* Close every descriptor inherited by a file_bcast helper process other
+ * than stdio, the log file and its pipes */
+static void _file_bcast_close_fds(int in_fd, int out_fd)
+{
+	FILE *log_file = log_fp();
+	int fd, log_fd = log_file ? fileno(log_file) : -1;
+	int fdlimit = sysconf(_SC_OPEN_MAX);
 
-	info("sbcast req_uid=%u fname=%s block_no=%u",
-	     req_uid, req->fname, req->block_no);
-	child = fork();
-	if (child == -1) {
-		error("sbcast: fork failure");
-		return errno;
-	} else if (child > 0) {
-		waitpid(child, &rc, 0);
-		return WEXITSTATUS(rc);
+	for (fd = 3; fd < fdlimit; fd++) {
+		if ((fd != in_fd) && (fd != out_fd) && (fd != log_fd))
+			close(fd);
 	}
+}
+
+/* Body of a file_bcast helper process: become the user, create the file and
+ * write the blocks read from in_fd, replying to each on out_fd. Exits after
+ * the last block, on error or when not sent a block for FILE_BCAST_TIMEOUT
+ * seconds. Does not return. */
+static void _file_bcast_helper(file_bcast_msg_t *req, uid_t req_uid,
+			       gid_t req_gid, int in_fd, int out_fd)
+{
+	file_bcast_block_t block;
+	struct pollfd pfd;
+	char *buf = NULL;
+	uint32_t buf_size = 0;
+	int fd, flags, rc;
+	off_t offset;
+	ssize_t inx;
+
+	/* The helper outlives the RPC which started it: keep only its
+	 * pipes, stdio and the log file open, so that it holds neither
+	 * slurmd's listening socket (slurmd could not be restarted while
+	 * the file is being transferred) nor any other connection */
+	_file_bcast_close_fds(in_fd, out_fd);
 
-	/* The child actually performs the I/O and exits with
-	 * a return code, do not return! */
 	if (_init_groups(req_uid, req_gid) < 0) {
 		error("sbcast: initgroups(%u): %m", req_uid);
-		exit(errno);
+		rc = errno;
+		goto reply;
 	}
 	if (setgid(req_gid) < 0) {
 		error("sbcast: uid:%u setgid(%u): %s", req_uid, req_gid,
 		      strerror(errno));
-		exit(errno);
+		rc = errno;
+		goto reply;
 	}
 	if (setuid(req_uid) < 0) {
 		error("sbcast: getuid(%u): %s", req_uid, strerror(errno));
-		exit(errno);
+		rc = errno;
+		goto reply;
 	}
 
-	flags = O_WRONLY;
-	if (req->block_no == 1) {
-		flags |= O_CREAT;
-		if (req->force)
-			flags |= O_TRUNC;
-		else
-			flags |= O_EXCL;
-	} else
-		flags |= O_APPEND;
-
+	flags = O_WRONLY | O_CREAT;
+	if (req->force)
+		flags |= O_TRUNC;
+	else
+		flags |= O_EXCL;
 	fd = open(req->fname, flags, 0700);
 	if (fd == -1) {
 		error("sbcast: uid:%u can't open `%s`: %s",
 		      req_uid, req->fname, strerror(errno));
-		exit(errno);
+		rc = errno;
+		goto reply;
 	}
+	rc = SLURM_SUCCESS;
+	if (_file_bcast_io(out_fd, (char *) &rc, sizeof(rc), true))
+		exit(SLURM_ERROR);
 
-	offset = 0;
-	while (req->block_len - offset) {
-		inx = write(fd, &req->block[offset],
-			    (req->block_len - offset));
-		if (inx == -1) {
-			if ((errno == EINTR) || (errno == EAGAIN))
-				continue;
-			error("sbcast: uid:%u can't write `%s`: %s",
+	pfd.fd = in_fd;
+	pfd.events = POLLIN;
+	while (1) {
+		rc = poll(&pfd, 1, FILE_BCAST_TIMEOUT * 1000);
+		if ((rc == -1) && (errno == EINTR))
+			continue;
+		if (rc <= 0) {
+			error("sbcast: uid:%u no data for `%s`, "
+			      "abandoning it", req_uid, req->fname);
+			exit(SLURM_ERROR);
+		}
+		if (_file_bcast_io(in_fd, (char *) &block, sizeof(block),
+				   false))
+			exit(SLURM_ERROR);	/* slurmd ended transfer */
+		if (block.len > buf_size) {
+			buf_size = block.len;
+			xrealloc(buf, buf_size);
+		}
+		if (_file_bcast_io(in_fd, buf, block.len, false))
+			exit(SLURM_ERROR);
+
+		rc = SLURM_SUCCESS;
+		if (block.offset == FILE_BCAST_APPEND)
+			offset = lseek(fd, 0, SEEK_END);
+		else
+			offset = (off_t) block.offset;
+		for (inx = 0; inx < block.len; ) {
+			ssize_t size = pwrite(fd, &buf[inx], block.len - inx,
+					      offset + inx);
+			if (size == -1) {
+				if ((errno == EINTR) || (errno == EAGAIN))
+					continue;
+				error("sbcast: uid:%u can't write `%s`: %s",
+				      req_uid, req->fname, strerror(errno));
+				rc = errno;
+				break;
+			}
+			inx += size;
+		}
+		if (rc || !block.last_block) {
+			if (_file_bcast_io(out_fd, (char *) &rc, sizeof(rc),
+					   true) || rc)
+				exit(rc);
+			continue;
+		}
+
+		if (fchmod(fd, (req->modes & 0777))) {
+			error("sbcast: uid:%u can't chmod `%s`: %s",
 			      req_uid, req->fname, strerror(errno));
-			close(fd);
-			exit(errno);
 		}
-		offset += inx;
+		if (fchown(fd, req->uid, req->gid)) {
+			error("sbcast: uid:%u can't chown `%s`: %s",
+			      req_uid, req->fname, strerror(errno));
+		}
+		close(fd);
+		if (req->atime) {
+			struct utimbuf time_buf;
+			time_buf.actime  = req->atime;
+			time_buf.modtime = req->mtime;
+			if (utime(req->fname, &time_buf)) {
+				error("sbcast: uid:%u can't utime `%s`: %s",
+				      req_uid, req->fname, strerror(errno));
+			}
+		}
+		break;
 	}
-	if (req->last_block && fchmod(fd, (req->modes & 0777))) {
-		error("sbcast: uid:%u can't chmod `%s`: %s",
-		      req_uid, req->fname, strerror(errno));
+
+reply:	(void) _file_bcast_io(out_fd, (char *) &rc, sizeof(rc), true);
+	exit(rc);
+}
+
+static int _file_bcast_match(void *x, void *key)
+{
+	return (x == key);
+}
+
+/* Close a file_bcast helper's pipes, wait for it to exit and free the
+ * record */
+static void _file_bcast_free(file_bcast_info_t *bcast)
+{
+	int status;
+
+	close(bcast->to_fd);
+	close(bcast->from_fd);
+	if (bcast->pid > 0)
+		waitpid(bcast->pid, &status, 0);
+	slurm_mutex_destroy(&bcast->mutex);
+	xfree(bcast->fname);
+	xfree(bcast);
+}
+
+/* Release a file_bcast record found or made by _file_bcast_find() or
+ * _file_bcast_start(). If end is set or the record was ended by another
+ * RPC, it is removed and freed once no RPC is using it. */
+static void _file_bcast_release(file_bcast_info_t *bcast, bool end)
+{
+	bool free_it = false;
+
+	slurm_mutex_lock(&file_bcast_mutex);
+	if (end)
+		bcast->ended = true;
+	bcast->last_update = time(NULL);
+	if ((--bcast->ref_cnt == 0) && bcast->ended) {
+		(void) list_delete_all(file_bcast_list, _file_bcast_match,
+				       bcast);
+		free_it = true;
 	}
-	if (req->last_block && fchown(fd, req->uid, req->gid)) {
-		error("sbcast: uid:%u can't chown `%s`: %s",
-		      req_uid, req->fname, strerror(errno));
+	slurm_mutex_unlock(&file_bcast_mutex);
+
+	if (free_it)
+		_file_bcast_free(bcast);
+}
+
+/* Find the transfer in progress of a file, RET NULL if none */
+static file_bcast_info_t *_file_bcast_find(file_bcast_msg_t *req,
+					   uid_t req_uid, uint32_t job_id)
+{
+	file_bcast_info_t *bcast = NULL;
+	ListIterator iter;
+
+	slurm_mutex_lock(&file_bcast_mutex);
+	if (file_bcast_list) {
+		iter = list_iterator_create(file_bcast_list);
+		while ((bcast = list_next(iter))) {
+			if (!bcast->ended && (bcast->uid == req_uid) &&
+			    (bcast->job_id == job_id) &&
+			    !strcmp(bcast->fname, req->fname)) {
+				bcast->ref_cnt++;
+				break;
+			}
+		}
+		list_iterator_destroy(iter);
 	}
-	close(fd);
-	fd = 0;
-	if (req->last_block && req->atime) {
-		struct utimbuf time_buf;
-		time_buf.actime  = req->atime;
-		time_buf.modtime = req->mtime;
-		if (utime(req->fname, &time_buf)) {
-			error("sbcast: uid:%u can't utime `%s`: %s",
-			      req_uid, req->fname, strerror(errno));
+	slurm_mutex_unlock(&file_bcast_mutex);
+
+	return bcast;
+}
+
+/* Start a file's transfer by forking a helper process to create and write
+ * it. Transfers whose sbcast has not sent a block for FILE_BCAST_TIMEOUT
+ * seconds are ended.
+ * OUT bcast_ptr - the transfer's record, release with _file_bcast_release()
+ * RET SLURM_SUCCESS or an error code */
+static int _file_bcast_start(file_bcast_msg_t *req, uid_t req_uid,
+			     gid_t req_gid, uint32_t job_id,
+			     file_bcast_info_t **bcast_ptr)
+{
+	file_bcast_info_t *bcast;
+	int to_pipe[2], from_pipe[2], rc;
+	ListIterator iter;
+	List stale_list = NULL;
+	time_t now = time(NULL);
+	pid_t child;
+
+	*bcast_ptr = NULL;
+	slurm_mutex_lock(&file_bcast_mutex);
+	if (file_bcast_list == NULL)
+		file_bcast_list = list_create(NULL);
+	iter = list_iterator_create(file_bcast_list);
+	while ((bcast = list_next(iter))) {
+		if ((bcast->ref_cnt == 0) &&
+		    (bcast->ended ||
+		     (difftime(now, bcast->last_update) >
+		      FILE_BCAST_TIMEOUT))) {
+			if (stale_list == NULL)
+				stale_list = list_create(NULL);
+			list_append(stale_list, bcast);
+			list_remove(iter);
 		}
 	}
-	exit(SLURM_SUCCESS);
+	list_iterator_destroy(iter);
+	slurm_mutex_unlock(&file_bcast_mutex);
+	if (stale_list) {
+		while ((bcast = list_pop(stale_list)))
+			_file_bcast_free(bcast);
+		list_destroy(stale_list);
+	}
+
+	if (pipe(to_pipe) < 0) {
+		error("sbcast: pipe: %m");
+		return errno;
+	}
+	if (pipe(from_pipe) < 0) {
+		error("sbcast: pipe: %m");
+		rc = errno;
+		close(to_pipe[0]);
+		close(to_pipe[1]);
+		return rc;
+	}
+	child = fork();
+	if (child == -1) {
+		error("sbcast: fork failure");
+		rc = errno;
+		close(to_pipe[0]);
+		close(to_pipe[1]);
+		close(from_pipe[0]);
+		close(from_pipe[1]);
+		return rc;
+	} else if (child == 0) {
+		close(to_pipe[1]);
+		close(from_pipe[0]);
+		_file_bcast_helper(req, req_uid, req_gid, to_pipe[0],
+				   from_pipe[1]);
+	}
+	close(to_pipe[0]);
+	close(from_pipe[1]);
+	fd_set_close_on_exec(to_pipe[1]);
+	fd_set_close_on_exec(from_pipe[0]);
+
+	bcast = xmalloc(sizeof(file_bcast_info_t));
+	bcast->fname = xstrdup(req->fname);
+	bcast->uid = req_uid;
+	bcast->job_id = job_id;
+	bcast->pid = child;
+	bcast->to_fd = to_pipe[1];
+	bcast->from_fd = from_pipe[0];
+	slurm_mutex_init(&bcast->mutex);
+	bcast->ref_cnt = 1;
+	bcast->last_update = now;
+
+	/* The helper replies once it has opened the file */
+	if (_file_bcast_io(bcast->from_fd, (char *) &rc, sizeof(rc), false))
+		rc = SLURM_ERROR;
+	if (rc != SLURM_SUCCESS) {
+		_file_bcast_free(bcast);
+		return rc;
+	}
+
+	slurm_mutex_lock(&file_bcast_mutex);
+	list_append(file_bcast_list, bcast);
+	slurm_mutex_unlock(&file_bcast_mutex);
+	*bcast_ptr = bcast;
+	return SLURM_SUCCESS;
+}
+
+/* Send a block of data to a file's helper process and wait for it to be
+ * written, RET SLURM_SUCCESS or an error code */
+static int _file_bcast_write(file_bcast_info_t *bcast, file_bcast_msg_t *req,
+			     char *data, uint32_t data_len)
+{
+	file_bcast_block_t block;
+	int rc;
+
+	memset(&block, 0, sizeof(block));
+	block.offset = req->block_offset;
+	block.len = data_len;
+	block.last_block = req->last_block;
+
+	slurm_mutex_lock(&bcast->mutex);
+	if (_file_bcast_io(bcast->to_fd, (char *) &block, sizeof(block),
+			   true) ||
+	    _file_bcast_io(bcast->to_fd, data, data_len, true) ||
+	    _file_bcast_io(bcast->from_fd, (char *) &rc, sizeof(rc), false)) {
+		error("sbcast: uid:%u lost helper writing `%s`",
+		      bcast->uid, bcast->fname);
+		rc = SLURM_ERROR;
+	}
+	slurm_mutex_unlock(&bcast->mutex);
+
+	return rc;
+}
+
+static int
+_rpc_file_bcast(slurm_msg_t *msg)
+{
+	file_bcast_msg_t *req = msg->data;
+	file_bcast_info_t *bcast = NULL;
+	char *data = req->block;
+	uint32_t data_len = req->block_len, job_id;
+	int rc;
+	uid_t req_uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+	gid_t req_gid = g_slurm_auth_get_gid(msg->auth_cred, NULL);
+
+#if 0
+	info("last_block=%u force=%u modes=%o",
+	     req->last_block, req->force, req->modes);
+	info("uid=%u gid=%u atime=%lu mtime=%lu block_len[0]=%u",
+	     req->uid, req->gid, req->atime, req->mtime, req->block_len);
+#if 0
+	/* when the file being transferred is binary, the following line
+	 * can break the terminal output for slurmd */
+	info("req->block[0]=%s, @ %lu", \
+	     req->block[0], (unsigned long) &req->block);
+#endif
+#endif
+
+	if ((rc = _valid_sbcast_cred(req, req_uid, req->block_no, &job_id))
+	    != SLURM_SUCCESS)
+		return rc;
+
+	info("sbcast req_uid=%u fname=%s block_no=%u",
+	     req_uid, req->fname, req->block_no);
+
+	if (req->compress) {
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+		uLongf uncomp_len = req->uncomp_len;
+		/* Check the size sent before allocating for it */
+		if (uncomp_len > FILE_BCAST_MAX_BLOCK) {
+			error("sbcast: uid:%u block %u of `%s` is too large "
+			      "(%u bytes uncompressed)", req_uid,
+			      req->block_no, req->fname, req->uncomp_len);
+			return SLURM_ERROR;
+		}
+		data = xmalloc(MAX(uncomp_len, 1));
+		if (uncompress((Bytef *) data, &uncomp_len,
+			       (Bytef *) req->block, req->block_len) != Z_OK) {
+			error("sbcast: uid:%u can't uncompress block %u "
+			      "of `%s`", req_uid, req->block_no, req->fname);
+			xfree(data);
+			return SLURM_ERROR;
+		}
+		data_len = uncomp_len;
+#else
+		error("sbcast: uid:%u sent compressed `%s`, but zlib is not "
+		      "available", req_uid, req->fname);
+		return ESLURM_NOT_SUPPORTED;
+#endif
+	}
+
+	if (req->block_no == 1) {
+		rc = _file_bcast_start(req, req_uid, req_gid, job_id,
+				       &bcast);
+	} else if ((bcast = _file_bcast_find(req, req_uid, job_id)) == NULL) {
+		error("sbcast: uid:%u block %u of `%s` is not part of a "
+		      "transfer in progress", req_uid, req->block_no,
+		      req->fname);
+		rc = SLURM_ERROR;
+	}
+	if (bcast) {
+		rc = _file_bcast_write(bcast, req, data, data_len);
+		_file_bcast_release(bcast, (req->last_block || rc));
+	}
+
+	if (data != req->block)
+		xfree(data);
+	return rc;
 }
 
 static void
@@ -2542,8 +2966,8 @@ _rpc_reattach_tasks(slurm_msg_t *msg)
 	uint32_t nodeid = (uint32_t)NO_VAL;
 
 	slurm_msg_t_copy(&resp_msg, msg);
-	fd = stepd_connect(conf->spooldir, conf->node_name,
-			   req->job_id, req->job_step_id);
+	fd = step_registry_connect(conf->spooldir, conf->node_name,
+				   req->job_id, req->job_step_id);
 	if (fd == -1) {
 		debug("reattach for nonexistent job %u.%u stepd_connect"
 		      " failed: %m", req->job_id, req->job_step_id);
@@ -2624,49 +3048,6 @@ done:
 	slurm_free_reattach_tasks_response_msg(resp);
 }
 
-static long
-_get_job_uid(uint32_t jobid)
-{
-	List steps;
-	ListIterator i;
-	step_loc_t *stepd;
-	slurmstepd_info_t *info = NULL;
-	int fd;
-	long uid = -1;
-
-	steps = stepd_available(conf->spooldir, conf->node_name);
-	i = list_iterator_create(steps);
-	while ((stepd = list_next(i))) {
-		if (stepd->jobid != jobid) {
-			/* multiple jobs expected on shared nodes */
-			continue;
-		}
-
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
-		if (fd == -1) {
-			debug3("Unable to connect to step %u.%u",
-			       stepd->jobid, stepd->stepid);
-			continue;
-		}
-
-		info = stepd_get_info(fd);
-		close(fd);
-		if (info == NULL) {
-			debug("stepd_get_info failed %u.%u: %m",
-			      stepd->jobid, stepd->stepid);
-			continue;
-		}
-		uid = (long)info->uid;
-		break;
-	}
-	list_iterator_destroy(i);
-	list_destroy(steps);
-
-	xfree(info);
-	return uid;
-}
-
 /*
  * _kill_all_active_steps - signals the container of all steps of a job
  * jobid IN - id of job to signal
@@ -2683,7 +3064,7 @@ _kill_all_active_steps(uint32_t jobid, int sig, bool batch)
 	int step_cnt  = 0;
 	int fd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(jobid);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid != jobid) {
@@ -2698,8 +3079,8 @@ _kill_all_active_steps(uint32_t jobid, int sig, bool batch)
 
 		step_cnt++;
 
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1) {
 			debug3("Unable to connect to step %u.%u",
 			       stepd->jobid, stepd->stepid);
@@ -2734,7 +3115,7 @@ _terminate_all_steps(uint32_t jobid, bool batch)
 	int step_cnt  = 0;
 	int fd;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(jobid);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid != jobid) {
@@ -2749,8 +3130,8 @@ _terminate_all_steps(uint32_t jobid, bool batch)
 
 		step_cnt++;
 
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1) {
 			debug3("Unable to connect to step %u.%u",
 			       stepd->jobid, stepd->stepid);
@@ -2778,13 +3159,13 @@ _job_still_running(uint32_t job_id)
 	ListIterator i;
 	step_loc_t  *s     = NULL;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(job_id);
 	i = list_iterator_create(steps);
 	while ((s = list_next(i))) {
 		if (s->jobid == job_id) {
 			int fd;
-			fd = stepd_connect(s->directory, s->nodename,
-					   s->jobid, s->stepid);
+			fd = step_registry_connect(s->directory, s->nodename,
+						   s->jobid, s->stepid);
 			if (fd == -1)
 				continue;
 			if (stepd_state(fd) != SLURMSTEPD_NOT_RUNNING) {
@@ -2835,13 +3216,15 @@ _steps_completed_now(uint32_t jobid)
 	step_loc_t *stepd;
 	bool rc = true;
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(jobid);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid == jobid) {
 			int fd;
-			fd = stepd_connect(stepd->directory, stepd->nodename,
-					   stepd->jobid, stepd->stepid);
+			fd = step_registry_connect(stepd->directory,
+						   stepd->nodename,
+						   stepd->jobid,
+						   stepd->stepid);
 			if (fd == -1)
 				continue;
 			if (stepd_state(fd) != SLURMSTEPD_NOT_RUNNING) {
@@ -2927,7 +3310,7 @@ _rpc_signal_job(slurm_msg_t *msg)
 #endif
 
 	debug("_rpc_signal_job, uid = %d, signal = %d", req_uid, req->signal);
-	job_uid = _get_job_uid(req->job_id);
+	job_uid = step_registry_job_uid(req->job_id);
 	if (job_uid < 0)
 		goto no_job;
 
@@ -2951,7 +3334,7 @@ _rpc_signal_job(slurm_msg_t *msg)
 	 * Loop through all job steps for this job and signal the
 	 * step's process group through the slurmstepd.
 	 */
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(req->job_id);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		if (stepd->jobid != req->job_id) {
@@ -2968,8 +3351,8 @@ _rpc_signal_job(slurm_msg_t *msg)
 
 		step_cnt++;
 
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1) {
 			debug3("Unable to connect to step %u.%u",
 			       stepd->jobid, stepd->stepid);
@@ -3124,7 +3507,7 @@ _rpc_suspend_job(slurm_msg_t *msg)
 	 * as appropriate. Since the "suspend" action contains a 'sleep 1',
 	 * suspend multiple jobsteps in parallel.
 	 */
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(req->job_id);
 	i = list_iterator_create(steps);
 
 	while (1) {
@@ -3140,9 +3523,10 @@ _rpc_suspend_job(slurm_msg_t *msg)
 			}
 			step_cnt++;
 
-			fd[fdi] = stepd_connect(stepd->directory,
-						stepd->nodename, stepd->jobid,
-						stepd->stepid);
+			fd[fdi] = step_registry_connect(stepd->directory,
+							stepd->nodename,
+							stepd->jobid,
+							stepd->stepid);
 			if (fd[fdi] == -1) {
 				debug3("Unable to connect to step %u.%u",
 				       stepd->jobid, stepd->stepid);
@@ -48,6 +48,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sys/poll.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -60,6 +61,7 @@
 #include <dlfcn.h>
 
 #include "src/common/bitstring.h"
+#include "src/common/conn_cache.h"
 #include "src/common/daemonize.h"
 #include "src/common/fd.h"
 #include "src/common/forward.h"
@@ -93,6 +95,7 @@
 #include "src/slurmd/slurmd/slurmd.h"
 #include "src/slurmd/slurmd/req.h"
 #include "src/slurmd/slurmd/get_mach_stat.h"
+#include "src/slurmd/slurmd/step_registry.h"
 #include "src/slurmd/common/proctrack.h"
 
 #define GETOPT_ARGS	"cCd:Df:hL:Mn:N:vV"
@@ -119,8 +122,83 @@ static pthread_mutex_t fork_mutex     = PTHREAD_MUTEX_INITIALIZER;
 typedef struct connection {
 	slurm_fd_t fd;
 	slurm_addr_t *cli_addr;
+	slurm_msg_t *msg;		/* request, once received */
+	struct timeval accept_time;
+	struct connection *next;
 } conn_t;
 
+/*
+ * Requests are serviced by a pool of at most MAX_THREADS worker threads,
+ * started as needed. A worker first receives a request on a new connection
+ * and then queues it on a lane by type. Workers take requests from the
+ * highest priority lane. The launch and other lanes may each only use part
+ * of the pool and together leave RPC_WORKER_RESERVE workers free, and the
+ * urgent lane leaves one worker free, so that workers are left to receive
+ * requests and to kill jobs however many requests are in progress. At most
+ * MAX_RECV_QUEUE new connections wait to be received, further connections
+ * are left unaccepted until workers catch up.
+ */
+enum {
+	RPC_LANE_URGENT,	/* job termination and signals */
+	RPC_LANE_LAUNCH,	/* job and step launch */
+	RPC_LANE_OTHER,		/* pings, status and everything else */
+	RPC_LANE_CNT
+};
+
+static const char *rpc_lane_name[RPC_LANE_CNT] = {
+	"urgent", "launch", "other"
+};
+
+/* Maximum workers servicing requests of each lane */
+static const int rpc_lane_max[RPC_LANE_CNT] = {
+	MAX_THREADS - 1, (MAX_THREADS * 3) / 4, MAX_THREADS / 2
+};
+
+/* Workers which the launch and other lanes together may not use */
+#define RPC_WORKER_RESERVE	10
+#define MAX_RECV_QUEUE		MAX_THREADS
+
+typedef struct rpc_lane {
+	conn_t *head, *tail;	/* queued requests */
+	int queued;
+	int running;
+	uint32_t cnt;		/* requests serviced */
+	uint64_t wait_usec;	/* total time from accept until serviced */
+	uint64_t wait_max_usec;
+	uint64_t run_usec;	/* total time to service */
+	uint64_t run_max_usec;
+} rpc_lane_t;
+
+static rpc_lane_t      rpc_lane[RPC_LANE_CNT];
+static conn_t         *recv_head = NULL, *recv_tail = NULL;
+static int             recv_queued = 0;
+static int             worker_cnt = 0;	/* workers started */
+static int             worker_idle = 0;	/* workers waiting for work */
+static int             worker_busy = 0;	/* workers with work */
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  worker_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  worker_done_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Connections from slurmctld may be kept open for another request once a
+ * request has been serviced (see src/common/conn_cache.h). Kept connections
+ * are watched by _kept_conn_engine(), which services the next request on
+ * a connection in a new thread, or closes the connection once it has been
+ * idle for longer than slurmctld would keep it.
+ */
+#define MAX_KEPT_CONNS		64
+#define KEPT_CONN_IDLE_TIME	(CONN_CACHE_IDLE_TIME * 2)
+
+typedef struct kept_conn {
+	slurm_fd_t fd;
+	slurm_addr_t cli_addr;
+	time_t idle_start;
+} kept_conn_t;
+
+static kept_conn_t     kept_conn[MAX_KEPT_CONNS];
+static int             kept_conn_cnt = 0;
+static int             kept_conn_pipe[2] = {-1, -1};
+static pthread_mutex_t kept_conn_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
 /*
@@ -143,6 +221,8 @@ static void      _hup_handler(int);
 static void      _increment_thd_count(void);
 static void      _init_conf(void);
 static void      _install_fork_handlers(void);
+static bool      _keep_conn(conn_t *con, slurm_msg_t *msg);
+static void     *_kept_conn_engine(void *arg);
 static void 	 _kill_old_slurmd(void);
 static void      _msg_engine(void);
 static void      _print_conf(void);
@@ -152,17 +232,20 @@ static void      _read_config(void);
 static void      _reconfigure(void);
 static void     *_registration_engine(void *arg);
 static int       _restore_cred_state(slurm_cred_ctx_t ctx);
-static void     *_service_connection(void *);
+static void      _service_connection(conn_t *con);
 static int       _set_slurmd_spooldir(void);
 static int       _set_topo_info(void);
 static int       _slurmd_init(void);
 static int       _slurmd_fini(void);
+static void      _spawn_kept_conn_engine(void);
 static void      _spawn_registration_engine(void);
 static void      _term_handler(int);
 static void      _update_logging(void);
 static void      _update_nice(void);
 static void      _usage(void);
 static void      _wait_for_all_threads(void);
+static void      _wait_for_workers(void);
+static void     *_worker(void *arg);
 
 
 int
@@ -257,6 +340,7 @@ main (int argc, char *argv[])
 		if (daemon(1,1) == -1)
 			error("Couldn't daemonize slurmd: %m");
 	}
+	log_async_init();
 	test_core_limit();
 	info("slurmd version %s started", SLURM_VERSION_STRING);
 	debug3("finished daemonize");
@@ -313,6 +397,7 @@ main (int argc, char *argv[])
 	slurm_conf_install_fork_handlers();
 
 	_spawn_registration_engine();
+	_spawn_kept_conn_engine();
 	_msg_engine();
 
 	/*
@@ -324,6 +409,7 @@ main (int argc, char *argv[])
 	if (unlink(conf->pidfile) < 0)
 		error("Unable to remove pidfile `%s': %m", conf->pidfile);
 
+	_wait_for_workers();
 	_wait_for_all_threads();
 
 	interconnect_node_fini();
@@ -388,6 +474,185 @@ _registration_engine(void *arg)
 	return NULL;
 }
 
+static void
+_spawn_kept_conn_engine(void)
+{
+	pthread_attr_t attr;
+	pthread_t      id;
+
+	if (pipe(kept_conn_pipe) < 0) {
+		error("Unable to create pipe for kept connections: %m");
+		kept_conn_pipe[0] = kept_conn_pipe[1] = -1;
+		return;
+	}
+	fd_set_close_on_exec(kept_conn_pipe[0]);
+	fd_set_close_on_exec(kept_conn_pipe[1]);
+	fd_set_nonblocking(kept_conn_pipe[0]);
+	fd_set_nonblocking(kept_conn_pipe[1]);
+
+	slurm_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&id, &attr, &_kept_conn_engine, NULL)) {
+		error("Unable to start kept connection thread: %m");
+		(void) close(kept_conn_pipe[0]);
+		(void) close(kept_conn_pipe[1]);
+		kept_conn_pipe[0] = kept_conn_pipe[1] = -1;
+	}
+	slurm_attr_destroy(&attr);
+}
+
+/* Return true if a request from slurmctld may leave its connection open
+ * for another request */
+static bool
+_keep_conn_msg(slurm_msg_t *msg)
+{
+	uid_t uid;
+
+	switch (msg->msg_type) {
+	case REQUEST_ABORT_JOB:
+	case REQUEST_BATCH_JOB_LAUNCH:
+	case REQUEST_CHECKPOINT_TASKS:
+	case REQUEST_HEALTH_CHECK:
+	case REQUEST_JOB_NOTIFY:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_NODE_REGISTRATION_STATUS:
+	case REQUEST_PING:
+	case REQUEST_SIGNAL_JOB:
+	case REQUEST_SIGNAL_TASKS:
+	case REQUEST_SUSPEND:
+	case REQUEST_TERMINATE_JOB:
+	case REQUEST_TERMINATE_TASKS:
+	case REQUEST_UPDATE_JOB_TIME:
+		break;
+	default:
+		return false;
+	}
+
+	uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+	return ((uid == (uid_t) 0) || (uid == conf->slurm_user_id));
+}
+
+/*
+ * _keep_conn - arrange for another request to be read from a connection
+ *	once the request just received has been replied to. The request's
+ *	handler may close the connection (and keep working) after replying,
+ *	so the connection is duplicated.
+ * RET true if the connection is kept
+ */
+static bool
+_keep_conn(conn_t *con, slurm_msg_t *msg)
+{
+	slurm_fd_t fd;
+	char c = '\0';
+	bool kept = false;
+
+	if (!_keep_conn_msg(msg))
+		return false;
+
+	slurm_mutex_lock(&kept_conn_mutex);
+	if ((kept_conn_pipe[1] >= 0) && (kept_conn_cnt < MAX_KEPT_CONNS) &&
+	    ((fd = dup(con->fd)) >= 0)) {
+		fd_set_close_on_exec(fd);
+		kept_conn[kept_conn_cnt].fd = fd;
+		memcpy(&kept_conn[kept_conn_cnt].cli_addr, con->cli_addr,
+		       sizeof(slurm_addr_t));
+		kept_conn[kept_conn_cnt].idle_start = time(NULL);
+		kept_conn_cnt++;
+		kept = true;
+		/* Wake _kept_conn_engine to poll the new connection */
+		if (write(kept_conn_pipe[1], &c, 1) < 0)
+			debug3("kept connection pipe write: %m");
+	}
+	slurm_mutex_unlock(&kept_conn_mutex);
+
+	return kept;
+}
+
+/* Remove an entry from the kept connection table, optionally closing it.
+ * Call with kept_conn_mutex held. */
+static void
+_kept_conn_remove(int inx, bool close_conn)
+{
+	if (close_conn)
+		(void) slurm_close_accepted_conn(kept_conn[inx].fd);
+	kept_conn_cnt--;
+	if (inx < kept_conn_cnt)
+		kept_conn[inx] = kept_conn[kept_conn_cnt];
+}
+
+static void *
+_kept_conn_engine(void *arg)
+{
+	struct pollfd ufds[MAX_KEPT_CONNS + 1];
+	kept_conn_t ready[MAX_KEPT_CONNS];
+	int i, nfds, ready_cnt, rc;
+	slurm_addr_t *cli;
+	char buf[64];
+	time_t now;
+
+	while (!_shutdown) {
+		ufds[0].fd = kept_conn_pipe[0];
+		ufds[0].events = POLLIN;
+		slurm_mutex_lock(&kept_conn_mutex);
+		nfds = kept_conn_cnt;
+		for (i = 0; i < nfds; i++) {
+			ufds[i + 1].fd = kept_conn[i].fd;
+			ufds[i + 1].events = POLLIN;
+		}
+		slurm_mutex_unlock(&kept_conn_mutex);
+
+		rc = poll(ufds, nfds + 1, 1000);
+		if (rc < 0) {
+			if (errno != EINTR) {
+				error("kept connection poll: %m");
+				sleep(1);
+			}
+			continue;
+		}
+		if (ufds[0].revents & POLLIN) {
+			while (read(kept_conn_pipe[0], buf, sizeof(buf)) > 0)
+				;
+		}
+
+		/* Only this thread removes entries, so the first nfds
+		 * entries are those polled. Work down so that entries
+		 * moved into a removed entry's place were already seen. */
+		now = time(NULL);
+		ready_cnt = 0;
+		slurm_mutex_lock(&kept_conn_mutex);
+		for (i = nfds - 1; i >= 0; i--) {
+			if (ufds[i + 1].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				_kept_conn_remove(i, true);
+			} else if (ufds[i + 1].revents & POLLIN) {
+				/* Closed by slurmctld or a new request */
+				if (recv(kept_conn[i].fd, buf, 1, MSG_PEEK) <= 0) {
+					_kept_conn_remove(i, true);
+				} else {
+					ready[ready_cnt++] = kept_conn[i];
+					_kept_conn_remove(i, false);
+				}
+			} else if (difftime(now, kept_conn[i].idle_start) >=
+				   KEPT_CONN_IDLE_TIME) {
+				_kept_conn_remove(i, true);
+			}
+		}
+		slurm_mutex_unlock(&kept_conn_mutex);
+
+		for (i = 0; i < ready_cnt; i++) {
+			cli = xmalloc(sizeof(slurm_addr_t));
+			memcpy(cli, &ready[i].cli_addr, sizeof(slurm_addr_t));
+			_handle_connection(ready[i].fd, cli);
+		}
+	}
+
+	slurm_mutex_lock(&kept_conn_mutex);
+	while (kept_conn_cnt)
+		_kept_conn_remove(kept_conn_cnt - 1, true);
+	slurm_mutex_unlock(&kept_conn_mutex);
+	return NULL;
+}
+
 static void
 _msg_engine(void)
 {
@@ -460,54 +725,138 @@ _wait_for_all_threads(void)
 	verbose("all threads complete.");
 }
 
+/* Return the lane on which a request is queued */
+static int
+_rpc_lane(slurm_msg_t *msg)
+{
+	switch (msg->msg_type) {
+	case REQUEST_ABORT_JOB:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_RECONFIGURE:
+	case REQUEST_SHUTDOWN:
+	case REQUEST_SIGNAL_JOB:
+	case REQUEST_SIGNAL_TASKS:
+	case REQUEST_SUSPEND:
+	case REQUEST_TERMINATE_JOB:
+	case REQUEST_TERMINATE_TASKS:
+		return RPC_LANE_URGENT;
+	case REQUEST_BATCH_JOB_LAUNCH:
+	case REQUEST_FILE_BCAST:
+	case REQUEST_LAUNCH_TASKS:
+		return RPC_LANE_LAUNCH;
+	default:
+		return RPC_LANE_OTHER;
+	}
+}
+
+/* Microseconds from start until end */
+static uint64_t
+_usec_diff(struct timeval *end, struct timeval *start)
+{
+	if ((end->tv_sec < start->tv_sec) ||
+	    ((end->tv_sec == start->tv_sec) &&
+	     (end->tv_usec < start->tv_usec)))
+		return 0;
+	return ((uint64_t) (end->tv_sec - start->tv_sec) * 1000000) +
+	       end->tv_usec - start->tv_usec;
+}
+
+/* Queue work for the worker pool, starting a worker if none are idle.
+ * Call with worker_mutex held. */
 static void
-_handle_connection(slurm_fd_t fd, slurm_addr_t *cli)
+_queue_work(conn_t **head, conn_t **tail, conn_t *con)
 {
-	int            rc;
 	pthread_attr_t attr;
 	pthread_t      id;
-	conn_t         *arg = xmalloc(sizeof(conn_t));
-	int            retries = 0;
-
-	arg->fd       = fd;
-	arg->cli_addr = cli;
 
-	slurm_attr_init(&attr);
-	rc = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-	if (rc != 0) {
-		errno = rc;
-		xfree(arg);
-		error("Unable to set detachstate on attr: %m");
+	con->next = NULL;
+	if (*tail)
+		(*tail)->next = con;
+	else
+		*head = con;
+	*tail = con;
+
+	if ((worker_idle == 0) && (worker_cnt < MAX_THREADS)) {
+		slurm_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		if (pthread_create(&id, &attr, &_worker, NULL) == 0)
+			worker_cnt++;
+		else if (worker_cnt == 0)
+			fatal("Unable to start a worker thread: %m");
+		else
+			error("Unable to start a worker thread: %m");
 		slurm_attr_destroy(&attr);
-		return;
 	}
+	pthread_cond_signal(&worker_cond);
+}
 
-	fd_set_close_on_exec(fd);
+static conn_t *
+_dequeue_work(conn_t **head, conn_t **tail)
+{
+	conn_t *con = *head;
 
-	_increment_thd_count();
-	while (pthread_create(&id, &attr, &_service_connection, (void *)arg)) {
-		error("msg_engine: pthread_create: %m");
-		if (++retries > 3) {
-			error("running service_connection without starting "
-			      "a new thread slurmd will be "
-			      "unresponsive until done");
+	if ((*head = con->next) == NULL)
+		*tail = NULL;
+	con->next = NULL;
+	return con;
+}
 
-			_service_connection((void *) arg);
-			info("slurmd should be responsive now");
-			break;
+/* Return true if another worker may service a request on a lane.
+ * Call with worker_mutex held. */
+static bool
+_lane_may_run(int lane)
+{
+	if (rpc_lane[lane].running >= rpc_lane_max[lane])
+		return false;
+	if (lane == RPC_LANE_URGENT)
+		return true;
+	return ((rpc_lane[RPC_LANE_LAUNCH].running +
+		 rpc_lane[RPC_LANE_OTHER].running) <
+		(MAX_THREADS - RPC_WORKER_RESERVE));
+}
+
+/* Take the next piece of work: a request on the urgent lane, then a new
+ * connection to receive a request from, then a request on the launch and
+ * other lanes, each only if its lane is within its limits.
+ * OUT lane_ptr - lane of the request or -1 for a new connection
+ * RET work or NULL if none may be started now
+ * Call with worker_mutex held. */
+static conn_t *
+_next_work(int *lane_ptr)
+{
+	int lane;
+
+	if (rpc_lane[RPC_LANE_URGENT].head &&
+	    _lane_may_run(RPC_LANE_URGENT)) {
+		lane = RPC_LANE_URGENT;
+	} else if (recv_head) {
+		*lane_ptr = -1;
+		recv_queued--;
+		return _dequeue_work(&recv_head, &recv_tail);
+	} else {
+		for (lane = RPC_LANE_URGENT + 1; lane < RPC_LANE_CNT;
+		     lane++) {
+			if (rpc_lane[lane].head && _lane_may_run(lane))
+				break;
 		}
-		usleep(10);	/* sleep and again */
+		if (lane >= RPC_LANE_CNT)
+			return NULL;
 	}
 
-	return;
+	*lane_ptr = lane;
+	rpc_lane[lane].queued--;
+	rpc_lane[lane].running++;
+	return _dequeue_work(&rpc_lane[lane].head, &rpc_lane[lane].tail);
 }
 
-static void *
-_service_connection(void *arg)
+/* Receive a request on a new connection and queue it on its lane.
+ * RET true if the request was queued */
+static bool
+_receive_request(conn_t *con)
 {
-	conn_t *con = (conn_t *) arg;
 	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
-	int rc = SLURM_SUCCESS;
+	int rc, lane;
 
 	debug3("in the service_connection");
 	slurm_msg_t_init(msg);
@@ -518,22 +867,181 @@ _service_connection(void *arg)
 		   to are taken care of and sent back. This way the control
 		   also has a better idea what happened to us */
 		slurm_send_rc_msg(msg, rc);
-		goto cleanup;
+		con->msg = msg;
+		return false;
 	}
 	debug2("got this type of message %d", msg->msg_type);
-	slurmd_req(msg);
+	con->msg = msg;
+
+	lane = _rpc_lane(msg);
+	slurm_mutex_lock(&worker_mutex);
+	rpc_lane[lane].queued++;
+	_queue_work(&rpc_lane[lane].head, &rpc_lane[lane].tail, con);
+	slurm_mutex_unlock(&worker_mutex);
+	return true;
+}
 
-cleanup:
-	if ((msg->conn_fd >= 0) && slurm_close_accepted_conn(msg->conn_fd) < 0)
+/* Close a connection once its request is serviced and free it */
+static void
+_free_conn(conn_t *con)
+{
+	slurm_msg_t *msg = con->msg;
+
+	if (msg && (msg->conn_fd >= 0) &&
+	    (slurm_close_accepted_conn(msg->conn_fd) < 0))
 		error ("close(%d): %m", con->fd);
 
 	xfree(con->cli_addr);
 	xfree(con);
-	slurm_free_msg(msg);
-	_decrement_thd_count();
+	if (msg)
+		slurm_free_msg(msg);
+}
+
+static void *
+_worker(void *arg)
+{
+	struct timeval start, end;
+	uint64_t wait_usec, run_usec;
+	conn_t *con;
+	int lane;
+
+	slurm_mutex_lock(&worker_mutex);
+	while (1) {
+		if ((con = _next_work(&lane)) == NULL) {
+			worker_idle++;
+			pthread_cond_wait(&worker_cond, &worker_mutex);
+			worker_idle--;
+			continue;
+		}
+		worker_busy++;
+		slurm_mutex_unlock(&worker_mutex);
+
+		if (lane < 0) {
+			if (!_receive_request(con))
+				_free_conn(con);
+			slurm_mutex_lock(&worker_mutex);
+			worker_busy--;
+			pthread_cond_broadcast(&worker_done_cond);
+			continue;
+		}
+
+		gettimeofday(&start, NULL);
+		_service_connection(con);
+		gettimeofday(&end, NULL);
+		wait_usec = _usec_diff(&start, &con->accept_time);
+		run_usec  = _usec_diff(&end, &start);
+		_free_conn(con);
+
+		slurm_mutex_lock(&worker_mutex);
+		worker_busy--;
+		rpc_lane[lane].running--;
+		rpc_lane[lane].cnt++;
+		rpc_lane[lane].wait_usec += wait_usec;
+		rpc_lane[lane].wait_max_usec =
+			MAX(rpc_lane[lane].wait_max_usec, wait_usec);
+		rpc_lane[lane].run_usec += run_usec;
+		rpc_lane[lane].run_max_usec =
+			MAX(rpc_lane[lane].run_max_usec, run_usec);
+		/* A lane may be below its limits again */
+		if ((rpc_lane[lane].running == (rpc_lane_max[lane] - 1)) ||
+		    ((lane != RPC_LANE_URGENT) &&
+		     ((rpc_lane[RPC_LANE_LAUNCH].running +
+		       rpc_lane[RPC_LANE_OTHER].running) ==
+		      (MAX_THREADS - RPC_WORKER_RESERVE - 1))))
+			pthread_cond_broadcast(&worker_cond);
+		pthread_cond_broadcast(&worker_done_cond);
+	}
+	slurm_mutex_unlock(&worker_mutex);
 	return NULL;
 }
 
+/* Wait until all queued requests have been serviced */
+static void
+_wait_for_workers(void)
+{
+	int lane;
+	bool queued;
+
+	slurm_mutex_lock(&worker_mutex);
+	while (1) {
+		queued = (recv_head != NULL);
+		for (lane = 0; lane < RPC_LANE_CNT; lane++) {
+			if (rpc_lane[lane].head)
+				queued = true;
+		}
+		if (!queued && (worker_busy == 0))
+			break;
+		verbose("waiting on %d active workers", worker_busy);
+		pthread_cond_wait(&worker_done_cond, &worker_mutex);
+	}
+	slurm_mutex_unlock(&worker_mutex);
+}
+
+/*
+ * slurmd_rpc_stats - report the requests queued and serviced on each lane,
+ *	one line per lane
+ * RET string, xfree() when done
+ */
+extern char *
+slurmd_rpc_stats(void)
+{
+	char *stats = NULL;
+	rpc_lane_t *l;
+	int lane;
+
+	slurm_mutex_lock(&worker_mutex);
+	for (lane = 0; lane < RPC_LANE_CNT; lane++) {
+		l = &rpc_lane[lane];
+		xstrfmtcat(stats, "%s%s: count=%u queued=%d running=%d "
+			   "wait_avg=%"PRIu64"us wait_max=%"PRIu64"us "
+			   "run_avg=%"PRIu64"us run_max=%"PRIu64"us",
+			   (lane ? "\n" : ""), rpc_lane_name[lane], l->cnt,
+			   l->queued, l->running,
+			   (l->cnt ? (l->wait_usec / l->cnt) : 0),
+			   l->wait_max_usec,
+			   (l->cnt ? (l->run_usec / l->cnt) : 0),
+			   l->run_max_usec);
+	}
+	slurm_mutex_unlock(&worker_mutex);
+
+	return stats;
+}
+
+static void
+_handle_connection(slurm_fd_t fd, slurm_addr_t *cli)
+{
+	conn_t *con = xmalloc(sizeof(conn_t));
+
+	con->fd       = fd;
+	con->cli_addr = cli;
+	gettimeofday(&con->accept_time, NULL);
+	fd_set_close_on_exec(fd);
+
+	slurm_mutex_lock(&worker_mutex);
+	/* Leave further connections to the kernel's listen queue until
+	 * workers have received some of those queued */
+	while ((recv_queued >= MAX_RECV_QUEUE) && !_shutdown) {
+		struct timespec ts;
+		ts.tv_sec  = time(NULL) + 1;
+		ts.tv_nsec = 0;
+		pthread_cond_timedwait(&worker_done_cond, &worker_mutex, &ts);
+	}
+	recv_queued++;
+	_queue_work(&recv_head, &recv_tail, con);
+	slurm_mutex_unlock(&worker_mutex);
+}
+
+static void
+_service_connection(conn_t *con)
+{
+	slurm_msg_t *msg = con->msg;
+
+	/* The reply tells slurmctld whether the connection is kept */
+	if ((msg->flags & SLURM_KEEP_CONN) && !_keep_conn(con, msg))
+		msg->flags &= (~SLURM_KEEP_CONN);
+	slurmd_req(msg);
+}
+
 extern int
 send_registration_msg(uint32_t status, bool startup)
 {
@@ -631,7 +1139,7 @@ _fill_registration_msg(slurm_node_registration_status_msg_t *msg)
 			error("switch_g_build_node_info: %m");
 	}
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(NO_VAL);
 	msg->job_count = list_count(steps);
 	msg->job_id    = xmalloc(msg->job_count * sizeof(*msg->job_id));
 	/* Note: Running batch jobs will have step_id == NO_VAL */
@@ -641,8 +1149,8 @@ _fill_registration_msg(slurm_node_registration_status_msg_t *msg)
 	n = 0;
 	while ((stepd = list_next(i))) {
 		int fd;
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1) {
 			--(msg->job_count);
 			continue;
@@ -891,12 +1399,12 @@ _reconfigure(void)
 	 * file handle
 	 */
 
-	steps = stepd_available(conf->spooldir, conf->node_name);
+	steps = step_registry_list(NO_VAL);
 	i = list_iterator_create(steps);
 	while ((stepd = list_next(i))) {
 		int fd;
-		fd = stepd_connect(stepd->directory, stepd->nodename,
-				   stepd->jobid, stepd->stepid);
+		fd = step_registry_connect(stepd->directory, stepd->nodename,
+					   stepd->jobid, stepd->stepid);
 		if (fd == -1)
 			continue;
 		if(stepd_reconfig(fd) != SLURM_SUCCESS)
@@ -1277,6 +1785,8 @@ _slurmd_init(void)
 		stepd_cleanup_sockets(conf->spooldir, conf->node_name);
 	}
 
+	step_registry_init();
+
 	if (conf->daemonize) {
 		if (conf->logfile && (conf->logfile[0] == '/')) {
 			char *slash_ptr, *work_dir;
@@ -1399,6 +1909,7 @@ _slurmd_fini(void)
 	gres_plugin_fini();
 	slurm_topo_fini();
 	slurmd_req(NULL);	/* purge memory allocated by slurmd_req() */
+	step_registry_fini();
 	fini_setproctitle();
 	slurm_select_fini();
 	slurm_jobacct_gather_fini();
@@ -159,5 +159,12 @@ int send_registration_msg(uint32_t status, bool startup);
  */
 int save_cred_state(slurm_cred_ctx_t vctx);
 
+/*
+ * slurmd_rpc_stats - report the requests queued and serviced on each lane
+ *	of the worker pool, one line per lane
+ * RET string, xfree() when done
+ */
+extern char *slurmd_rpc_stats(void);
+
 
 #endif /* !_SLURMD_H */
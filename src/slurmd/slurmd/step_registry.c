@@ -0,0 +1,300 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/step_registry.c - registry of running slurmstepds
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/stepd_api.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "src/slurmd/slurmd/slurmd.h"
+#include "src/slurmd/slurmd/step_registry.h"
+
+/* Steps are hashed by job id, so all steps of a job share a bucket */
+#define STEP_HASH_SIZE	1024
+#define STEP_HASH(_jobid)	((_jobid) % STEP_HASH_SIZE)
+
+typedef struct step_reg {
+	uint32_t jobid;
+	uint32_t stepid;
+	uid_t uid;
+	pid_t pid;		/* slurmstepd pid, 0 if unknown */
+	struct step_reg *next;
+} step_reg_t;
+
+static pthread_mutex_t step_lock = PTHREAD_MUTEX_INITIALIZER;
+static step_reg_t *step_hash[STEP_HASH_SIZE];
+
+/*
+ * The slurmstepd is not a child of slurmd, so there is no notification
+ * of its exit. Check that the process still exists instead. A step whose
+ * pid is unknown is reported as running and the caller's connection
+ * attempt to its socket decides.
+ */
+static bool
+_step_alive(step_reg_t *step)
+{
+	if (step->pid <= 0)
+		return true;
+	if ((kill(step->pid, 0) == 0) || (errno == EPERM))
+		return true;
+	debug3("slurmstepd for %u.%u (pid %d) has exited",
+	       step->jobid, step->stepid, (int) step->pid);
+	return false;
+}
+
+static void
+_free_step_loc(step_loc_t *loc)
+{
+	xfree(loc->directory);
+	xfree(loc->nodename);
+	xfree(loc);
+}
+
+/* Append the live steps in one hash bucket to list l, removing dead
+ * ones. step_lock must be locked. */
+static void
+_list_bucket(List l, int inx, uint32_t jobid)
+{
+	step_reg_t **prev = &step_hash[inx], *step;
+	step_loc_t *loc;
+
+	while ((step = *prev)) {
+		if ((jobid != NO_VAL) && (step->jobid != jobid)) {
+			prev = &step->next;
+			continue;
+		}
+		if (!_step_alive(step)) {
+			*prev = step->next;
+			xfree(step);
+			continue;
+		}
+		loc = xmalloc(sizeof(step_loc_t));
+		loc->directory = xstrdup(conf->spooldir);
+		loc->nodename  = xstrdup(conf->node_name);
+		loc->jobid     = step->jobid;
+		loc->stepid    = step->stepid;
+		list_append(l, loc);
+		prev = &step->next;
+	}
+}
+
+extern void
+step_registry_init(void)
+{
+	List steps;
+	ListIterator iter;
+	step_loc_t *stepd;
+	slurmstepd_info_t *stepd_info;
+	pid_t pid;
+	int fd, cnt = 0;
+
+	steps = stepd_available(conf->spooldir, conf->node_name);
+	iter = list_iterator_create(steps);
+	while ((stepd = list_next(iter))) {
+		fd = stepd_connect(stepd->directory, stepd->nodename,
+				   stepd->jobid, stepd->stepid);
+		if (fd == -1)
+			continue;
+		stepd_info = stepd_get_info(fd);
+		pid = stepd_daemon_pid(fd);
+		close(fd);
+		if (stepd_info == NULL) {
+			debug("stepd_get_info failed %u.%u: %m",
+			      stepd->jobid, stepd->stepid);
+			continue;
+		}
+		step_registry_add(stepd->jobid, stepd->stepid, stepd_info->uid,
+				  (pid == (pid_t) -1) ? 0 : pid);
+		xfree(stepd_info);
+		cnt++;
+	}
+	list_iterator_destroy(iter);
+	list_destroy(steps);
+
+	if (cnt)
+		info("Recovered %d running job steps", cnt);
+}
+
+extern void
+step_registry_fini(void)
+{
+	step_reg_t *step;
+	int inx;
+
+	slurm_mutex_lock(&step_lock);
+	for (inx = 0; inx < STEP_HASH_SIZE; inx++) {
+		while ((step = step_hash[inx])) {
+			step_hash[inx] = step->next;
+			xfree(step);
+		}
+	}
+	slurm_mutex_unlock(&step_lock);
+}
+
+extern void
+step_registry_add(uint32_t jobid, uint32_t stepid,
+		  uid_t uid, pid_t pid)
+{
+	step_reg_t *step;
+	int inx = STEP_HASH(jobid);
+
+	slurm_mutex_lock(&step_lock);
+	for (step = step_hash[inx]; step; step = step->next) {
+		if ((step->jobid == jobid) && (step->stepid == stepid))
+			break;
+	}
+	if (step == NULL) {
+		step = xmalloc(sizeof(step_reg_t));
+		step->jobid  = jobid;
+		step->stepid = stepid;
+		step->next   = step_hash[inx];
+		step_hash[inx] = step;
+	}
+	step->uid = uid;
+	step->pid = pid;
+	slurm_mutex_unlock(&step_lock);
+}
+
+extern void
+step_registry_remove(uint32_t jobid, uint32_t stepid)
+{
+	step_reg_t **prev, *step;
+
+	slurm_mutex_lock(&step_lock);
+	prev = &step_hash[STEP_HASH(jobid)];
+	while ((step = *prev)) {
+		if ((step->jobid == jobid) && (step->stepid == stepid)) {
+			*prev = step->next;
+			xfree(step);
+			break;
+		}
+		prev = &step->next;
+	}
+	slurm_mutex_unlock(&step_lock);
+}
+
+extern void
+step_registry_remove_exited(uint32_t jobid, uint32_t stepid)
+{
+	step_reg_t **prev, *step;
+
+	slurm_mutex_lock(&step_lock);
+	prev = &step_hash[STEP_HASH(jobid)];
+	while ((step = *prev)) {
+		if ((step->jobid == jobid) && (step->stepid == stepid)) {
+			if ((step->pid > 0) && !_step_alive(step)) {
+				*prev = step->next;
+				xfree(step);
+			}
+			break;
+		}
+		prev = &step->next;
+	}
+	slurm_mutex_unlock(&step_lock);
+}
+
+extern int
+step_registry_connect(const char *directory, const char *nodename,
+		      uint32_t jobid, uint32_t stepid)
+{
+	int fd, err;
+
+	fd = stepd_connect(directory, nodename, jobid, stepid);
+	if (fd == -1) {
+		err = errno;
+		if ((err == ENOENT) || (err == ECONNREFUSED)) {
+			debug3("slurmstepd for %u.%u is gone, removing it "
+			       "from the step registry", jobid, stepid);
+			step_registry_remove(jobid, stepid);
+		}
+		errno = err;
+	}
+	return fd;
+}
+
+extern List
+step_registry_list(uint32_t jobid)
+{
+	List l = list_create((ListDelF) _free_step_loc);
+	int inx;
+
+	slurm_mutex_lock(&step_lock);
+	if (jobid != NO_VAL) {
+		_list_bucket(l, STEP_HASH(jobid), jobid);
+	} else {
+		for (inx = 0; inx < STEP_HASH_SIZE; inx++)
+			_list_bucket(l, inx, NO_VAL);
+	}
+	slurm_mutex_unlock(&step_lock);
+
+	return l;
+}
+
+extern long
+step_registry_job_uid(uint32_t jobid)
+{
+	step_reg_t **prev, *step;
+	long uid = -1;
+
+	slurm_mutex_lock(&step_lock);
+	prev = &step_hash[STEP_HASH(jobid)];
+	while ((step = *prev)) {
+		if (step->jobid != jobid) {
+			prev = &step->next;
+		} else if (!_step_alive(step)) {
+			*prev = step->next;
+			xfree(step);
+		} else {
+			uid = (long) step->uid;
+			break;
+		}
+	}
+	slurm_mutex_unlock(&step_lock);
+
+	return uid;
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************\
+ *  src/slurmd/slurmd/step_registry.h - registry of running slurmstepds
+ *****************************************************************************
+ *  Copyright (C) 2011 Lawrence Livermore National Security.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  CODE-OCEC-09-009. All rights reserved.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <https://computing.llnl.gov/linux/slurm/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _STEP_REGISTRY_H
+#define _STEP_REGISTRY_H
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include "src/common/list.h"
+
+/*
+ * Build the registry from the step sockets in the slurmd spool directory.
+ * This picks up the steps started by an earlier slurmd and is the only
+ * directory scan the registry makes.
+ */
+extern void step_registry_init(void);
+
+/* Free all registry entries */
+extern void step_registry_fini(void);
+
+/* Record a newly started slurmstepd */
+extern void step_registry_add(uint32_t jobid, uint32_t stepid,
+			      uid_t uid, pid_t pid);
+
+/* Remove a step from the registry */
+extern void step_registry_remove(uint32_t jobid, uint32_t stepid);
+
+/* Remove a step from the registry if its slurmstepd is known to have
+ * exited, otherwise leave it to be dropped when found to have exited */
+extern void step_registry_remove_exited(uint32_t jobid, uint32_t stepid);
+
+/*
+ * Connect to a step's slurmstepd as stepd_connect() does. If its socket
+ * is gone (ENOENT) or nothing is listening on it (ECONNREFUSED), the step
+ * has ended and is removed from the registry.
+ * RET socket file descriptor or -1 on error
+ */
+extern int step_registry_connect(const char *directory, const char *nodename,
+				 uint32_t jobid, uint32_t stepid);
+
+/*
+ * Return a List of step_loc_t (see stepd_api.h) for the running steps of
+ * job jobid, or of every job if jobid is NO_VAL. Entries whose slurmstepd
+ * no longer exists are dropped from the registry as they are found.
+ * The List must be destroyed by the caller.
+ */
+extern List step_registry_list(uint32_t jobid);
+
+/* RET user id of job jobid or -1 if no step of that job is running */
+extern long step_registry_job_uid(uint32_t jobid);
+
+#endif /* _STEP_REGISTRY_H */
@@ -2820,8 +2820,8 @@ extern int get_new_info_job(job_info_msg_t **info_ptr,
 	if (g_job_info_ptr) {
 		if (show_flags != last_flags)
 			g_job_info_ptr->last_update = 0;
-		error_code = slurm_load_jobs(g_job_info_ptr->last_update,
-					     &new_job_ptr, show_flags);
+		error_code = slurm_load_jobs_delta(g_job_info_ptr,
+						   &new_job_ptr, show_flags);
 		if (error_code == SLURM_SUCCESS) {
 			slurm_free_job_info_msg(g_job_info_ptr);
 			changed = 1;
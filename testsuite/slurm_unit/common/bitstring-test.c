@@ -14,6 +14,68 @@
 		pass( _msg );		\
 } while (0)
 
+/* Fill a bitstring with pseudo-random bits, about one in "density" set */
+static void
+_fill_random(bitstr_t *b, int density)
+{
+	bitoff_t bit;
+
+	bit_nclear(b, 0, bit_size(b) - 1);
+	for (bit = 0; bit < bit_size(b); bit++) {
+		if ((random() % density) == 0)
+			bit_set(b, bit);
+	}
+}
+
+/* Bit by bit versions of the word-parallel operations, for comparison */
+static int
+_slow_overlap(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit;
+	int count = 0;
+
+	for (bit = 0; bit < bit_size(b1); bit++) {
+		if (bit_test(b1, bit) && bit_test(b2, bit))
+			count++;
+	}
+	return count;
+}
+
+static bitoff_t
+_slow_ffs_and_not(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < bit_size(b1); bit++) {
+		if (bit_test(b1, bit) && !bit_test(b2, bit))
+			return bit;
+	}
+	return -1;
+}
+
+static bitoff_t
+_slow_fls(bitstr_t *b)
+{
+	bitoff_t bit;
+
+	for (bit = bit_size(b) - 1; bit >= 0; bit--) {
+		if (bit_test(b, bit))
+			return bit;
+	}
+	return -1;
+}
+
+/* Microseconds elapsed since *start */
+static long
+_usec_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+	       (now.tv_usec - start->tv_usec);
+}
+
 
 int
 main(int argc, char *argv[])
@@ -196,6 +258,161 @@ main(int argc, char *argv[])
 		TEST(bit_equal(bs, bs2), "bitstring");
 	}
 
+	note("Testing word-parallel operations");
+	{
+		/* odd sizes leave a partial last word */
+		int sizes[] = { 1, 31, 32, 33, 257, 1000, 4099 };
+		int i, j, ok_count = 1, ok_ffs = 1, ok_fls = 1, ok_and = 1;
+		int ok_any = 1, ok_super = 1;
+
+		srandom(1);
+		for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			bitstr_t *bs1 = bit_alloc(sizes[i]);
+			bitstr_t *bs2 = bit_alloc(sizes[i]);
+			bitstr_t *bs3 = bit_alloc(sizes[i]);
+			bitstr_t *bs4 = bit_alloc(sizes[i]);
+
+			for (j = 0; j < 20; j++) {
+				_fill_random(bs1, (j % 5) * 7 + 1);
+				_fill_random(bs2, (j % 3) * 11 + 1);
+				if (bit_overlap(bs1, bs2) !=
+				    _slow_overlap(bs1, bs2))
+					ok_count = 0;
+				if (bit_set_count(bs1) !=
+				    _slow_overlap(bs1, bs1))
+					ok_count = 0;
+				if ((bit_overlap_any(bs1, bs2) != 0) !=
+				    (_slow_overlap(bs1, bs2) != 0))
+					ok_any = 0;
+				if (bit_ffs_and_not(bs1, bs2) !=
+				    _slow_ffs_and_not(bs1, bs2))
+					ok_ffs = 0;
+				if (bit_fls(bs1) != _slow_fls(bs1))
+					ok_fls = 0;
+
+				/* bs3 = bs1 & ~bs2, computed two ways */
+				bit_copybits(bs3, bs1);
+				bit_and_not(bs3, bs2);
+				bit_copybits(bs4, bs2);
+				bit_not(bs4);
+				bit_and(bs4, bs1);
+				if (!bit_equal(bs3, bs4) ||
+				    !bit_super_set(bs3, bs1) ||
+				    bit_overlap_any(bs3, bs2))
+					ok_and = 0;
+
+				/* bits beyond the end after bit_not() must
+				 * be ignored */
+				bit_copybits(bs3, bs1);
+				bit_not(bs3);
+				if ((bit_set_count(bs3) !=
+				     sizes[i] - bit_set_count(bs1)) ||
+				    (bit_clear_count(bs3) != bit_set_count(bs1)))
+					ok_count = 0;
+				bit_not(bs3);
+				if (!bit_equal(bs3, bs1))
+					ok_and = 0;
+				bit_or(bs3, bs2);
+				if (!bit_super_set(bs1, bs3) ||
+				    !bit_super_set(bs2, bs3))
+					ok_super = 0;
+				if (bit_fls(bs3) != _slow_fls(bs3))
+					ok_fls = 0;
+			}
+			bit_nset(bs1, 0, sizes[i] - 1);
+			if ((bit_ffc(bs1) != -1) ||
+			    (bit_ffs_and_not(bs1, bs1) != -1))
+				ok_ffs = 0;
+			bit_not(bs1);
+			if ((bit_ffs(bs1) != -1) || (bit_fls(bs1) != -1) ||
+			    (bit_ffc(bs1) != 0))
+				ok_ffs = 0;
+
+			bit_free(bs1);
+			bit_free(bs2);
+			bit_free(bs3);
+			bit_free(bs4);
+		}
+		TEST(ok_count, "overlap/set_count");
+		TEST(ok_any, "overlap_any");
+		TEST(ok_ffs, "ffs/ffc/ffs_and_not");
+		TEST(ok_fls, "fls");
+		TEST(ok_and, "and_not");
+		TEST(ok_super, "super_set");
+	}
+
+	note("Timing word-parallel operations");
+	{
+		/* e.g. the core bitmap of a 4096 node, 32 core system */
+		int nbits = 131072, reps = 1000, i, sum = 0;
+		bitstr_t *bs1 = bit_alloc(nbits);
+		bitstr_t *bs2 = bit_alloc(nbits);
+		bitstr_t *bs3 = bit_alloc(nbits);
+		struct timeval tv;
+		long usec;
+
+		_fill_random(bs1, 2);
+		_fill_random(bs2, 3);
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < reps; i++)
+			sum += _slow_overlap(bs1, bs2) > 0;
+		usec = _usec_since(&tv);
+		note("bit by bit AND count: %ld nsec per %d bits",
+		     usec * 1000 / reps, nbits);
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < reps; i++)
+			sum += bit_overlap(bs1, bs2) > 0;
+		usec = _usec_since(&tv);
+		note("bit_overlap: %ld nsec per %d bits",
+		     usec * 1000 / reps, nbits);
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < reps; i++)
+			sum += bit_set_count(bs1) > 0;
+		usec = _usec_since(&tv);
+		note("bit_set_count: %ld nsec per %d bits",
+		     usec * 1000 / reps, nbits);
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < reps; i++) {
+			bit_copybits(bs3, bs2);
+			bit_not(bs3);
+			bit_and(bs3, bs1);
+		}
+		usec = _usec_since(&tv);
+		note("bit_copybits+bit_not+bit_and: %ld nsec per %d bits",
+		     usec * 1000 / reps, nbits);
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < reps; i++) {
+			bit_copybits(bs3, bs1);
+			bit_and_not(bs3, bs2);
+		}
+		usec = _usec_since(&tv);
+		note("bit_copybits+bit_and_not: %ld nsec per %d bits",
+		     usec * 1000 / reps, nbits);
+
+		/* worst case, the only bit of b1 & ~b2 is the last one */
+		bit_copybits(bs3, bs1);
+		bit_or(bs3, bs2);
+		bit_set(bs1, nbits - 1);
+		bit_clear(bs3, nbits - 1);
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < reps; i++)
+			sum += bit_ffs_and_not(bs1, bs3) > 0;
+		usec = _usec_since(&tv);
+		note("bit_ffs_and_not: %ld nsec per %d bits",
+		     usec * 1000 / reps, nbits);
+		TEST(bit_ffs_and_not(bs1, bs3) == nbits - 1, "ffs_and_not");
+
+		bit_free(bs1);
+		bit_free(bs2);
+		bit_free(bs3);
+		note("(checksum %d)", sum);
+	}
+
 	totals();
 	return failed;
 }
@@ -0,0 +1,206 @@
+/* Test of src/common/list.c queues, with timing of concurrent use
+ */
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <src/common/list.h>
+
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define THREAD_CNT	8
+#define ITEM_CNT	200000
+
+/* Items are encoded as (thread << 24) + sequence number + 1 */
+#define ITEM(_thread, _seq)	((void *) (uintptr_t) \
+				 ((((uintptr_t) (_thread)) << 24) + (_seq) + 1))
+#define ITEM_THREAD(_item)	((int) (((uintptr_t) (_item) - 1) >> 24))
+#define ITEM_SEQ(_item)		((int) (((uintptr_t) (_item) - 1) & 0xffffff))
+
+static ListQueue test_queue = NULL;
+static List test_list = NULL;
+static int item_cnt = ITEM_CNT;
+
+/* Microseconds elapsed since *start */
+static long
+_usec_since(struct timeval *start)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+	       (now.tv_usec - start->tv_usec);
+}
+
+static void *
+_queue_producer(void *arg)
+{
+	int i, id = (int) (uintptr_t) arg;
+
+	for (i = 0; i < item_cnt; i++)
+		list_queue_push(test_queue, ITEM(id, i));
+	return NULL;
+}
+
+static void *
+_list_producer(void *arg)
+{
+	int i, id = (int) (uintptr_t) arg;
+
+	for (i = 0; i < item_cnt; i++)
+		list_enqueue(test_list, ITEM(id, i));
+	return NULL;
+}
+
+/* Each thread appends to and removes from a list of its own, so the only
+ * shared state is that of the list node allocator */
+static void *
+_private_list_user(void *arg)
+{
+	List l = list_create(NULL);
+	ListIterator iter;
+	int i, j;
+
+	for (i = 0; i < item_cnt; i += 16) {
+		for (j = 0; j < 16; j++)
+			list_append(l, ITEM(0, j));
+		iter = list_iterator_create(l);
+		while (list_next(iter))
+			list_delete_item(iter);
+		list_iterator_destroy(iter);
+	}
+	list_destroy(l);
+	return NULL;
+}
+
+/* Start thread_cnt threads running func and return once they all end.
+ * If consume is set, items are removed from test_queue or test_list while
+ * the threads run. RET 1 if the items removed were complete and in order */
+static int
+_run_threads(int thread_cnt, void *(*func)(void *), int consume)
+{
+	pthread_t tid[THREAD_CNT];
+	int next_seq[THREAD_CNT];
+	int i, received = 0, ok = 1;
+	void *item;
+
+	for (i = 0; i < thread_cnt; i++) {
+		next_seq[i] = 0;
+		pthread_create(&tid[i], NULL, func, (void *) (uintptr_t) i);
+	}
+	while (consume && (received < (thread_cnt * item_cnt))) {
+		if (test_queue)
+			item = list_queue_pop(test_queue);
+		else
+			item = list_dequeue(test_list);
+		if (item == NULL)
+			continue;
+		if ((ITEM_THREAD(item) >= thread_cnt) ||
+		    (ITEM_SEQ(item) != next_seq[ITEM_THREAD(item)]))
+			ok = 0;
+		else
+			next_seq[ITEM_THREAD(item)]++;
+		received++;
+	}
+	for (i = 0; i < thread_cnt; i++)
+		pthread_join(tid[i], NULL);
+	return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+	note("Testing list_queue functions");
+	{
+		ListQueue q = list_queue_create(NULL);
+		int i, ok = 1;
+
+		TEST(list_queue_pop(q) == NULL, "pop from empty queue");
+		TEST(list_queue_push(q, ITEM(0, 0)) == 1, "push to empty queue");
+		TEST(list_queue_push(q, ITEM(0, 1)) == 0, "push to queue");
+		TEST(list_queue_count(q) == 2, "queue count");
+		TEST(list_queue_pop(q) == ITEM(0, 0), "pop first item");
+		TEST(list_queue_push(q, ITEM(0, 2)) == 1,
+		     "push after consumer took items");
+		for (i = 3; i < 1000; i++)
+			list_queue_push(q, ITEM(0, i));
+		for (i = 1; i < 1000; i++) {
+			if (list_queue_pop(q) != ITEM(0, i))
+				ok = 0;
+		}
+		TEST(ok, "items popped in order");
+		TEST(list_queue_pop(q) == NULL, "queue empty");
+		TEST(list_queue_count(q) == 0, "queue count zero");
+		for (i = 0; i < 10; i++)
+			list_queue_push(q, ITEM(0, i));
+		list_queue_destroy(q);
+	}
+
+	note("Testing list_queue with concurrent producers");
+	{
+		test_queue = list_queue_create(NULL);
+		TEST(_run_threads(THREAD_CNT, _queue_producer, 1),
+		     "all items received in order");
+		TEST(list_queue_pop(test_queue) == NULL, "queue empty");
+		list_queue_destroy(test_queue);
+		test_queue = NULL;
+	}
+
+	note("Timing concurrent list use");
+	{
+		struct timeval tv;
+		long usec;
+		int ok;
+
+		gettimeofday(&tv, NULL);
+		_run_threads(1, _private_list_user, 0);
+		usec = _usec_since(&tv);
+		note("private lists, 1 thread: %ld nsec per item",
+		     usec * 1000 / item_cnt);
+
+		gettimeofday(&tv, NULL);
+		_run_threads(THREAD_CNT, _private_list_user, 0);
+		usec = _usec_since(&tv);
+		note("private lists, %d threads: %ld nsec per item",
+		     THREAD_CNT, usec * 1000 / item_cnt / THREAD_CNT);
+
+		test_list = list_create(NULL);
+		gettimeofday(&tv, NULL);
+		ok = _run_threads(THREAD_CNT, _list_producer, 1);
+		usec = _usec_since(&tv);
+		note("list_enqueue/list_dequeue, %d producers: "
+		     "%ld nsec per item",
+		     THREAD_CNT, usec * 1000 / item_cnt / THREAD_CNT);
+		TEST(ok, "list items received in order");
+		list_destroy(test_list);
+		test_list = NULL;
+
+		test_queue = list_queue_create(NULL);
+		gettimeofday(&tv, NULL);
+		ok = _run_threads(THREAD_CNT, _queue_producer, 1);
+		usec = _usec_since(&tv);
+		note("list_queue_push/list_queue_pop, %d producers: "
+		     "%ld nsec per item",
+		     THREAD_CNT, usec * 1000 / item_cnt / THREAD_CNT);
+		TEST(ok, "queue items received in order");
+		list_queue_destroy(test_queue);
+		test_queue = NULL;
+	}
+
+	totals();
+	return failed;
+}
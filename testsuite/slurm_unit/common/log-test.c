@@ -1,5 +1,9 @@
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <slurm/slurm_errno.h>
@@ -9,6 +13,111 @@ int bad_func()
 {
 	slurm_seterrno_ret(EINVAL);
 }
+
+/* Return 1 if file contains the string, otherwise 0 */
+int file_has(char *file, char *string)
+{
+	char line[256];
+	int found = 0;
+	FILE *fp = fopen(file, "r");
+
+	if (fp == NULL)
+		return 0;
+	while (!found && fgets(line, sizeof(line), fp))
+		found = (strstr(line, string) != NULL);
+	fclose(fp);
+	return found;
+}
+
+/* Messages logged through the writer thread just before exit() must
+ * still be written. RET 0 on success */
+int test_async_exit(void)
+{
+	char logfile[] = "/tmp/log-test.XXXXXX";
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	int fd, status, rc = 0;
+	pid_t pid;
+
+	if ((fd = mkstemp(logfile)) < 0) {
+		error("mkstemp: %m");
+		return 1;
+	}
+	close(fd);
+
+	pid = fork();
+	if (pid == 0) {
+		log_opts.stderr_level  = LOG_LEVEL_QUIET;
+		log_opts.logfile_level = LOG_LEVEL_DEBUG;
+		log_init("log-test", log_opts, 0, logfile);
+		log_async_init();
+		error("async error before exit");
+		info ("async info before exit");
+		exit(0);
+	}
+	if ((pid < 0) || (waitpid(pid, &status, 0) != pid)) {
+		error("fork: %m");
+		rc = 1;
+	} else if (!file_has(logfile, "async info before exit") ||
+		   !file_has(logfile, "async error before exit")) {
+		error("messages logged before exit() were lost");
+		rc = 1;
+	}
+	(void) unlink(logfile);
+	return rc;
+}
+
+static void *debug_flood(void *arg)
+{
+	while (1)
+		debug("async flood");
+	return NULL;
+}
+
+/* Children forked while other threads log must be able to exit() and
+ * error() must return while other threads keep logging. RET 0 on success */
+int test_async_fork(void)
+{
+	char logfile[] = "/tmp/log-test.XXXXXX";
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	pthread_t tid;
+	int fd, i, status, rc = 0;
+	pid_t pid, child;
+
+	if ((fd = mkstemp(logfile)) < 0) {
+		error("mkstemp: %m");
+		return 1;
+	}
+	close(fd);
+
+	pid = fork();
+	if (pid == 0) {
+		alarm(60);	/* SIGALRM fails the test on a hang */
+		log_opts.stderr_level  = LOG_LEVEL_QUIET;
+		log_opts.logfile_level = LOG_LEVEL_DEBUG;
+		log_init("log-test", log_opts, 0, logfile);
+		log_async_init();
+		pthread_create(&tid, NULL, debug_flood, NULL);
+		for (i = 0; i < 200; i++) {
+			error("async error %d while flooding", i);
+			child = fork();
+			if (child == 0)
+				exit(0);
+			if ((child < 0) || (waitpid(child, &status, 0) != child))
+				exit(1);
+		}
+		_exit(0);
+	}
+	if ((pid < 0) || (waitpid(pid, &status, 0) != pid)) {
+		error("fork: %m");
+		rc = 1;
+	} else if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		error("fork or error() while logging hung or failed");
+		rc = 1;
+	}
+	(void) unlink(logfile);
+	return rc;
+}
+
 int main(int ac, char **av)
 {
 	/* test elements */
@@ -60,8 +169,26 @@ int main(int ac, char **av)
 	 * dumping core
 	 */
 
+	/* test logging through the writer thread */
+	log_async_init();
+	info   ("testing async info");
+	debug2 ("testing async debug level 2");
+	debug3 ("ERROR: Should not see this.");
+	if (fork() == 0) {
+		info("in child of async log");
+		exit(0);
+	}
+	log_flush();
+	info   ("testing async info after flush");
+	log_fini();
+
 	if (bad_func() < 0)
 		error("bad_func: %m");
+
+	if (test_async_exit())
+		return 1;
+	if (test_async_fork())
+		return 1;
 	return 0;
 }
 	